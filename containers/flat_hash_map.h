@@ -0,0 +1,239 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_CONTAINERS_FLAT_HASH_MAP_H_
+#define COMMA_CONTAINERS_FLAT_HASH_MAP_H_
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <boost/functional/hash.hpp>
+#include "../base/types.h"
+
+namespace comma {
+
+/// hash map with open addressing (linear probing) over a flat slot table;
+/// entries are stored contiguously in insertion order, thus iteration is
+/// in insertion order (as long as nothing was erased) and there is no
+/// per-entry node allocation;
+/// erase() moves the last entry into the place of the erased one;
+/// any insertion or erasure invalidates iterators and references;
+/// lookups, including operator[] and try_emplace() on an existing key,
+/// do not copy the key or construct a value
+template < typename K, typename V, typename Hash = boost::hash< K >, typename Equal = std::equal_to< K > >
+class flat_hash_map
+{
+    public:
+        typedef K key_type;
+        typedef V mapped_type;
+        typedef std::pair< K, V > value_type;
+        typedef typename std::vector< value_type >::iterator iterator;
+        typedef typename std::vector< value_type >::const_iterator const_iterator;
+
+        /// constructor
+        flat_hash_map( const Hash& hash = Hash(), const Equal& equal = Equal() ) : hash_( hash ), equal_( equal ), mask_( 0 ) {}
+
+        /// return iterator to entry with given key or end()
+        iterator find( const K& key ) { std::size_t s = find_( key ); return s == npos_ ? entries_.end() : entries_.begin() + slots_[s].index; }
+
+        /// return iterator to entry with given key or end()
+        const_iterator find( const K& key ) const { std::size_t s = find_( key ); return s == npos_ ? entries_.end() : entries_.begin() + slots_[s].index; }
+
+        /// insert, if key does not exist; return iterator to the entry and true, if inserted
+        std::pair< iterator, bool > insert( const value_type& v );
+
+        /// insert entry with default-constructed value, if key does not exist;
+        /// key is copied and value constructed only, if inserted
+        /// @return iterator to the entry and true, if inserted
+        std::pair< iterator, bool > try_emplace( const K& key );
+
+        /// insert entry with given value, if key does not exist; key and value are copied only, if inserted
+        /// @return iterator to the entry and true, if inserted
+        std::pair< iterator, bool > try_emplace( const K& key, const V& value );
+
+        /// return value for given key, insert default-constructed value, if key does not exist
+        V& operator[]( const K& key ) { return try_emplace( key ).first->second; }
+
+        /// return value for given key
+        /// @throw std::out_of_range, if key does not exist
+        V& at( const K& key ) { iterator it = find( key ); if( it == end() ) { throw std::out_of_range( "flat_hash_map::at: key not found" ); } return it->second; }
+
+        /// return value for given key
+        /// @throw std::out_of_range, if key does not exist
+        const V& at( const K& key ) const { const_iterator it = find( key ); if( it == end() ) { throw std::out_of_range( "flat_hash_map::at: key not found" ); } return it->second; }
+
+        /// erase entry with given key, return number of erased entries
+        std::size_t erase( const K& key );
+
+        /// preallocate for given number of entries
+        void reserve( std::size_t size );
+
+        /// clear, keep allocated memory
+        void clear();
+
+        std::size_t size() const { return entries_.size(); }
+        bool empty() const { return entries_.empty(); }
+        iterator begin() { return entries_.begin(); }
+        iterator end() { return entries_.end(); }
+        const_iterator begin() const { return entries_.begin(); }
+        const_iterator end() const { return entries_.end(); }
+
+    private:
+        struct slot
+        {
+            comma::uint32 index; // index into entries_
+            comma::uint32 tag; // upper bits of hash; 0: empty slot
+            slot() : index( 0 ), tag( 0 ) {}
+        };
+        static const std::size_t npos_ = std::size_t( -1 );
+        Hash hash_;
+        Equal equal_;
+        std::vector< value_type > entries_;
+        std::vector< slot > slots_;
+        std::size_t mask_;
+
+        static comma::uint32 tag_( std::size_t h ) { comma::uint32 t = comma::uint32( comma::uint64( h ) >> 32 ) ^ comma::uint32( h ); return t == 0 ? 1 : t; }
+        std::size_t find_( const K& key ) const { std::size_t h; return probe_( key, h ); }
+        std::size_t probe_( const K& key, std::size_t& h ) const;
+        iterator insert_( std::size_t h, const value_type& v );
+        void rehash_( std::size_t size );
+        void place_( std::size_t h, comma::uint32 index );
+};
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline std::size_t flat_hash_map< K, V, Hash, Equal >::probe_( const K& key, std::size_t& h ) const // return slot of key and its hash
+{
+    h = hash_( key );
+    if( entries_.empty() ) { return npos_; }
+    comma::uint32 t = tag_( h );
+    for( std::size_t s = h & mask_; slots_[s].tag != 0; s = ( s + 1 ) & mask_ )
+    {
+        if( slots_[s].tag == t && equal_( entries_[ slots_[s].index ].first, key ) ) { return s; }
+    }
+    return npos_;
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline std::pair< typename flat_hash_map< K, V, Hash, Equal >::iterator, bool > flat_hash_map< K, V, Hash, Equal >::insert( const value_type& v )
+{
+    std::size_t h;
+    std::size_t s = probe_( v.first, h );
+    if( s != npos_ ) { return std::make_pair( entries_.begin() + slots_[s].index, false ); }
+    return std::make_pair( insert_( h, v ), true );
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline std::pair< typename flat_hash_map< K, V, Hash, Equal >::iterator, bool > flat_hash_map< K, V, Hash, Equal >::try_emplace( const K& key )
+{
+    std::size_t h;
+    std::size_t s = probe_( key, h );
+    if( s != npos_ ) { return std::make_pair( entries_.begin() + slots_[s].index, false ); }
+    return std::make_pair( insert_( h, value_type( key, V() ) ), true );
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline std::pair< typename flat_hash_map< K, V, Hash, Equal >::iterator, bool > flat_hash_map< K, V, Hash, Equal >::try_emplace( const K& key, const V& value )
+{
+    std::size_t h;
+    std::size_t s = probe_( key, h );
+    if( s != npos_ ) { return std::make_pair( entries_.begin() + slots_[s].index, false ); }
+    return std::make_pair( insert_( h, value_type( key, value ) ), true );
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline typename flat_hash_map< K, V, Hash, Equal >::iterator flat_hash_map< K, V, Hash, Equal >::insert_( std::size_t h, const value_type& v ) // insert key known not to exist
+{
+    if( ( entries_.size() + 1 ) * 2 > slots_.size() ) { rehash_( slots_.empty() ? 16 : slots_.size() * 2 ); }
+    place_( h, entries_.size() );
+    entries_.push_back( v );
+    return entries_.end() - 1;
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline std::size_t flat_hash_map< K, V, Hash, Equal >::erase( const K& key )
+{
+    std::size_t s = find_( key );
+    if( s == npos_ ) { return 0; }
+    comma::uint32 index = slots_[s].index;
+    slots_[s] = slot();
+    for( std::size_t n = ( s + 1 ) & mask_; slots_[n].tag != 0; n = ( n + 1 ) & mask_ ) // backward shift: re-place the rest of the probe sequence
+    {
+        slot moved = slots_[n];
+        slots_[n] = slot();
+        place_( hash_( entries_[ moved.index ].first ), moved.index );
+    }
+    std::size_t last = entries_.size() - 1;
+    if( index != last )
+    {
+        std::size_t m = find_( entries_[last].first );
+        slots_[m].index = index;
+        std::swap( entries_[index], entries_[last] );
+    }
+    entries_.pop_back();
+    return 1;
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline void flat_hash_map< K, V, Hash, Equal >::reserve( std::size_t size )
+{
+    entries_.reserve( size );
+    std::size_t n = 16;
+    while( n < size * 2 ) { n *= 2; }
+    if( n > slots_.size() ) { rehash_( n ); }
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline void flat_hash_map< K, V, Hash, Equal >::clear()
+{
+    entries_.clear();
+    std::fill( slots_.begin(), slots_.end(), slot() );
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline void flat_hash_map< K, V, Hash, Equal >::rehash_( std::size_t size )
+{
+    slots_.assign( size, slot() );
+    mask_ = size - 1;
+    for( std::size_t i = 0; i < entries_.size(); ++i ) { place_( hash_( entries_[i].first ), i ); }
+}
+
+template < typename K, typename V, typename Hash, typename Equal >
+inline void flat_hash_map< K, V, Hash, Equal >::place_( std::size_t h, comma::uint32 index )
+{
+    std::size_t s = h & mask_;
+    while( slots_[s].tag != 0 ) { s = ( s + 1 ) & mask_; }
+    slots_[s].index = index;
+    slots_[s].tag = tag_( h );
+}
+
+} // namespace comma {
+
+#endif // COMMA_CONTAINERS_FLAT_HASH_MAP_H_
@@ -0,0 +1,219 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_CONTAINERS_MPMC_QUEUE_H_
+#define COMMA_CONTAINERS_MPMC_QUEUE_H_
+
+#include <cstddef>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "waiting.h"
+
+namespace comma {
+
+/// bounded lock-free multi-producer multi-consumer queue on top of a ring
+/// of preallocated elements; any number of threads may push and pop
+///
+/// each slot carries a sequence number telling whether it is ready to be
+/// written or read in the current lap (as in Dmitry Vyukov's bounded mpmc
+/// queue), thus producers and consumers claim slots with a single
+/// compare-and-swap each and do not contend with each other unless the
+/// queue is nearly full or nearly empty
+///
+/// batch push and pop claim slots one at a time, but notify waiting
+/// threads only once per batch
+///
+/// Wait: how push() and pop() wait, while the queue is full or empty;
+/// see waiting.h; try_push() and try_pop() never wait
+///
+/// see unit test for usage
+template < typename T, typename Wait = waiting::blocking >
+class mpmc_queue : public boost::noncopyable
+{
+    public:
+        /// constructor
+        /// @param capacity rounded up to a power of 2, at least 2
+        mpmc_queue( std::size_t capacity );
+
+        /// push, if not full; return true on success
+        bool try_push( const T& t ) { if( !push_( t ) ) { return false; } not_empty_.notify(); return true; }
+
+        /// push as many values as there is room for; return number of values pushed
+        std::size_t try_push( const T* values, std::size_t size );
+
+        /// push, wait while full
+        void push( const T& t ) { push( &t, 1 ); }
+
+        /// push all values, wait while full
+        void push( const T* values, std::size_t size );
+
+        /// pop, if not empty; return true on success
+        bool try_pop( T& t ) { if( !pop_( t ) ) { return false; } not_full_.notify(); return true; }
+
+        /// pop up to given number of values; return number of values popped
+        std::size_t try_pop( T* values, std::size_t size );
+
+        /// pop, wait while empty
+        void pop( T& t ) { pop( &t, 1 ); }
+
+        /// pop, wait while empty
+        T pop() { T t; pop( t ); return t; }
+
+        /// wait while empty, then pop up to given number of values; return number of values popped
+        std::size_t pop( T* values, std::size_t size );
+
+        /// return capacity
+        std::size_t capacity() const { return cells_.size(); }
+
+        /// return number of values in the queue; approximate, since other threads may push and pop concurrently
+        std::size_t size() const { std::size_t head = load_( head_ ); std::size_t tail = load_( tail_ ); return tail > head ? tail - head : 0; }
+
+        /// return true, if empty; approximate, since other threads may push and pop concurrently
+        bool empty() const { return size() == 0; }
+
+    private:
+        enum { cache_line_size = 64 };
+        struct cell
+        {
+            std::size_t sequence;
+            T value;
+        };
+        std::vector< cell > cells_;
+        std::size_t mask_;
+        char padding0_[ cache_line_size ];
+        std::size_t tail_; // next to push
+        char padding1_[ cache_line_size ];
+        std::size_t head_; // next to pop
+        char padding2_[ cache_line_size ];
+        Wait not_empty_;
+        Wait not_full_;
+        char padding3_[ cache_line_size ];
+
+        static std::size_t load_( const std::size_t& i ) { return __atomic_load_n( &i, __ATOMIC_ACQUIRE ); }
+        static void store_( std::size_t& i, std::size_t value ) { __atomic_store_n( &i, value, __ATOMIC_RELEASE ); }
+        static std::size_t round_up_( std::size_t n ) { std::size_t s = 2; while( s < n ) { s <<= 1; } return s; }
+        bool push_( const T& t );
+        bool pop_( T& t );
+        bool full_() const { std::size_t tail = load_( tail_ ); return std::ptrdiff_t( load_( cells_[ tail & mask_ ].sequence ) - tail ) < 0; }
+        bool empty_() const { std::size_t head = load_( head_ ); return std::ptrdiff_t( load_( cells_[ head & mask_ ].sequence ) - ( head + 1 ) ) < 0; }
+};
+
+template < typename T, typename Wait >
+inline mpmc_queue< T, Wait >::mpmc_queue( std::size_t capacity )
+    : cells_( round_up_( capacity ) )
+    , mask_( cells_.size() - 1 )
+    , tail_( 0 )
+    , head_( 0 )
+{
+    for( std::size_t i = 0; i < cells_.size(); ++i ) { cells_[i].sequence = i; }
+}
+
+template < typename T, typename Wait >
+inline bool mpmc_queue< T, Wait >::push_( const T& t )
+{
+    std::size_t tail = __atomic_load_n( &tail_, __ATOMIC_RELAXED );
+    while( true )
+    {
+        std::ptrdiff_t diff = std::ptrdiff_t( load_( cells_[ tail & mask_ ].sequence ) - tail );
+        if( diff < 0 ) { return false; } // slot not popped yet in the previous lap: full
+        if( diff > 0 ) { tail = __atomic_load_n( &tail_, __ATOMIC_RELAXED ); continue; } // another producer got there first
+        if( __atomic_compare_exchange_n( &tail_, &tail, tail + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) { break; } // on failure, tail gets updated
+    }
+    cell& c = cells_[ tail & mask_ ];
+    c.value = t;
+    store_( c.sequence, tail + 1 );
+    return true;
+}
+
+template < typename T, typename Wait >
+inline bool mpmc_queue< T, Wait >::pop_( T& t )
+{
+    std::size_t head = __atomic_load_n( &head_, __ATOMIC_RELAXED );
+    while( true )
+    {
+        std::ptrdiff_t diff = std::ptrdiff_t( load_( cells_[ head & mask_ ].sequence ) - ( head + 1 ) );
+        if( diff < 0 ) { return false; } // slot not pushed yet: empty
+        if( diff > 0 ) { head = __atomic_load_n( &head_, __ATOMIC_RELAXED ); continue; } // another consumer got there first
+        if( __atomic_compare_exchange_n( &head_, &head, head + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) { break; } // on failure, head gets updated
+    }
+    cell& c = cells_[ head & mask_ ];
+    t = c.value;
+    store_( c.sequence, head + cells_.size() ); // ready to be pushed in the next lap
+    return true;
+}
+
+template < typename T, typename Wait >
+inline std::size_t mpmc_queue< T, Wait >::try_push( const T* values, std::size_t size )
+{
+    std::size_t n = 0;
+    while( n < size && push_( values[n] ) ) { ++n; }
+    if( n > 0 ) { not_empty_.notify(); }
+    return n;
+}
+
+template < typename T, typename Wait >
+inline void mpmc_queue< T, Wait >::push( const T* values, std::size_t size )
+{
+    while( size > 0 )
+    {
+        std::size_t n = try_push( values, size );
+        values += n;
+        size -= n;
+        if( n > 0 ) { continue; }
+        comma::uint32 epoch = not_full_.prepare();
+        if( full_() ) { not_full_.wait( epoch ); }
+        not_full_.done();
+    }
+}
+
+template < typename T, typename Wait >
+inline std::size_t mpmc_queue< T, Wait >::try_pop( T* values, std::size_t size )
+{
+    std::size_t n = 0;
+    while( n < size && pop_( values[n] ) ) { ++n; }
+    if( n > 0 ) { not_full_.notify(); }
+    return n;
+}
+
+template < typename T, typename Wait >
+inline std::size_t mpmc_queue< T, Wait >::pop( T* values, std::size_t size )
+{
+    while( true )
+    {
+        std::size_t n = try_pop( values, size );
+        if( n > 0 || size == 0 ) { return n; }
+        comma::uint32 epoch = not_empty_.prepare();
+        if( empty_() ) { not_empty_.wait( epoch ); }
+        not_empty_.done();
+    }
+}
+
+} // namespace comma {
+
+#endif // COMMA_CONTAINERS_MPMC_QUEUE_H_
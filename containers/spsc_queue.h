@@ -0,0 +1,182 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_CONTAINERS_SPSC_QUEUE_H_
+#define COMMA_CONTAINERS_SPSC_QUEUE_H_
+
+#include <algorithm>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "waiting.h"
+
+namespace comma {
+
+/// bounded lock-free single-producer single-consumer queue on top of a
+/// ring of preallocated elements; one thread pushes, one thread pops
+///
+/// producer and consumer indices live on separate cache lines and each
+/// side keeps a cached copy of the other side's index, thus in the steady
+/// state push and pop touch shared cache lines only once per batch
+///
+/// Wait: how push() and pop() wait, while the queue is full or empty;
+/// see waiting.h; try_push() and try_pop() never wait
+///
+/// see unit test for usage
+template < typename T, typename Wait = waiting::blocking >
+class spsc_queue : public boost::noncopyable
+{
+    public:
+        /// constructor
+        /// @param capacity rounded up to a power of 2
+        spsc_queue( std::size_t capacity );
+
+        /// push, if not full; return true on success
+        bool try_push( const T& t ) { return try_push( &t, 1 ) == 1; }
+
+        /// push as many values as there is room for; return number of values pushed
+        std::size_t try_push( const T* values, std::size_t size );
+
+        /// push, wait while full
+        void push( const T& t ) { push( &t, 1 ); }
+
+        /// push all values, wait while full
+        void push( const T* values, std::size_t size );
+
+        /// pop, if not empty; return true on success
+        bool try_pop( T& t ) { return try_pop( &t, 1 ) == 1; }
+
+        /// pop up to given number of values; return number of values popped
+        std::size_t try_pop( T* values, std::size_t size );
+
+        /// pop, wait while empty
+        void pop( T& t ) { pop( &t, 1 ); }
+
+        /// pop, wait while empty
+        T pop() { T t; pop( t ); return t; }
+
+        /// wait while empty, then pop up to given number of values; return number of values popped
+        std::size_t pop( T* values, std::size_t size );
+
+        /// return capacity
+        std::size_t capacity() const { return buffer_.size(); }
+
+        /// return number of values in the queue; approximate, if called not from producer or consumer
+        std::size_t size() const { return load_( tail_ ) - load_( head_ ); }
+
+        /// return true, if empty; approximate, if called not from producer or consumer
+        bool empty() const { return size() == 0; }
+
+    private:
+        enum { cache_line_size = 64 };
+        std::vector< T > buffer_;
+        std::size_t mask_;
+        char padding0_[ cache_line_size ];
+        std::size_t head_; // next to pop, written by consumer
+        std::size_t tail_cache_; // consumer's copy of tail_
+        char padding1_[ cache_line_size ];
+        std::size_t tail_; // next to push, written by producer
+        std::size_t head_cache_; // producer's copy of head_
+        char padding2_[ cache_line_size ];
+        Wait not_empty_;
+        Wait not_full_;
+        char padding3_[ cache_line_size ];
+
+        static std::size_t load_( const std::size_t& i ) { return __atomic_load_n( &i, __ATOMIC_ACQUIRE ); }
+        static void store_( std::size_t& i, std::size_t value ) { __atomic_store_n( &i, value, __ATOMIC_RELEASE ); }
+        static std::size_t round_up_( std::size_t n ) { std::size_t s = 1; while( s < n ) { s <<= 1; } return s; }
+};
+
+template < typename T, typename Wait >
+inline spsc_queue< T, Wait >::spsc_queue( std::size_t capacity )
+    : buffer_( round_up_( capacity ) )
+    , mask_( buffer_.size() - 1 )
+    , head_( 0 )
+    , tail_cache_( 0 )
+    , tail_( 0 )
+    , head_cache_( 0 )
+{
+}
+
+template < typename T, typename Wait >
+inline std::size_t spsc_queue< T, Wait >::try_push( const T* values, std::size_t size )
+{
+    std::size_t tail = tail_;
+    if( buffer_.size() - ( tail - head_cache_ ) < size ) { head_cache_ = load_( head_ ); }
+    std::size_t n = std::min( size, buffer_.size() - ( tail - head_cache_ ) );
+    if( n == 0 ) { return 0; }
+    for( std::size_t i = 0; i < n; ++i ) { buffer_[ ( tail + i ) & mask_ ] = values[i]; }
+    store_( tail_, tail + n );
+    not_empty_.notify();
+    return n;
+}
+
+template < typename T, typename Wait >
+inline void spsc_queue< T, Wait >::push( const T* values, std::size_t size )
+{
+    while( size > 0 )
+    {
+        std::size_t n = try_push( values, size );
+        values += n;
+        size -= n;
+        if( n > 0 ) { continue; }
+        comma::uint32 epoch = not_full_.prepare();
+        if( tail_ - load_( head_ ) == buffer_.size() ) { not_full_.wait( epoch ); }
+        not_full_.done();
+    }
+}
+
+template < typename T, typename Wait >
+inline std::size_t spsc_queue< T, Wait >::try_pop( T* values, std::size_t size )
+{
+    std::size_t head = head_;
+    if( tail_cache_ - head < size ) { tail_cache_ = load_( tail_ ); }
+    std::size_t n = std::min( size, tail_cache_ - head );
+    if( n == 0 ) { return 0; }
+    for( std::size_t i = 0; i < n; ++i ) { values[i] = buffer_[ ( head + i ) & mask_ ]; }
+    store_( head_, head + n );
+    not_full_.notify();
+    return n;
+}
+
+template < typename T, typename Wait >
+inline std::size_t spsc_queue< T, Wait >::pop( T* values, std::size_t size )
+{
+    while( true )
+    {
+        std::size_t n = try_pop( values, size );
+        if( n > 0 || size == 0 ) { return n; }
+        comma::uint32 epoch = not_empty_.prepare();
+        if( load_( tail_ ) == head_ ) { not_empty_.wait( epoch ); }
+        not_empty_.done();
+    }
+}
+
+} // namespace comma {
+
+#endif // COMMA_CONTAINERS_SPSC_QUEUE_H_
@@ -0,0 +1,123 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+#include <boost/lexical_cast.hpp>
+#include "../flat_hash_map.h"
+
+namespace comma {
+
+TEST( flat_hash_map, basics )
+{
+    flat_hash_map< std::string, int > m;
+    EXPECT_TRUE( m.empty() );
+    EXPECT_TRUE( m.find( "a" ) == m.end() );
+    m[ "a" ] = 1;
+    m[ "b" ] = 2;
+    EXPECT_EQ( 2u, m.size() );
+    EXPECT_EQ( 1, m.find( "a" )->second );
+    EXPECT_EQ( 2, m[ "b" ] );
+    EXPECT_FALSE( m.insert( std::make_pair( std::string( "a" ), 5 ) ).second );
+    EXPECT_EQ( 1, m[ "a" ] );
+    EXPECT_TRUE( m.insert( std::make_pair( std::string( "c" ), 3 ) ).second );
+    EXPECT_EQ( "a", m.begin()->first ); // insertion order
+    EXPECT_EQ( "c", ( m.end() - 1 )->first );
+    m.clear();
+    EXPECT_TRUE( m.empty() );
+    EXPECT_TRUE( m.find( "a" ) == m.end() );
+}
+
+struct counted // counts copies and default constructions
+{
+    int value;
+    static unsigned int copies;
+    static unsigned int constructions;
+    counted( int value = 0 ) : value( value ) { ++constructions; }
+    counted( const counted& rhs ) : value( rhs.value ) { ++copies; }
+    bool operator==( const counted& rhs ) const { return value == rhs.value; }
+    struct hash { std::size_t operator()( const counted& c ) const { return boost::hash< int >()( c.value ); } };
+};
+
+unsigned int counted::copies = 0;
+unsigned int counted::constructions = 0;
+
+TEST( flat_hash_map, try_emplace )
+{
+    flat_hash_map< counted, counted, counted::hash > m;
+    counted key( 1 );
+    EXPECT_TRUE( m.try_emplace( key ).second );
+    EXPECT_FALSE( m.try_emplace( key, counted( 5 ) ).second );
+    m[ key ].value = 2;
+    counted::copies = 0;
+    counted::constructions = 0;
+    for( unsigned int i = 0; i < 10; ++i ) { m[ key ].value += 1; m.try_emplace( key ); }
+    EXPECT_EQ( 0u, counted::copies ); // existing key: neither key nor value copied
+    EXPECT_EQ( 0u, counted::constructions );
+    EXPECT_EQ( 12, m.at( key ).value );
+    EXPECT_TRUE( m.try_emplace( counted( 3 ), counted( 4 ) ).second );
+    EXPECT_EQ( 4, m.at( counted( 3 ) ).value );
+    EXPECT_EQ( 2u, m.size() );
+    EXPECT_THROW( m.at( counted( 7 ) ), std::out_of_range );
+    const flat_hash_map< counted, counted, counted::hash >& c = m;
+    EXPECT_THROW( c.at( counted( 7 ) ), std::out_of_range );
+}
+
+TEST( flat_hash_map, erase )
+{
+    flat_hash_map< int, int > m;
+    std::map< int, int > expected;
+    for( int i = 0; i < 1000; ++i ) { m[i] = i * 2; expected[i] = i * 2; }
+    EXPECT_EQ( 0u, m.erase( 5000 ) );
+    for( int i = 0; i < 1000; i += 3 ) { EXPECT_EQ( 1u, m.erase( i ) ); expected.erase( i ); }
+    EXPECT_EQ( expected.size(), m.size() );
+    for( int i = 0; i < 1000; ++i )
+    {
+        flat_hash_map< int, int >::const_iterator it = m.find( i );
+        if( expected.find( i ) == expected.end() ) { EXPECT_TRUE( it == m.end() ); continue; }
+        ASSERT_TRUE( it != m.end() );
+        EXPECT_EQ( i * 2, it->second );
+    }
+    for( int i = 0; i < 1000; ++i ) { m[i] = i; }
+    EXPECT_EQ( 1000u, m.size() );
+}
+
+TEST( flat_hash_map, rehash )
+{
+    flat_hash_map< std::string, unsigned int > m;
+    m.reserve( 10 );
+    for( unsigned int i = 0; i < 100000; ++i ) { m[ boost::lexical_cast< std::string >( i ) ] = i; }
+    EXPECT_EQ( 100000u, m.size() );
+    for( unsigned int i = 0; i < 100000; i += 7 ) { EXPECT_EQ( i, m.find( boost::lexical_cast< std::string >( i ) )->second ); }
+}
+
+} // namespace comma {
@@ -0,0 +1,121 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/thread.hpp>
+#include "../mpmc_queue.h"
+
+namespace comma {
+
+TEST( mpmc_queue, basics )
+{
+    EXPECT_EQ( 2u, mpmc_queue< int >( 1 ).capacity() );
+    mpmc_queue< int > q( 5 );
+    EXPECT_EQ( 8u, q.capacity() );
+    int i;
+    EXPECT_FALSE( q.try_pop( i ) );
+    for( int k = 0; k < 8; ++k ) { EXPECT_TRUE( q.try_push( k ) ); }
+    EXPECT_FALSE( q.try_push( 8 ) );
+    EXPECT_EQ( 8u, q.size() );
+    for( int k = 0; k < 3; ++k ) { EXPECT_TRUE( q.try_pop( i ) ); EXPECT_EQ( k, i ); }
+    int in[] = { 8, 9, 10, 11 };
+    EXPECT_EQ( 3u, q.try_push( in, 4 ) );
+    int out[10];
+    EXPECT_EQ( 8u, q.try_pop( out, 10 ) );
+    for( int k = 0; k < 8; ++k ) { EXPECT_EQ( k + 3, out[k] ); }
+    EXPECT_TRUE( q.empty() );
+}
+
+template < typename Q >
+static void produce( Q* q, unsigned int from, unsigned int size, unsigned int batch )
+{
+    std::vector< unsigned int > values( batch );
+    for( unsigned int i = 0; i < size; i += batch )
+    {
+        unsigned int n = std::min( batch, size - i );
+        for( unsigned int k = 0; k < n; ++k ) { values[k] = from + i + k; }
+        q->push( &values[0], n );
+    }
+}
+
+template < typename Q >
+static void consume( Q* q, std::vector< unsigned int >* counts, unsigned int batch )
+{
+    std::vector< unsigned int > values( batch );
+    while( true )
+    {
+        std::size_t n = q->pop( &values[0], batch );
+        unsigned int markers = 0;
+        for( std::size_t k = 0; k < n; ++k )
+        {
+            if( values[k] == counts->size() ) { ++markers; } // end marker
+            else { ++( *counts )[ values[k] ]; }
+        }
+        if( markers == 0 ) { continue; }
+        for( ; markers > 1; --markers ) { q->push( counts->size() ); } // give back end markers for other consumers
+        return;
+    }
+}
+
+template < typename Wait >
+static void test_threads( unsigned int size, unsigned int batch )
+{
+    typedef mpmc_queue< unsigned int, Wait > queue_t;
+    const unsigned int producers = 4;
+    const unsigned int consumers = 3;
+    queue_t q( 64 );
+    std::vector< std::vector< unsigned int > > counts( consumers, std::vector< unsigned int >( producers * size, 0 ) );
+    boost::ptr_vector< boost::thread > threads;
+    for( unsigned int i = 0; i < consumers; ++i ) { threads.push_back( new boost::thread( boost::bind( &consume< queue_t >, &q, &counts[i], batch ) ) ); }
+    for( unsigned int i = 0; i < producers; ++i ) { threads.push_back( new boost::thread( boost::bind( &produce< queue_t >, &q, i * size, size, batch ) ) ); }
+    for( unsigned int i = consumers; i < threads.size(); ++i ) { threads[i].join(); }
+    for( unsigned int i = 0; i < consumers; ++i ) { q.push( producers * size ); } // one end marker per consumer
+    for( unsigned int i = 0; i < consumers; ++i ) { threads[i].join(); }
+    bool ok = true;
+    for( unsigned int k = 0; k < producers * size; ++k )
+    {
+        unsigned int count = 0;
+        for( unsigned int i = 0; i < consumers; ++i ) { count += counts[i][k]; }
+        ok = ok && count == 1;
+    }
+    EXPECT_TRUE( ok ); // every value popped exactly once
+    EXPECT_TRUE( q.empty() );
+}
+
+TEST( mpmc_queue, spin ) { test_threads< waiting::spin >( 1000, 1 ); } // spinning takes ages on a single core
+
+TEST( mpmc_queue, yield ) { test_threads< waiting::yield >( 100000, 1 ); test_threads< waiting::yield >( 100000, 16 ); }
+
+TEST( mpmc_queue, blocking ) { test_threads< waiting::blocking >( 100000, 1 ); test_threads< waiting::blocking >( 100000, 16 ); }
+
+} // namespace comma {
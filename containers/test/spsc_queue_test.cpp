@@ -0,0 +1,115 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "../spsc_queue.h"
+
+namespace comma {
+
+TEST( spsc_queue, basics )
+{
+    spsc_queue< int > q( 5 );
+    EXPECT_EQ( 8u, q.capacity() );
+    EXPECT_TRUE( q.empty() );
+    int i;
+    EXPECT_FALSE( q.try_pop( i ) );
+    for( int k = 0; k < 8; ++k ) { EXPECT_TRUE( q.try_push( k ) ); }
+    EXPECT_FALSE( q.try_push( 8 ) );
+    EXPECT_EQ( 8u, q.size() );
+    for( int k = 0; k < 8; ++k ) { EXPECT_TRUE( q.try_pop( i ) ); EXPECT_EQ( k, i ); }
+    EXPECT_FALSE( q.try_pop( i ) );
+    EXPECT_TRUE( q.empty() );
+}
+
+TEST( spsc_queue, batch )
+{
+    spsc_queue< int > q( 8 );
+    int in[] = { 0, 1, 2, 3, 4, 5 };
+    int out[10];
+    EXPECT_EQ( 6u, q.try_push( in, 6 ) );
+    EXPECT_EQ( 4u, q.try_pop( out, 4 ) );
+    EXPECT_EQ( 3, out[3] );
+    EXPECT_EQ( 6u, q.try_push( in, 6 ) ); // wraps around
+    EXPECT_EQ( 0u, q.try_push( in, 6 ) );
+    EXPECT_EQ( 8u, q.try_pop( out, 10 ) );
+    EXPECT_EQ( 4, out[0] );
+    EXPECT_EQ( 5, out[1] );
+    EXPECT_EQ( 0, out[2] );
+    EXPECT_EQ( 5, out[7] );
+    EXPECT_EQ( 0u, q.try_pop( out, 10 ) );
+}
+
+template < typename Q >
+static void produce( Q* q, unsigned int size, unsigned int batch )
+{
+    std::vector< unsigned int > values( batch );
+    for( unsigned int i = 0; i < size; i += batch )
+    {
+        unsigned int n = std::min( batch, size - i );
+        for( unsigned int k = 0; k < n; ++k ) { values[k] = i + k; }
+        q->push( &values[0], n );
+    }
+}
+
+template < typename Q >
+static bool consume( Q& q, unsigned int size, unsigned int batch )
+{
+    std::vector< unsigned int > values( batch );
+    for( unsigned int expected = 0; expected < size; )
+    {
+        std::size_t n = q.pop( &values[0], batch );
+        for( std::size_t k = 0; k < n; ++k, ++expected ) { if( values[k] != expected ) { return false; } }
+    }
+    return true;
+}
+
+template < typename Wait >
+static void test_threads( unsigned int size )
+{
+    for( unsigned int batch = 1; batch < 100; batch *= 7 )
+    {
+        spsc_queue< unsigned int, Wait > q( 64 );
+        boost::thread producer( boost::bind( &produce< spsc_queue< unsigned int, Wait > >, &q, size, batch ) );
+        EXPECT_TRUE( consume( q, size, batch ) );
+        producer.join();
+        EXPECT_TRUE( q.empty() );
+    }
+}
+
+TEST( spsc_queue, spin ) { test_threads< waiting::spin >( 1000 ); } // spinning takes ages on a single core
+
+TEST( spsc_queue, yield ) { test_threads< waiting::yield >( 1000000 ); }
+
+TEST( spsc_queue, blocking ) { test_threads< waiting::blocking >( 1000000 ); }
+
+} // namespace comma {
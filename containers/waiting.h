@@ -0,0 +1,122 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_CONTAINERS_WAITING_H_
+#define COMMA_CONTAINERS_WAITING_H_
+
+#ifdef __linux__
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <boost/thread/thread.hpp>
+#include "../base/types.h"
+
+namespace comma { namespace waiting {
+
+/// wait strategies for lock-free queues (see spsc_queue.h and mpmc_queue.h)
+///
+/// a waiting thread calls prepare(), checks its condition once more, and
+/// if it still does not hold, calls wait() with the value prepare()
+/// returned and then done(); a thread changing the state calls notify()
+///
+/// wait() may return spuriously, thus always check the condition again
+
+/// busy spin: lowest latency, but burns a core while waiting
+struct spin
+{
+    comma::uint32 prepare() { return 0; }
+    void wait( comma::uint32 ) { relax(); }
+    void done() {}
+    void notify() {}
+    static void relax()
+    {
+        #if defined( __i386__ ) || defined( __x86_64__ )
+        __builtin_ia32_pause();
+        #endif
+    }
+};
+
+/// yield to other threads while waiting: still keeps a core busy, if
+/// there is nothing else to run, but does not starve other threads
+struct yield
+{
+    comma::uint32 prepare() { return 0; }
+    void wait( comma::uint32 ) { boost::this_thread::yield(); }
+    void done() {}
+    void notify() {}
+};
+
+#ifdef __linux__
+
+/// sleep in the kernel while waiting; notify() costs a memory fence and
+/// makes a system call only if someone is actually waiting
+class futex
+{
+    public:
+        futex() : epoch_( 0 ), waiters_( 0 ) {}
+
+        comma::uint32 prepare()
+        {
+            __atomic_add_fetch( &waiters_, 1, __ATOMIC_SEQ_CST );
+            __atomic_thread_fence( __ATOMIC_SEQ_CST ); // the caller checks its condition after this point
+            return __atomic_load_n( &epoch_, __ATOMIC_SEQ_CST );
+        }
+
+        void wait( comma::uint32 epoch ) { ::syscall( SYS_futex, &epoch_, FUTEX_WAIT_PRIVATE, epoch, NULL, NULL, 0 ); }
+
+        void done() { __atomic_sub_fetch( &waiters_, 1, __ATOMIC_SEQ_CST ); }
+
+        void notify()
+        {
+            __atomic_thread_fence( __ATOMIC_SEQ_CST ); // make the state change visible before checking for waiters
+            if( __atomic_load_n( &waiters_, __ATOMIC_RELAXED ) == 0 ) { return; }
+            __atomic_add_fetch( &epoch_, 1, __ATOMIC_SEQ_CST );
+            ::syscall( SYS_futex, &epoch_, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0 );
+        }
+
+    private:
+        comma::uint32 epoch_;
+        comma::uint32 waiters_;
+};
+
+/// strategy for threads that may stay idle for a while
+typedef futex blocking;
+
+#else // #ifdef __linux__
+
+typedef yield blocking;
+
+#endif // #ifdef __linux__
+
+} } // namespace comma { namespace waiting {
+
+#endif // COMMA_CONTAINERS_WAITING_H_
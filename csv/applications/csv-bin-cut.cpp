@@ -36,7 +36,15 @@
 #include <io.h>
 #endif
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <stdlib.h>
+#include <string.h>
 #include <fstream>
 #include <numeric>
 #include "../../application/command_line_options.h"
@@ -108,10 +116,13 @@ namespace {
             std::cerr << "    csv-bin-cut ... --fields=1,3: fields to output are specified by numbers as in cut (1) utility; numbers start with 1" << std::endl;
             std::cerr << std::endl;
             std::cerr << "Algorithm:" << std::endl;
-            std::cerr << "    When csv-bin-cut reads a file (as opposed to stdin), it seeks to the position of the next data to be output as opposed to" << std::endl;
-            std::cerr << "    reading entire records; this improves performance for large record sizes as most of the input is skipped. For small records," << std::endl;
-            std::cerr << "    however, the improvement is lost because seek-read-seek-read would repeatedly read the same disk block. Therefore, for small" << std::endl;
-            std::cerr << "    records it is advised to turn off the seeking algorithm by the '--read-all' option." << std::endl;
+            std::cerr << "    Output fields adjacent in the input record are merged into contiguous byte runs, which are copied at once." << std::endl;
+            std::cerr << "    Records are read and written in blocks, unless --flush is given." << std::endl;
+            std::cerr << "    When csv-bin-cut reads a regular file (as opposed to stdin), it memory-maps the file, thus only the pages" << std::endl;
+            std::cerr << "    holding the data to be output are read; this improves performance for large record sizes as most of the input" << std::endl;
+            std::cerr << "    is skipped. On systems without mmap, it seeks to the position of the next data to be output instead; for small" << std::endl;
+            std::cerr << "    records it is then advised to turn off the seeking algorithm by the '--read-all' option." << std::endl;
+            std::cerr << "    With '--read-all', files are neither mapped nor seeked, but read as entire records in the same way as stdin." << std::endl;
             std::cerr << std::endl;
             std::cerr << "Examples:" << std::endl;
             std::cerr << "    csv-bin-cut input.bin --binary=t,s[1000000] --fields=t,s --output-fields=t" << std::endl;
@@ -230,11 +241,49 @@ namespace {
         return fields;
     }
 
+    /// contiguous run of bytes copied from input to output record
+    struct run
+    {
+        size_t input_offset;
+        size_t output_offset;
+        size_t size;
+        run( size_t input_offset, size_t output_offset, size_t size ) : input_offset( input_offset ), output_offset( output_offset ), size( size ) {}
+    };
+
+    /// merge output fields adjacent in the input record into runs
+    std::vector< run > make_plan( const std::vector< field >& fields )
+    {
+        std::vector< run > runs;
+        for( unsigned int i = 0; i < fields.size(); ++i )
+        {
+            if( !runs.empty() && runs.back().input_offset + runs.back().size == fields[i].input_offset ) { runs.back().size += fields[i].size; continue; }
+            runs.push_back( run( fields[i].input_offset, fields[i].offset, fields[i].size ) );
+        }
+        return runs;
+    }
+
+    /// copy with sizes of common field types known at compile time, which compilers turn into single loads and stores
+    inline void copy( char* to, const char* from, size_t size )
+    {
+        switch( size )
+        {
+            case 1: *to = *from; break;
+            case 2: ::memcpy( to, from, 2 ); break;
+            case 4: ::memcpy( to, from, 4 ); break;
+            case 8: ::memcpy( to, from, 8 ); break;
+            case 12: ::memcpy( to, from, 12 ); break;
+            case 16: ::memcpy( to, from, 16 ); break;
+            case 24: ::memcpy( to, from, 24 ); break;
+            default: ::memcpy( to, from, size ); break;
+        }
+    }
+
     class seeker
     {
         public:
             seeker( const std::vector< field > & fields, const comma::csv::options & csv, unsigned int skip, long int count_max, bool flush, bool force_read )
                 : fields_( fields )
+                , runs_( make_plan( fields ) )
                 , orecord_size_( std::accumulate( fields.begin(), fields.end(), (size_t)0, seeker::add_size ) )
                 , obuf_( orecord_size_ )
                 , ibuf_( 0 )
@@ -244,6 +293,7 @@ namespace {
                 , count_max_( count_max )
                 , flush_( flush )
                 , force_read_( force_read )
+                , block_size_( flush ? 1 : std::max( size_t( 1 ), size_t( 65536 ) / irecord_size_ ) )
                 {}
 
             int process( const std::vector< std::string > & files );
@@ -251,8 +301,13 @@ namespace {
         private:
             int read_fields( std::ifstream & ifs, const std::string & fname );
             int read_all( std::istream & is );
+            #ifndef WIN32
+            bool read_mapped( const std::string & fname );
+            #endif
+            void write_block( const char* records, size_t size );
 
             const std::vector< field > & fields_;
+            std::vector< run > runs_;
             size_t orecord_size_;
             std::vector< char > obuf_;
             std::vector< char > ibuf_;
@@ -262,27 +317,69 @@ namespace {
             long int count_max_;
             bool flush_;
             bool force_read_;
+            size_t block_size_;
 
             static size_t add_size( size_t i, const field & f ){ return i + f.size; }
     };
 
+    // extract given number of records, taking care of skip and count; write output block at once
+    void seeker::write_block( const char* records, size_t size )
+    {
+        if( skip_ ) { size_t n = std::min( size_t( skip_ ), size ); skip_ -= n; records += n * irecord_size_; size -= n; }
+        if( count_max_ >= 0 && size_t( count_max_ - count_ ) < size ) { size = count_max_ - count_; }
+        if( size == 0 ) { return; }
+        if( obuf_.size() < size * orecord_size_ ) { obuf_.resize( size * orecord_size_ ); }
+        char* out = &obuf_[0];
+        for( size_t k = 0; k < size; ++k, records += irecord_size_, out += orecord_size_ )
+        {
+            for( unsigned int i = 0; i < runs_.size(); ++i ) { copy( out + runs_[i].output_offset, records + runs_[i].input_offset, runs_[i].size ); }
+        }
+        std::cout.write( &obuf_[0], size * orecord_size_ );
+        if( flush_ ) { std::cout.flush(); }
+        if( count_max_ >= 0 ) { count_ += size; }
+    }
+
     int seeker::read_all( std::istream & is )
     {
         if ( count_max_ >= 0 && count_ >= count_max_ ) { return 0; }
-        ibuf_.resize( irecord_size_ );
+        ibuf_.resize( irecord_size_ * block_size_ );
         while( is.good() && !is.eof() )
         {
-            is.read( &ibuf_[0], irecord_size_ );
-            if( is.gcount() == 0 ) { continue; }
-            if( is.gcount() < int( irecord_size_ ) ) { std::cerr << "csv-bin-cut: expected " << irecord_size_ << " bytes, got only " << is.gcount() << std::endl; exit( 1 ); }
-            if ( skip_ ) { --skip_; continue; }
-            for( unsigned int i = 0; i < fields_.size(); ++i ) { std::cout.write( &ibuf_[0] + fields_[i].input_offset, fields_[i].size ); }
-            if( flush_ ) { std::cout.flush(); }
-            if ( count_max_ >= 0 && ++count_ >= count_max_ ) { return 0; }
+            is.read( &ibuf_[0], ibuf_.size() );
+            size_t size = is.gcount();
+            if( size == 0 ) { continue; }
+            write_block( &ibuf_[0], size / irecord_size_ );
+            if ( count_max_ >= 0 && count_ >= count_max_ ) { return 0; }
+            if( size % irecord_size_ ) { std::cerr << "csv-bin-cut: expected " << irecord_size_ << " bytes, got only " << size % irecord_size_ << std::endl; exit( 1 ); }
         }
         return 0;
     }
 
+    #ifndef WIN32
+    // map the whole file and extract records from memory; return false if the file cannot be mapped (e.g. it is not a regular file)
+    // or its size is not a multiple of the record size, in which case the stream path handles the trailing partial record as before
+    bool seeker::read_mapped( const std::string & fname )
+    {
+        int fd = ::open( fname.c_str(), O_RDONLY );
+        if( fd < 0 ) { std::cerr << "csv-bin-cut: cannot open '" << fname << "' for reading" << std::endl; exit( 1 ); }
+        struct stat st;
+        if( ::fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) ) { ::close( fd ); return false; }
+        size_t size = st.st_size;
+        if( size % irecord_size_ ) { ::close( fd ); return false; }
+        if( size == 0 ) { ::close( fd ); return true; }
+        void* p = ::mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        ::close( fd );
+        if( p == MAP_FAILED ) { return false; }
+        ::madvise( p, size, irecord_size_ > 4 * orecord_size_ && irecord_size_ >= 4096 ? MADV_RANDOM : MADV_SEQUENTIAL );
+        const char* records = static_cast< const char* >( p );
+        size_t nrecords = size / irecord_size_;
+        for( size_t i = 0; i < nrecords && ( count_max_ < 0 || count_ < count_max_ ); i += block_size_ ) { write_block( records + i * irecord_size_, std::min( block_size_, nrecords - i ) ); }
+        ::munmap( p, size );
+        if( std::cout.fail() ) { std::cerr << "csv-bin-cut: std::cout output failed" << std::endl; exit( 1 ); }
+        return true;
+    }
+    #endif
+
     int seeker::read_fields( std::ifstream & ifs, const std::string & fname )
     {
         // algorithm summary:
@@ -340,6 +437,9 @@ namespace {
                 int rv = read_all( std::cin );
                 if ( rv != 0 ) { return rv; }
             } else {
+                #ifndef WIN32
+                if( !force_read_ && read_mapped( *ifile ) ) { continue; }
+                #endif
                 std::ifstream ifs( &( *ifile )[0], std::ifstream::binary );
                 if ( !ifs.is_open() ) { std::cerr << "csv-bin-cut: cannot open '" << *ifile << "' for reading" << std::endl; exit( 1 ); }
                 int rv = ( force_read_ ? read_all( ifs ) : read_fields( ifs, *ifile ) );
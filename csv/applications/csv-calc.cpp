@@ -47,6 +47,7 @@
 #include "../../application/contact_info.h"
 #include "../../application/verbose.h"
 #include "../../base/exception.h"
+#include "../../csv/columnar.h"
 #include "../../csv/format.h"
 #include "../../csv/options.h"
 #include "../../string/string.h"
@@ -62,6 +63,7 @@ static void bash_completion( unsigned const ac, char const * const * av )
         " --output-format"
         " --format"
         " --binary -b"
+        " --columnar"
         " --verbose -v";
     std::cout << arguments << std::endl;
     exit( 0 );
@@ -102,6 +104,10 @@ static void usage( bool verbose )
     std::cerr << std::endl;
     std::cerr << "<options>" << std::endl;
     std::cerr << "    --append: append statistics to each input line" << std::endl;
+    std::cerr << "    --columnar=<file>: read records from columnar file (see csv-columnar) instead of stdin; input format is taken" << std::endl;
+    std::cerr << "                       from the file, only columns of non-empty fields are read; if the operations are min," << std::endl;
+    std::cerr << "                       max, centre, radius or diameter only and there are no id or block fields, block" << std::endl;
+    std::cerr << "                       statistics are used instead of reading blocks, where possible" << std::endl;
     std::cerr << "    --delimiter,-d <delimiter> : default ','" << std::endl;
     std::cerr << "    --fields,-f: field names for which the extents should be computed, default: all fields" << std::endl;
     std::cerr << "                 if 'block' field present, calculate block-wise" << std::endl;
@@ -320,8 +326,9 @@ class asciiInput
 class binaryInput
 {
     public:
-        binaryInput( const comma::csv::options& csv )
+        binaryInput( const comma::csv::options& csv, std::istream* is = NULL )
             : csv_( csv )
+            , is_( is )
             , values_( csv, csv.format() )
             , buffer_( csv.format().size() > 65536 ? csv.format().size() : 65536 / csv.format().size() * csv.format().size() )
             , cur_( &buffer_[0] )
@@ -343,7 +350,7 @@ class binaryInput
                     if( cur_ == end_ ) { cur_ = &buffer_[0]; offset_ = 0; }
                     return &values_;
                 }
-                int count = ::read( 0, cur_ + offset_, end_ - cur_ - offset_ );
+                int count = is_ ? is_->read( cur_ + offset_, end_ - cur_ - offset_ ).gcount() : ::read( 0, cur_ + offset_, end_ - cur_ - offset_ );
                 if( count <= 0 ) { return NULL; }
                 offset_ += count;
             }
@@ -352,6 +359,7 @@ class binaryInput
 
     private:
         comma::csv::options csv_;
+        std::istream* is_;
         Values values_;
         std::vector< char > buffer_;
         char* cur_;
@@ -1139,6 +1147,46 @@ typedef boost::unordered_map< comma::uint32, boost::ptr_vector< Operationbase >*
 typedef boost::unordered_map< comma::uint32, std::string > ResultsMap;
 typedef std::vector< std::pair < comma::uint32, std::string > > Inputs;
 
+static void init_operations( boost::ptr_vector< Operationbase >& operations
+                           , const std::vector< Operations::operation_parameters >& operations_parameters
+                           , const comma::csv::format& format );
+
+static bool extents_only( const std::vector< Operations::operation_parameters >& operations_parameters )
+{
+    for( std::size_t i = 0; i < operations_parameters.size(); ++i )
+    {
+        switch( operations_parameters[i].type )
+        {
+            case Operations::Enum::min: case Operations::Enum::max: case Operations::Enum::centre: case Operations::Enum::radius: case Operations::Enum::diameter: break;
+            default: return false;
+        }
+    }
+    return true;
+}
+
+// columnar block filter: if operations depend only on extents and block statistics of the
+// used columns are exact, push block minimum and maximum instead of reading the block
+static bool read_block( const comma::csv::columnar::block& b
+                      , const comma::csv::format& format
+                      , const std::vector< std::size_t >& columns
+                      , Values& values
+                      , OperationsMap& operations
+                      , const std::vector< Operations::operation_parameters >& operations_parameters )
+{
+    for( std::size_t i = 0; i < columns.size(); ++i ) { if( !comma::csv::columnar::bounded( format, b, columns[i] ) ) { return true; } }
+    OperationsMap::iterator it = operations.find( 0 );
+    if( it == operations.end() )
+    {
+        it = operations.insert( std::make_pair( 0, new boost::ptr_vector< Operationbase > ) ).first;
+        init_operations( *it->second, operations_parameters, values.format() );
+    }
+    values.set( &b.min[0] );
+    for( std::size_t i = 0; i < it->second->size(); ++i ) { ( *it->second )[i].push( values.buffer() ); }
+    values.set( &b.max[0] );
+    for( std::size_t i = 0; i < it->second->size(); ++i ) { ( *it->second )[i].push( values.buffer() ); }
+    return false;
+}
+
 static void init_operations( boost::ptr_vector< Operationbase >& operations
                            , const std::vector< Operations::operation_parameters >& operations_parameters
                            , const comma::csv::format& format )
@@ -1231,6 +1279,9 @@ int main( int ac, char** av )
         if( options.exists( "--bash-completion" ) ) bash_completion( ac, av );
         std::vector< std::string > unnamed = options.unnamed( "", "--binary,-b,--delimiter,-d,--format,--fields,-f,--output-fields" );
         comma::csv::options csv( options );
+        boost::optional< std::string > columnar_file = options.optional< std::string >( "--columnar" );
+        boost::scoped_ptr< comma::csv::columnar::istream > columnar;
+        if( columnar_file ) { csv.format( comma::csv::columnar::reader( *columnar_file ).format() ); }
         #ifdef WIN32
         if( csv.binary() ) { _setmode( _fileno( stdin ), _O_BINARY ); _setmode( _fileno( stdout ), _O_BINARY ); }
         #endif
@@ -1246,10 +1297,6 @@ int main( int ac, char** av )
         boost::optional< comma::csv::format > format;
         if( csv.binary() ) { format = csv.format(); }
         else if( options.exists( "--format" ) ) { format = comma::csv::format( options.value< std::string >( "--format" ) ); }
-        boost::scoped_ptr< asciiInput > ascii;
-        boost::scoped_ptr< binaryInput > binary;
-        if( csv.binary() ) { binary.reset( new binaryInput( csv ) ); }
-        else { ascii.reset( new asciiInput( csv, format ) ); }
         OperationsMap operations;
         ResultsMap results;
         Inputs inputs;
@@ -1257,6 +1304,24 @@ int main( int ac, char** av )
         bool has_block = csv.has_field( "block" );
         bool has_id = csv.has_field( "id" );
         bool append = options.exists("--append");
+        boost::scoped_ptr< Values > extents;
+        if( columnar_file )
+        {
+            std::vector< std::size_t > columns;
+            const std::vector< std::string >& fields = comma::split( csv.fields, ',' );
+            for( std::size_t i = 0; i < fields.size() && !append; ++i ) { if( !fields[i].empty() ) { columns.push_back( i ); } }
+            comma::csv::columnar::istream::filter_type filter;
+            if( !columns.empty() && !has_id && !has_block && !append && extents_only( operations_parameters ) )
+            {
+                extents.reset( new Values( csv, csv.format() ) );
+                filter = boost::bind( &read_block, _1, boost::cref( csv.format() ), columns, boost::ref( *extents ), boost::ref( operations ), boost::cref( operations_parameters ) );
+            }
+            columnar.reset( new comma::csv::columnar::istream( *columnar_file, columns, filter ) );
+        }
+        boost::scoped_ptr< asciiInput > ascii;
+        boost::scoped_ptr< binaryInput > binary;
+        if( csv.binary() ) { binary.reset( new binaryInput( csv, columnar.get() ) ); }
+        else { ascii.reset( new asciiInput( csv, format ) ); }
         
         if (options.exists("--output-fields"))
         {
@@ -1293,7 +1358,7 @@ int main( int ac, char** av )
             std::cout << std::endl;
             return 0;
         } 
-        while( std::cin.good() && !std::cin.eof() )
+        while( columnar || ( std::cin.good() && !std::cin.eof() ) ) // columnar: binary input buffers records past end of stream, thus stop on no more records
         {
             const Values* v = csv.binary() ? binary->read() : ascii->read();
             if( v == NULL ) { break; }
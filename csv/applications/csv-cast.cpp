@@ -36,8 +36,10 @@
 #include <io.h>
 #endif
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <vector>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
@@ -186,68 +188,194 @@ static void lexical_cast( const comma::csv::format::types_enum to_type, const st
     }
 }
 
+/// conversion kernel: convert given number of consecutive fields of the same type in each of given number of records
+typedef void ( *kernel_t )( const char* in, std::size_t istride, char* out, std::size_t ostride, std::size_t records, unsigned int count, unsigned int isize, unsigned int osize );
+
 template< typename From, typename To >
-static void cast( const char* in, char* out ) { comma::csv::format::traits< To >::to_bin( comma::csv::format::traits< From >::from_bin( in ), out ); }
+static void cast( const char* in, std::size_t istride, char* out, std::size_t ostride, std::size_t records, unsigned int count, unsigned int, unsigned int )
+{
+    for( std::size_t r = 0; r < records; ++r, in += istride, out += ostride )
+    {
+        const char* i = in;
+        char* o = out;
+        for( unsigned int k = 0; k < count; ++k, i += sizeof( From ), o += sizeof( To ) ) // memcpy: fields are not necessarily aligned; loop over contiguous fields is vectorized by compiler
+        {
+            From f;
+            std::memcpy( &f, i, sizeof( From ) );
+            To t = static_cast< To >( f );
+            std::memcpy( o, &t, sizeof( To ) );
+        }
+    }
+}
+
+static void copy( const char* in, std::size_t istride, char* out, std::size_t ostride, std::size_t records, unsigned int, unsigned int size, unsigned int )
+{
+    for( std::size_t r = 0; r < records; ++r, in += istride, out += ostride ) { std::memcpy( out, in, size ); }
+}
+
+static void copy_string( const char* in, std::size_t istride, char* out, std::size_t ostride, std::size_t records, unsigned int count, unsigned int isize, unsigned int osize )
+{
+    unsigned int size = std::min( isize, osize );
+    for( std::size_t r = 0; r < records; ++r, in += istride, out += ostride )
+    {
+        for( unsigned int k = 0; k < count; ++k ) { std::memcpy( out + k * osize, in + k * isize, size ); std::memset( out + k * osize + size, 0, osize - size ); }
+    }
+}
+
+template < comma::csv::format::types_enum To >
+static void lexical_cast( const char* in, std::size_t istride, char* out, std::size_t ostride, std::size_t records, unsigned int count, unsigned int isize, unsigned int osize )
+{
+    for( std::size_t r = 0; r < records; ++r, in += istride, out += ostride )
+    {
+        for( unsigned int k = 0; k < count; ++k ) { lexical_cast( To, std::string( in + k * isize, isize ), out + k * osize ); }
+    }
+}
 
 template < typename From >
-static void cast( const comma::csv::format::types_enum to_type, const char* in, char* out  )
+static kernel_t kernel( const comma::csv::format::types_enum to_type )
+{
+    switch( to_type )
+    {
+        case comma::csv::format::int8:          return cast< From, char >;
+        case comma::csv::format::uint8:         return cast< From, unsigned char >;
+        case comma::csv::format::int16:         return cast< From, comma::int16 >;
+        case comma::csv::format::uint16:        return cast< From, comma::uint16 >;
+        case comma::csv::format::int32:         return cast< From, comma::int32 >;
+        case comma::csv::format::uint32:        return cast< From, comma::uint32 >;
+        case comma::csv::format::int64:         return cast< From, comma::int64 >;
+        case comma::csv::format::uint64:        return cast< From, comma::uint64 >;
+        case comma::csv::format::char_t:        return cast< From, char >;
+        case comma::csv::format::float_t:       return cast< From, float >;
+        case comma::csv::format::double_t:      return cast< From, double >;
+        default:                                COMMA_THROW( comma::exception, "type conversion to " << comma::csv::format::to_format( to_type ) << " is not supported" );
+    }
+}
+
+static kernel_t lexical_cast_kernel( const comma::csv::format::types_enum to_type )
 {
     switch( to_type )
     {
-        case comma::csv::format::int8:          cast< From, char >( in, out ); break;
-        case comma::csv::format::uint8:         cast< From, unsigned char >( in, out ); break;
-        case comma::csv::format::int16:         cast< From, comma::int16 >( in, out ); break;
-        case comma::csv::format::uint16:        cast< From, comma::uint16 >( in, out ); break;
-        case comma::csv::format::int32:         cast< From, comma::int32 >( in, out ); break;
-        case comma::csv::format::uint32:        cast< From, comma::uint32 >( in, out ); break;
-        case comma::csv::format::int64:         cast< From, comma::int64 >( in, out ); break;
-        case comma::csv::format::uint64:        cast< From, comma::uint64 >( in, out ); break;
-        case comma::csv::format::char_t:        cast< From, char >( in, out ); break;
-        case comma::csv::format::float_t:       cast< From, float >( in, out ); break;
-        case comma::csv::format::double_t:      cast< From, double >( in, out ); break;
-        default:                                COMMA_THROW( comma::exception, "type conversion to " << comma::csv::format::to_format( to_type ) << " is not supported" ); break;
+        case comma::csv::format::int8:          return lexical_cast< comma::csv::format::int8 >;
+        case comma::csv::format::uint8:         return lexical_cast< comma::csv::format::uint8 >;
+        case comma::csv::format::int16:         return lexical_cast< comma::csv::format::int16 >;
+        case comma::csv::format::uint16:        return lexical_cast< comma::csv::format::uint16 >;
+        case comma::csv::format::int32:         return lexical_cast< comma::csv::format::int32 >;
+        case comma::csv::format::uint32:        return lexical_cast< comma::csv::format::uint32 >;
+        case comma::csv::format::int64:         return lexical_cast< comma::csv::format::int64 >;
+        case comma::csv::format::uint64:        return lexical_cast< comma::csv::format::uint64 >;
+        case comma::csv::format::char_t:        return lexical_cast< comma::csv::format::char_t >;
+        case comma::csv::format::float_t:       return lexical_cast< comma::csv::format::float_t >;
+        case comma::csv::format::double_t:      return lexical_cast< comma::csv::format::double_t >;
+        case comma::csv::format::time:          return lexical_cast< comma::csv::format::time >;
+        case comma::csv::format::long_time:     return lexical_cast< comma::csv::format::long_time >;
+        default:                                COMMA_THROW( comma::exception, "type conversion from fixed_string to " << comma::csv::format::to_format( to_type ) << " is not supported" );
     }
 }
 
-void cast( const comma::csv::format& iformat, const std::vector< char >& input, const comma::csv::format& oformat, std::vector< char >& output )
+static kernel_t kernel( const comma::csv::format::types_enum from_type, const comma::csv::format::types_enum to_type )
+{
+    switch( from_type )
+    {
+        case comma::csv::format::int8:          return kernel< char >( to_type );
+        case comma::csv::format::uint8:         return kernel< unsigned char >( to_type );
+        case comma::csv::format::int16:         return kernel< comma::int16 >( to_type );
+        case comma::csv::format::uint16:        return kernel< comma::uint16 >( to_type );
+        case comma::csv::format::int32:         return kernel< comma::int32 >( to_type );
+        case comma::csv::format::uint32:        return kernel< comma::uint32 >( to_type );
+        case comma::csv::format::int64:         return kernel< comma::int64 >( to_type );
+        case comma::csv::format::uint64:        return kernel< comma::uint64 >( to_type );
+        case comma::csv::format::char_t:        return kernel< char >( to_type );
+        case comma::csv::format::float_t:       return kernel< float >( to_type );
+        case comma::csv::format::double_t:      return kernel< double >( to_type );
+        case comma::csv::format::fixed_string:  return lexical_cast_kernel( to_type );
+        default:                                COMMA_THROW( comma::exception, "type conversion from " << comma::csv::format::to_format( from_type ) << " to " << comma::csv::format::to_format( to_type ) << " is not supported" );
+    }
+}
+
+/// conversion plan: conversion kernels resolved once for runs of fields with the same conversion
+class plan
+{
+    public:
+        plan( const comma::csv::format& iformat, const comma::csv::format& oformat );
+
+        /// convert given number of records
+        void convert( const char* in, char* out, std::size_t records ) const;
+
+    private:
+        struct step
+        {
+            kernel_t kernel;
+            unsigned int ioffset;
+            unsigned int ooffset;
+            unsigned int count;
+            unsigned int isize;
+            unsigned int osize;
+        };
+        std::vector< step > steps_;
+        std::size_t istride_;
+        std::size_t ostride_;
+};
+
+plan::plan( const comma::csv::format& iformat, const comma::csv::format& oformat ) : istride_( iformat.size() ), ostride_( oformat.size() )
 {
-    const char* in = &input[0];
     unsigned int ioffset = 0;
     unsigned int icount = 0;
-    char* out = &output[0];
     unsigned int ooffset = 0;
     unsigned int ocount = 0;
+    unsigned int in = 0;
+    unsigned int out = 0;
     for( unsigned int i = 0; i < iformat.count(); ++i, ++icount, ++ocount )
     {
         if( icount >= iformat.elements()[ ioffset ].count ) { icount = 0; ++ioffset; }
         if( ocount >= oformat.elements()[ ooffset ].count ) { ocount = 0; ++ooffset; }
         comma::csv::format::types_enum from_type = iformat.elements()[ ioffset ].type;
         comma::csv::format::types_enum to_type = oformat.elements()[ ooffset ].type;
-        if( from_type == to_type ) { std::memcpy( out, in, iformat.elements()[ ioffset ].size ); }
-        else
+        unsigned int isize = iformat.elements()[ ioffset ].size;
+        unsigned int osize = oformat.elements()[ ooffset ].size;
+        step s;
+        s.kernel = from_type != to_type ? kernel( from_type, to_type ) : isize == osize ? copy : copy_string;
+        s.ioffset = in;
+        s.ooffset = out;
+        s.count = 1;
+        s.isize = isize;
+        s.osize = osize;
+        in += isize;
+        out += osize;
+        if( !steps_.empty() )
         {
-            switch( from_type )
-            {
-                case comma::csv::format::int8:          cast< char >( to_type, in, out ); break;
-                case comma::csv::format::uint8:         cast< unsigned char >( to_type, in, out ); break;
-                case comma::csv::format::int16:         cast< comma::int16 >( to_type, in, out ); break;
-                case comma::csv::format::uint16:        cast< comma::uint16 >( to_type, in, out ); break;
-                case comma::csv::format::int32:         cast< comma::int32 >( to_type, in, out ); break;
-                case comma::csv::format::uint32:        cast< comma::uint32 >( to_type, in, out ); break;
-                case comma::csv::format::int64:         cast< comma::int64 >( to_type, in, out ); break;
-                case comma::csv::format::uint64:        cast< comma::uint64 >( to_type, in, out ); break;
-                case comma::csv::format::char_t:        cast< char >( to_type, in, out ); break;
-                case comma::csv::format::float_t:       cast< float >( to_type, in, out ); break;
-                case comma::csv::format::double_t:      cast< double >( to_type, in, out ); break;
-                case comma::csv::format::fixed_string:  lexical_cast( to_type, std::string( in, iformat.elements()[ ioffset ].size ), out ); break;
-                default:                                COMMA_THROW( comma::exception, "type conversion from " << comma::csv::format::to_format( from_type ) << " to " << comma::csv::format::to_format( to_type ) << " is not supported" ); break;
-            }
+            step& last = steps_.back();
+            if( s.kernel == copy && last.kernel == copy ) { last.isize += isize; last.osize += osize; continue; } // merge copies of adjacent fields
+            if( s.kernel == last.kernel && s.isize == last.isize && s.osize == last.osize ) { ++last.count; continue; }
         }
-        in += iformat.elements()[ ioffset ].size;
-        out += oformat.elements()[ ooffset ].size;
+        steps_.push_back( s );
     }
 }
 
+void plan::convert( const char* in, char* out, std::size_t records ) const
+{
+    for( unsigned int i = 0; i < steps_.size(); ++i )
+    {
+        const step& s = steps_[i];
+        s.kernel( in + s.ioffset, istride_, out + s.ooffset, ostride_, records, s.count, s.isize, s.osize );
+    }
+}
+
+/// read at least one record, blocking, and then as many records as are available without blocking (up to the buffer size); return number of records read
+static std::size_t read( std::vector< char >& buffer, std::size_t record_size )
+{
+    std::cin.read( &buffer[0], record_size );
+    if( std::cin.gcount() == 0 ) { return 0; }
+    if( std::cin.gcount() < static_cast< int >( record_size ) ) { COMMA_THROW( comma::exception, "expected " << record_size << " bytes, got only " << std::cin.gcount() ); }
+    std::size_t size = record_size;
+    std::streamsize available = std::cin.rdbuf()->in_avail();
+    if( available <= 0 ) { return 1; }
+    std::size_t more = std::min( std::size_t( available ) / record_size * record_size, buffer.size() - size );
+    if( more == 0 ) { return 1; }
+    std::cin.read( &buffer[size], more );
+    if( std::size_t( std::cin.gcount() ) != more ) { COMMA_THROW( comma::exception, "expected " << more << " bytes, got only " << std::cin.gcount() ); }
+    return ( size + more ) / record_size;
+}
+
 int main( int ac, char** av )
 {
 #ifdef WIN32
@@ -262,15 +390,17 @@ int main( int ac, char** av )
         comma::csv::format iformat( options.value< std::string >( "--binary,-b,--from", av[1] ) );
         comma::csv::format oformat( options.value< std::string >( "--output-binary,--output,-o,--to", av[2] ) );
         check_conversions( iformat, oformat, options.exists( "--force" ) );
-        std::vector< char > in( iformat.size() );
-        std::vector< char > out( oformat.size() );
+        std::ios_base::sync_with_stdio( false ); // unsync to make rdbuf()->in_avail() working
+        plan p( iformat, oformat );
+        std::size_t block = std::max( std::size_t( 1 ), std::size_t( 65536 ) / iformat.size() );
+        std::vector< char > in( iformat.size() * block );
+        std::vector< char > out( oformat.size() * block );
         while( std::cin.good() )
         {
-            std::cin.read( &in[0], iformat.size() );
-            if( std::cin.gcount() == 0 ) { break; }
-            if( std::cin.gcount() < static_cast< int >( iformat.size() ) ) { COMMA_THROW( comma::exception, "expected " << iformat.size() << " bytes, got only " << std::cin.gcount() ); }
-            cast( iformat, in, oformat, out );
-            std::cout.write( &out[0], oformat.size() ).flush();
+            std::size_t records = read( in, iformat.size() );
+            if( records == 0 ) { break; }
+            p.convert( &in[0], &out[0], records );
+            std::cout.write( &out[0], oformat.size() * records ).flush();
         }
         return 0;
     }
@@ -0,0 +1,228 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifdef WIN32
+#include <stdio.h>
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include "../../application/command_line_options.h"
+#include "../../application/contact_info.h"
+#include "../../base/exception.h"
+#include "../../csv/columnar.h"
+#include "../../csv/format.h"
+#include "../../string/string.h"
+
+static void usage( bool verbose )
+{
+    std::cerr << std::endl;
+    std::cerr << "convert binary or csv records to and from columnar files: records are stored" << std::endl;
+    std::cerr << "in blocks, column by column, with minimum and maximum of each column per block," << std::endl;
+    std::cerr << "which lets readers load only the columns they need and skip whole blocks," << std::endl;
+    std::cerr << "see e.g. csv-select --columnar, csv-calc --columnar" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "usage: csv-columnar <operation> <file> [<options>]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "operations" << std::endl;
+    std::cerr << "    to: read records on stdin, write them to columnar file" << std::endl;
+    std::cerr << "        options" << std::endl;
+    std::cerr << "            --binary,-b=<format>: input binary format" << std::endl;
+    std::cerr << "            --format=<format>: input csv format, if input is csv" << std::endl;
+    std::cerr << "            --fields,-f=<fields>: input fields, stored in the file" << std::endl;
+    std::cerr << "            --delimiter,-d=<delimiter>: csv delimiter; default: ," << std::endl;
+    std::cerr << "            --block-size=<n>: number of records per block; default: 65536" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "    from: output records of columnar file to stdout as binary in the file format" << std::endl;
+    std::cerr << "        options" << std::endl;
+    std::cerr << "            --output-fields,-o=<fields>: output only given fields, only their columns" << std::endl;
+    std::cerr << "                                         are read from the file" << std::endl;
+    std::cerr << "            --output-ascii,--ascii: output as csv" << std::endl;
+    std::cerr << "            --delimiter,-d=<delimiter>: csv delimiter; default: ," << std::endl;
+    std::cerr << "            --precision=<n>: floating point precision for csv output" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "    info: output format, fields, number of blocks and records" << std::endl;
+    std::cerr << "        options" << std::endl;
+    std::cerr << "            --blocks: output block statistics as csv: <offset>,<size>,<min record>,<max record>" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "options" << std::endl;
+    std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
+    std::cerr << std::endl;
+    if( verbose )
+    {
+        std::cerr << "file layout" << std::endl;
+        std::cerr << "    header: magic \"COMMACOL\", version, reserved" << std::endl;
+        std::cerr << "    blocks: columns of a block stored one after another" << std::endl;
+        std::cerr << "    footer: format, fields, block offsets, sizes, minimum and maximum records" << std::endl;
+        std::cerr << "    trailer: footer offset, magic" << std::endl;
+        std::cerr << "    a column is an element of the expanded format, e.g. 3d,ui has 4 columns" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << "csv options" << std::endl;
+        std::cerr << comma::csv::format::usage() << std::endl;
+    }
+    std::cerr << "examples" << std::endl;
+    std::cerr << "    cat points.bin | csv-columnar to points.col --binary=t,3d,ui --fields=t,x,y,z,id" << std::endl;
+    std::cerr << "    csv-columnar from points.col --output-fields=t,z | csv-from-bin t,d" << std::endl;
+    std::cerr << "    csv-columnar info points.col --blocks" << std::endl;
+    std::cerr << "    csv-select --columnar=points.col \"z;from=10;to=20\" | csv-from-bin t,3d,ui" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << comma::contact_info << std::endl;
+    std::cerr << std::endl;
+    exit( 0 );
+}
+
+static int to( const std::string& filename, const comma::command_line_options& options )
+{
+    bool binary = options.exists( "--binary,-b" );
+    std::string s = options.value< std::string >( "--binary,-b", options.value< std::string >( "--format", "" ) );
+    if( s.empty() ) { std::cerr << "csv-columnar: to: please specify --binary or --format" << std::endl; return 1; }
+    comma::csv::format format( s );
+    char delimiter = options.value( "--delimiter,-d", ',' );
+    std::ofstream ofs( filename.c_str(), std::ios::binary );
+    if( !ofs.is_open() ) { std::cerr << "csv-columnar: to: failed to open \"" << filename << "\"" << std::endl; return 1; }
+    comma::csv::columnar::writer writer( ofs, format, options.value< std::string >( "--fields,-f", "" ), options.value< std::size_t >( "--block-size", 65536 ) );
+    std::size_t size = writer.format().size();
+    if( binary )
+    {
+        #ifdef WIN32
+        _setmode( _fileno( stdin ), _O_BINARY );
+        #endif
+        std::vector< char > buf( size * 4096 );
+        while( std::cin.good() )
+        {
+            std::cin.read( &buf[0], buf.size() );
+            std::size_t count = std::cin.gcount() / size;
+            if( count * size != std::size_t( std::cin.gcount() ) ) { std::cerr << "csv-columnar: to: expected records of size " << size << ", got incomplete record at the end of input" << std::endl; return 1; }
+            writer.write( &buf[0], count );
+        }
+    }
+    else
+    {
+        while( std::cin.good() )
+        {
+            std::string line;
+            std::getline( std::cin, line );
+            line = comma::strip( line, '\r' );
+            if( line.empty() ) { continue; }
+            writer.write( &format.csv_to_bin( line, delimiter )[0] );
+        }
+    }
+    writer.close();
+    return 0;
+}
+
+static int from( const std::string& filename, const comma::command_line_options& options )
+{
+    comma::csv::columnar::reader reader( filename );
+    const comma::csv::format& format = reader.format();
+    std::vector< comma::csv::format::element > elements;
+    std::vector< std::size_t > columns;
+    if( options.exists( "--output-fields,-o" ) )
+    {
+        const std::vector< std::string >& fields = comma::split( reader.fields(), ',' );
+        const std::vector< std::string >& output = comma::split( options.value< std::string >( "--output-fields,-o" ), ',' );
+        for( std::size_t i = 0; i < output.size(); ++i )
+        {
+            std::size_t j = 0;
+            for( ; j < fields.size() && fields[j] != output[i]; ++j );
+            if( j == fields.size() || j >= format.count() ) { std::cerr << "csv-columnar: from: field \"" << output[i] << "\" not found in \"" << reader.fields() << "\"" << std::endl; return 1; }
+            columns.push_back( j );
+            elements.push_back( format.offset( j ) );
+        }
+    }
+    std::string output_format;
+    for( std::size_t i = 0; i < elements.size(); ++i ) { output_format += ( i == 0 ? "" : "," ) + comma::csv::format::to_format( elements[i].type, elements[i].size ); }
+    comma::csv::format out( elements.empty() ? format.string() : output_format );
+    bool ascii = options.exists( "--output-ascii,--ascii" );
+    char delimiter = options.value( "--delimiter,-d", ',' );
+    boost::optional< unsigned int > precision = options.optional< unsigned int >( "--precision" );
+    #ifdef WIN32
+    if( !ascii ) { _setmode( _fileno( stdout ), _O_BINARY ); }
+    #endif
+    std::vector< char > buf;
+    std::vector< char > record( out.size() );
+    for( std::size_t b = 0; b < reader.blocks().size(); ++b )
+    {
+        std::size_t count = reader.blocks()[b].size;
+        buf.resize( count * format.size() );
+        reader.read( b, &buf[0], columns );
+        if( elements.empty() && !ascii ) { std::cout.write( &buf[0], buf.size() ); continue; }
+        for( std::size_t i = 0; i < count; ++i )
+        {
+            const char* p = &buf[ i * format.size() ];
+            if( !elements.empty() ) { for( std::size_t k = 0, offset = 0; k < elements.size(); offset += elements[k].size, ++k ) { ::memcpy( &record[offset], p + elements[k].offset, elements[k].size ); } p = &record[0]; }
+            if( ascii ) { std::cout << out.bin_to_csv( p, delimiter, precision ) << std::endl; } else { std::cout.write( p, out.size() ); }
+        }
+    }
+    std::cout.flush();
+    return 0;
+}
+
+static int info( const std::string& filename, const comma::command_line_options& options )
+{
+    comma::csv::columnar::reader reader( filename );
+    if( options.exists( "--blocks" ) )
+    {
+        char delimiter = options.value( "--delimiter,-d", ',' );
+        for( std::size_t i = 0; i < reader.blocks().size(); ++i )
+        {
+            const comma::csv::columnar::block& b = reader.blocks()[i];
+            std::cout << b.offset << delimiter << b.size << delimiter << reader.format().bin_to_csv( &b.min[0], delimiter ) << delimiter << reader.format().bin_to_csv( &b.max[0], delimiter ) << std::endl;
+        }
+        return 0;
+    }
+    std::cout << "format=" << reader.format().string() << std::endl;
+    std::cout << "fields=" << reader.fields() << std::endl;
+    std::cout << "blocks=" << reader.blocks().size() << std::endl;
+    std::cout << "size=" << reader.size() << std::endl;
+    return 0;
+}
+
+int main( int ac, char** av )
+{
+    try
+    {
+        comma::command_line_options options( ac, av, usage );
+        const std::vector< std::string >& unnamed = options.unnamed( "--output-ascii,--ascii,--blocks,--verbose,-v", "-.*" );
+        if( unnamed.size() != 2 ) { std::cerr << "csv-columnar: expected operation and file name, got: " << comma::join( unnamed, ' ' ) << std::endl; return 1; }
+        if( unnamed[0] == "to" ) { return to( unnamed[1], options ); }
+        if( unnamed[0] == "from" ) { return from( unnamed[1], options ); }
+        if( unnamed[0] == "info" ) { return info( unnamed[1], options ); }
+        std::cerr << "csv-columnar: expected operation, got: \"" << unnamed[0] << "\"" << std::endl;
+    }
+    catch( std::exception& ex ) { std::cerr << "csv-columnar: " << ex.what() << std::endl; }
+    catch( ... ) { std::cerr << "csv-columnar: unknown exception" << std::endl; }
+    return 1;
+}
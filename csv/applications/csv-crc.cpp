@@ -36,10 +36,13 @@
 #include <io.h>
 #endif
 #include <string.h>
+#if defined( __GNUC__ ) && defined( __x86_64__ ) && !defined( WIN32 )
+#define COMMA_CSV_CRC_SSE42
+#include <nmmintrin.h>
+#endif
 #include <algorithm>
 #include <iostream>
 #include <vector>
-#include <boost/crc.hpp>
 #include <boost/optional.hpp>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
@@ -119,10 +122,113 @@ struct traits< comma::uint32 >
     static comma::uint32 ntoh( comma::uint32 v ) { return ntohl( v ); }
 };
 
+/// table-driven crc processing 8 bytes at a time (slice-by-8)
+/// gives the same result as boost::crc_optimal< Bits, Poly, Init, XorOut, Reflected, Reflected >
+template < typename T, unsigned int Bits, comma::uint32 Poly, comma::uint32 Init, comma::uint32 XorOut, bool Reflected >
+class slice_by_8
+{
+    public:
+        typedef T value_type;
+
+        static value_type checksum( const char* buf, std::size_t size ) { return update( Init, buf, size ) ^ XorOut; }
+
+        /// update crc register (before final xor) with given data
+        static value_type update( comma::uint32 crc, const char* buf, std::size_t size )
+        {
+            const tables& t = tables_();
+            const unsigned char* p = reinterpret_cast< const unsigned char* >( buf );
+            if( Reflected )
+            {
+                for( ; size >= 8; size -= 8, p += 8 )
+                {
+                    comma::uint32 a = ( comma::uint32( p[0] ) | comma::uint32( p[1] ) << 8 | comma::uint32( p[2] ) << 16 | comma::uint32( p[3] ) << 24 ) ^ crc;
+                    comma::uint32 b = comma::uint32( p[4] ) | comma::uint32( p[5] ) << 8 | comma::uint32( p[6] ) << 16 | comma::uint32( p[7] ) << 24;
+                    crc = t.t[7][ a & 0xff ] ^ t.t[6][ ( a >> 8 ) & 0xff ] ^ t.t[5][ ( a >> 16 ) & 0xff ] ^ t.t[4][ a >> 24 ]
+                        ^ t.t[3][ b & 0xff ] ^ t.t[2][ ( b >> 8 ) & 0xff ] ^ t.t[1][ ( b >> 16 ) & 0xff ] ^ t.t[0][ b >> 24 ];
+                }
+                for( ; size > 0; --size, ++p ) { crc = ( crc >> 8 ) ^ t.t[0][ ( crc ^ *p ) & 0xff ]; }
+                return value_type( crc );
+            }
+            crc <<= 32 - Bits; // register aligned to the most significant bit
+            for( ; size >= 8; size -= 8, p += 8 )
+            {
+                comma::uint32 a = ( comma::uint32( p[0] ) << 24 | comma::uint32( p[1] ) << 16 | comma::uint32( p[2] ) << 8 | comma::uint32( p[3] ) ) ^ crc;
+                comma::uint32 b = comma::uint32( p[4] ) << 24 | comma::uint32( p[5] ) << 16 | comma::uint32( p[6] ) << 8 | comma::uint32( p[7] );
+                crc = t.t[7][ a >> 24 ] ^ t.t[6][ ( a >> 16 ) & 0xff ] ^ t.t[5][ ( a >> 8 ) & 0xff ] ^ t.t[4][ a & 0xff ]
+                    ^ t.t[3][ b >> 24 ] ^ t.t[2][ ( b >> 16 ) & 0xff ] ^ t.t[1][ ( b >> 8 ) & 0xff ] ^ t.t[0][ b & 0xff ];
+            }
+            for( ; size > 0; --size, ++p ) { crc = ( crc << 8 ) ^ t.t[0][ ( crc >> 24 ) ^ *p ]; }
+            return value_type( crc >> ( 32 - Bits ) );
+        }
+
+    private:
+        struct tables
+        {
+            comma::uint32 t[8][256];
+            tables()
+            {
+                if( Reflected )
+                {
+                    comma::uint32 poly = 0;
+                    for( unsigned int i = 0; i < Bits; ++i ) { if( Poly & ( comma::uint32( 1 ) << i ) ) { poly |= comma::uint32( 1 ) << ( Bits - 1 - i ); } }
+                    for( unsigned int b = 0; b < 256; ++b )
+                    {
+                        comma::uint32 c = b;
+                        for( unsigned int k = 0; k < 8; ++k ) { c = c & 1 ? ( c >> 1 ) ^ poly : c >> 1; }
+                        t[0][b] = c;
+                    }
+                    for( unsigned int b = 0; b < 256; ++b ) { for( unsigned int k = 1; k < 8; ++k ) { t[k][b] = ( t[k-1][b] >> 8 ) ^ t[0][ t[k-1][b] & 0xff ]; } }
+                    return;
+                }
+                const comma::uint32 poly = Poly << ( 32 - Bits );
+                for( unsigned int b = 0; b < 256; ++b )
+                {
+                    comma::uint32 c = comma::uint32( b ) << 24;
+                    for( unsigned int k = 0; k < 8; ++k ) { c = c & 0x80000000 ? ( c << 1 ) ^ poly : c << 1; }
+                    t[0][b] = c;
+                }
+                for( unsigned int b = 0; b < 256; ++b ) { for( unsigned int k = 1; k < 8; ++k ) { t[k][b] = ( t[k-1][b] << 8 ) ^ t[0][ t[k-1][b] >> 24 ]; } }
+            }
+        };
+        static const tables& tables_() { static const tables t; return t; }
+};
+
+typedef slice_by_8< comma::uint16, 16, 0x8005, 0, 0, true > crc_16;
+typedef slice_by_8< comma::uint16, 16, 0x1021, 0xFFFF, 0, false > crc_ccitt;
+typedef slice_by_8< comma::uint16, 16, 0x8408, 0, 0, true > crc_xmodem;
+typedef slice_by_8< comma::uint32, 32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, true > crc_32;
+
+/// crc32c (castagnoli), using sse4.2 crc32 instruction, if available, slice-by-8 otherwise
+struct crc_32c
+{
+    typedef comma::uint32 value_type;
+    typedef slice_by_8< comma::uint32, 32, 0x1EDC6F41, 0xFFFFFFFF, 0xFFFFFFFF, true > software;
+
+    static value_type checksum( const char* buf, std::size_t size )
+    {
+        #ifdef COMMA_CSV_CRC_SSE42
+        static const bool sse42 = __builtin_cpu_supports( "sse4.2" );
+        if( sse42 ) { return hardware( buf, size ); }
+        #endif
+        return software::checksum( buf, size );
+    }
+
+    #ifdef COMMA_CSV_CRC_SSE42
+    __attribute__(( target( "sse4.2" ) )) static value_type hardware( const char* buf, std::size_t size )
+    {
+        comma::uint64 crc = 0xFFFFFFFF;
+        for( ; size >= 8; size -= 8, buf += 8 ) { comma::uint64 v; ::memcpy( &v, buf, 8 ); crc = _mm_crc32_u64( crc, v ); }
+        comma::uint32 c = comma::uint32( crc );
+        for( ; size > 0; --size, ++buf ) { c = _mm_crc32_u8( c, static_cast< unsigned char >( *buf ) ); }
+        return c ^ 0xFFFFFFFF;
+    }
+    #endif
+};
+
 template < typename Crc >
 static typename Crc::value_type crc_( const char* buf, std::size_t size )
 {
-    return std::for_each( buf, buf + size, Crc() )();
+    return Crc::checksum( buf, size );
 }
 
 template < typename Crc >
@@ -153,7 +259,6 @@ static bool run_()
                     if( big_endian ) { crc = traits< typename Crc::value_type >::hton( crc ); }
                     std::cout.write( p, size );
                     std::cout.write( reinterpret_cast< const char* >( &crc ), sizeof( typename Crc::value_type ) );
-                    std::cout.flush();
                 }
                 else if( recover )
                 {
@@ -180,7 +285,6 @@ static bool run_()
                             }
                         }
                         std::cout.write( p, size );
-                        std::cout.flush();
                     }
                     else // quick and dirty: lots of code duplication, but just to make it working
                     {
@@ -199,6 +303,7 @@ static bool run_()
                 }
                 continue;
             }
+            std::cout.flush(); // all records read so far are processed: flush once per block rather than on each record
             int r = ::read( 0, p, end - p );
             if( r <= 0 ) { break; }
             offset += r;
@@ -246,10 +351,11 @@ int main( int ac, char** av )
         std::string crc = options.value< std::string >( "--crc", "ccitt" );
         if( options.exists( "--crc-size" ) )
         {
-            if( crc == "16" ) { std::cout << sizeof( boost::crc_16_type::value_type ) << std::endl; }
-            else if( crc == "32" ) { std::cout << sizeof( boost::crc_32_type::value_type ) << std::endl; }
-            else if( crc == "ccitt" ) { std::cout << sizeof( boost::crc_ccitt_type::value_type ) << std::endl; }
-            else if( crc == "xmodem" ) { std::cout << sizeof( boost::crc_xmodem_type::value_type ) << std::endl; }
+            if( crc == "16" ) { std::cout << sizeof( crc_16::value_type ) << std::endl; }
+            else if( crc == "32" ) { std::cout << sizeof( crc_32::value_type ) << std::endl; }
+            else if( crc == "32c" ) { std::cout << sizeof( crc_32c::value_type ) << std::endl; }
+            else if( crc == "ccitt" ) { std::cout << sizeof( crc_ccitt::value_type ) << std::endl; }
+            else if( crc == "xmodem" ) { std::cout << sizeof( crc_xmodem::value_type ) << std::endl; }
             else { std::cerr << "csv-crc: expected crc type, got \"" << crc << "\"" << std::endl; return 1; }
             return 0;
         }
@@ -271,10 +377,11 @@ int main( int ac, char** av )
             else if( commands[i] == "recover" ) { recover = true; }
             else { std::cerr << "csv-crc: expected command, got '" << commands[i] << "'" << std::endl; return 1; }
         }
-        if( crc == "16" ) { return run_< boost::crc_16_type >(); }
-        else if( crc == "32" ) { return run_< boost::crc_32_type >(); }
-        else if( crc == "ccitt" ) { return run_< boost::crc_ccitt_type >(); }
-        else if( crc == "xmodem" ) { return run_< boost::crc_xmodem_type >(); }
+        if( crc == "16" ) { return run_< crc_16 >(); }
+        else if( crc == "32" ) { return run_< crc_32 >(); }
+        else if( crc == "32c" ) { return run_< crc_32c >(); }
+        else if( crc == "ccitt" ) { return run_< crc_ccitt >(); }
+        else if( crc == "xmodem" ) { return run_< crc_xmodem >(); }
         std::cerr << "csv-crc: expected crc type, got \"" << crc << "\"" << std::endl;
         return 1;
     }
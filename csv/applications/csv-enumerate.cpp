@@ -29,10 +29,19 @@
 
 /// @author vsevolod vlaskine
 
-#include <boost/unordered_map.hpp>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <fstream>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "../../application/command_line_options.h"
 #include "../../base/exception.h"
 #include "../../base/types.h"
+#include "../../containers/flat_hash_map.h"
 #include "../../csv/stream.h"
 #include "../../csv/impl/unstructured.h"
 #include "../../string/string.h"
@@ -49,18 +58,149 @@ static void usage( bool verbose )
     std::cerr << "options" << std::endl;
     std::cerr << "    --fields,-f=<fields>; fields of interest, actual field names do not matter; e.g: --fields ,,,a,,b,,,c" << std::endl;
     std::cerr << "    --format=<binary format>; if input is ascii and deducing data types may be ambiguous, define field types explicitly, value as in --binary" << std::endl;
+    std::cerr << "    --dictionary=<filename>: stable ids across runs: load key values and their ids from <filename>, if it exists," << std::endl;
+    std::cerr << "                             keys not in the dictionary get new ids, which are appended to <filename> as they appear" << std::endl;
+    std::cerr << "                             dictionary records are key values followed by id (as ui) in the same ascii or binary form as input" << std::endl;
+    std::cerr << "                             binary dictionaries are memory-mapped on loading" << std::endl;
     std::cerr << "    --output-map,--map: do not output input records, only the list of key values, corresponding ids (as ui), and value count (as ui)" << std::endl;
     std::cerr << std::endl;
+    std::cerr << "examples" << std::endl;
+    std::cerr << "    cat monday.csv | csv-enumerate --fields=,id --dictionary=ids.csv > monday.enumerated.csv" << std::endl;
+    std::cerr << "    cat tuesday.csv | csv-enumerate --fields=,id --dictionary=ids.csv > tuesday.enumerated.csv # same ids for the same keys as on monday" << std::endl;
+    std::cerr << std::endl;
     std::cerr << "csv options" << std::endl;
     if( verbose ) { std::cerr << comma::csv::options::usage() << std::endl; } else { std::cerr << "    run csv-enumerate --help --verbose for more..." << std::endl; }
     std::cerr << std::endl;
     exit( 0 );
 }
 
+typedef comma::csv::impl::unstructured input_t;
+typedef comma::csv::impl::unstructured::packed packed_t;
+typedef comma::flat_hash_map< packed_t, std::pair< comma::uint32, comma::uint32 >, packed_t::hash > map_t;
+typedef std::pair< input_t, std::pair< comma::uint32, comma::uint32 > > output_t;
+typedef std::pair< input_t, comma::uint32 > dictionary_entry_t;
+
+/// binary format of key values in the order of input_t members, with string sizes taken from input format
+static std::string key_format( const comma::csv::format& f, const std::vector< std::string >& fields )
+{
+    std::vector< std::string > longs, doubles, time, strings;
+    for( unsigned int i = 0; i < fields.size(); ++i )
+    {
+        if( fields[i].empty() ) { continue; }
+        switch( fields[i][0] )
+        {
+            case 'l': longs.push_back( "l" ); break;
+            case 'd': doubles.push_back( "d" ); break;
+            case 't': time.push_back( "t" ); break;
+            case 's': strings.push_back( "s[" + boost::lexical_cast< std::string >( f.offset( i ).size ) + "]" ); break;
+        }
+    }
+    longs.insert( longs.end(), doubles.begin(), doubles.end() );
+    longs.insert( longs.end(), time.begin(), time.end() );
+    longs.insert( longs.end(), strings.begin(), strings.end() );
+    return comma::join( longs, ',' );
+}
+
+/// dictionary of key values and their ids persistent across runs
+class dictionary
+{
+    public:
+        dictionary( const std::string& filename, const comma::csv::options& csv, const input_t& sample, const std::string& key_format ) : filename_( filename ), csv_( csv ), sample_( sample, 0 )
+        {
+            csv_.fields.clear();
+            csv_.full_xpath = true;
+            csv_.flush = true;
+            if( csv.binary() ) { csv_.format( key_format + ",ui" ); }
+        }
+        
+        /// load dictionary into map, return next id
+        comma::uint32 load( map_t& map, bool verbose )
+        {
+            comma::uint32 id = 0;
+            packed_t key;
+            if( csv_.binary() ) { load_binary_( map, key, id ); } else { load_ascii_( map, key, id ); }
+            if( verbose ) { std::cerr << "csv-enumerate: loaded " << map.size() << " key(s) from dictionary " << filename_ << std::endl; }
+            return id;
+        }
+        
+        /// append new entry
+        void append( const input_t& key, comma::uint32 id )
+        {
+            if( !ostream_ )
+            {
+                ofstream_.open( filename_.c_str(), std::ios::out | std::ios::app | ( csv_.binary() ? std::ios::binary : std::ios::openmode( 0 ) ) );
+                if( !ofstream_.is_open() ) { COMMA_THROW( comma::exception, "failed to open dictionary \"" << filename_ << "\" for writing" ); }
+                ostream_.reset( new comma::csv::output_stream< dictionary_entry_t >( ofstream_, csv_, sample_ ) );
+            }
+            ostream_->write( dictionary_entry_t( key, id ) );
+        }
+        
+    private:
+        std::string filename_;
+        comma::csv::options csv_;
+        dictionary_entry_t sample_;
+        std::ofstream ofstream_;
+        boost::scoped_ptr< comma::csv::output_stream< dictionary_entry_t > > ostream_;
+        
+        static void insert_( map_t& map, packed_t& key, const dictionary_entry_t& e, comma::uint32& id )
+        {
+            if( !map.try_emplace( key.assign( e.first ), std::make_pair( e.second, 0 ) ).second ) { COMMA_THROW( comma::exception, "duplicated key with id " << e.second << " in dictionary" ); }
+            if( e.second >= id ) { id = e.second + 1; }
+        }
+        
+        void load_ascii_( map_t& map, packed_t& key, comma::uint32& id )
+        {
+            std::ifstream ifs( filename_.c_str() );
+            if( !ifs.is_open() ) { return; }
+            comma::csv::input_stream< dictionary_entry_t > istream( ifs, csv_, sample_ );
+            while( istream.ready() || ifs.good() )
+            {
+                const dictionary_entry_t* e = istream.read();
+                if( !e ) { break; }
+                insert_( map, key, *e, id );
+            }
+        }
+        
+        void load_binary_( map_t& map, packed_t& key, comma::uint32& id )
+        {
+            #ifdef WIN32
+            std::ifstream ifs( filename_.c_str(), std::ios::binary );
+            if( !ifs.is_open() ) { return; }
+            comma::csv::input_stream< dictionary_entry_t > istream( ifs, csv_, sample_ );
+            while( istream.ready() || ifs.good() )
+            {
+                const dictionary_entry_t* e = istream.read();
+                if( !e ) { break; }
+                insert_( map, key, *e, id );
+            }
+            #else
+            int fd = ::open( filename_.c_str(), O_RDONLY );
+            if( fd < 0 ) { return; }
+            struct stat st;
+            if( ::fstat( fd, &st ) != 0 ) { ::close( fd ); COMMA_THROW( comma::exception, "failed to stat dictionary \"" << filename_ << "\"" ); }
+            std::size_t size = st.st_size;
+            std::size_t record_size = csv_.format().size();
+            if( size % record_size ) { ::close( fd ); COMMA_THROW( comma::exception, "expected dictionary \"" << filename_ << "\" size to be multiple of " << record_size << "; got: " << size ); }
+            if( size == 0 ) { ::close( fd ); return; }
+            void* p = ::mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            ::close( fd );
+            if( p == MAP_FAILED ) { COMMA_THROW( comma::exception, "failed to map dictionary \"" << filename_ << "\"" ); }
+            ::madvise( p, size, MADV_SEQUENTIAL );
+            // keys are copied into the hash map rather than looked up in the mapped file: lookups still need
+            // a hash index over the records and new keys get appended to the dictionary while running;
+            // mapping only saves the buffered reads and per-record stream overhead on loading
+            map.reserve( size / record_size );
+            comma::csv::binary< dictionary_entry_t > binary( csv_, sample_ );
+            dictionary_entry_t e = sample_;
+            try { for( const char* r = static_cast< const char* >( p ); r < static_cast< const char* >( p ) + size; r += record_size ) { insert_( map, key, binary.get( e, r ), id ); } }
+            catch( ... ) { ::munmap( p, size ); throw; }
+            ::munmap( p, size );
+            #endif
+        }
+};
+
 int main( int ac, char** av )
 {
-    typedef comma::csv::impl::unstructured input_t;
-    typedef boost::unordered_map< comma::csv::impl::unstructured, std::pair< comma::uint32, comma::uint32 >, comma::csv::impl::unstructured::hash >  map_t;
     try
     {
         comma::command_line_options options( ac, av, usage );
@@ -87,26 +227,35 @@ int main( int ac, char** av )
             v[i] = default_input.append( f.offset( i ).type );
         }
         if( verbose ) { std::cerr << "csv-enumerate: fields " << csv.fields << " interpreted as: " << comma::join( v, ',' ) << std::endl; }
+        const std::string& binary_key_format = key_format( f, v );
         csv.fields = comma::join( v, ',' );
         comma::csv::input_stream< input_t > istream( std::cin, csv, default_input );
         #ifdef WIN32
         if( istream.is_binary() ) { _setmode( _fileno( stdout ), _O_BINARY ); }
         #endif
         static map_t map;
+        packed_t key;
         comma::uint32 id = 0;
+        boost::scoped_ptr< dictionary > dict;
+        if( options.exists( "--dictionary" ) )
+        {
+            dict.reset( new dictionary( options.value< std::string >( "--dictionary" ), csv, default_input, binary_key_format ) );
+            id = dict->load( map, verbose );
+        }
         if( !first_line.empty() )
         { 
             input_t input = comma::csv::ascii< input_t >( csv, default_input ).get( first_line );
-            map[ comma::csv::ascii< input_t >( csv, default_input ).get( first_line ) ] = std::make_pair( id++, 1 );
-            if( !output_map ) { std::cout << first_line << csv.delimiter << 0 << std::endl; }
+            std::pair< map_t::iterator, bool > r = map.try_emplace( key.assign( input ), std::make_pair( id, 1 ) );
+            if( r.second ) { if( dict ) { dict->append( input, id ); } ++id; } else { ++( r.first->second.second ); }
+            if( !output_map ) { std::cout << first_line << csv.delimiter << r.first->second.first << std::endl; }
         }
         while( istream.ready() || std::cin.good() )
         {
             const input_t* p = istream.read();
             if( !p ) { break; }
-            map_t::iterator it = map.find( *p );
-            comma::uint32 cur = id;
-            if( it == map.end() ) { map[ *p ] = std::make_pair( id++, 1 ); } else { cur = it->second.first; ++( it->second.second ); }
+            std::pair< map_t::iterator, bool > r = map.try_emplace( key.assign( *p ), std::make_pair( id, 1 ) );
+            comma::uint32 cur = r.first->second.first;
+            if( r.second ) { if( dict ) { dict->append( *p, id ); } ++id; } else { ++( r.first->second.second ); }
             if( !output_map )
             {
                 if( csv.binary() )
@@ -124,9 +273,19 @@ int main( int ac, char** av )
         comma::csv::options output_csv;
         output_csv.delimiter = csv.delimiter;
         output_csv.full_xpath = true;
-        if( csv.binary() ) { output_csv.format( comma::csv::format::value< input_t >( default_input ) + "2ui" ); }
-        comma::csv::output_stream< map_t::value_type > ostream( std::cout, output_csv, std::make_pair( default_input, std::make_pair( 0, 0 ) ) );
-        if( output_map ) { for( map_t::const_iterator it = map.begin(); it != map.end(); ++it ) { ostream.write( *it ); } }
+        if( csv.binary() ) { output_csv.format( binary_key_format + ",2ui" ); }
+        output_t output( default_input, std::make_pair( 0, 0 ) );
+        comma::csv::output_stream< output_t > ostream( std::cout, output_csv, output );
+        if( output_map )
+        {
+            for( map_t::const_iterator it = map.begin(); it != map.end(); ++it )
+            {
+                if( it->second.second == 0 ) { continue; } // dictionary keys not present in input
+                it->first.unpack( output.first );
+                output.second = it->second;
+                ostream.write( output );
+            }
+        }
         return 0;
     }
     catch( std::exception& ex ) { std::cerr << "csv-enumerate: " << ex.what() << std::endl; }
@@ -37,11 +37,16 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
+#include <cstdio>
+#include <algorithm>
 #include <iostream>
+#include <vector>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
 #include "../../csv/format.h"
+#include "../../csv/impl/iso_time.h"
 #include "../../string/string.h"
 
 using namespace comma;
@@ -59,6 +64,126 @@ static void usage()
     exit( 0 );
 }
 
+namespace {
+
+/// formats binary records as csv into a block of text, without per-record string streams;
+/// output is the same as of comma::csv::format::bin_to_csv()
+class converter
+{
+    public:
+        converter( const comma::csv::format& format, char delimiter, const boost::optional< unsigned int >& precision )
+            : delimiter_( delimiter )
+            , float_precision_( precision ? *precision : 6 )
+            , double_precision_( precision ? *precision : 16 )
+        {
+            for( unsigned int i = 0; i < format.elements().size(); ++i )
+            {
+                for( unsigned int j = 0; j < format.elements()[i].count; ++j ) { fields_.push_back( field( format.elements()[i].type, format.elements()[i].size ) ); }
+            }
+        }
+
+        /// append record as csv line to output
+        void convert( const char* buf, std::vector< char >& output ) const
+        {
+            for( unsigned int i = 0; i < fields_.size(); buf += fields_[i].size, ++i )
+            {
+                if( i > 0 ) { output.push_back( delimiter_ ); }
+                convert_( fields_[i], buf, output );
+            }
+            output.push_back( '\n' );
+        }
+
+    private:
+        struct field
+        {
+            comma::csv::format::types_enum type;
+            std::size_t size;
+            field( comma::csv::format::types_enum type, std::size_t size ) : type( type ), size( size ) {}
+        };
+        char delimiter_;
+        int float_precision_;
+        int double_precision_;
+        std::vector< field > fields_;
+
+        static void append_( std::vector< char >& output, const char* s, std::size_t size ) { output.insert( output.end(), s, s + size ); }
+
+        template < typename T > static void integer_( T v, std::vector< char >& output )
+        {
+            char buf[24];
+            char* p = buf + sizeof( buf );
+            bool negative = v < 0;
+            comma::uint64 u = negative ? comma::uint64( -( v + 1 ) ) + 1 : comma::uint64( v );
+            do { *--p = '0' + u % 10; u /= 10; } while( u );
+            if( negative ) { *--p = '-'; }
+            append_( output, p, buf + sizeof( buf ) - p );
+        }
+
+        template < typename T > static void integer_( const char* buf, std::vector< char >& output ) { T v; ::memcpy( &v, buf, sizeof( T ) ); integer_( v, output ); }
+
+        static void floating_point_( double v, int precision, std::vector< char >& output ) // same as std::ostream with given precision
+        {
+            char buf[64];
+            int size = ::snprintf( buf, sizeof( buf ), "%.*g", precision, v );
+            if( size < int( sizeof( buf ) ) ) { append_( output, buf, size ); return; }
+            std::vector< char > b( size + 1 );
+            ::snprintf( &b[0], b.size(), "%.*g", precision, v );
+            append_( output, &b[0], size );
+        }
+
+        void convert_( const field& f, const char* buf, std::vector< char >& output ) const
+        {
+            switch( f.type )
+            {
+                case comma::csv::format::int8: integer_( int( *buf ), output ); break;
+                case comma::csv::format::uint8: integer_( static_cast< unsigned int >( static_cast< unsigned char >( *buf ) ), output ); break;
+                case comma::csv::format::int16: integer_< comma::int16 >( buf, output ); break;
+                case comma::csv::format::uint16: integer_< comma::uint16 >( buf, output ); break;
+                case comma::csv::format::int32: integer_< comma::int32 >( buf, output ); break;
+                case comma::csv::format::uint32: integer_< comma::uint32 >( buf, output ); break;
+                case comma::csv::format::int64: integer_< comma::int64 >( buf, output ); break;
+                case comma::csv::format::uint64: integer_< comma::uint64 >( buf, output ); break;
+                case comma::csv::format::char_t: output.push_back( *buf ); break;
+                case comma::csv::format::float_t: { float v; ::memcpy( &v, buf, sizeof( float ) ); floating_point_( v, float_precision_, output ); break; }
+                case comma::csv::format::double_t: { double v; ::memcpy( &v, buf, sizeof( double ) ); floating_point_( v, double_precision_, output ); break; }
+                case comma::csv::format::time:
+                {
+                    char t[32];
+                    append_( output, t, comma::csv::impl::to_iso_basic_string( comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::from_bin( buf ), t ) );
+                    break;
+                }
+                case comma::csv::format::long_time:
+                {
+                    char t[32];
+                    append_( output, t, comma::csv::impl::to_iso_basic_string( comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::from_bin( buf ), t ) );
+                    break;
+                }
+                case comma::csv::format::fixed_string:
+                {
+                    const char* end = static_cast< const char* >( ::memchr( buf, 0, f.size ) );
+                    append_( output, buf, buf[ f.size - 1 ] == 0 ? end - buf : f.size );
+                    break;
+                }
+            }
+        }
+};
+
+/// read at least one record, blocking, and then as many records as are available without blocking (up to the buffer size); return number of records read
+static std::size_t read( std::vector< char >& buffer, std::size_t record_size )
+{
+    std::cin.read( &buffer[0], record_size );
+    if( std::cin.gcount() == 0 ) { return 0; }
+    if( std::cin.gcount() < static_cast< int >( record_size ) ) { COMMA_THROW( comma::exception, "expected " << record_size << " bytes, got only " << std::cin.gcount() ); }
+    std::streamsize available = std::cin.rdbuf()->in_avail();
+    if( available <= 0 ) { return 1; }
+    std::size_t more = std::min( std::size_t( available ) / record_size * record_size, buffer.size() - record_size );
+    if( more == 0 ) { return 1; }
+    std::cin.read( &buffer[record_size], more );
+    if( std::size_t( std::cin.gcount() ) != more ) { COMMA_THROW( comma::exception, "expected " << more << " bytes, got only " << std::cin.gcount() ); }
+    return 1 + more / record_size;
+}
+
+} // namespace {
+
 int main( int ac, char** av )
 {
     #ifdef WIN32
@@ -72,14 +197,17 @@ int main( int ac, char** av )
         boost::optional< unsigned int > precision;
         if( options.exists( "--precision" ) ) { precision = options.value< unsigned int >( "--precision" ); }
         comma::csv::format format( av[1] );
-        std::vector< char > w( format.size() ); //char buf[ format.size() ]; // stupid windows
-        char* buf = &w[0];
+        std::ios_base::sync_with_stdio( false ); // unsync to make rdbuf()->in_avail() working
+        converter c( format, delimiter, precision );
+        std::vector< char > input( std::max( std::size_t( 1 ), std::size_t( 1 << 20 ) / format.size() ) * format.size() );
+        std::vector< char > output;
         while( std::cin.good() && !std::cin.eof() )
         {
-            std::cin.read( buf, format.size() );
-            if( std::cin.gcount() == 0 ) { break; }
-            if( std::cin.gcount() < static_cast< int >( format.size() ) ) { COMMA_THROW( comma::exception, "expected " << format.size() << " bytes, got only " << std::cin.gcount() ); }
-            std::cout << format.bin_to_csv( buf, delimiter, precision ) << std::endl;
+            std::size_t records = read( input, format.size() );
+            if( records == 0 ) { break; }
+            output.clear();
+            for( std::size_t i = 0; i < records; ++i ) { c.convert( &input[ i * format.size() ], output ); }
+            std::cout.write( &output[0], output.size() ).flush();
         }
         return 0;
     }
@@ -31,6 +31,7 @@
 /// @author Vinny Do
 
 #include <iostream>
+#include <map>
 #include <set>
 #include <string>
 #include <boost/icl/interval.hpp>
@@ -118,6 +119,10 @@ static void usage( bool verbose = false )
     std::cerr << "                  s  : \"" << limits< std::string >::lowest() << "\" \"" << limits< std::string >::max() << "\"" << std::endl;
     std::cerr << "                  t  : " << limits< boost::posix_time::ptime >::lowest() << " " << limits< boost::posix_time::ptime >::max() << std::endl;
     std::cerr << "                  lt : " << limits< boost::posix_time::ptime >::lowest() << " " << limits< boost::posix_time::ptime >::max() << std::endl;
+    std::cerr << "    --sorted,--input-sorted: input is sorted by interval start; output split intervals as soon as they are final" << std::endl;
+    std::cerr << "                             only currently active intervals are kept in memory, thus suitable for unbounded streams" << std::endl;
+    std::cerr << "                             payloads of a split interval are output in the order of input records" << std::endl;
+    std::cerr << "                             identical payloads are not merged and adjacent split intervals are not joined" << std::endl;
     std::cerr << std::endl;
     std::cerr << "ascii notes" << std::endl;
     std::cerr << "    unbounded intervals may be indicated by no value (e.g. ,3 \u2261 -\u221e,3), both sides unbounded is also supported" << std::endl;
@@ -278,7 +283,13 @@ struct intervals
     boost::optional< bound_type > empty;
     bool intervals_only;
     bool use_limits;
+    bool sorted;
     map_t map;
+    std::multimap< bound_t< bound_type >, comma::uint64 > active; // sorted mode: upper bound -> index of active record
+    std::map< comma::uint64, std::string > payloads; // sorted mode: payloads of active records by record index
+    comma::uint64 count;
+    boost::optional< bound_t< bound_type > > last_from;
+    bound_t< bound_type > cursor;
 
     intervals( const comma::command_line_options& options ) : options( options )
                                                             , csv( options )
@@ -287,6 +298,9 @@ struct intervals
                                                             , empty( traits< bound_type >::cast( options.optional< std::string >( "--empty" ) ) )
                                                             , intervals_only( options.exists( "--intervals-only" ) )
                                                             , use_limits( options.exists( "--limits,-l" ) )
+                                                            , sorted( options.exists( "--sorted,--input-sorted" ) )
+                                                            , count( 0 )
+                                                            , cursor( LOWER )
     {
         if( csv.fields.empty() ) { csv.fields = comma::join( comma::csv::names< interval_t< From, To > >(), ',' ); }
         if( ocsv.fields.empty() || intervals_only )
@@ -301,53 +315,87 @@ struct intervals
 
     void add( const bound_t< bound_type >& from, const bound_t< bound_type >& to, const std::string& payload )
     {
+        if( sorted ) { add_sorted_( from, to, payload ); return; }
         set_t s;
         s.insert( payload );
         map += std::make_pair( boost::icl::interval< bound_t< bound_type > >::right_open( from, to ), s );
     }
 
     void write()
+    {
+        if( sorted ) { flush_sorted_(); return; }
+        for( typename map_t::iterator it = map.begin(); it != map.end(); ++it ) { write_( it->first.lower(), it->first.upper(), it->second.begin(), it->second.end() ); }
+    }
+
+    static bool before_( const bound_t< bound_type >& lhs, const bound_t< bound_type >& rhs ) { return lhs.value || rhs.value ? lhs < rhs : lhs.side == LOWER && rhs.side == UPPER; }
+
+    static const std::string& payload_( const std::string& s ) { return s; }
+    static const std::string& payload_( const std::pair< const comma::uint64, std::string >& p ) { return p.second; }
+
+    template < typename It >
+    void write_( const bound_t< bound_type >& from, const bound_t< bound_type >& to, It begin, It end )
     {
         static comma::csv::output_stream< interval_t< From, To > > ostream( std::cout, ocsv );
         static comma::csv::ascii< from_t< std::string > > from_ascii( ascii_csv );
         static comma::csv::ascii< to_t< std::string > > to_ascii( ascii_csv );
-        for( typename map_t::iterator it = map.begin(); it != map.end(); ++it )
+        interval_t< From, To > interval;
+        bool from_has_value = true;
+        bool to_has_value = true;
+        if( from.value ) { interval.from.value = *from.value; }
+        else if( use_limits ) { interval.from.value = limits< From >::lowest(); }
+        else if( empty ) { interval.from.value = static_cast< From >( *empty ); }
+        else { from_has_value = false; }
+        if( to.value ) { interval.to.value = *to.value; }
+        else if( use_limits ) { interval.to.value = limits< To >::max(); }
+        else if( empty ) { interval.to.value = static_cast< To >( *empty ); }
+        else { to_has_value = false; }
+        if( csv.binary() )
         {
-            bound_t< bound_type > from = it->first.lower();
-            bound_t< bound_type > to = it->first.upper();
-            interval_t< From, To > interval;
-            bool from_has_value = true;
-            bool to_has_value = true;
-            if( from.value ) { interval.from.value = *from.value; }
-            else if( use_limits ) { interval.from.value = limits< From >::lowest(); }
-            else if( empty ) { interval.from.value = static_cast< From >( *empty ); }
-            else { from_has_value = false; }
-            if( to.value ) { interval.to.value = *to.value; }
-            else if( use_limits ) { interval.to.value = limits< To >::max(); }
-            else if( empty ) { interval.to.value = static_cast< To >( *empty ); }
-            else { to_has_value = false; }
-            const set_t& s = it->second;
-            if( csv.binary() )
-            {
-                if( intervals_only ) { ostream.write( interval ); ostream.flush(); continue; }
-                for( typename set_t::const_iterator v = s.begin(); v != s.end(); ++v ) { ostream.write( interval, *v ); }
-                ostream.flush();
-            }
-            else
+            if( intervals_only ) { ostream.write( interval ); ostream.flush(); return; }
+            for( It v = begin; v != end; ++v ) { ostream.write( interval, payload_( *v ) ); }
+            ostream.flush();
+        }
+        else
+        {
+            for( It v = begin; v != end; ++v )
             {
-                for( typename set_t::const_iterator v = s.begin(); v != s.end(); ++v )
-                {
-                    std::string payload( intervals_only ? "" : *v );
-                    ostream.ascii().ascii().put( interval, payload );
-                    if( !from_has_value ) { from_ascii.put( from_t< std::string >(), payload ); }
-                    if( !to_has_value ) { to_ascii.put( to_t< std::string >(), payload); }
-                    std::cout << payload << std::endl;
-                    if( intervals_only ) { break; }
-                }
+                std::string payload( intervals_only ? "" : payload_( *v ) );
+                ostream.ascii().ascii().put( interval, payload );
+                if( !from_has_value ) { from_ascii.put( from_t< std::string >(), payload ); }
+                if( !to_has_value ) { to_ascii.put( to_t< std::string >(), payload); }
+                std::cout << payload << std::endl;
+                if( intervals_only ) { break; }
             }
         }
     }
 
+    /// sweep line: output split intervals of all active records up to the given bound and drop records that ended
+    void sweep_( const bound_t< bound_type >& until )
+    {
+        while( !active.empty() && !before_( until, active.begin()->first ) )
+        {
+            bound_t< bound_type > to = active.begin()->first;
+            if( before_( cursor, to ) ) { write_( cursor, to, payloads.begin(), payloads.end() ); }
+            cursor = to;
+            while( !active.empty() && !before_( to, active.begin()->first ) ) { payloads.erase( active.begin()->second ); active.erase( active.begin() ); }
+        }
+        if( !active.empty() && before_( cursor, until ) ) { write_( cursor, until, payloads.begin(), payloads.end() ); }
+        cursor = until;
+    }
+
+    void add_sorted_( const bound_t< bound_type >& from, const bound_t< bound_type >& to, const std::string& payload )
+    {
+        if( last_from && before_( from, *last_from ) ) { COMMA_THROW( comma::exception, "expected input sorted by interval start; got from: " << from << " after: " << *last_from ); }
+        last_from = from;
+        ++count;
+        if( !before_( from, to ) ) { return; }
+        sweep_( from );
+        payloads[ count ] = payload;
+        active.insert( std::make_pair( to, count ) );
+    }
+
+    void flush_sorted_() { sweep_( bound_t< bound_type >( UPPER ) ); }
+
     void run()
     {
         comma::csv::input_stream< interval_t< From, To > > istream( std::cin, csv );
@@ -30,6 +30,8 @@
 
 /// @author vsevolod vlaskine
 
+#include <string.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -57,6 +59,10 @@ static void usage()
     std::cerr << std::endl;
     std::cerr << "in the simplest case, the lines in all the given csv sources" << std::endl;
     std::cerr << "are expected to be exactly in the same order;" << std::endl;
+    std::cerr << "if some of the sources end before the others, exit with error" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "binary inputs are pasted in blocks: records already available on all" << std::endl;
+    std::cerr << "the inputs are read at once, interleaved, and output in a single write" << std::endl;
     std::cerr << std::endl;
     std::cerr << "something like:" << std::endl;
     std::cerr << "    csv-paste \"file1.csv\" \"file2.csv\" \"value=<value>\" \"line-number\"" << std::endl;
@@ -100,6 +106,8 @@ class source
         virtual ~source() {}
         virtual const std::string* read() = 0;
         virtual const char* read( char* buf ) = 0;
+        /// binary: write next n records to buf with given stride between records; for streams, n must not exceed fill()
+        virtual void read( char* buf, std::size_t n, std::size_t stride ) { for( std::size_t i = 0; i < n; ++i, buf += stride ) { read( buf ); } }
         bool binary() const { return binary_; }
         virtual const bool is_stream() const { return false; }
         const std::string& properties() const { return properties_; }
@@ -118,6 +126,8 @@ class stream : public source
         stream( const std::string& properties )
             : source( properties )
             , stream_( comma::split( properties, ';' )[0], binary() ? comma::io::mode::binary : comma::io::mode::ascii )
+            , begin_( 0 )
+            , count_( 0 )
         {
         }
         
@@ -137,11 +147,47 @@ class stream : public source
             stream_->read( buf, value_.size() );
             return stream_->gcount() == int( value_.size() ) ? buf : NULL;
         }
+
+        /// binary: make sure at least one record is buffered (blocking), then buffer
+        /// as many further records as already available without blocking, up to
+        /// given capacity; return number of buffered records, 0 on end of stream
+        std::size_t fill( std::size_t capacity )
+        {
+            std::size_t size = value_.size();
+            if( block_.size() < capacity * size ) { block_.resize( capacity * size ); }
+            if( begin_ > 0 ) { ::memmove( &block_[0], &block_[ begin_ * size ], count_ * size ); begin_ = 0; }
+            if( count_ == 0 )
+            {
+                stream_->read( &block_[0], size );
+                if( stream_->gcount() < int( size ) ) { return 0; }
+                count_ = 1;
+            }
+            std::streamsize available = stream_->rdbuf()->in_avail();
+            if( available >= std::streamsize( size ) && count_ < capacity )
+            {
+                std::size_t n = std::min( capacity - count_, std::size_t( available ) / size );
+                stream_->read( &block_[ count_ * size ], n * size );
+                count_ += stream_->gcount() / size; // should not happen, but if there is partial record, it will be lost as at the end of stream
+            }
+            return count_;
+        }
+
+        void read( char* buf, std::size_t n, std::size_t stride )
+        {
+            std::size_t size = value_.size();
+            const char* p = &block_[ begin_ * size ];
+            for( std::size_t i = 0; i < n; ++i, buf += stride, p += size ) { ::memcpy( buf, p, size ); }
+            begin_ += n;
+            count_ -= n;
+        }
         
-        const bool is_stream() { return true; }
+        const bool is_stream() const { return true; }
         
     private:
         comma::io::istream stream_;
+        std::vector< char > block_;
+        std::size_t begin_;
+        std::size_t count_;
 };
 
 struct value : public source
@@ -155,6 +201,7 @@ struct value : public source
     }
     const std::string* read() { return &value_; }
     const char* read( char* buf ) { ::memcpy( buf, &value_[0], value_.size() ); return buf; } // quick and dirty
+    void read( char* buf, std::size_t n, std::size_t stride ) { for( std::size_t i = 0; i < n; ++i, buf += stride ) { ::memcpy( buf, &value_[0], value_.size() ); } }
 };
 
 class line_number : public source
@@ -175,6 +222,17 @@ class line_number : public source
             update_();
             return buf;
         }
+
+        void read( char* buf, std::size_t n, std::size_t stride )
+        {
+            for( std::size_t i = 0; i < n; ++i, buf += stride )
+            {
+                comma::csv::format::traits< comma::uint32 >::to_bin( value_, buf );
+                if( ++count_ < size_ ) { continue; }
+                count_ = 0;
+                ++value_;
+            }
+        }
         
     private:
         comma::uint32 value_;
@@ -197,6 +255,7 @@ int main( int ac, char** av )
     {
         comma::command_line_options options( ac, av );
         if( options.exists( "--help,-h" ) ) { usage(); }
+        std::ios_base::sync_with_stdio( false ); // to make std::cin.rdbuf()->in_avail() meaningful
         char delimiter = options.value( "--delimiter,-d", ',' );
         std::vector< std::string > unnamed = options.unnamed( "--flush", "--delimiter,-d,--begin,--size,--block-size" );
         boost::ptr_vector< source > sources;
@@ -240,22 +299,27 @@ int main( int ac, char** av )
             #endif
             std::size_t size = 0;
             for( unsigned int i = 0; i < sources.size(); ++i ) { size += sources[i].size(); }
-            std::vector< char > buffer( size );
+            std::size_t capacity = std::max( std::size_t( 1 ), std::size_t( 65536 ) / size ); // records per output block, arbitrary
+            std::vector< char > buffer( size * capacity );
+            std::vector< stream* > streams;
+            std::vector< unsigned int > indices; // of streams in sources
+            for( unsigned int i = 0; i < sources.size(); ++i ) { stream* t = dynamic_cast< stream* >( &sources[i] ); if( t ) { streams.push_back( t ); indices.push_back( i ); } }
             while( true )
             {
-                unsigned int streams = 0;
-                char* p = &buffer[0];
-                for( unsigned int i = 0; i < sources.size(); p += sources[i].size(), ++i )
+                std::size_t n = capacity; // records available in all the streams
+                unsigned int finished = 0; // number of streams at end of file
+                unsigned int first_finished = 0;
+                for( unsigned int i = 0; i < streams.size(); ++i )
                 {
-                    if( sources[i].read( p ) == NULL )
-                    {
-                        if( streams == 0 ) { return 0; }
-                        std::cerr << "csv-paste: unexpected end of file in " << unnamed[i] << std::endl;
-                        return 1;
-                    }
-                    if( sources[i].is_stream() ) { ++streams; }
+                    std::size_t count = streams[i]->fill( capacity );
+                    if( count > 0 ) { n = std::min( n, count ); continue; }
+                    if( finished++ == 0 ) { first_finished = indices[i]; }
                 }
-                std::cout.write( &buffer[0], buffer.size() );
+                if( finished > 0 && finished == streams.size() ) { return 0; }
+                if( finished > 0 ) { std::cerr << "csv-paste: unexpected end of file in " << unnamed[ first_finished ] << std::endl; return 1; }
+                char* p = &buffer[0];
+                for( unsigned int i = 0; i < sources.size(); p += sources[i].size(), ++i ) { sources[i].read( p, n, size ); }
+                std::cout.write( &buffer[0], n * size );
                 std::cout.flush();
             }
         }
@@ -270,7 +334,9 @@ int main( int ac, char** av )
                     const std::string* s = sources[i].read();
                     if( s == NULL )
                     {
-                        if( streams == 0 ) { return 0; }
+                        bool finished = streams == 0; // done, if all streams are at end of file
+                        for( unsigned int j = i + 1; finished && j < sources.size(); ++j ) { finished = !sources[j].is_stream() || sources[j].read() == NULL; }
+                        if( finished ) { return 0; }
                         std::cerr << "csv-paste: unexpected end of file in " << unnamed[i] << std::endl; return 1;
                     }
                     if (sources[i].is_stream()) ++streams;
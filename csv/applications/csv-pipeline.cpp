@@ -0,0 +1,779 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifdef WIN32
+#include <stdio.h>
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include <string.h>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "../../application/command_line_options.h"
+#include "../../application/contact_info.h"
+#include "../../base/exception.h"
+#include "../../base/types.h"
+#include "../../containers/spsc_queue.h"
+#include "../../csv/format.h"
+#include "../../math/compare.h"
+#include "../../name_value/map.h"
+#include "../../string/string.h"
+
+static void usage( bool verbose )
+{
+    std::cerr << std::endl;
+    std::cerr << "run a chain of operations on binary records in a single process as if the" << std::endl;
+    std::cerr << "corresponding utilities were piped into each other, but without serialising" << std::endl;
+    std::cerr << "and parsing records between them; records are passed from operation to" << std::endl;
+    std::cerr << "operation in blocks, each operation runs in its own thread" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "usage: cat records.bin | csv-pipeline --binary=<format> --fields=<fields> <operation> [<operation>...] [<options>]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "operations: <name>;<properties>, operations are applied in the given order" << std::endl;
+    std::cerr << "    select;field=<field>;<constraints>: same as csv-select \"<field>;<constraints>\"" << std::endl;
+    std::cerr << "        <constraints>: equals, not-equal, less, greater, from (or ge), to (or le)" << std::endl;
+    std::cerr << "        e.g: \"select;field=x;from=0;to=10\"" << std::endl;
+    std::cerr << "    cut;fields=<fields>: output only the given fields in the given order (same as csv-shuffle)" << std::endl;
+    std::cerr << "        e.g: \"cut;fields=t,x,id\"" << std::endl;
+    std::cerr << "    units;fields=<fields>;from=<unit>;to=<unit>: same as csv-units; floating point fields only" << std::endl;
+    std::cerr << "        if only one of from, to is given, the other defaults to metric units" << std::endl;
+    std::cerr << "        e.g: \"units;fields=x,y;from=feet;to=metres\"" << std::endl;
+    std::cerr << "    units;fields=<fields>;scale=<factor>;offset=<value>: same as csv-units --scale, --offset" << std::endl;
+    std::cerr << "    time;fields=<fields>;to=seconds: convert time fields to seconds since epoch, t becomes d" << std::endl;
+    std::cerr << "    time;fields=<fields>;from=seconds: convert seconds since epoch to time, d becomes t" << std::endl;
+    std::cerr << "    calc;fields=<fields>;operations=<operations>: same as csv-calc <operations>, numeric fields only;" << std::endl;
+    std::cerr << "        has to be the last operation; output on end of stream" << std::endl;
+    std::cerr << "        <operations>: comma-separated list of: min, max, mean, sum, size" << std::endl;
+    std::cerr << "        output types: mean as d, size as ui, others of the field type" << std::endl;
+    std::cerr << "        e.g: \"calc;fields=x,y;operations=min,max\"" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "options" << std::endl;
+    std::cerr << "    --binary,-b=<format>: input format" << std::endl;
+    std::cerr << "    --delimiter,-d=<delimiter>: delimiter for ascii output; default: ," << std::endl;
+    std::cerr << "    --fields,-f=<fields>: input fields" << std::endl;
+    std::cerr << "    --output-ascii,--ascii: output as csv (same as piping into csv-from-bin)" << std::endl;
+    std::cerr << "    --output-fields: output fields after the last operation and exit" << std::endl;
+    std::cerr << "    --output-format: output format after the last operation and exit" << std::endl;
+    std::cerr << "    --precision=<n>: floating point precision for ascii output" << std::endl;
+    std::cerr << "    --single-thread: run all the operations in a single thread; useful for" << std::endl;
+    std::cerr << "                     short chains of cheap operations or on a loaded machine" << std::endl;
+    std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
+    std::cerr << std::endl;
+    if( verbose )
+    {
+        std::cerr << "units: same as in csv-units" << std::endl;
+        std::cerr << "    metres, meters, m / feet, ft / statute-miles, miles, mi / nautical-miles, nm" << std::endl;
+        std::cerr << "    kilograms, kg / pounds, lbs" << std::endl;
+        std::cerr << "    metres-per-second, meters-per-second / knots" << std::endl;
+        std::cerr << "    kelvin / celsius / fahrenheit" << std::endl;
+        std::cerr << "    radians, rad / degrees, deg" << std::endl;
+        std::cerr << "    hours / minutes, min / seconds, sec" << std::endl;
+        std::cerr << "    percent / fraction" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << comma::csv::format::usage() << std::endl;
+    }
+    std::cerr << "examples" << std::endl;
+    std::cerr << "    cat points.bin | csv-pipeline --binary=t,3d,ui --fields=t,x,y,z,id \\" << std::endl;
+    std::cerr << "                                  \"select;field=z;from=0;to=10\" \\" << std::endl;
+    std::cerr << "                                  \"cut;fields=t,x,y,id\" \\" << std::endl;
+    std::cerr << "                                  \"units;fields=x,y;from=feet;to=metres\" \\" << std::endl;
+    std::cerr << "                                  \"time;fields=t;to=seconds\" --output-ascii" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "    does the same as" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "    cat points.bin | csv-select --binary=t,3d,ui --fields=,,,z --from=0 --to=10 \\" << std::endl;
+    std::cerr << "                   | csv-shuffle --binary=t,3d,ui --fields=t,x,y,z,id --output-fields=t,x,y,id \\" << std::endl;
+    std::cerr << "                   | csv-units --binary=t,2d,ui --fields=,x,y --from=feet --to=metres \\" << std::endl;
+    std::cerr << "                   | csv-time --binary=t,2d,ui --fields=t --to seconds \\" << std::endl;
+    std::cerr << "                   | csv-from-bin d,2d,ui" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << comma::contact_info << std::endl;
+    std::cerr << std::endl;
+    exit( 0 );
+}
+
+static bool verbose;
+
+/// record layout: format and field names, one per element of expanded format
+struct layout
+{
+    comma::csv::format format;
+    std::vector< std::string > fields;
+
+    layout() {}
+
+    layout( const std::string& f, const std::string& names ) : format( comma::csv::format( f ).expanded_string() ), fields( comma::split( names, ',' ) )
+    {
+        if( fields.size() > format.count() ) { COMMA_THROW( comma::exception, "expected at most " << format.count() << " fields for format " << f << ", got " << fields.size() << " fields: " << names ); }
+        fields.resize( format.count() );
+    }
+
+    std::size_t index( const std::string& name ) const
+    {
+        for( std::size_t i = 0; i < fields.size(); ++i ) { if( fields[i] == name ) { return i; } }
+        COMMA_THROW( comma::exception, "field \"" << name << "\" not found in \"" << comma::join( fields, ',' ) << "\"" );
+    }
+
+    std::vector< std::size_t > indices( const std::string& names ) const
+    {
+        const std::vector< std::string >& v = comma::split( names, ',' );
+        std::vector< std::size_t > indices( v.size() );
+        for( std::size_t i = 0; i < v.size(); ++i ) { indices[i] = index( v[i] ); }
+        return indices;
+    }
+};
+
+static bool is_numeric( comma::csv::format::types_enum type ) { return type != comma::csv::format::time && type != comma::csv::format::long_time && type != comma::csv::format::fixed_string; }
+
+static double to_double( const char* p, comma::csv::format::types_enum type )
+{
+    switch( type )
+    {
+        case comma::csv::format::char_t:
+        case comma::csv::format::int8: return comma::csv::format::traits< char >::from_bin( p );
+        case comma::csv::format::uint8: return comma::csv::format::traits< unsigned char >::from_bin( p );
+        case comma::csv::format::int16: return comma::csv::format::traits< comma::int16 >::from_bin( p );
+        case comma::csv::format::uint16: return comma::csv::format::traits< comma::uint16 >::from_bin( p );
+        case comma::csv::format::int32: return comma::csv::format::traits< comma::int32 >::from_bin( p );
+        case comma::csv::format::uint32: return comma::csv::format::traits< comma::uint32 >::from_bin( p );
+        case comma::csv::format::int64: return comma::csv::format::traits< comma::int64 >::from_bin( p );
+        case comma::csv::format::uint64: return comma::csv::format::traits< comma::uint64 >::from_bin( p );
+        case comma::csv::format::float_t: return comma::csv::format::traits< float >::from_bin( p );
+        case comma::csv::format::double_t: return comma::csv::format::traits< double >::from_bin( p );
+        default: COMMA_THROW( comma::exception, "expected numeric type, got " << comma::csv::format::to_format( type ) );
+    }
+}
+
+static void from_double( double v, char* p, comma::csv::format::types_enum type )
+{
+    switch( type )
+    {
+        case comma::csv::format::char_t:
+        case comma::csv::format::int8: comma::csv::format::traits< char >::to_bin( static_cast< char >( v ), p ); break;
+        case comma::csv::format::uint8: comma::csv::format::traits< unsigned char >::to_bin( static_cast< unsigned char >( v ), p ); break;
+        case comma::csv::format::int16: comma::csv::format::traits< comma::int16 >::to_bin( static_cast< comma::int16 >( v ), p ); break;
+        case comma::csv::format::uint16: comma::csv::format::traits< comma::uint16 >::to_bin( static_cast< comma::uint16 >( v ), p ); break;
+        case comma::csv::format::int32: comma::csv::format::traits< comma::int32 >::to_bin( static_cast< comma::int32 >( v ), p ); break;
+        case comma::csv::format::uint32: comma::csv::format::traits< comma::uint32 >::to_bin( static_cast< comma::uint32 >( v ), p ); break;
+        case comma::csv::format::int64: comma::csv::format::traits< comma::int64 >::to_bin( static_cast< comma::int64 >( v ), p ); break;
+        case comma::csv::format::uint64: comma::csv::format::traits< comma::uint64 >::to_bin( static_cast< comma::uint64 >( v ), p ); break;
+        case comma::csv::format::float_t: comma::csv::format::traits< float >::to_bin( static_cast< float >( v ), p ); break;
+        case comma::csv::format::double_t: comma::csv::format::traits< double >::to_bin( v, p ); break;
+        default: COMMA_THROW( comma::exception, "expected numeric type, got " << comma::csv::format::to_format( type ) );
+    }
+}
+
+static boost::posix_time::ptime to_time( const char* p, comma::csv::format::types_enum type )
+{
+    return type == comma::csv::format::time ? comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::from_bin( p )
+                                            : comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::from_bin( p );
+}
+
+/// block of records passed from operation to operation
+struct block
+{
+    std::vector< char > data;
+    std::size_t count; // number of records
+    bool last; // end of stream
+    block() : count( 0 ), last( false ) {}
+};
+
+class operation
+{
+    public:
+        virtual ~operation() {}
+
+        /// process records in place; output records may be of different size
+        virtual void apply( block& b ) = 0;
+
+        /// on end of stream, append records, if any, to the block
+        virtual void finish( block& ) {}
+
+        const layout& output() const { return output_; }
+
+    protected:
+        operation( const layout& input ) : input_( input ), output_( input ) {}
+        layout input_;
+        layout output_;
+};
+
+template < typename T > static T parse( const std::string& s ) { return boost::lexical_cast< T >( s ); }
+template <> boost::posix_time::ptime parse< boost::posix_time::ptime >( const std::string& s ) { return boost::posix_time::from_iso_string( s ); }
+template <> std::string parse< std::string >( const std::string& s ) { return s; }
+
+/// same semantics as in csv-select
+template < typename T >
+struct constraints
+{
+    boost::optional< T > equals;
+    boost::optional< T > not_equal;
+    boost::optional< T > less;
+    boost::optional< T > greater;
+    boost::optional< T > from;
+    boost::optional< T > to;
+
+    constraints( const comma::name_value::map& m )
+    {
+        if( m.exists( "equals" ) ) { equals = parse< T >( m.value< std::string >( "equals" ) ); }
+        if( m.exists( "not-equal" ) ) { not_equal = parse< T >( m.value< std::string >( "not-equal" ) ); }
+        if( m.exists( "less" ) ) { less = parse< T >( m.value< std::string >( "less" ) ); }
+        if( m.exists( "greater" ) ) { greater = parse< T >( m.value< std::string >( "greater" ) ); }
+        if( m.exists( "from" ) ) { from = parse< T >( m.value< std::string >( "from" ) ); }
+        if( m.exists( "greater-or-equal" ) ) { from = parse< T >( m.value< std::string >( "greater-or-equal" ) ); }
+        if( m.exists( "ge" ) ) { from = parse< T >( m.value< std::string >( "ge" ) ); }
+        if( m.exists( "to" ) ) { to = parse< T >( m.value< std::string >( "to" ) ); }
+        if( m.exists( "less-or-equal" ) ) { to = parse< T >( m.value< std::string >( "less-or-equal" ) ); }
+        if( m.exists( "le" ) ) { to = parse< T >( m.value< std::string >( "le" ) ); }
+    }
+
+    bool is_a_match( const T& t ) const
+    {
+        return    ( !equals || comma::math::equal( *equals, t ) )
+               && ( !not_equal || !comma::math::equal( *not_equal, t ) )
+               && ( !from || !comma::math::less( t, *from ) )
+               && ( !to || !comma::math::less( *to, t ) )
+               && ( !less || comma::math::less( t, *less ) )
+               && ( !greater || comma::math::less( *greater, t ) );
+    }
+};
+
+namespace pipeline {
+
+class select : public operation
+{
+    public:
+        select( const layout& input, const comma::name_value::map& m ) : operation( input ), size_( input.format.size() )
+        {
+            element_ = input.format.offset( input.index( m.value< std::string >( "field" ) ) );
+            switch( element_.type )
+            {
+                case comma::csv::format::time:
+                case comma::csv::format::long_time: time_.reset( new constraints< boost::posix_time::ptime >( m ) ); break;
+                case comma::csv::format::fixed_string: string_.reset( new constraints< std::string >( m ) ); break;
+                default: number_.reset( new constraints< double >( m ) ); break;
+            }
+        }
+
+        void apply( block& b )
+        {
+            char* out = &b.data[0];
+            const char* in = out;
+            std::size_t count = 0;
+            for( std::size_t i = 0; i < b.count; ++i, in += size_ )
+            {
+                if( !is_a_match_( in + element_.offset ) ) { continue; }
+                if( out != in ) { ::memcpy( out, in, size_ ); }
+                out += size_;
+                ++count;
+            }
+            b.count = count;
+        }
+
+    private:
+        std::size_t size_;
+        comma::csv::format::element element_;
+        boost::scoped_ptr< constraints< double > > number_;
+        boost::scoped_ptr< constraints< boost::posix_time::ptime > > time_;
+        boost::scoped_ptr< constraints< std::string > > string_;
+
+        bool is_a_match_( const char* p ) const
+        {
+            if( number_ ) { return number_->is_a_match( to_double( p, element_.type ) ); }
+            if( time_ ) { return time_->is_a_match( to_time( p, element_.type ) ); }
+            return string_->is_a_match( std::string( p, ::strnlen( p, element_.size ) ) );
+        }
+};
+
+class cut : public operation
+{
+    public:
+        cut( const layout& input, const comma::name_value::map& m ) : operation( input ), input_size_( input.format.size() )
+        {
+            const std::vector< std::string >& names = comma::split( m.value< std::string >( "fields" ), ',' );
+            const std::vector< std::size_t >& indices = input.indices( m.value< std::string >( "fields" ) );
+            std::string f;
+            std::size_t offset = 0;
+            for( std::size_t i = 0; i < indices.size(); ++i )
+            {
+                comma::csv::format::element e = input.format.offset( indices[i] );
+                f += ( i == 0 ? "" : "," ) + comma::csv::format::to_format( e.type, e.size );
+                if( runs_.empty() || runs_.back().input_offset + runs_.back().size != e.offset ) { runs_.push_back( run( e.offset, offset, e.size ) ); }
+                else { runs_.back().size += e.size; } // adjacent in input and output: copy in one go
+                offset += e.size;
+            }
+            output_ = layout( f, comma::join( names, ',' ) );
+        }
+
+        void apply( block& b )
+        {
+            std::size_t size = output_.format.size();
+            if( buffer_.size() < b.count * size ) { buffer_.resize( b.count * size ); }
+            const char* in = &b.data[0];
+            char* out = &buffer_[0];
+            for( std::size_t i = 0; i < b.count; ++i, in += input_size_, out += size )
+            {
+                for( std::size_t j = 0; j < runs_.size(); ++j ) { ::memcpy( out + runs_[j].output_offset, in + runs_[j].input_offset, runs_[j].size ); }
+            }
+            b.data.swap( buffer_ );
+        }
+
+    private:
+        struct run
+        {
+            std::size_t input_offset;
+            std::size_t output_offset;
+            std::size_t size;
+            run( std::size_t input_offset, std::size_t output_offset, std::size_t size ) : input_offset( input_offset ), output_offset( output_offset ), size( size ) {}
+        };
+        std::size_t input_size_;
+        std::vector< run > runs_;
+        std::vector< char > buffer_;
+};
+
+/// unit: value in metric units = ( value + offset ) * factor
+struct unit
+{
+    std::string dimension;
+    double factor;
+    double offset;
+    unit( const std::string& dimension = "", double factor = 1, double offset = 0 ) : dimension( dimension ), factor( factor ), offset( offset ) {}
+};
+
+static unit unit_from_string( const std::string& s )
+{
+    static std::map< std::string, unit > units;
+    if( units.empty() )
+    {
+        units[ "metres" ] = units[ "meters" ] = units[ "m" ] = unit( "length" );
+        units[ "feet" ] = units[ "ft" ] = unit( "length", 0.3048 );
+        units[ "statute-miles" ] = units[ "miles" ] = units[ "mi" ] = unit( "length", 1609.344 );
+        units[ "nautical-miles" ] = units[ "nm" ] = unit( "length", 1852 );
+        units[ "kilograms" ] = units[ "kg" ] = unit( "mass" );
+        units[ "pounds" ] = units[ "lbs" ] = unit( "mass", 0.45359237 );
+        units[ "metres-per-second" ] = units[ "meters-per-second" ] = unit( "velocity" );
+        units[ "knots" ] = unit( "velocity", 1852.0 / 3600 );
+        units[ "kelvin" ] = unit( "temperature" );
+        units[ "celsius" ] = unit( "temperature", 1, 273.15 );
+        units[ "fahrenheit" ] = unit( "temperature", 5.0 / 9, 459.67 );
+        units[ "radians" ] = units[ "rad" ] = unit( "angle" );
+        units[ "degrees" ] = units[ "deg" ] = unit( "angle", M_PI / 180 );
+        units[ "seconds" ] = units[ "sec" ] = unit( "time" );
+        units[ "minutes" ] = units[ "min" ] = unit( "time", 60 );
+        units[ "hours" ] = unit( "time", 3600 );
+        units[ "fraction" ] = unit( "ratio" );
+        units[ "percent" ] = unit( "ratio", 0.01 );
+    }
+    std::string t = s;
+    for( std::size_t i = 0; i < t.size(); ++i ) { if( t[i] >= 'A' && t[i] <= 'Z' ) { t[i] = t[i] - 'A' + 'a'; } }
+    std::map< std::string, unit >::const_iterator it = units.find( t );
+    if( it == units.end() ) { COMMA_THROW( comma::exception, "expected unit name, got \"" << s << "\"" ); }
+    return it->second;
+}
+
+class units : public operation
+{
+    public:
+        units( const layout& input, const comma::name_value::map& m ) : operation( input ), size_( input.format.size() ), scale_( 1 ), offset_( 0 )
+        {
+            const std::vector< std::size_t >& indices = input.indices( m.value< std::string >( "fields" ) );
+            for( std::size_t i = 0; i < indices.size(); ++i )
+            {
+                elements_.push_back( input.format.offset( indices[i] ) );
+                if( elements_.back().type != comma::csv::format::float_t && elements_.back().type != comma::csv::format::double_t ) { COMMA_THROW( comma::exception, "units: expected floating point field, got field \"" << input.fields[ indices[i] ] << "\" of type " << comma::csv::format::to_format( elements_.back().type ) ); }
+            }
+            if( m.exists( "scale" ) || m.exists( "offset" ) )
+            {
+                scale_ = m.value( "scale", 1.0 );
+                offset_ = m.value( "offset", 0.0 );
+                return;
+            }
+            if( !m.exists( "from" ) && !m.exists( "to" ) ) { COMMA_THROW( comma::exception, "units: please specify from and/or to, or scale and/or offset" ); }
+            unit from = m.exists( "from" ) ? unit_from_string( m.value< std::string >( "from" ) ) : unit();
+            unit to = m.exists( "to" ) ? unit_from_string( m.value< std::string >( "to" ) ) : unit();
+            if( from.dimension.empty() ) { from.dimension = to.dimension; }
+            if( to.dimension.empty() ) { to.dimension = from.dimension; }
+            if( from.dimension != to.dimension ) { COMMA_THROW( comma::exception, "units: cannot convert " << m.value< std::string >( "from" ) << " to " << m.value< std::string >( "to" ) ); }
+            scale_ = from.factor / to.factor;
+            offset_ = from.offset * scale_ - to.offset;
+        }
+
+        void apply( block& b )
+        {
+            char* p = &b.data[0];
+            for( std::size_t i = 0; i < b.count; ++i, p += size_ )
+            {
+                for( std::size_t j = 0; j < elements_.size(); ++j )
+                {
+                    char* q = p + elements_[j].offset;
+                    if( elements_[j].type == comma::csv::format::double_t ) { comma::csv::format::traits< double >::to_bin( comma::csv::format::traits< double >::from_bin( q ) * scale_ + offset_, q ); }
+                    else { comma::csv::format::traits< float >::to_bin( comma::csv::format::traits< float >::from_bin( q ) * scale_ + offset_, q ); }
+                }
+            }
+        }
+
+    private:
+        std::size_t size_;
+        double scale_;
+        double offset_;
+        std::vector< comma::csv::format::element > elements_;
+};
+
+class time : public operation
+{
+    public:
+        time( const layout& input, const comma::name_value::map& m ) : operation( input ), size_( input.format.size() )
+        {
+            to_seconds_ = m.value< std::string >( "to", "" ) == "seconds";
+            if( !to_seconds_ && m.value< std::string >( "from", "" ) != "seconds" ) { COMMA_THROW( comma::exception, "time: expected to=seconds or from=seconds" ); }
+            comma::csv::format::types_enum from = to_seconds_ ? comma::csv::format::time : comma::csv::format::double_t;
+            std::vector< comma::csv::format::types_enum > types( input.format.count() );
+            for( std::size_t i = 0; i < types.size(); ++i ) { types[i] = input.format.offset( i ).type; }
+            const std::vector< std::size_t >& indices = input.indices( m.value< std::string >( "fields" ) );
+            for( std::size_t i = 0; i < indices.size(); ++i )
+            {
+                if( types[ indices[i] ] != from ) { COMMA_THROW( comma::exception, "time: expected field \"" << input.fields[ indices[i] ] << "\" of type " << comma::csv::format::to_format( from ) << ", got " << comma::csv::format::to_format( types[ indices[i] ] ) ); }
+                offsets_.push_back( input.format.offset( indices[i] ).offset );
+                types[ indices[i] ] = to_seconds_ ? comma::csv::format::double_t : comma::csv::format::time; // same size, convert in place
+            }
+            std::string f;
+            for( std::size_t i = 0; i < types.size(); ++i ) { f += ( i == 0 ? "" : "," ) + comma::csv::format::to_format( types[i], input.format.offset( i ).size ); }
+            output_ = layout( f, comma::join( input.fields, ',' ) );
+        }
+
+        void apply( block& b )
+        {
+            static const boost::posix_time::ptime epoch( boost::gregorian::date( 1970, 1, 1 ) );
+            typedef comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time > time_traits;
+            char* p = &b.data[0];
+            for( std::size_t i = 0; i < b.count; ++i, p += size_ )
+            {
+                for( std::size_t j = 0; j < offsets_.size(); ++j )
+                {
+                    char* q = p + offsets_[j];
+                    if( to_seconds_ )
+                    {
+                        boost::posix_time::ptime t = time_traits::from_bin( q );
+                        comma::csv::format::traits< double >::to_bin( t.is_special() ? std::numeric_limits< double >::quiet_NaN() : double( ( t - epoch ).total_microseconds() ) / 1000000, q );
+                    }
+                    else
+                    {
+                        double d = comma::csv::format::traits< double >::from_bin( q );
+                        time_traits::to_bin( std::isnan( d ) ? boost::posix_time::ptime() : epoch + boost::posix_time::microseconds( static_cast< comma::int64 >( std::floor( d * 1000000 + 0.5 ) ) ), q );
+                    }
+                }
+            }
+        }
+
+    private:
+        std::size_t size_;
+        bool to_seconds_;
+        std::vector< std::size_t > offsets_;
+};
+
+class calc : public operation
+{
+    public:
+        calc( const layout& input, const comma::name_value::map& m ) : operation( input ), size_( input.format.size() ), count_( 0 )
+        {
+            const std::vector< std::size_t >& indices = input.indices( m.value< std::string >( "fields" ) );
+            const std::vector< std::string >& operations = comma::split( m.value< std::string >( "operations" ), ',' );
+            for( std::size_t i = 0; i < indices.size(); ++i )
+            {
+                elements_.push_back( input.format.offset( indices[i] ) );
+                if( !is_numeric( elements_.back().type ) ) { COMMA_THROW( comma::exception, "calc: expected numeric field, got field \"" << input.fields[ indices[i] ] << "\" of type " << comma::csv::format::to_format( elements_.back().type ) ); }
+            }
+            std::string f;
+            std::vector< std::string > fields;
+            for( std::size_t i = 0; i < operations.size(); ++i )
+            {
+                if( operations[i] == "min" ) { operations_.push_back( min ); }
+                else if( operations[i] == "max" ) { operations_.push_back( max ); }
+                else if( operations[i] == "mean" ) { operations_.push_back( mean ); }
+                else if( operations[i] == "sum" ) { operations_.push_back( sum ); }
+                else if( operations[i] == "size" ) { operations_.push_back( size ); }
+                else { COMMA_THROW( comma::exception, "calc: expected operation, got: \"" << operations[i] << "\"" ); }
+                for( std::size_t j = 0; j < indices.size(); ++j ) // for each operation, values for all the fields: size as ui, mean as d, otherwise of input type
+                {
+                    comma::csv::format::types_enum type = operations_.back() == size ? comma::csv::format::uint32 : operations_.back() == mean ? comma::csv::format::double_t : elements_[j].type;
+                    f += ( f.empty() ? "" : "," ) + comma::csv::format::to_format( type );
+                    fields.push_back( input.fields[ indices[j] ] + "/" + operations[i] );
+                }
+            }
+            output_ = layout( f, comma::join( fields, ',' ) );
+            min_.resize( elements_.size(), std::numeric_limits< double >::max() );
+            max_.resize( elements_.size(), -std::numeric_limits< double >::max() );
+            sum_.resize( elements_.size(), 0 );
+        }
+
+        void apply( block& b )
+        {
+            const char* p = &b.data[0];
+            for( std::size_t i = 0; i < b.count; ++i, p += size_ )
+            {
+                for( std::size_t j = 0; j < elements_.size(); ++j )
+                {
+                    double v = to_double( p + elements_[j].offset, elements_[j].type );
+                    if( v < min_[j] ) { min_[j] = v; }
+                    if( max_[j] < v ) { max_[j] = v; }
+                    sum_[j] += v;
+                }
+            }
+            count_ += b.count;
+            b.count = 0;
+        }
+
+        void finish( block& b )
+        {
+            if( count_ == 0 ) { return; }
+            if( b.data.size() < output_.format.size() ) { b.data.resize( output_.format.size() ); }
+            for( std::size_t i = 0, k = 0; i < operations_.size(); ++i )
+            {
+                for( std::size_t j = 0; j < elements_.size(); ++j, ++k )
+                {
+                    comma::csv::format::element e = output_.format.offset( k );
+                    switch( operations_[i] )
+                    {
+                        case min: from_double( min_[j], &b.data[ e.offset ], e.type ); break;
+                        case max: from_double( max_[j], &b.data[ e.offset ], e.type ); break;
+                        case mean: from_double( sum_[j] / count_, &b.data[ e.offset ], e.type ); break;
+                        case sum: from_double( sum_[j], &b.data[ e.offset ], e.type ); break;
+                        case size: comma::csv::format::traits< comma::uint32 >::to_bin( count_, &b.data[ e.offset ] ); break;
+                    }
+                }
+            }
+            b.count = 1;
+        }
+
+    private:
+        enum operations_enum { min, max, mean, sum, size };
+        std::size_t size_;
+        comma::uint64 count_;
+        std::vector< comma::csv::format::element > elements_;
+        std::vector< operations_enum > operations_;
+        std::vector< double > min_;
+        std::vector< double > max_;
+        std::vector< double > sum_;
+};
+
+} // namespace pipeline {
+
+static operation* make_operation( const layout& input, const std::string& s )
+{
+    comma::name_value::map m( s, ';', '=' );
+    std::string name = comma::split( s, ';' )[0];
+    if( name == "select" ) { return new pipeline::select( input, m ); }
+    if( name == "cut" ) { return new pipeline::cut( input, m ); }
+    if( name == "units" ) { return new pipeline::units( input, m ); }
+    if( name == "time" ) { return new pipeline::time( input, m ); }
+    if( name == "calc" ) { return new pipeline::calc( input, m ); }
+    COMMA_THROW( comma::exception, "expected operation, got: \"" << s << "\"" );
+}
+
+/// hands blocks from thread to thread without locking: each queue has exactly one producer
+/// and one consumer thread; idle threads sleep rather than spin
+typedef comma::spsc_queue< block*, comma::waiting::blocking > queue;
+
+/// read one record (blocking) and then as many whole records as already available
+static void read( block& b, std::size_t size, std::size_t capacity )
+{
+    if( b.data.size() < size * capacity ) { b.data.resize( size * capacity ); }
+    b.count = 0;
+    std::cin.read( &b.data[0], size );
+    if( std::cin.gcount() == 0 ) { b.last = true; return; }
+    if( std::cin.gcount() < std::streamsize( size ) ) { COMMA_THROW( comma::exception, "expected " << size << " bytes, got only " << std::cin.gcount() ); }
+    b.count = 1;
+    std::streamsize available = std::cin.rdbuf()->in_avail();
+    if( available < std::streamsize( size ) ) { return; }
+    std::size_t n = std::min( capacity - 1, std::size_t( available ) / size );
+    std::cin.read( &b.data[size], n * size );
+    b.count += n;
+}
+
+class writer
+{
+    public:
+        writer( const layout& output, const comma::command_line_options& options )
+            : format_( output.format )
+            , ascii_( options.exists( "--output-ascii,--ascii" ) )
+            , delimiter_( options.value( "--delimiter,-d", ',' ) )
+            , precision_( options.optional< unsigned int >( "--precision" ) )
+        {
+        }
+
+        void write( const block& b )
+        {
+            if( b.count == 0 ) { return; }
+            if( ascii_ ) { for( std::size_t i = 0; i < b.count; ++i ) { std::cout << format_.bin_to_csv( &b.data[ i * format_.size() ], delimiter_, precision_ ) << '\n'; } }
+            else { std::cout.write( &b.data[0], b.count * format_.size() ); }
+            std::cout.flush();
+        }
+
+    private:
+        comma::csv::format format_;
+        bool ascii_;
+        char delimiter_;
+        boost::optional< unsigned int > precision_;
+};
+
+/// first error in worker threads; once it is set, the reader ends the stream at the next
+/// block and operations pass the blocks in flight on empty, so that all the threads finish
+class error
+{
+    public:
+        error() : failed_( false ) {}
+        void set( const std::string& what ) { boost::mutex::scoped_lock lock( mutex_ ); if( !failed_ ) { what_ = what; failed_ = true; } }
+        bool failed() const { boost::mutex::scoped_lock lock( mutex_ ); return failed_; }
+        const std::string& what() const { return what_; } // call only after joining the threads
+
+    private:
+        mutable boost::mutex mutex_;
+        bool failed_;
+        std::string what_;
+};
+
+static error worker_error;
+
+static void run_reader( queue* free, queue* out, std::size_t size, std::size_t capacity )
+{
+    while( true )
+    {
+        block* b = free->pop();
+        try
+        {
+            if( worker_error.failed() ) { b->count = 0; b->last = true; } else { read( *b, size, capacity ); }
+        }
+        catch( comma::exception& ex ) { worker_error.set( ex.error() ); b->count = 0; b->last = true; }
+        catch( std::exception& ex ) { worker_error.set( ex.what() ); b->count = 0; b->last = true; }
+        catch( ... ) { worker_error.set( "unknown exception" ); b->count = 0; b->last = true; }
+        out->push( b );
+        if( b->last ) { return; }
+    }
+}
+
+static void run_operation( operation* op, queue* in, queue* out )
+{
+    while( true )
+    {
+        block* b = in->pop();
+        try
+        {
+            if( worker_error.failed() ) { b->count = 0; }
+            else
+            {
+                op->apply( *b );
+                if( b->last ) { op->finish( *b ); }
+            }
+        }
+        catch( comma::exception& ex ) { worker_error.set( ex.error() ); b->count = 0; }
+        catch( std::exception& ex ) { worker_error.set( ex.what() ); b->count = 0; }
+        catch( ... ) { worker_error.set( "unknown exception" ); b->count = 0; }
+        out->push( b );
+        if( b->last ) { return; }
+    }
+}
+
+int main( int ac, char** av )
+{
+    try
+    {
+        comma::command_line_options options( ac, av, usage );
+        verbose = options.exists( "--verbose,-v" );
+        const std::vector< std::string >& unnamed = options.unnamed( "--output-ascii,--ascii,--output-fields,--output-format,--single-thread,--verbose,-v", "-.*" );
+        if( !options.exists( "--binary,-b" ) ) { std::cerr << "csv-pipeline: please specify --binary" << std::endl; return 1; }
+        layout input( options.value< std::string >( "--binary,-b" ), options.value< std::string >( "--fields,-f", "" ) );
+        boost::ptr_vector< operation > operations;
+        for( std::size_t i = 0; i < unnamed.size(); ++i )
+        {
+            if( !operations.empty() && dynamic_cast< const pipeline::calc* >( &operations.back() ) ) { std::cerr << "csv-pipeline: calc has to be the last operation, got \"" << unnamed[i] << "\" after it" << std::endl; return 1; }
+            operations.push_back( make_operation( operations.empty() ? input : operations.back().output(), unnamed[i] ) );
+            if( verbose ) { std::cerr << "csv-pipeline: " << unnamed[i] << ": output fields: " << comma::join( operations.back().output().fields, ',' ) << " format: " << operations.back().output().format.collapsed_string() << std::endl; }
+        }
+        const layout& output = operations.empty() ? input : operations.back().output();
+        if( options.exists( "--output-fields" ) ) { std::cout << comma::join( output.fields, ',' ) << std::endl; return 0; }
+        if( options.exists( "--output-format" ) ) { std::cout << output.format.collapsed_string() << std::endl; return 0; }
+        #ifdef WIN32
+        _setmode( _fileno( stdin ), _O_BINARY );
+        if( !options.exists( "--output-ascii,--ascii" ) ) { _setmode( _fileno( stdout ), _O_BINARY ); }
+        #endif
+        std::ios_base::sync_with_stdio( false ); // to make std::cin.rdbuf()->in_avail() meaningful
+        std::size_t size = input.format.size();
+        std::size_t capacity = std::max( std::size_t( 1 ), std::size_t( 65536 ) / size ); // arbitrary
+        writer w( output, options );
+        if( options.exists( "--single-thread" ) )
+        {
+            block b;
+            while( !b.last )
+            {
+                read( b, size, capacity );
+                for( std::size_t i = 0; i < operations.size(); ++i )
+                {
+                    operations[i].apply( b );
+                    if( b.last ) { operations[i].finish( b ); }
+                }
+                w.write( b );
+            }
+            return 0;
+        }
+        const std::size_t depth = 4; // blocks in flight per queue, arbitrary
+        boost::ptr_vector< block > blocks;
+        queue free( depth * ( operations.size() + 1 ) );
+        for( std::size_t i = 0; i < depth * ( operations.size() + 1 ); ++i ) { blocks.push_back( new block ); free.push( &blocks.back() ); }
+        boost::ptr_vector< queue > queues;
+        for( std::size_t i = 0; i < operations.size() + 1; ++i ) { queues.push_back( new queue( depth ) ); }
+        boost::ptr_vector< boost::thread > threads;
+        threads.push_back( new boost::thread( boost::bind( &run_reader, &free, &queues[0], size, capacity ) ) );
+        for( std::size_t i = 0; i < operations.size(); ++i ) { threads.push_back( new boost::thread( boost::bind( &run_operation, &operations[i], &queues[i], &queues[ i + 1 ] ) ) ); }
+        while( true )
+        {
+            block* b = queues.back().pop();
+            if( !worker_error.failed() ) { w.write( *b ); }
+            if( b->last ) { break; }
+            free.push( b );
+        }
+        for( std::size_t i = 0; i < threads.size(); ++i ) { threads[i].join(); }
+        if( worker_error.failed() ) { std::cerr << "csv-pipeline: " << worker_error.what() << std::endl; return 1; }
+        return 0;
+    }
+    catch( comma::exception& ex ) { std::cerr << "csv-pipeline: " << ex.error() << std::endl; }
+    catch( std::exception& ex ) { std::cerr << "csv-pipeline: " << ex.what() << std::endl; }
+    catch( ... ) { std::cerr << "csv-pipeline: unknown exception" << std::endl; }
+    return 1;
+}
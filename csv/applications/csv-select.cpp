@@ -41,6 +41,7 @@
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
+#include "../../csv/columnar.h"
 #include "../../csv/stream.h"
 #include "../../csv/impl/unstructured.h"
 #include "../../math/compare.h"
@@ -67,6 +68,9 @@ void usage()
     std::cerr << "      todo: implement a simple boolean expression grammar" << std::endl;
     std::cerr << "input/output control options" << std::endl;
     std::cerr << "    --first-matching: output the first record matching the expression, then exit" << std::endl;
+    std::cerr << "    --columnar=<file>: read records from columnar file (see csv-columnar) instead of stdin; input format and fields" << std::endl;
+    std::cerr << "                       default to those stored in the file; blocks whose column minimum and maximum cannot satisfy" << std::endl;
+    std::cerr << "                       the constraints are skipped without reading (unless --not-matching or --output-all are given)" << std::endl;
     std::cerr << "    --format=<format>: explicitly specify input format, in case if in ascii mode csv-select guesses incorrectly" << std::endl;
     std::cerr << "    --not-matching: output only not matching records" << std::endl;
     std::cerr << "    --output-all,--all: output all records, append 1 to matching, 0 to not matching; if binary, format of the additional field is 'b'" << std::endl;
@@ -89,6 +93,7 @@ void usage()
     std::cerr << "    cat a.csv | csv-select --fields=,,t --from=20120101T000000 --to=20120101T000010 --sorted" << std::endl;
     std::cerr << "    cat xyz.csv | csv-select --fields=x,y,z \"x;from=1;to=2\" \"y;from=-1;to=1.1\" \"z;from=5;to=5.5\"" << std::endl;
     std::cerr << "    cat a.csv | csv-select --fields=t,scalar \"t;from=20120101T000000;sorted\" \"scalar;from=-10;to=20.5\"" << std::endl;
+    std::cerr << "    csv-select --columnar=points.col \"z;from=10;to=20\" --verbose | csv-from-bin t,3d,ui" << std::endl;
     std::cerr << "    echo hello,world | csv-select --fields=h,w \"h;regex=he.*\"" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
@@ -164,6 +169,16 @@ struct constraints
                && ( !regex || matches( t, *regex ) );
     }
 
+    bool may_match( const T& min, const T& max ) const // conservative: false only if no value in [min,max] can match
+    {
+        return    ( !equals || ( !comma::math::less( *equals, min ) && !comma::math::less( max, *equals ) ) )
+               && ( !not_equal || !comma::math::equal( *not_equal, min ) || !comma::math::equal( *not_equal, max ) )
+               && ( !from || !comma::math::less( max, *from ) )
+               && ( !to || !comma::math::less( *to, min ) )
+               && ( !less || comma::math::less( min, *less ) )
+               && ( !greater || comma::math::less( *greater, max ) );
+    }
+
     bool done( const T& t ) const // quick and dirty
     {
         if( !sorted ) { return false; }
@@ -198,6 +213,17 @@ struct constrained
         return true;
     }
 
+    bool may_match( const T& min, const T& max, bool is_or = false ) const
+    {
+        if( is_or )
+        {
+            for( unsigned int i = 0; i < constraints.size(); ++i ) { if( this->constraints[i].may_match( min, max ) ) { return true; } }
+            return false;
+        }
+        for( unsigned int i = 0; i < constraints.size(); ++i ) { if( !this->constraints[i].may_match( min, max ) ) { return false; } }
+        return true;
+    }
+
     bool done( bool is_or = false ) const
     {
         if( constraints.empty() ) { return false; }
@@ -240,6 +266,21 @@ struct input_t
         }
     }
 
+    bool may_match( const input_t& min, const input_t& max, bool is_or ) const // min and max: values of block statistics
+    {
+        if( is_or )
+        {
+            for( unsigned int i = 0; i < time.size(); ++i ) { if( time[i].may_match( min.time[i].value, max.time[i].value, is_or ) ) { return true; } }
+            for( unsigned int i = 0; i < doubles.size(); ++i ) { if( doubles[i].may_match( min.doubles[i].value, max.doubles[i].value, is_or ) ) { return true; } }
+            for( unsigned int i = 0; i < strings.size(); ++i ) { if( strings[i].may_match( min.strings[i].value, max.strings[i].value, is_or ) ) { return true; } }
+            return false;
+        }
+        for( unsigned int i = 0; i < time.size(); ++i ) { if( !time[i].may_match( min.time[i].value, max.time[i].value ) ) { return false; } }
+        for( unsigned int i = 0; i < doubles.size(); ++i ) { if( !doubles[i].may_match( min.doubles[i].value, max.doubles[i].value ) ) { return false; } }
+        for( unsigned int i = 0; i < strings.size(); ++i ) { if( !strings[i].may_match( min.strings[i].value, max.strings[i].value ) ) { return false; } }
+        return true;
+    }
+
     bool done( bool is_or ) const
     {
         if( is_or )
@@ -341,6 +382,19 @@ static void init_input( const comma::csv::format& format, const comma::command_l
     csv.full_xpath = true;
 }
 
+static bool is_or;
+static boost::scoped_ptr< comma::csv::binary< input_t > > block_statistics;
+
+static bool may_match( const comma::csv::columnar::block& b ) // quick and dirty: globals
+{
+    if( !block_statistics ) { block_statistics.reset( new comma::csv::binary< input_t >( csv, input ) ); }
+    input_t min = input;
+    input_t max = input;
+    block_statistics->get( min, &b.min[0] );
+    block_statistics->get( max, &b.max[0] );
+    return input.may_match( min, max, is_or );
+}
+
 int main( int ac, char** av )
 {
         comma::command_line_options options( ac, av );
@@ -348,16 +402,24 @@ int main( int ac, char** av )
     {
         if( options.exists( "--help,-h" ) ) { usage(); }
         verbose = options.exists( "--verbose,-v" );
-        bool is_or = options.exists( "--or" );
+        is_or = options.exists( "--or" );
         csv = comma::csv::options( options );
+        bool not_matching = options.exists( "--not-matching" );
+        bool all = options.exists( "--output-all,--all" );
+        boost::scoped_ptr< comma::csv::columnar::istream > columnar;
+        if( options.exists( "--columnar" ) )
+        {
+            columnar.reset( new comma::csv::columnar::istream( options.value< std::string >( "--columnar" ), std::vector< std::size_t >(), not_matching || all ? comma::csv::columnar::istream::filter_type() : &may_match ) );
+            csv.format( columnar->reader().format() );
+            if( !options.exists( "--fields,-f" ) ) { csv.fields = columnar->reader().fields(); }
+        }
+        std::istream& is = columnar ? *columnar : std::cin;
         fields = comma::split( csv.fields, ',' );
         if( fields.size() == 1 && fields[0].empty() ) { fields.clear(); }
         std::vector< std::string > unnamed = options.unnamed( "--first-matching,--or,--sorted,--input-sorted,--not-matching,--output-all,--all,--strict,--verbose,-v", "-.*" );
         //for( unsigned int i = 0; i < unnamed.size(); constraints_map.insert( std::make_pair( comma::split( unnamed[i], ';' )[0], unnamed[i] ) ), ++i );
         bool strict = options.exists( "--strict" );
         bool first_matching = options.exists( "--first-matching" );
-        bool not_matching = options.exists( "--not-matching" );
-        bool all = options.exists( "--output-all,--all" );
         for( unsigned int i = 0; i < unnamed.size(); ++i )
         {
             std::string field = comma::split( unnamed[i], ';' )[0];
@@ -377,8 +439,8 @@ int main( int ac, char** av )
             _setmode( _fileno( stdout ), _O_BINARY );
             #endif
             init_input( csv.format(), options );
-            comma::csv::binary_input_stream< input_t > istream( std::cin, csv, input );
-            while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+            comma::csv::binary_input_stream< input_t > istream( is, csv, input );
+            while( istream.ready() || ( is.good() && !is.eof() ) )
             {
                 const input_t* p = istream.read();
                 if( !p || p->done( is_or ) ) { break; }
@@ -391,6 +453,7 @@ int main( int ac, char** av )
                     if( first_matching ) { break; }
                 }
             }
+            if( verbose && columnar ) { std::cerr << "csv-select: skipped " << columnar->skipped() << " of " << columnar->reader().blocks().size() << " block(s)" << std::endl; }
         }
         else
         {
@@ -35,7 +35,9 @@
 #include <iostream>
 #include <vector>
 #include "../../application/command_line_options.h"
+#include "../../base/exception.h"
 #include "../../csv/options.h"
+#include "../../csv/parallel_map.h"
 #include "../../string/string.h"
 
 static void usage( bool verbose )
@@ -52,6 +54,8 @@ static void usage( bool verbose )
     std::cerr << "            \"--output-fields=x,y\": do not output trailing fields" << std::endl;
     std::cerr << "            \"--output-fields=x,y...\": output trailing fields" << std::endl;
     std::cerr << "            see example below" << std::endl;
+    std::cerr << "    --threads=<n>: shuffle in n threads, output order is preserved; default: 1" << std::endl;
+    std::cerr << "                   n=0: number of hardware threads" << std::endl;
     std::cerr << "    --verbose,-v: more output" << std::endl;
     if( verbose ) { std::cerr << std::endl << comma::csv::options::usage() << std::endl; }
     std::cerr << std::endl;
@@ -85,6 +89,72 @@ struct field
     field( const std::string& name, unsigned int index ) : name( name ), index( index ) {}
 };
 
+static comma::csv::options csv;
+static std::vector< field > fields;
+static std::vector< comma::csv::format::element > elements;
+static bool output_trailing_fields;
+
+static void shuffle_binary( std::istream& is, std::ostream& os )
+{
+    std::vector< char > buf( csv.format().size() );
+    while( is.good() && !is.eof() )
+    {
+        // todo: quick and dirty; if performance is an issue, you could read more than
+        // one record every time see comma::csv::binary_input_stream::read() for reference
+        is.read( &buf[0], csv.format().size() );
+        if( is.gcount() == 0 ) { continue; }
+        if( is.gcount() < int( csv.format().size() ) ) { COMMA_THROW( comma::exception, "expected " << csv.format().size() << " bytes, got only " << is.gcount() ); }
+        unsigned int previous_index = 0;
+        for( unsigned int i = 0; i < fields.size(); ++i ) // quick and dirty
+        {
+            for( unsigned int k = previous_index; k < fields[i].index && k < elements.size(); ++k )
+            {
+                os.write( &buf[ elements[k].offset ], elements[k].size );
+            }
+            os.write( &buf[ fields[i].input_offset ], fields[i].size );
+            previous_index = fields[i].index + 1;
+        }
+        //std::cerr << "--> previous_index: " << previous_index << " elements.size(): " << elements.size() << std::endl;
+        for( unsigned int k = previous_index; output_trailing_fields && k < elements.size(); ++k )
+        {
+            os.write( &buf[ elements[k].offset ], elements[k].size );
+        }
+        os.flush(); // todo: flushing too often?
+    }
+}
+
+static void shuffle_ascii( std::istream& is, std::ostream& os )
+{
+    while( is.good() && !is.eof() )
+    {
+        std::string line;
+        std::getline( is, line );
+        if( !line.empty() && *line.rbegin() == '\r' ) { line = line.substr( 0, line.length() - 1 ); } // windows... sigh...
+        if( line.empty() ) { continue; }
+        std::vector< std::string > v = comma::split( line, csv.delimiter );
+        std::string delimiter;
+        unsigned int previous_index = 0;
+        for( unsigned int i = 0; i < fields.size(); ++i ) // quick and dirty
+        {
+            for( unsigned int k = previous_index; k < fields[i].index && k < v.size(); ++k )
+            {
+                os << delimiter << v[k];
+                delimiter = csv.delimiter;
+            }
+            previous_index = fields[i].index + 1;
+            os << delimiter;
+            if ( *fields[i].input_index < v.size() ) { os << v[ *fields[i].input_index ]; }
+            delimiter = csv.delimiter;
+        }
+        for( unsigned int k = previous_index; output_trailing_fields && k < v.size(); ++k )
+        {
+            os << delimiter << v[k];
+            delimiter = csv.delimiter;
+        }
+        os << std::endl;
+    }
+}
+
 int main( int ac, char** av )
 {
     try
@@ -92,14 +162,13 @@ int main( int ac, char** av )
         comma::command_line_options options( ac, av );
         bool verbose = options.exists( "--verbose,-v" );
         if( options.exists( "--help,-h" ) ) { usage( verbose ); }
-        comma::csv::options csv( options );
+        csv = comma::csv::options( options );
         std::string f = options.value< std::string >( "--input-fields", "" );
         if( !f.empty() ) { csv.fields = f; }
         std::vector< std::string > input_fields = comma::split( csv.fields, ',' );
         std::vector< std::string > output_fields = comma::split( options.value< std::string >( "--output-fields,--output,-o" ), ',' );
-        bool output_trailing_fields = output_fields.back() == "...";
+        output_trailing_fields = output_fields.back() == "...";
         if( output_fields.back() == "..." ) { output_fields.erase( output_fields.end() - 1 ); }
-        std::vector< field > fields;
         for( unsigned int i = 0; i < output_fields.size(); ++i )
         {
             if( output_fields[i].empty() ) { continue; }
@@ -129,68 +198,20 @@ int main( int ac, char** av )
             _setmode( _fileno( stdin ), _O_BINARY );
             _setmode( _fileno( stdout ), _O_BINARY );
             #endif
-            std::vector< char > buf( csv.format().size() );
-            std::vector< comma::csv::format::element > elements;
             elements.reserve( csv.format().count() ); // quick and dirty, can be really wasteful on large things like images
             for( unsigned int i = 0; i < elements.capacity(); ++i ) { elements.push_back( csv.format().offset( i ) ); }
-            while( std::cin.good() && !std::cin.eof() )
-            {
-                // todo: quick and dirty; if performance is an issue, you could read more than
-                // one record every time see comma::csv::binary_input_stream::read() for reference
-                std::cin.read( &buf[0], csv.format().size() );
-                if( std::cin.gcount() == 0 ) { continue; }
-                if( std::cin.gcount() < int( csv.format().size() ) ) { std::cerr << "csv-shuffle: expected " << csv.format().size() << " bytes, got only " << std::cin.gcount() << std::endl; return 1; }
-                unsigned int previous_index = 0;
-                for( unsigned int i = 0; i < fields.size(); ++i ) // quick and dirty
-                {
-                    for( unsigned int k = previous_index; k < fields[i].index && k < elements.size(); ++k )
-                    {
-                        std::cout.write( &buf[ elements[k].offset ], elements[k].size );
-                    }
-                    std::cout.write( &buf[ fields[i].input_offset ], fields[i].size );
-                    previous_index = fields[i].index + 1;
-                }
-                //std::cerr << "--> previous_index: " << previous_index << " elements.size(): " << elements.size() << std::endl;
-                for( unsigned int k = previous_index; output_trailing_fields && k < elements.size(); ++k )
-                {
-                    std::cout.write( &buf[ elements[k].offset ], elements[k].size );
-                }
-                std::cout.flush(); // todo: flushing too often?
-            }
-        }
-        else
-        {
-            while( std::cin.good() && !std::cin.eof() )
-            {
-                std::string line;
-                std::getline( std::cin, line );
-                if( !line.empty() && *line.rbegin() == '\r' ) { line = line.substr( 0, line.length() - 1 ); } // windows... sigh...
-                if( line.empty() ) { continue; }
-                std::vector< std::string > v = comma::split( line, csv.delimiter );
-                std::string delimiter;
-                unsigned int previous_index = 0;
-                for( unsigned int i = 0; i < fields.size(); ++i ) // quick and dirty
-                {
-                    for( unsigned int k = previous_index; k < fields[i].index && k < v.size(); ++k )
-                    {
-                        std::cout << delimiter << v[k];
-                        delimiter = csv.delimiter;
-                    }
-                    previous_index = fields[i].index + 1;
-                    std::cout << delimiter;
-                    if ( *fields[i].input_index < v.size() ) { std::cout << v[ *fields[i].input_index ]; }
-                    delimiter = csv.delimiter;
-                }
-                for( unsigned int k = previous_index; output_trailing_fields && k < v.size(); ++k )
-                {
-                    std::cout << delimiter << v[k];
-                    delimiter = csv.delimiter;
-                }
-                std::cout << std::endl;
-            }
         }
+        comma::csv::parallel_map::function_type shuffle = csv.binary() ? &shuffle_binary : &shuffle_ascii;
+        unsigned int threads = options.value( "--threads", 1 );
+        if( threads == 1 ) { shuffle( std::cin, std::cout ); return 0; }
+        std::ios_base::sync_with_stdio( false ); // for chunks to be larger than a line on ascii input
+        comma::csv::parallel_map( shuffle, csv.binary() ? csv.format().size() : 0, threads ).run( std::cin, std::cout );
         return 0;
     }
+    catch( comma::exception& ex )
+    {
+        std::cerr << "csv-shuffle: " << ex.error() << std::endl;
+    }
     catch( std::exception& ex )
     {
         std::cerr << "csv-shuffle: " << ex.what() << std::endl;
@@ -42,6 +42,7 @@
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
 #include "../../base/types.h"
+#include "../../containers/flat_hash_map.h"
 #include "../../csv/stream.h"
 #include "../../csv/traits.h"
 #include "../../io/stream.h"
@@ -297,25 +298,28 @@ struct limit_data_t
     }
 };
 
+/// ID key packed into a flat byte string
+typedef comma::csv::impl::unstructured::packed ids_t;
+
 /// ID key to records
-typedef boost::unordered_map< comma::csv::impl::unstructured, limit_data_t, comma::csv::impl::unstructured::hash >  limit_map_t;
+typedef comma::flat_hash_map< ids_t, limit_data_t, ids_t::hash > limit_map_t;
 
 /// Use to flag if a record is in the minimum map as well as the maximum map, this is true when a first new record is added (for that ID)
-typedef boost::unordered_map< comma::csv::impl::unstructured, bool, comma::csv::impl::unstructured::hash >  same_map_t;
+typedef comma::flat_hash_map< ids_t, bool, ids_t::hash > same_map_t;
 static same_map_t is_same_map;
 
 /// Preserve the input order of the ID
-std::vector< comma::csv::impl::unstructured > input_order;
+std::vector< ids_t > input_order;
 
 void output_current_block( const limit_map_t& min, const limit_map_t& max )
 {
     for( std::size_t i=0; i<input_order.size(); ++i )
     {
-        const comma::csv::impl::unstructured& ids = input_order[i];
+        const ids_t& ids = input_order[i];
         
         if( is_min )
         {
-            const limit_data_t& data = min.at(ids);
+            const limit_data_t& data = min.at( ids );
             for ( std::size_t i=0; i<data.records.size(); ++i) {
                 std::cout.write( &( data.records[i][0] ), stdin_csv.binary() ? stdin_csv.format().size() : data.records[i].length() );
             }
@@ -325,7 +329,7 @@ void output_current_block( const limit_map_t& min, const limit_map_t& max )
         
         if( is_max )
         {
-            const limit_data_t& data = max.at(ids);
+            const limit_data_t& data = max.at( ids );
             for ( std::size_t i=0; i<data.records.size(); ++i) {
                 std::cout.write( &( data.records[i][0] ), stdin_csv.binary() ? stdin_csv.format().size() : data.records[i].length() );
             }
@@ -390,18 +394,20 @@ int handle_operations( const comma::command_line_options& options )
     comma::uint32 block = 0;    // previous block number, use default of 0
     limit_map_t min_map;
     limit_map_t max_map;
+    ids_t ids;
     
     bool first = true;
     if (!first_line.empty()) 
     { 
         input_with_id_t input =  comma::csv::ascii< input_with_id_t >(stdin_csv,default_input).get(first_line);
-        limit_data_t& data = min_map[input.ids];
+        ids.assign( input.ids );
+        limit_data_t& data = min_map[ids];
         data.keys = input;
         data.records.push_back( first_line + "\n");
         
-        max_map[input.ids] = data;
-        is_same_map[input.ids] = true;
-        input_order.push_back( input.ids );
+        max_map[ids] = data;
+        is_same_map[ids] = true;
+        input_order.push_back( ids );
         block = input.block;
         first = false;
     }
@@ -409,17 +415,18 @@ int handle_operations( const comma::command_line_options& options )
     {
         const input_with_id_t* p = stdin_stream.read();
         if( !p ) { break; }
+        ids.assign( p->ids );
 //         std::cerr  << "p: " << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ) << " - " << p->keys.longs[0] << std::endl;
         
         if( first )
         {
-            limit_data_t& data = min_map[p->ids];
+            limit_data_t& data = min_map[ids];
             data.keys = *p;
             data.add_current_record( stdin_stream );
             
-            max_map[p->ids] = data;
-            is_same_map[p->ids] = true;
-            input_order.push_back( p->ids );
+            max_map[ids] = data;
+            is_same_map[ids] = true;
+            input_order.push_back( ids );
             
             block = p->block;
             first = false;
@@ -433,13 +440,13 @@ int handle_operations( const comma::command_line_options& options )
             input_order.clear();
             
             // Set the same record for both min and max, it's a new block, new IDs
-            limit_data_t& data = min_map[p->ids];
+            limit_data_t& data = min_map[ids];
             data.keys = *p;
             data.add_current_record( stdin_stream );
             
-            max_map[p->ids] = data;
-            is_same_map[p->ids] = true;
-            input_order.push_back( p->ids );
+            max_map[ids] = data;
+            is_same_map[ids] = true;
+            input_order.push_back( ids );
             
             block = p->block;
         }
@@ -447,14 +454,14 @@ int handle_operations( const comma::command_line_options& options )
         {
             if( is_min )
             {
-                limit_map_t::iterator iter = min_map.find( p->ids );
+                limit_map_t::iterator iter = min_map.find( ids );
                 if( iter == min_map.end() )
                 {
-                    limit_data_t& data = min_map[p->ids];
+                    limit_data_t& data = min_map[ids];
                     data.keys = *p;
                     data.add_current_record( stdin_stream );
-                    is_same_map[p->ids] = true;
-                    input_order.push_back( p->ids );
+                    is_same_map[ids] = true;
+                    input_order.push_back( ids );
                 }
                 else
                 {
@@ -465,21 +472,21 @@ int handle_operations( const comma::command_line_options& options )
                         data.keys = *p;
                         data.records.clear();
                         data.add_current_record( stdin_stream );
-                        is_same_map[p->ids] = false;
+                        is_same_map[ids] = false;
                     }
                 }
             }
             if( is_max )
             {
-                limit_map_t::iterator iter = max_map.find( p->ids );
+                limit_map_t::iterator iter = max_map.find( ids );
                 if( iter == max_map.end() )
                 {
 //                     std::cerr  << "not found ids: " << p->ids.strings[0] << std::endl;
-                    limit_data_t& data = max_map[p->ids];
+                    limit_data_t& data = max_map[ids];
                     data.keys = *p;
                     data.add_current_record( stdin_stream );
-                    is_same_map[p->ids] = true;
-                    if( !is_min ) { input_order.push_back( p->ids ); }
+                    is_same_map[ids] = true;
+                    if( !is_min ) { input_order.push_back( ids ); }
                 }
                 else
                 {
@@ -493,7 +500,7 @@ int handle_operations( const comma::command_line_options& options )
                         data.keys = *p;
                         data.records.clear();
                         data.add_current_record( stdin_stream );
-                        is_same_map[p->ids] = false;
+                        is_same_map[ids] = false;
                     }
                 }
             }
@@ -35,20 +35,26 @@
 #include <io.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <boost/date_time/posix_time/ptime.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_real.hpp>
 #include <boost/random/variate_generator.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
 #include "../../base/types.h"
+#include "../../containers/flat_hash_map.h"
 #include "../../io/file_descriptor.h"
 #include "../../math/compare.h"
 #include "../../csv/options.h"
 #include "../../csv/stream.h"
+#include "../../string/string.h"
 #include "../../visiting/traits.h"
 
 using namespace comma;
@@ -60,8 +66,12 @@ static void usage(bool detail=false)
     std::cerr << "buffer handling optimized for a high-output producer" << std::endl;
     std::cerr << std::endl;
     std::cerr << "Usage: cat full.csv | csv-thin <rate> [<options>] > thinned.csv" << std::endl;
+    std::cerr << "       cat full.csv | csv-thin --reservoir=<k> [<options>] > sample.csv" << std::endl;
+    std::cerr << "       cat full.csv | csv-thin --max-rate=<n> [<options>] > thinned.csv" << std::endl;
     std::cerr << std::endl;
     std::cerr << "e.g. output 70% of data:  cat full.csv | csv-thin 0.7 > thinned.csv" << std::endl;
+    std::cerr << "     output 100 records uniformly sampled from the whole input: cat full.csv | csv-thin --reservoir=100 > sample.csv" << std::endl;
+    std::cerr << "     output at most 10 records per second per id: cat full.csv | csv-thin --max-rate=10 --fields=t,id > thinned.csv" << std::endl;
     std::cerr << std::endl;
     std::cerr << "<options>" << std::endl;
     std::cerr << std::endl;
@@ -71,6 +81,20 @@ static void usage(bool detail=false)
     std::cerr << "                        That is, if <rate> is 0.33, output every third packet." << std::endl;
     std::cerr << "                        Default is to output each packet with a probability of <rate>." << std::endl;
     std::cerr << "   --fps,--frames-per-second <d>: deprecated and removed" << std::endl;
+    std::cerr << "   --geometric,-g: output each packet with a probability of <rate>, but instead of drawing" << std::endl;
+    std::cerr << "                   a random number for each packet, draw the number of packets to skip" << std::endl;
+    std::cerr << "                   before the next output packet from the geometric distribution;" << std::endl;
+    std::cerr << "                   one random number per output packet; in binary mode, skipped packets" << std::endl;
+    std::cerr << "                   are jumped over in whole without looking at them; recommended for small rates" << std::endl;
+    std::cerr << "   --max-rate=<n>: output at most <n> records per second per id, based on the timestamp field t;" << std::endl;
+    std::cerr << "                   a record is output, if at least 1/<n> seconds passed since the last output" << std::endl;
+    std::cerr << "                   record with the same id; fields: t,id; default: t; use --binary=<format>" << std::endl;
+    std::cerr << "                   for binary input; <rate> is not expected" << std::endl;
+    std::cerr << "   --reservoir=<k>: output exactly <k> records (or all, if input is shorter) uniformly sampled" << std::endl;
+    std::cerr << "                    from the whole input (reservoir sampling), in the order of input;" << std::endl;
+    std::cerr << "                    output happens on end of input; <k> records are kept in memory;" << std::endl;
+    std::cerr << "                    random numbers are drawn only for records that get into the reservoir" << std::endl;
+    std::cerr << "                    <rate> is not expected" << std::endl;
     std::cerr << "    --size,-s <size>: if given, data is packets of fixed size" << std::endl;
     std::cerr << "                      otherwise data is expected line-wise" << std::endl;
     std::cerr << "                      alternatively use --binary" << std::endl;
@@ -93,9 +117,46 @@ static void usage(bool detail=false)
 
 static double rate;
 static bool deterministic;
+static bool geometric;
+static boost::mt19937 rng;
+
+static double uniform()
+{
+    static boost::uniform_real<> dist( 0, 1 );
+    static boost::variate_generator< boost::mt19937&, boost::uniform_real<> > random( rng, dist );
+    return random();
+}
+
+static double uniform_open() // uniform in (0, 1)
+{
+    double u = uniform();
+    while( u == 0 ) { u = uniform(); }
+    return u;
+}
+
+static comma::uint64 geometric_count( double log_complement ) // number of failures before first success, log_complement: log of 1 - success probability
+{
+    double n = std::floor( std::log( uniform_open() ) / log_complement );
+    return n < 1.8e+19 ? comma::uint64( n ) : std::numeric_limits< comma::uint64 >::max();
+}
+
+static comma::uint64 to_skip = 0; // geometric: number of packets to skip before the next output
+
+static comma::uint64 geometric_skip()
+{
+    if( !comma::math::less( rate, 1.0 ) ) { return 0; }
+    if( !comma::math::less( 0, rate ) ) { return std::numeric_limits< comma::uint64 >::max(); }
+    return geometric_count( std::log( 1 - rate ) );
+}
 
 static bool ignore()
 {
+    if( geometric )
+    {
+        if( to_skip > 0 ) { --to_skip; return true; }
+        to_skip = geometric_skip();
+        return false;
+    }
     if( deterministic )
     {
         /*
@@ -121,13 +182,120 @@ static bool ignore()
         }
         return false;
     }
-    static boost::mt19937 rng;
-    static boost::uniform_real<> dist( 0, 1 );
-    static boost::variate_generator< boost::mt19937&, boost::uniform_real<> > random( rng, dist );
     static bool do_ignore = comma::math::less( rate, 1.0 );
-    return do_ignore && random() > rate;
+    return do_ignore && uniform() > rate;
+}
+
+/// reservoir sampling with geometric skips (algorithm L by Kim-Hung Li):
+/// after the reservoir is full, the number of records to skip before the next
+/// replacement is drawn directly, so that skipped records cost nothing
+class reservoir
+{
+    public:
+        reservoir( std::size_t size ) : size_( size ), count_( 0 ), next_( 0 ), log_w_( 0 ) { records_.reserve( size ); }
+
+        /// number of following records that will not get into the reservoir
+        comma::uint64 skippable() const { return count_ < size_ ? 0 : next_ - count_; }
+
+        void skip( comma::uint64 n ) { count_ += n; }
+
+        void push( const char* buf, std::size_t size )
+        {
+            if( count_ < size_ )
+            {
+                records_.push_back( record( count_, std::string( buf, size ) ) );
+                if( ++count_ == size_ ) { log_w_ = std::log( uniform_open() ) / size_; next_ = count_ + advance_(); }
+                return;
+            }
+            if( count_++ != next_ ) { return; }
+            record& r = records_[ std::min( std::size_t( uniform() * size_ ), size_ - 1 ) ];
+            r.first = next_;
+            r.second.assign( buf, size );
+            log_w_ += std::log( uniform_open() ) / size_;
+            next_ += 1 + advance_();
+        }
+
+        /// write records in the order of input, each followed by given delimiter, if any
+        void write( std::ostream& os, const char* delimiter = NULL )
+        {
+            std::sort( records_.begin(), records_.end() );
+            for( std::size_t i = 0; i < records_.size(); ++i )
+            {
+                os.write( &records_[i].second[0], records_[i].second.size() );
+                if( delimiter ) { os << delimiter; }
+            }
+            os.flush();
+        }
+
+    private:
+        typedef std::pair< comma::uint64, std::string > record;
+        std::size_t size_;
+        comma::uint64 count_;
+        comma::uint64 next_;
+        double log_w_;
+        std::vector< record > records_;
+
+        comma::uint64 advance_() const
+        {
+            double w = std::exp( log_w_ );
+            return w < 1 ? geometric_count( std::log1p( -w ) ) : 0;
+        }
+};
+
+static boost::scoped_ptr< reservoir > sample;
+
+static comma::uint64 skippable() { return sample ? sample->skippable() : geometric ? to_skip : 0; }
+
+static void skip( comma::uint64 n ) { if( sample ) { sample->skip( n ); } else { to_skip -= n; } }
+
+struct input_t
+{
+    boost::posix_time::ptime t;
+    comma::uint32 id;
+    input_t() : id( 0 ) {}
+};
+
+namespace comma { namespace visiting {
+
+template <> struct traits< input_t >
+{
+    template < typename K, typename V > static void visit( const K&, input_t& p, V& v )
+    {
+        v.apply( "t", p.t );
+        v.apply( "id", p.id );
+    }
+    template < typename K, typename V > static void visit( const K&, const input_t& p, V& v )
+    {
+        v.apply( "t", p.t );
+        v.apply( "id", p.id );
+    }
+};
+
+} } // namespace comma { namespace visiting {
+
+static int thin_by_time( const comma::command_line_options& options, double max_rate )
+{
+    comma::csv::options csv( options, "t" );
+    if( !csv.has_field( "t" ) ) { std::cerr << "csv-thin: --max-rate: expected field t, got: \"" << csv.fields << "\"" << std::endl; return 1; }
+    boost::posix_time::time_duration period = boost::posix_time::microseconds( boost::posix_time::time_duration::tick_type( std::ceil( 1e+6 / max_rate ) ) );
+    comma::flat_hash_map< comma::uint32, boost::posix_time::ptime > last;
+    comma::csv::input_stream< input_t > istream( std::cin, csv );
+    while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+    {
+        const input_t* p = istream.read();
+        if( !p ) { break; }
+        if( p->t.is_special() ) { std::cerr << "csv-thin: --max-rate: expected valid timestamp, got: " << p->t << std::endl; return 1; }
+        boost::posix_time::ptime& t = last[ p->id ];
+        if( !t.is_not_a_date_time() && p->t < t + period ) { continue; }
+        t = p->t;
+        if( csv.binary() ) { std::cout.write( istream.binary().last(), csv.format().size() ); }
+        else { std::cout << comma::join( istream.ascii().last(), csv.delimiter ) << std::endl; }
+        if( csv.flush ) { std::cout.flush(); }
+    }
+    return 0;
 }
 
+
 int main( int ac, char** av )
 {
     try
@@ -140,10 +308,28 @@ int main( int ac, char** av )
         if( binary ) { _setmode( _fileno( stdin ), _O_BINARY ); _setmode( _fileno( stdout ), _O_BINARY ); }
         #endif
         
-        std::vector< std::string > v = options.unnamed( "--deterministic,-d", "-.*" );
-        if( v.empty() ) { std::cerr << "csv-thin: please specify rate" << std::endl; usage(); }
-        rate = boost::lexical_cast< double >( v[0] );
-        if( comma::math::less( rate, 0 ) || comma::math::less( 1, rate ) ) { std::cerr << "csv-thin: expected rate between 0 and 1, got " << rate << std::endl; usage(); }
+        geometric = options.exists( "--geometric,-g" );
+        options.assert_mutually_exclusive( "--deterministic,--geometric,--reservoir,--max-rate" );
+        std::vector< std::string > v = options.unnamed( "--deterministic,-d,--geometric,-g,--flush,--verbose,-v", "-.*" );
+        if( options.exists( "--max-rate" ) )
+        {
+            double max_rate = options.value< double >( "--max-rate" );
+            if( !comma::math::less( 0, max_rate ) ) { std::cerr << "csv-thin: expected positive --max-rate, got " << max_rate << std::endl; return 1; }
+            return thin_by_time( options, max_rate );
+        }
+        if( options.exists( "--reservoir" ) )
+        {
+            std::size_t k = options.value< std::size_t >( "--reservoir" );
+            if( k == 0 ) { std::cerr << "csv-thin: expected positive --reservoir, got 0" << std::endl; return 1; }
+            sample.reset( new reservoir( k ) );
+        }
+        else
+        {
+            if( v.empty() ) { std::cerr << "csv-thin: please specify rate" << std::endl; usage(); }
+            rate = boost::lexical_cast< double >( v[0] );
+            if( comma::math::less( rate, 0 ) || comma::math::less( 1, rate ) ) { std::cerr << "csv-thin: expected rate between 0 and 1, got " << rate << std::endl; usage(); }
+            if( geometric ) { to_skip = geometric_skip(); }
+        }
 
         if( binary ) // quick and dirty, improve performance by reading larger buffer
         {
@@ -167,7 +353,9 @@ int main( int ac, char** av )
                 std::cin.read( &buf[0], size ); // quick and dirty
                 if( std::cin.gcount() <= 0 ) { break; }
                 if( std::cin.gcount() < int( size ) ) { std::cerr << "csv-thin: expected " << size << " bytes; got only " << std::cin.gcount() << std::endl; exit( 1 ); }
-                { if( !ignore() ) { std::cout.write( &buf[0], size ); std::cout.flush(); } }
+                if( skippable() ) { skip( 1 ); continue; }
+                if( sample ) { sample->push( &buf[0], size ); }
+                else if( !ignore() ) { std::cout.write( &buf[0], size ); std::cout.flush(); }
             }
             #else
             char* cur = &buf[0];
@@ -185,12 +373,22 @@ int main( int ac, char** av )
                 capacity -= count;
                 for( ; offset >= size; cur += size, offset -= size )
                 {
-                    if( !ignore() ) { std::cout.write( cur, size ); }
+                    comma::uint64 n = std::min< comma::uint64 >( skippable(), offset / size ); // jump over whole run of skipped packets
+                    if( n > 0 )
+                    {
+                        skip( n );
+                        cur += n * size;
+                        offset -= n * size;
+                        if( offset < size ) { break; }
+                    }
+                    if( sample ) { sample->push( cur, size ); }
+                    else if( !ignore() ) { std::cout.write( cur, size ); }
                 }
                 if( capacity == 0 ) { cur = &buf[0]; offset = 0; capacity = buf.size(); }
-                std::cout.flush();
+                if( !sample ) { std::cout.flush(); }
             }
             #endif
+            if( sample ) { sample->write( std::cout ); }
         }
         else
         {
@@ -198,8 +396,12 @@ int main( int ac, char** av )
             while( std::cin.good() && !std::cin.eof() )
             {
                 std::getline( std::cin, line );
-                if( !line.empty() && !ignore() ) { std::cout << line << std::endl; }
+                if( line.empty() ) { continue; }
+                if( skippable() ) { skip( 1 ); continue; }
+                if( sample ) { sample->push( &line[0], line.size() ); }
+                else if( !ignore() ) { std::cout << line << std::endl; }
             }
+            if( sample ) { sample->write( std::cout, "\n" ); }
         }
         return 0;
     }
@@ -47,8 +47,10 @@
 #include "../../application/command_line_options.h"
 #include "../../base/exception.h"
 #include "../../base/types.h"
+#include "../../csv/parallel_map.h"
 #include "../../csv/stream.h"
 #include "../../csv/impl/epoch.h"
+#include "../../csv/impl/iso_time.h"
 #include "../../string/string.h"
 #include "../../visiting/traits.h"
 
@@ -69,6 +71,8 @@ static void usage( bool )
         "\n                        e.g. \"1,5,7\" or \"a,b,,d\""
         "\n                        defaults to \"a\" (first field only is datetime)"
         "\n    --empty-as-not-a-date-time,--accept-empty,-e: if time field is empty, consider it as not-a-date-time"
+        "\n    --threads=<n>: convert in n threads, output order is preserved; default: 1"
+        "\n                   n=0: number of hardware threads"
         "\n"
         "\nTime formats"
         "\n    - iso, iso-8601-basic"
@@ -229,10 +233,12 @@ static boost::posix_time::ptime from_string( const std::string& s, const what_t
         if( accept_empty ) { return boost::posix_time::not_a_date_time; }
         COMMA_THROW( comma::exception, "expected non-empty field, got empty; use --accept-empty" );
     }
+    boost::posix_time::ptime t;
     switch( w )
     {
         case iso:
         case iso_always_with_fractions:
+            if( comma::csv::impl::from_iso_basic_string( &s[0], s.size(), t ) ) { return t; }
             return s == not_a_date_time_string ? boost::posix_time::not_a_date_time : boost::posix_time::from_iso_string( s ); // todo? support infinity?
             
         case local:
@@ -246,7 +252,7 @@ static boost::posix_time::ptime from_string( const std::string& s, const what_t
 
         case seconds:
         {
-            std::cerr.precision( 20 );
+            if( comma::csv::impl::from_seconds_string( &s[0], s.size(), t ) ) { return t; }
             double d = boost::lexical_cast< double >( s );
             long long seconds = d;
             // ::round() does not compile on windows for c++03
@@ -261,9 +267,11 @@ static boost::posix_time::ptime from_string( const std::string& s, const what_t
         }
         
         case sql:
+            if( s.size() > 10 && s[10] == ' ' && comma::csv::impl::from_iso_extended_string( &s[0], s.size(), t ) ) { return t; }
             return s == "NULL" || s == "null" ? boost::posix_time::not_a_date_time : boost::posix_time::time_from_string( s );
 
         case xsd: // 2014-03-05T23:00:00.000Z
+            if( comma::csv::impl::from_iso_extended_string( &s[0], s.size(), t ) ) { return t; }
             return from_string_xsd( s );
 
         case format:
@@ -277,6 +285,7 @@ static boost::posix_time::ptime from_string( const std::string& s, const what_t
         }
 
         case guess:
+            if( comma::csv::impl::from_any_string( &s[0], s.size(), t ) ) { return t; } // fast path: detect format by shape
             try
             { 
                 return from_string( s, iso );
@@ -310,16 +319,14 @@ static boost::posix_time::ptime from_string( const std::string& s, const what_t
 
 std::string to_string( const boost::posix_time::ptime& t, what_t w )
 {
+    char buf[32];
     switch( w )
     {
         case iso:
-            return boost::posix_time::to_iso_string( t );
+            return std::string( buf, comma::csv::impl::to_iso_basic_string( t, buf ) );
             
         case iso_always_with_fractions:
-        {
-            const std::string& s = boost::posix_time::to_iso_string( t );
-            return !t.is_special() && s.find( "." ) == std::string::npos ? s + ".000000" : s; // quick and dirty
-        }
+            return std::string( buf, comma::csv::impl::to_iso_basic_string( t, buf, true ) );
             
         case local:
             return boost::posix_time::to_iso_string( boost::date_time::c_local_adjustor<boost::posix_time::ptime>::utc_to_local( t ) );
@@ -353,10 +360,10 @@ std::string to_string( const boost::posix_time::ptime& t, what_t w )
         }
 
         case sql:
-            return t.is_not_a_date_time() ? std::string( "NULL" ) : comma::split( boost::replace_all_copy( boost::posix_time::to_iso_extended_string( t ), "T", " " ), '.' )[0];
+            return t.is_not_a_date_time() ? std::string( "NULL" ) : std::string( buf, comma::csv::impl::to_iso_extended_string( t, buf, ' ', false ) );
 
         case xsd: // 2014-03-05T23:00:00.000Z
-            return boost::posix_time::to_iso_extended_string( t );
+            return std::string( buf, comma::csv::impl::to_iso_extended_string( t, buf ) );
 
         case format:
         {
@@ -446,11 +453,11 @@ static void init_input()
     input.values.resize( size );
 }
 
-static int run()
+static void convert( std::istream& is, std::ostream& os )
 {
-    comma::csv::input_stream< input_t > istream( std::cin, csv, input );
-    comma::csv::output_stream< input_t > ostream( std::cout, csv, input );
-    while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+    comma::csv::input_stream< input_t > istream( is, csv, input );
+    comma::csv::output_stream< input_t > ostream( os, csv, input );
+    while( istream.ready() || ( is.good() && !is.eof() ) )
     {
         const input_t* p = istream.read();
         if( !p ) { break; }
@@ -458,6 +465,13 @@ static int run()
         for( unsigned int i = 0; i < output.values.size(); output.values[i] = to_string( from_string( output.values[i], from ), to ), ++i );
         ostream.write( output, istream );
     }
+}
+
+static int run( unsigned int threads )
+{
+    if( threads == 1 ) { convert( std::cin, std::cout ); return 0; }
+    std::ios_base::sync_with_stdio( false ); // for chunks to be larger than a line on ascii input
+    comma::csv::parallel_map( &convert, csv.binary() ? csv.format().size() : 0, threads ).run( std::cin, std::cout );
     return 0;
 }
 
@@ -478,7 +492,8 @@ int main( int ac, char** av )
         else if ( options.exists( "--to-seconds,--sec,-s" ) ) { from = iso; to = seconds; }
         else { from = what( "--from", options ); to = what( "--to", options ); }
         if( guess == to ) { std::cerr << "csv-time: please specify valid --to" << std::endl; return 1; }
-        return run();
+        std::cerr.precision( 20 ); // once, before the worker threads start, rather than on every conversion from seconds
+        return run( options.value( "--threads", 1 ) );
     }
     catch( std::exception& ex ) { std::cerr << "csv-time: " << ex.what() << std::endl; }
     catch( ... ) { std::cerr << "csv-time: unknown exception" << std::endl; }
@@ -37,10 +37,15 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
+#include <cstdio>
 #include <iostream>
+#include <limits>
+#include <vector>
 #include "../../application/contact_info.h"
 #include "../../application/command_line_options.h"
 #include "../../csv/format.h"
+#include "../../csv/impl/iso_time.h"
 #include "../../string/string.h"
 
 //#include <google/profiler.h>
@@ -63,6 +68,160 @@ static void usage( bool )
     exit( 0 );
 }
 
+namespace {
+
+/// converts csv lines into binary records in place, without splitting lines into strings
+/// and without lexical casts; returns false on anything unusual, in which case the caller
+/// falls back to comma::csv::format::csv_to_bin(), which also reports errors
+class converter
+{
+    public:
+        converter( const comma::csv::format& format, char delimiter ) : delimiter_( delimiter ), size_( format.size() )
+        {
+            for( unsigned int i = 0; i < format.elements().size(); ++i )
+            {
+                for( unsigned int j = 0; j < format.elements()[i].count; ++j ) { fields_.push_back( field( format.elements()[i].type, format.elements()[i].size ) ); }
+            }
+        }
+
+        /// convert line [begin, end) and append the record to output; line must be followed by a non-numeric character, e.g. newline
+        bool convert( const char* begin, const char* end, std::vector< char >& output ) const
+        {
+            std::size_t offset = output.size();
+            output.resize( offset + size_ );
+            char* p = &output[offset];
+            const char* b = begin;
+            for( unsigned int i = 0; i < fields_.size(); ++i )
+            {
+                const char* e = static_cast< const char* >( ::memchr( b, delimiter_, end - b ) );
+                if( i + 1 == fields_.size() ) { if( e ) { output.resize( offset ); return false; } e = end; }
+                else if( !e ) { output.resize( offset ); return false; }
+                if( !convert_( fields_[i], b, e, p ) ) { output.resize( offset ); return false; }
+                p += fields_[i].size;
+                b = e + 1;
+            }
+            return true;
+        }
+
+    private:
+        struct field
+        {
+            comma::csv::format::types_enum type;
+            std::size_t size;
+            field( comma::csv::format::types_enum type, std::size_t size ) : type( type ), size( size ) {}
+        };
+        char delimiter_;
+        std::size_t size_;
+        std::vector< field > fields_;
+
+        template < typename T > static bool integer_( const char* s, const char* e, T min, T max, T& v )
+        {
+            bool negative = s != e && *s == '-';
+            if( negative || ( s != e && *s == '+' ) ) { ++s; }
+            if( s == e || ( negative && min == 0 ) ) { return false; }
+            comma::uint64 u = 0;
+            for( ; s != e; ++s )
+            {
+                unsigned int d = static_cast< unsigned char >( *s ) - '0';
+                if( d > 9 || u > ( std::numeric_limits< comma::uint64 >::max() - d ) / 10 ) { return false; }
+                u = u * 10 + d;
+            }
+            if( negative ) { if( u > comma::uint64( -( min + 1 ) ) + 1 ) { return false; } v = static_cast< T >( -static_cast< comma::int64 >( u - 1 ) - 1 ); }
+            else { if( u > comma::uint64( max ) ) { return false; } v = static_cast< T >( u ); }
+            return true;
+        }
+
+        template < typename T > static bool integer_( const char* s, const char* e, char* p )
+        {
+            T v;
+            if( !integer_( s, e, std::numeric_limits< T >::min(), std::numeric_limits< T >::max(), v ) ) { return false; }
+            ::memcpy( p, &v, sizeof( T ) );
+            return true;
+        }
+
+        static bool floating_point_( const char* s, const char* e ) // only plain decimal notation; anything else (e.g. inf, nan, hex) goes to lexical_cast; strtod() stops at the delimiter, as long as it is not a numeric character
+        {
+            if( s == e ) { return false; }
+            for( ; s != e; ++s ) { if( !( ( *s >= '0' && *s <= '9' ) || *s == '.' || *s == '-' || *s == '+' || *s == 'e' || *s == 'E' ) ) { return false; } }
+            return true;
+        }
+
+        static bool convert_( const field& f, const char* s, const char* e, char* p )
+        {
+            switch( f.type )
+            {
+                case comma::csv::format::int8:
+                {
+                    int i;
+                    if( !integer_( s, e, -127, 128, i ) ) { return false; } // as in comma::csv::format
+                    *p = static_cast< char >( i );
+                    return true;
+                }
+                case comma::csv::format::uint8:
+                {
+                    unsigned int i;
+                    if( !integer_( s, e, 0u, 255u, i ) ) { return false; }
+                    *p = static_cast< unsigned char >( i );
+                    return true;
+                }
+                case comma::csv::format::int16: return integer_< comma::int16 >( s, e, p );
+                case comma::csv::format::uint16: return integer_< comma::uint16 >( s, e, p );
+                case comma::csv::format::int32: return integer_< comma::int32 >( s, e, p );
+                case comma::csv::format::uint32: return integer_< comma::uint32 >( s, e, p );
+                case comma::csv::format::int64: return integer_< comma::int64 >( s, e, p );
+                case comma::csv::format::uint64: return integer_< comma::uint64 >( s, e, p );
+                case comma::csv::format::char_t:
+                    if( e - s != 1 ) { return false; }
+                    *p = *s;
+                    return true;
+                case comma::csv::format::float_t:
+                {
+                    if( !floating_point_( s, e ) ) { return false; }
+                    char* end;
+                    float v = ::strtof( s, &end );
+                    if( end != e || v == std::numeric_limits< float >::infinity() || v == -std::numeric_limits< float >::infinity() ) { return false; } // overflow
+                    ::memcpy( p, &v, sizeof( float ) );
+                    return true;
+                }
+                case comma::csv::format::double_t:
+                {
+                    if( !floating_point_( s, e ) ) { return false; }
+                    char* end;
+                    double v = ::strtod( s, &end );
+                    if( end != e || v == std::numeric_limits< double >::infinity() || v == -std::numeric_limits< double >::infinity() ) { return false; } // overflow
+                    ::memcpy( p, &v, sizeof( double ) );
+                    return true;
+                }
+                case comma::csv::format::time:
+                {
+                    boost::posix_time::ptime t;
+                    if( !comma::csv::impl::from_iso_basic_string( s, e - s, t ) ) { return false; }
+                    comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::to_bin( t, p );
+                    return true;
+                }
+                case comma::csv::format::long_time:
+                {
+                    boost::posix_time::ptime t;
+                    if( !comma::csv::impl::from_iso_basic_string( s, e - s, t ) ) { return false; }
+                    comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::to_bin( t, p );
+                    return true;
+                }
+                case comma::csv::format::fixed_string:
+                {
+                    std::size_t length = e - s;
+                    if( length > f.size ) { return false; }
+                    if( length > 1 && *s == '\"' && *( e - 1 ) == '\"' ) { ++s; length -= 2; }
+                    ::memcpy( p, s, length );
+                    ::memset( p + length, 0, f.size - length );
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+} // namespace {
+
 int main( int ac, char** av )
 {
     #ifdef WIN32
@@ -76,12 +235,43 @@ int main( int ac, char** av )
         char delimiter = options.value( "--delimiter", ',' );
         bool flush = options.exists( "--flush" );
         comma::csv::format format( av[1] );
+        std::ios_base::sync_with_stdio( false ); // unsync to make rdbuf()->in_avail() working
+        converter c( format, delimiter );
+        std::vector< char > input( 1 << 20 );
+        std::vector< char > output;
+        std::size_t size = 0;
+        bool eof = false;
         //{ ProfilerStart( "csv-to-bin.prof" );
-        while( std::cin.good() && !std::cin.eof() )
+        while( !eof )
         {
-            std::getline( std::cin, line );
-            if( !line.empty() && *line.rbegin() == '\r' ) { line = line.substr( 0, line.length() - 1 ); } // windows... sigh...
-            if( !line.empty() ) { format.csv_to_bin( std::cout, line, delimiter, flush ); }
+            if( size + 1 >= input.size() ) { input.resize( input.size() * 2 ); } // very long line
+            std::streamsize n = std::cin.readsome( &input[size], input.size() - size - 1 ); // read what is available, keeping a byte for terminating the last line
+            if( n == 0 ) { eof = std::cin.peek() == std::char_traits< char >::eof(); if( !eof ) { continue; } } // peek() blocks until there is more input
+            size += n;
+            char* begin = &input[0];
+            char* end = begin + size;
+            if( eof && size > 0 && *( end - 1 ) != '\n' ) { *end++ = '\n'; } // last line without newline
+            output.clear();
+            for( char* newline; ( newline = static_cast< char* >( ::memchr( begin, '\n', end - begin ) ) ); begin = newline + 1 )
+            {
+                char* e = newline > begin && *( newline - 1 ) == '\r' ? newline - 1 : newline; // windows... sigh...
+                if( e == begin ) { continue; }
+                if( !c.convert( begin, e, output ) )
+                {
+                    if( !output.empty() ) { std::cout.write( &output[0], output.size() ); } // slow path: comma::csv::format, which reports errors
+                    output.clear();
+                    line = std::string( begin, e );
+                    format.csv_to_bin( std::cout, line, delimiter );
+                    line.clear();
+                }
+                if( !flush ) { continue; }
+                if( !output.empty() ) { std::cout.write( &output[0], output.size() ); }
+                output.clear();
+                std::cout.flush();
+            }
+            if( !output.empty() ) { std::cout.write( &output[0], output.size() ); }
+            size = end - begin;
+            if( size > 0 ) { ::memmove( &input[0], begin, size ); }
         }
         //ProfilerStop(); }
         return 0;
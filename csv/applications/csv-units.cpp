@@ -55,6 +55,7 @@
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
+#include "../../csv/parallel_map.h"
 #include "../../csv/stream.h"
 #include "../../visiting/traits.h"
 
@@ -75,6 +76,8 @@ static void usage(char const * const txt = "")
         "\n                       a convenience option, probably somewhat misplaced"
         "\n    --offset <value> : offset each value by a given <value> instead of unit conversion"
         "\n                       a convenience option, probably somewhat misplaced"
+        "\n    --threads=<n>    : convert in n threads, output order is preserved; default: 1"
+        "\n                       n=0: number of hardware threads"
         "\n"
         "\nSupported Units:"
         "\n    metres / feet / statute-miles / nautical-miles "
@@ -358,7 +361,7 @@ namespace units {
 
 static void bash_completion( unsigned const ac, char const * const * av )
 {
-    static char const * const arguments = "--from --to --scale";
+    static char const * const arguments = "--from --to --scale --offset --threads";
     std::cout << arguments;
     for( unsigned i = 0; i < units::count; ++i )
         std::cout << ' ' << units::name(units::et(i));
@@ -465,11 +468,11 @@ static void init_input()
     input.values.resize( input_fields.size() ); //input.values.resize( size );
 }
 
-static int scale_and_offset( double factor, double offset )
+static void scale_and_offset( double factor, double offset, std::istream& is, std::ostream& os )
 {
-    comma::csv::input_stream< input_t > istream( std::cin, csv, input );
-    comma::csv::output_stream< input_t > ostream( std::cout, csv, input );
-    while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+    comma::csv::input_stream< input_t > istream( is, csv, input );
+    comma::csv::output_stream< input_t > ostream( os, csv, input );
+    while( istream.ready() || ( is.good() && !is.eof() ) )
     {
         const input_t* p = istream.read();
         if( !p ) { break; }
@@ -477,19 +480,18 @@ static int scale_and_offset( double factor, double offset )
         for( unsigned int i = 0; i < output.values.size(); output.values[i].value = output.values[i].value * factor + offset, ++i );
         ostream.write( output, istream );
     }
-    return 0;
 }
 
-static int run( const units::et from, const units::et to )
+static void convert( const units::et from, const units::et to, std::istream& is, std::ostream& os, comma::uint64 offset ) // offset: number of records before, if run on a chunk of input
 {
-    comma::csv::input_stream< input_t > istream( std::cin, csv, input );
-    comma::csv::output_stream< input_t > ostream( std::cout, csv, input );
+    comma::csv::input_stream< input_t > istream( is, csv, input );
+    comma::csv::output_stream< input_t > ostream( os, csv, input );
 
     units::cast_function const default_cast_function = units::cast_lookup( from, to );
     if (NULL == default_cast_function) { COMMA_THROW( comma::exception, "unsupported default conversion from " << debug_name(from) << " to " << debug_name(to) ); }
     
-    unsigned line = 0;
-    while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+    comma::uint64 line = offset;
+    while( istream.ready() || ( is.good() && !is.eof() ) )
     {
         const input_t* p = istream.read();
         if( !p ) { break; }
@@ -509,6 +511,13 @@ static int run( const units::et from, const units::et to )
         ostream.write( output, istream );
         ++line;
     }
+}
+
+static int run( const comma::csv::parallel_map::indexed_function_type& function, unsigned int threads )
+{
+    if( threads == 1 ) { function( std::cin, std::cout, 0 ); return 0; }
+    std::ios_base::sync_with_stdio( false ); // for chunks to be larger than a line on ascii input
+    comma::csv::parallel_map( comma::csv::parallel_map::indexed( function ), csv.binary() ? csv.format().size() : 0, threads ).run( std::cin, std::cout );
     return 0;
 }
 
@@ -524,9 +533,10 @@ int main( int ac, char** av )
         csv = comma::csv::options( options );
         if( csv.fields.empty() ) { csv.fields="a"; }
         init_input();
+        unsigned int threads = options.value( "--threads", 1 );
         boost::optional< double > scale_factor = options.optional< double >( "--scale" );
         boost::optional< double > offset = options.optional< double >( "--offset" );
-        if( scale_factor || offset ) { return scale_and_offset( scale_factor ? *scale_factor : 1, offset ? *offset : 0 ); }
+        if( scale_factor || offset ) { return run( boost::bind( &scale_and_offset, scale_factor ? *scale_factor : 1, offset ? *offset : 0, _1, _2 ), threads ); }
         units::et from = units::metres; // quick and dirty: to avoid compilation warning
         units::et to = units::metres; // quick and dirty: to avoid compilation warning
         if( csv.fields.find( "/units" ) == std::string::npos )
@@ -543,7 +553,7 @@ int main( int ac, char** av )
             from = !options.exists( "--from" ) ? to : units::value( options.value< std::string >( "--from" ) );
         }
         if( !units::can_convert( from, to ) ) { std::cerr << "csv-units: don't know how to convert " << units::name(from) << " to " << units::name(to) << std::endl; return 1; }
-        return run( from, to );
+        return run( boost::bind( &convert, from, to, _1, _2, _3 ), threads );
     }
     catch( std::exception& ex ) { std::cerr << "csv-units: caught: " << ex.what() << std::endl; }
     catch( ... ) { std::cerr << "csv-units: unknown exception" << std::endl; }
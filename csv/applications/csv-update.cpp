@@ -29,7 +29,9 @@
 
 /// @author vsevolod vlaskine
 
+#include <stdio.h>
 #include <string.h>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <sstream>
@@ -38,14 +40,16 @@
 #include <boost/array.hpp>
 #include <boost/functional/hash.hpp>
 #include <boost/lexical_cast.hpp>
-#include <boost/unordered_map.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/graph/graph_concepts.hpp>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/types.h"
+#include "../../containers/flat_hash_map.h"
 #include "../../csv/stream.h"
 #include "../../csv/impl/unstructured.h"
 #include "../../io/stream.h"
+#include "../../packed/little_endian.h"
 #include "../../string/string.h"
 #include "../../visiting/traits.h"
 
@@ -106,6 +110,12 @@ static void usage( bool more )
     std::cerr << "        the type of reset values has to be correct: number for numeric fields, time for time fields, etc" << std::endl;
     std::cerr << "    --update-line,--line=[<line>]; a one-line update (see examples); a convenience option" << std::endl;
     std::cerr << "        does not output unmatched lines, i.e. behaves as if --matched-only specified" << std::endl;
+    std::cerr << "    --state=<filename>: keep state of updates of stdin by itself in the given file and resume from it on restart" << std::endl;
+    std::cerr << "        state is kept as a snapshot of the latest record for each id in <filename> and an append-only log of" << std::endl;
+    std::cerr << "        input records since the snapshot in <filename>.log; the log is compacted into the snapshot periodically and on exit" << std::endl;
+    std::cerr << "        the log is flushed on block change and on exit, i.e. after a crash the updates of the current block may be lost" << std::endl;
+    std::cerr << "        only for single stdin input, not with --last-block" << std::endl;
+    std::cerr << "    --state-compact=<n>: compact state log into snapshot after every <n> records; default: 1000000" << std::endl;
     std::cerr << "    --update-non-empty-fields,--update-non-empty,-u:" << std::endl;
     std::cerr << "        if update has empty fields, use the field value from stdin (for binary, empty fields must be defined with --empty)" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
@@ -144,6 +154,10 @@ static void usage( bool more )
         std::cerr << "        with updating values" << std::endl;
         std::cerr << "            ( echo 0,1,a,a; echo 0,1,,f; echo 0,2,,b1; echo 0,2,g1, ) | csv-update --fields=id,block --last-block --update-non-empty" << std::endl;
         std::cerr << std::endl;
+        std::cerr << "    keeping state across restarts" << std::endl;
+        std::cerr << "        cat today.csv | csv-update --fields=id -u --last --state=state.bin" << std::endl;
+        std::cerr << "        cat tomorrow.csv | csv-update --fields=id -u --last --state=state.bin" << std::endl;
+        std::cerr << std::endl;
         std::cerr << "    erasing values" << std::endl;
         std::cerr << "        echo -e 0,1,a,20140101T000000\\\\n0,-1,b,19000101T000000 | csv-update --fields=id -u --erase=,-1,,19000101T000000" << std::endl;
         std::cerr << "        0,1,a,20140101T000000" << std::endl;
@@ -182,7 +196,8 @@ struct map_t
         value_type() {}
         value_type( unsigned int index, const input_t& value, const std::string& string ) : index( index ), value( value ), string( string ) {}
     };
-    typedef boost::unordered_map< comma::csv::impl::unstructured, std::vector< value_type >, comma::csv::impl::unstructured::hash > type;
+    typedef comma::csv::impl::unstructured::packed key_type;
+    typedef comma::flat_hash_map< key_type, std::vector< value_type >, key_type::hash > type;
 };
 
 namespace comma { namespace visiting {
@@ -222,6 +237,109 @@ static map_t::type filter_map;
 static map_t::type unmatched;
 static map_t::type values;
 
+/// persistent state of updates: snapshot of the latest record for each key and append-only log
+/// of input records since the snapshot; file format: magic string followed by records, each as
+/// 32-bit little-endian size and record bytes (binary record or ascii line without line break)
+class state_store
+{
+    public:
+        state_store( const std::string& filename, unsigned int compact_every ) : filename_( filename ), compact_every_( compact_every ), count_( 0 ) {}
+
+        /// call f( record ) for each record in the snapshot, then in the log
+        template < typename F > void restore( F f )
+        {
+            unsigned int snapshot = read_( filename_, f );
+            unsigned int log = read_( filename_ + ".log", f );
+            if( verbose_ ) { std::cerr << "csv-update: restored " << snapshot << " record(s) from " << filename_ << " and " << log << " record(s) from " << filename_ << ".log" << std::endl; }
+        }
+
+        /// append record to log, return true, if it is time to compact
+        bool append( const std::string& record )
+        {
+            if( !log_.is_open() ) { open_log_( std::ios::app ); }
+            write_( log_, record );
+            return compact_every_ > 0 && ++count_ >= compact_every_;
+        }
+
+        /// write snapshot of given records and truncate log
+        void compact( const std::map< unsigned int, std::string >& records )
+        {
+            const std::string tmp = filename_ + ".tmp";
+            {
+                std::ofstream ofs( tmp.c_str(), std::ios::binary | std::ios::trunc );
+                if( !ofs.is_open() ) { COMMA_THROW( comma::exception, "failed to open \"" << tmp << "\"" ); }
+                ofs.write( magic_, sizeof( magic_ ) );
+                for( std::map< unsigned int, std::string >::const_iterator it = records.begin(); it != records.end(); ++it ) { write_( ofs, it->second ); }
+                ofs.flush();
+                if( !ofs.good() ) { COMMA_THROW( comma::exception, "failed to write \"" << tmp << "\"" ); }
+            }
+            if( ::rename( tmp.c_str(), filename_.c_str() ) != 0 ) { COMMA_THROW( comma::exception, "failed to rename \"" << tmp << "\" to \"" << filename_ << "\"" ); }
+            open_log_( std::ios::trunc );
+            count_ = 0;
+        }
+
+        /// flush log; called on block boundaries and on exit rather than per record
+        void flush() { if( log_.is_open() ) { log_.flush(); } }
+
+        static void verbose( bool v ) { verbose_ = v; }
+
+    private:
+        std::string filename_;
+        std::ofstream log_;
+        unsigned int compact_every_;
+        unsigned int count_;
+        static bool verbose_;
+        static const char magic_[16];
+
+        void open_log_( std::ios::openmode mode )
+        {
+            if( log_.is_open() ) { log_.close(); }
+            const std::string name = filename_ + ".log";
+            bool empty = mode & std::ios::trunc;
+            if( !empty ) { std::ifstream ifs( name.c_str(), std::ios::binary ); empty = !ifs.is_open() || ifs.peek() == std::ifstream::traits_type::eof(); }
+            log_.open( name.c_str(), std::ios::binary | std::ios::out | mode );
+            if( !log_.is_open() ) { COMMA_THROW( comma::exception, "failed to open \"" << name << "\"" ); }
+            if( empty ) { log_.write( magic_, sizeof( magic_ ) ); log_.flush(); }
+        }
+
+        static void write_( std::ostream& os, const std::string& record )
+        {
+            comma::packed::little_endian_uint32 size;
+            size = record.size();
+            os.write( size.data(), sizeof( comma::uint32 ) );
+            os.write( &record[0], record.size() );
+        }
+
+        template < typename F > static unsigned int read_( const std::string& name, F f ) // a truncated last record (e.g. after a crash) is ignored
+        {
+            std::ifstream ifs( name.c_str(), std::ios::binary );
+            if( !ifs.is_open() ) { return 0; }
+            char magic[ sizeof( magic_ ) ];
+            ifs.read( magic, sizeof( magic_ ) );
+            if( ifs.gcount() == 0 ) { return 0; }
+            if( ifs.gcount() != sizeof( magic_ ) || ::memcmp( magic, magic_, sizeof( magic_ ) ) != 0 ) { COMMA_THROW( comma::exception, "\"" << name << "\" is not a csv-update state file" ); }
+            unsigned int count = 0;
+            std::string record;
+            while( true )
+            {
+                comma::packed::little_endian_uint32 size;
+                ifs.read( size.data(), sizeof( comma::uint32 ) );
+                if( ifs.gcount() != sizeof( comma::uint32 ) ) { break; }
+                record.resize( size() );
+                ifs.read( &record[0], record.size() );
+                if( std::size_t( ifs.gcount() ) != record.size() ) { break; }
+                f( record );
+                ++count;
+            }
+            return count;
+        }
+};
+
+bool state_store::verbose_ = false;
+const char state_store::magic_[16] = { 'c', 's', 'v', '-', 'u', 'p', 'd', 'a', 't', 'e', '-', 's', 't', 'a', 't', 'e' };
+
+static boost::scoped_ptr< state_store > state;
+
 static void output_unmatched_all()
 {
     if( matched_only || !filter_transport ) { return; }
@@ -271,6 +389,7 @@ static void read_filter_block()
     if( !last ) { return; }
     block = last->block;
     filter_map.clear();
+    map_t::key_type key;
     unsigned int count = 0;
     while( last->block == block )
     {
@@ -280,7 +399,7 @@ static void read_filter_block()
             if( csv.binary() ) { s.resize( csv.format().size() ); ::memcpy( &s[0], filter_stream->binary().last(), csv.format().size() ); }
             else { s = comma::join( filter_stream->ascii().last(), csv.delimiter ) + '\n'; }
         }
-        filter_map[ last->key ].push_back( map_t::value_type( count++, *last, s ) );
+        filter_map[ key.assign( last->key ) ].push_back( map_t::value_type( count++, *last, s ) );
         //if( d.size() > 1 ) {}
         if( verbose ) { if( count % 10000 == 0 ) { std::cerr << "csv-update: reading block " << block << "; loaded " << count << " point[s]; hash map size: " << filter_map.size() << std::endl; } }
         last = filter_stream->read();
@@ -314,15 +433,69 @@ static void update( comma::csv::impl::unstructured& value, const comma::csv::imp
     update( value.time, value_update.time, empty.time, erase ? erase->time : dummy.time );
 }
 
+static unsigned int update_index = 0;
+
+/// update values by stdin itself; no output, if ostream is null (e.g. when restoring state)
+static void update_values( const input_t& v, const map_t::key_type& key, const std::string& s, comma::csv::output_stream< input_t >* ostream )
+{
+    if( v.block != block )
+    {
+        if( state ) { state->flush(); }
+        output_and_clear( values, last_only && ostream, ostream );
+    }
+    block = v.block;
+    map_t::type::iterator it = values.find( key );
+    if( it == values.end() )
+    {
+        values[ key ].push_back( map_t::value_type( update_index++, v, s ) );
+        if( !last_only && ostream ) { ostream->write( v, s ); }
+    }
+    else
+    {
+        update( it->second[0].value.value, v.value, update_non_empty );
+        it->second[0].index = update_index++;
+        it->second[0].string = s;
+        if( !last_only && ostream ) { ostream->write( it->second[0].value, s ); }
+    }
+}
+
+static void restore_record( const std::string& record )
+{
+    static boost::scoped_ptr< comma::csv::ascii< input_t > > ascii( csv.binary() ? NULL : new comma::csv::ascii< input_t >( csv, default_input ) );
+    static boost::scoped_ptr< comma::csv::binary< input_t > > binary( csv.binary() ? new comma::csv::binary< input_t >( csv, default_input ) : NULL );
+    static map_t::key_type key;
+    input_t v = default_input;
+    if( binary ) { binary->get( v, &record[0] ); } else { ascii->get( v, record ); }
+    update_values( v, key.assign( v.key ), record, NULL );
+}
+
+static void compact_state()
+{
+    static boost::scoped_ptr< comma::csv::ascii< input_t > > ascii( csv.binary() ? NULL : new comma::csv::ascii< input_t >( csv, default_input ) );
+    static boost::scoped_ptr< comma::csv::binary< input_t > > binary( csv.binary() ? new comma::csv::binary< input_t >( csv, default_input ) : NULL );
+    std::map< unsigned int, std::string > records; // records with updated values in the order of updates
+    for( map_t::type::const_iterator it = values.begin(); it != values.end(); ++it )
+    {
+        for( std::size_t i = 0; i < it->second.size(); ++i )
+        {
+            std::string& r = records[ it->second[i].index ];
+            r = it->second[i].string;
+            if( binary ) { binary->put( it->second[i].value, &r[0] ); } else { ascii->put( it->second[i].value, r ); }
+        }
+    }
+    state->compact( records );
+}
+
 static void update( const input_t& v, const comma::csv::input_stream< input_t >& istream, comma::csv::output_stream< input_t >& ostream, const std::string& last = std::string() )
 {
-    static unsigned int index = 0;
+    static map_t::key_type key;
+    key.assign( v.key );
     if( last_block ) 
     {
         std::string s;
         if( csv.binary() ) { s.resize( csv.format().size() ); ::memcpy( &s[0], istream.binary().last(), csv.format().size() ); }
         else { s = last.empty() ? comma::join( istream.ascii().last(), csv.delimiter ) : last; }
-        std::vector< map_t::value_type >& e = values[ v.key ];
+        std::vector< map_t::value_type >& e = values[ key ];
         
         input_t current = v;
         if( !e.empty() ) 
@@ -332,11 +505,11 @@ static void update( const input_t& v, const comma::csv::input_stream< input_t >&
             if( e.front().value.block != v.block ) {  e.clear();  } 
             current.value = prev;
         }
-        e.push_back( map_t::value_type( index++, current, s ) );
+        e.push_back( map_t::value_type( update_index++, current, s ) );
     }
     else if( has_filter )
     {
-        map_t::type::const_iterator it = filter_map.find( v.key );
+        map_t::type::const_iterator it = filter_map.find( key );
         if( it == filter_map.end() || it->second.empty() )
         {
             if( last.empty() ) { output_last( istream ); }
@@ -350,36 +523,18 @@ static void update( const input_t& v, const comma::csv::input_stream< input_t >&
             if( last.empty() ) { ostream.write( current, istream ); }
             else { ostream.write( current, last ); }
         }
-        unmatched.erase( it->first );
+        unmatched.erase( key );
     }
     else
     {
-        if( v.block != block ) { output_and_clear( values, last_only, &ostream ); }
-        block = v.block;
-        if( last.empty() )
+        std::string s = last;
+        if( s.empty() )
         {
-            std::string s;
             if( csv.binary() ) { s.resize( csv.format().size() ); ::memcpy( &s[0], istream.binary().last(), csv.format().size() ); }
             else { s = comma::join( istream.ascii().last(), csv.delimiter ); }
-            map_t::type::iterator it = values.find( v.key );
-            if( it == values.end() )
-            {
-                values[ v.key ].push_back( map_t::value_type( index++, v, s ) );
-                if( !last_only ) { ostream.write( v, s ); }
-            }
-            else
-            {
-                update( it->second[0].value.value, v.value, update_non_empty );
-                it->second[0].index = index++;
-                it->second[0].string = s;
-                if( !last_only ) { ostream.write( it->second[0].value, s ); }
-            }
-        }
-        else
-        {
-            values[ v.key ].push_back( map_t::value_type( index++, v, last ) );
-            if( !last_only ) { ostream.write( v, last ); }
         }
+        update_values( v, key, s, &ostream );
+        if( state && state->append( s ) ) { compact_state(); }
     }
 }
 
@@ -404,6 +559,13 @@ int main( int ac, char** av )
         if( !unnamed.empty() ) { filter_transport.reset( new comma::io::istream( unnamed[0], options.exists( "--binary,-b" ) ? comma::io::mode::binary : comma::io::mode::ascii ) ); }
         filter_line = options.value< std::string >( "--update-line,--line", "" );
         has_filter = filter_transport || !filter_line.empty();
+        if( options.exists( "--state" ) )
+        {
+            if( has_filter ) { std::cerr << "csv-update: --state supported only for single stdin input" << std::endl; return 1; }
+            if( last_block ) { std::cerr << "csv-update: --state not supported with --last-block" << std::endl; return 1; }
+            state_store::verbose( verbose );
+            state.reset( new state_store( options.value< std::string >( "--state" ), options.value< unsigned int >( "--state-compact", 1000000 ) ) );
+        }
         matched_only = options.exists( "--matched-only,--matched,-m" ) || !filter_line.empty();
         std::vector< std::string > v = comma::split( csv.fields, ',' );
         bool has_value_fields = false;
@@ -466,6 +628,7 @@ int main( int ac, char** av )
             erase = ( isstream.read() )->value;
         }
         read_filter_block();
+        if( state ) { state->restore( &restore_record ); compact_state(); }
         if( !first_line.empty() ) { update( comma::csv::ascii< input_t >( csv, default_input ).get( first_line ), istream, ostream, first_line ); }
         while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
         {
@@ -475,7 +638,11 @@ int main( int ac, char** av )
             update( *p, istream, ostream );
         }
         if( has_filter ) { output_and_clear( unmatched, !matched_only ); }
-        else { output_and_clear( values, last_only || last_block, &ostream ); }
+        else
+        {
+            if( state ) { compact_state(); }
+            output_and_clear( values, last_only || last_block, &ostream );
+        }
         return 0;
     }
     catch( std::exception& ex ) { std::cerr << "csv-update: " << ex.what() << std::endl; }
@@ -0,0 +1,397 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "../base/exception.h"
+#include "columnar.h"
+
+namespace comma { namespace csv { namespace columnar {
+
+static const char magic[] = "COMMACOL";
+static const std::size_t magic_size = 8;
+static const comma::uint32 version = 1;
+static const std::size_t header_size = magic_size + 2 * sizeof( comma::uint32 );
+
+template < typename T > static T load( const char* p ) { T t; ::memcpy( &t, p, sizeof( T ) ); return t; }
+template < typename T > static void store( const T& t, char* p ) { ::memcpy( p, &t, sizeof( T ) ); }
+
+template < typename T > static void write_value( std::ostream& os, const T& t ) { os.write( reinterpret_cast< const char* >( &t ), sizeof( T ) ); }
+static void write_string( std::ostream& os, const std::string& s ) { write_value( os, comma::uint32( s.size() ) ); os.write( &s[0], s.size() ); }
+
+template < typename T > static T read_value( std::istream& is )
+{
+    T t;
+    is.read( reinterpret_cast< char* >( &t ), sizeof( T ) );
+    if( is.gcount() != sizeof( T ) ) { COMMA_THROW( comma::exception, "columnar: unexpected end of file" ); }
+    return t;
+}
+
+static std::string read_string( std::istream& is )
+{
+    std::string s( read_value< comma::uint32 >( is ), 0 );
+    if( s.empty() ) { return s; }
+    is.read( &s[0], s.size() );
+    if( is.gcount() != std::streamsize( s.size() ) ) { COMMA_THROW( comma::exception, "columnar: unexpected end of file" ); }
+    return s;
+}
+
+template < typename T > struct column_traits // integers
+{
+    static void extents( const char* values, std::size_t count, char* min, char* max )
+    {
+        T lo = load< T >( values );
+        T hi = lo;
+        for( std::size_t i = 1; i < count; ++i ) { T t = load< T >( values + i * sizeof( T ) ); if( t < lo ) { lo = t; } if( hi < t ) { hi = t; } }
+        store( lo, min );
+        store( hi, max );
+    }
+};
+
+template < typename T > struct floating_point_traits
+{
+    static void extents( const char* values, std::size_t count, char* min, char* max )
+    {
+        T lo = std::numeric_limits< T >::infinity();
+        T hi = -std::numeric_limits< T >::infinity();
+        for( std::size_t i = 0; i < count; ++i )
+        {
+            T t = load< T >( values + i * sizeof( T ) );
+            if( std::isnan( t ) ) { lo = -std::numeric_limits< T >::infinity(); hi = std::numeric_limits< T >::infinity(); break; }
+            if( t < lo ) { lo = t; }
+            if( hi < t ) { hi = t; }
+        }
+        store( lo, min );
+        store( hi, max );
+    }
+};
+
+template <> struct column_traits< float > : public floating_point_traits< float > {};
+template <> struct column_traits< double > : public floating_point_traits< double > {};
+
+struct time_traits // as in format.cpp: microseconds since epoch, lowest values reserved for not-a-date-time and -infinity, highest for +infinity
+{
+    static void extents( const char* values, std::size_t count, std::size_t size, char* min, char* max )
+    {
+        static const comma::int64 not_a_date_time = std::numeric_limits< comma::int64 >::min();
+        static const comma::int64 neg_infin = std::numeric_limits< comma::int64 >::min() + 1;
+        static const comma::int64 pos_infin = std::numeric_limits< comma::int64 >::max();
+        const char* lo = values;
+        const char* hi = values;
+        for( std::size_t i = 0; i < count; ++i )
+        {
+            const char* p = values + i * size;
+            comma::int64 t = load< comma::int64 >( p );
+            if( t == not_a_date_time || t == neg_infin || t == pos_infin )
+            {
+                ::memset( min, 0, size );
+                ::memset( max, 0, size );
+                store( neg_infin, min );
+                store( pos_infin, max );
+                return;
+            }
+            if( less_( p, lo, size ) ) { lo = p; }
+            if( less_( hi, p, size ) ) { hi = p; }
+        }
+        ::memcpy( min, lo, size );
+        ::memcpy( max, hi, size );
+    }
+
+    static bool less_( const char* lhs, const char* rhs, std::size_t size ) // size 12: long time, nanoseconds follow seconds
+    {
+        comma::int64 l = load< comma::int64 >( lhs );
+        comma::int64 r = load< comma::int64 >( rhs );
+        return l < r || ( l == r && size > sizeof( comma::int64 ) && load< comma::int32 >( lhs + sizeof( comma::int64 ) ) < load< comma::int32 >( rhs + sizeof( comma::int64 ) ) );
+    }
+};
+
+static void string_extents( const char* values, std::size_t count, std::size_t size, char* min, char* max ) // zero-padded, thus memcmp order is string order
+{
+    const char* lo = values;
+    const char* hi = values;
+    for( std::size_t i = 1; i < count; ++i )
+    {
+        const char* p = values + i * size;
+        if( ::memcmp( p, lo, size ) < 0 ) { lo = p; }
+        if( ::memcmp( hi, p, size ) < 0 ) { hi = p; }
+    }
+    ::memcpy( min, lo, size );
+    ::memcpy( max, hi, size );
+}
+
+static void extents( const comma::csv::format::element& e, const char* values, std::size_t count, char* min, char* max )
+{
+    switch( e.type )
+    {
+        case comma::csv::format::char_t:
+        case comma::csv::format::int8: column_traits< signed char >::extents( values, count, min, max ); break;
+        case comma::csv::format::uint8: column_traits< unsigned char >::extents( values, count, min, max ); break;
+        case comma::csv::format::int16: column_traits< comma::int16 >::extents( values, count, min, max ); break;
+        case comma::csv::format::uint16: column_traits< comma::uint16 >::extents( values, count, min, max ); break;
+        case comma::csv::format::int32: column_traits< comma::int32 >::extents( values, count, min, max ); break;
+        case comma::csv::format::uint32: column_traits< comma::uint32 >::extents( values, count, min, max ); break;
+        case comma::csv::format::int64: column_traits< comma::int64 >::extents( values, count, min, max ); break;
+        case comma::csv::format::uint64: column_traits< comma::uint64 >::extents( values, count, min, max ); break;
+        case comma::csv::format::float_t: column_traits< float >::extents( values, count, min, max ); break;
+        case comma::csv::format::double_t: column_traits< double >::extents( values, count, min, max ); break;
+        case comma::csv::format::time:
+        case comma::csv::format::long_time: time_traits::extents( values, count, e.size, min, max ); break;
+        case comma::csv::format::fixed_string: string_extents( values, count, e.size, min, max ); break;
+    }
+}
+
+bool bounded( const comma::csv::format& format, const block& b, std::size_t column )
+{
+    comma::csv::format::element e = format.offset( column );
+    const char* min = &b.min[ e.offset ];
+    const char* max = &b.max[ e.offset ];
+    switch( e.type )
+    {
+        case comma::csv::format::float_t: return !std::isinf( load< float >( min ) ) && !std::isinf( load< float >( max ) );
+        case comma::csv::format::double_t: return !std::isinf( load< double >( min ) ) && !std::isinf( load< double >( max ) );
+        case comma::csv::format::time:
+        case comma::csv::format::long_time: return load< comma::int64 >( min ) > std::numeric_limits< comma::int64 >::min() + 1 && load< comma::int64 >( max ) < std::numeric_limits< comma::int64 >::max();
+        default: return true;
+    }
+}
+
+writer::writer( std::ostream& os, const comma::csv::format& format, const std::string& fields, std::size_t block_size )
+    : os_( os )
+    , format_( format.expanded_string() )
+    , fields_( fields )
+    , block_size_( block_size )
+    , count_( 0 )
+    , offset_( header_size )
+    , closed_( false )
+{
+    if( format_.size() == 0 ) { COMMA_THROW( comma::exception, "columnar: expected format, got empty format" ); }
+    if( block_size_ == 0 ) { COMMA_THROW( comma::exception, "columnar: expected positive block size" ); }
+    records_.resize( block_size_ * format_.size() );
+    column_.resize( block_size_ * format_.size() );
+    os_.write( magic, magic_size );
+    write_value( os_, version );
+    write_value( os_, comma::uint32( 0 ) );
+}
+
+writer::~writer() { if( !closed_ ) { try { close(); } catch( ... ) {} } }
+
+void writer::write( const char* record )
+{
+    ::memcpy( &records_[ count_ * format_.size() ], record, format_.size() );
+    if( ++count_ == block_size_ ) { flush_(); }
+}
+
+void writer::write( const char* records, std::size_t count )
+{
+    while( count > 0 )
+    {
+        std::size_t n = std::min( count, block_size_ - count_ );
+        ::memcpy( &records_[ count_ * format_.size() ], records, n * format_.size() );
+        count_ += n;
+        records += n * format_.size();
+        count -= n;
+        if( count_ == block_size_ ) { flush_(); }
+    }
+}
+
+void writer::flush_()
+{
+    if( count_ == 0 ) { return; }
+    block b;
+    b.offset = offset_;
+    b.size = count_;
+    b.min.resize( format_.size() );
+    b.max.resize( format_.size() );
+    std::size_t size = format_.size();
+    for( std::size_t i = 0; i < format_.count(); ++i )
+    {
+        comma::csv::format::element e = format_.offset( i );
+        char* column = &column_[ count_ * e.offset ];
+        const char* p = &records_[ e.offset ];
+        switch( e.size ) // transpose
+        {
+            case 4: for( std::size_t j = 0; j < count_; ++j, p += size ) { ::memcpy( column + j * 4, p, 4 ); } break;
+            case 8: for( std::size_t j = 0; j < count_; ++j, p += size ) { ::memcpy( column + j * 8, p, 8 ); } break;
+            default: for( std::size_t j = 0; j < count_; ++j, p += size ) { ::memcpy( column + j * e.size, p, e.size ); } break;
+        }
+        extents( e, column, count_, &b.min[ e.offset ], &b.max[ e.offset ] );
+    }
+    os_.write( &column_[0], count_ * size );
+    if( !os_.good() ) { COMMA_THROW( comma::exception, "columnar: failed to write block" ); }
+    offset_ += count_ * size;
+    blocks_.push_back( b );
+    count_ = 0;
+}
+
+void writer::close()
+{
+    if( closed_ ) { return; }
+    closed_ = true;
+    flush_();
+    write_string( os_, format_.string() );
+    write_string( os_, fields_ );
+    write_value( os_, comma::uint64( blocks_.size() ) );
+    for( std::size_t i = 0; i < blocks_.size(); ++i )
+    {
+        write_value( os_, blocks_[i].offset );
+        write_value( os_, blocks_[i].size );
+        os_.write( &blocks_[i].min[0], format_.size() );
+        os_.write( &blocks_[i].max[0], format_.size() );
+    }
+    write_value( os_, offset_ );
+    os_.write( magic, magic_size );
+    os_.flush();
+    if( !os_.good() ) { COMMA_THROW( comma::exception, "columnar: failed to write footer" ); }
+}
+
+reader::reader( const std::string& filename ) : file_( filename.c_str(), std::ios::binary )
+{
+    if( !file_.is_open() ) { COMMA_THROW( comma::exception, "columnar: failed to open \"" << filename << "\"" ); }
+    char m[ magic_size ];
+    file_.read( m, magic_size );
+    if( file_.gcount() != std::streamsize( magic_size ) || ::memcmp( m, magic, magic_size ) != 0 ) { COMMA_THROW( comma::exception, "columnar: \"" << filename << "\" is not a columnar file" ); }
+    comma::uint32 v = read_value< comma::uint32 >( file_ );
+    if( v != version ) { COMMA_THROW( comma::exception, "columnar: expected version " << version << ", got " << v << " in \"" << filename << "\"" ); }
+    file_.seekg( -std::streamoff( sizeof( comma::uint64 ) + magic_size ), std::ios::end );
+    comma::uint64 footer = read_value< comma::uint64 >( file_ );
+    file_.read( m, magic_size );
+    if( file_.gcount() != std::streamsize( magic_size ) || ::memcmp( m, magic, magic_size ) != 0 ) { COMMA_THROW( comma::exception, "columnar: \"" << filename << "\" is truncated or not closed properly" ); }
+    file_.seekg( footer );
+    format_ = comma::csv::format( read_string( file_ ) );
+    fields_ = read_string( file_ );
+    blocks_.resize( read_value< comma::uint64 >( file_ ) );
+    for( std::size_t i = 0; i < blocks_.size(); ++i )
+    {
+        blocks_[i].offset = read_value< comma::uint64 >( file_ );
+        blocks_[i].size = read_value< comma::uint32 >( file_ );
+        blocks_[i].min.resize( format_.size() );
+        blocks_[i].max.resize( format_.size() );
+        file_.read( &blocks_[i].min[0], format_.size() );
+        file_.read( &blocks_[i].max[0], format_.size() );
+    }
+    if( !file_.good() ) { COMMA_THROW( comma::exception, "columnar: failed to read footer of \"" << filename << "\"" ); }
+}
+
+comma::uint64 reader::size() const
+{
+    comma::uint64 size = 0;
+    for( std::size_t i = 0; i < blocks_.size(); ++i ) { size += blocks_[i].size; }
+    return size;
+}
+
+void reader::read( std::size_t index, char* buf, const std::vector< std::size_t >& columns )
+{
+    const block& b = blocks_.at( index );
+    std::size_t size = format_.size();
+    if( columns.empty() )
+    {
+        column_.resize( b.size * size );
+        file_.seekg( b.offset );
+        file_.read( &column_[0], b.size * size );
+        if( file_.gcount() != std::streamsize( b.size * size ) ) { COMMA_THROW( comma::exception, "columnar: unexpected end of file in block " << index ); }
+    }
+    else
+    {
+        column_.resize( b.size * size );
+        ::memset( buf, 0, b.size * size );
+    }
+    for( std::size_t k = 0; k < ( columns.empty() ? format_.count() : columns.size() ); ++k )
+    {
+        comma::csv::format::element e = format_.offset( columns.empty() ? k : columns[k] );
+        char* column = &column_[ b.size * e.offset ];
+        if( !columns.empty() )
+        {
+            file_.seekg( b.offset + b.size * e.offset );
+            file_.read( column, b.size * e.size );
+            if( file_.gcount() != std::streamsize( b.size * e.size ) ) { COMMA_THROW( comma::exception, "columnar: unexpected end of file in block " << index ); }
+        }
+        char* p = buf + e.offset;
+        switch( e.size )
+        {
+            case 4: for( std::size_t j = 0; j < b.size; ++j, p += size ) { ::memcpy( p, column + j * 4, 4 ); } break;
+            case 8: for( std::size_t j = 0; j < b.size; ++j, p += size ) { ::memcpy( p, column + j * 8, 8 ); } break;
+            default: for( std::size_t j = 0; j < b.size; ++j, p += size ) { ::memcpy( p, column + j * e.size, e.size ); } break;
+        }
+    }
+}
+
+class istream::streambuf : public std::streambuf
+{
+    public:
+        streambuf( columnar::reader& reader, const std::vector< std::size_t >& columns, const istream::filter_type& filter )
+            : reader_( reader ), columns_( columns ), filter_( filter ), block_( 0 ), skipped_( 0 )
+        {
+            std::size_t size = 0;
+            for( std::size_t i = 0; i < reader_.blocks().size(); ++i ) { size = std::max( size, std::size_t( reader_.blocks()[i].size ) ); }
+            buffer_.resize( size * reader_.format().size() );
+            setg( NULL, NULL, NULL );
+        }
+
+        std::size_t skipped() const { return skipped_; }
+
+    protected:
+        int_type underflow()
+        {
+            if( gptr() < egptr() ) { return traits_type::to_int_type( *gptr() ); }
+            for( ; block_ < reader_.blocks().size(); ++block_ )
+            {
+                const block& b = reader_.blocks()[ block_ ];
+                if( filter_ && !filter_( b ) ) { ++skipped_; continue; }
+                reader_.read( block_++, &buffer_[0], columns_ );
+                setg( &buffer_[0], &buffer_[0], &buffer_[0] + b.size * reader_.format().size() );
+                return traits_type::to_int_type( *gptr() );
+            }
+            return traits_type::eof();
+        }
+
+    private:
+        columnar::reader& reader_;
+        std::vector< std::size_t > columns_;
+        istream::filter_type filter_;
+        std::size_t block_;
+        std::size_t skipped_;
+        std::vector< char > buffer_;
+};
+
+istream::istream( const std::string& filename, const std::vector< std::size_t >& columns, const filter_type& filter )
+    : std::istream( NULL )
+    , reader_( filename )
+{
+    for( std::size_t i = 0; i < columns.size(); ++i ) { if( columns[i] >= reader_.format().count() ) { COMMA_THROW( comma::exception, "columnar: expected column index less than " << reader_.format().count() << ", got " << columns[i] ); } }
+    buf_.reset( new streambuf( reader_, columns, filter ) );
+    rdbuf( buf_.get() );
+}
+
+istream::~istream() {}
+
+std::size_t istream::skipped() const { return buf_->skipped(); }
+
+} } } // namespace comma { namespace csv { namespace columnar {
@@ -0,0 +1,173 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_CSV_COLUMNAR_H_
+#define COMMA_CSV_COLUMNAR_H_
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include "../base/types.h"
+#include "format.h"
+
+namespace comma { namespace csv { namespace columnar {
+
+/// columnar file: records of a given binary format stored in blocks, column by column,
+/// with per-block minimum and maximum of each column, so that readers can load only
+/// the columns they need and skip blocks that cannot contain records of interest
+///
+/// a column is an element of the expanded format, e.g. for format 2d,ui there are
+/// three columns: d, d, ui
+///
+/// layout:
+///     header: magic (8 bytes: "COMMACOL"), version (ui), reserved (ui)
+///     blocks: for each column, values of that column for all records of the block;
+///             thus, column i of a block of n records starts at n * format.offset( i ).offset
+///     footer: format string, fields, number of blocks, and for each block:
+///             offset in file, number of records, min record, max record,
+///             where min and max records are in the binary format of the file
+///     trailer: footer offset (ul), magic
+///
+/// statistics are conservative: a column of a block containing nan or
+/// special time values (e.g. not-a-date-time) gets -infinity and +infinity
+/// as minimum and maximum
+///
+/// all the numbers are in the host byte order, as in comma binary format
+
+/// block description
+struct block
+{
+    comma::uint64 offset; /// offset in file
+    comma::uint32 size; /// number of records
+    std::vector< char > min; /// minimum of each column as a binary record
+    std::vector< char > max; /// maximum of each column as a binary record
+
+    block() : offset( 0 ), size( 0 ) {}
+};
+
+/// return true, if block minimum and maximum of given column are actual values of the column
+/// rather than conservative infinities (i.e. for floating point and time columns: both are finite)
+bool bounded( const comma::csv::format& format, const block& b, std::size_t column );
+
+/// columnar file writer
+class writer
+{
+    public:
+        /// constructor; stream has to be binary and stay valid until close()
+        writer( std::ostream& os, const comma::csv::format& format, const std::string& fields = "", std::size_t block_size = 65536 );
+
+        /// destructor, closes writer, if not closed
+        ~writer();
+
+        /// write a record
+        void write( const char* record );
+
+        /// write a number of records
+        void write( const char* records, std::size_t count );
+
+        /// flush last block and write footer
+        void close();
+
+        const comma::csv::format& format() const { return format_; }
+
+    private:
+        std::ostream& os_;
+        comma::csv::format format_;
+        std::string fields_;
+        std::size_t block_size_;
+        std::vector< char > records_;
+        std::size_t count_;
+        comma::uint64 offset_;
+        std::vector< block > blocks_;
+        std::vector< char > column_;
+        bool closed_;
+        void flush_();
+};
+
+/// columnar file reader
+class reader
+{
+    public:
+        /// constructor, reads footer
+        reader( const std::string& filename );
+
+        const comma::csv::format& format() const { return format_; }
+
+        /// fields as stored in the file, may be empty
+        const std::string& fields() const { return fields_; }
+
+        const std::vector< block >& blocks() const { return blocks_; }
+
+        /// total number of records
+        comma::uint64 size() const;
+
+        /// read given block as binary records into buf of at least block size * format size;
+        /// read only given columns (indices into expanded format), all columns, if empty;
+        /// columns that are not read are filled with zeroes
+        void read( std::size_t block, char* buf, const std::vector< std::size_t >& columns = std::vector< std::size_t >() );
+
+    private:
+        std::ifstream file_;
+        comma::csv::format format_;
+        std::string fields_;
+        std::vector< block > blocks_;
+        std::vector< char > column_;
+};
+
+/// row-oriented view of a columnar file: reads like a stream of binary records
+/// in the file format, thus can be used e.g. with csv::input_stream
+class istream : public std::istream
+{
+    public:
+        /// block filter: return false to skip the block without reading it
+        typedef boost::function< bool( const block& ) > filter_type;
+
+        /// constructor; columns: indices into expanded format of the columns to read;
+        /// other columns are filled with zeroes; read all columns, if empty
+        istream( const std::string& filename, const std::vector< std::size_t >& columns = std::vector< std::size_t >(), const filter_type& filter = filter_type() );
+
+        ~istream();
+
+        const columnar::reader& reader() const { return reader_; }
+
+        /// number of skipped blocks so far
+        std::size_t skipped() const;
+
+    private:
+        class streambuf;
+        columnar::reader reader_;
+        boost::scoped_ptr< streambuf > buf_;
+};
+
+} } } // namespace comma { namespace csv { namespace columnar {
+
+#endif // COMMA_CSV_COLUMNAR_H_
@@ -42,6 +42,7 @@
 #include "../string/string.h"
 #include "../csv/format.h"
 #include "impl/epoch.h"
+#include "impl/iso_time.h"
 
 namespace comma { namespace csv {
 
@@ -226,6 +227,8 @@ static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, const b
 
 static boost::posix_time::ptime time_from_iso_string( const std::string& s )
 {
+    boost::posix_time::ptime t;
+    if( impl::from_iso_basic_string( &s[0], s.size(), t ) ) { return t; }
     if ( s.empty() || s == "not-a-date-time" ) { return boost::posix_time::not_a_date_time; }
     else if ( s == "+infinity" || s == "+inf" || s == "inf" ) { return boost::posix_time::pos_infin; }
     else if ( s == "-infinity" || s == "-inf" ) { return boost::posix_time::neg_infin; }
@@ -320,11 +323,17 @@ static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, format:
         case format::float_t: return bin_to_csv< float >( oss, buf, precision );
         case format::double_t: return bin_to_csv< double >( oss, buf, precision );
         case format::time:
-            oss << boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::time >::from_bin( buf, sizeof( comma::uint64 ) ) );
+        {
+            char t[32];
+            oss.write( t, impl::to_iso_basic_string( format::traits< boost::posix_time::ptime, format::time >::from_bin( buf, sizeof( comma::uint64 ) ), t ) );
             return format::traits< boost::posix_time::ptime, format::time >::size;
+        }
         case format::long_time:
-            oss << boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf, sizeof( comma::uint64 ) + sizeof( comma::uint32 ) ) );
+        {
+            char t[32];
+            oss.write( t, impl::to_iso_basic_string( format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf, sizeof( comma::uint64 ) + sizeof( comma::uint32 ) ), t ) );
             return format::traits< boost::posix_time::ptime, format::long_time >::size;
+        }
         case format::fixed_string:
             oss << ( buf[ size - 1 ] == 0 ? std::string( buf ) : std::string( buf, size ) );
             return size;
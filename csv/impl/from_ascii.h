@@ -45,6 +45,7 @@
 #include "../../string/string.h"
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
+#include "iso_time.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -86,7 +87,7 @@ class from_ascii_
         static void lexical_cast_( unsigned char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< unsigned char >( boost::lexical_cast< unsigned int >( s ) ); }
         static void lexical_cast_( boost::posix_time::ptime& v, const std::string& s )
         { 
-            if( s.empty() ) { return; }
+            if( s.empty() || from_iso_basic_string( &s[0], s.size(), v ) ) { return; }
             try
             { 
                 v = boost::posix_time::from_iso_string( s );
@@ -0,0 +1,302 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_CSV_IMPL_ISO_TIME_H_
+#define COMMA_CSV_IMPL_ISO_TIME_H_
+
+#include <string>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../../base/types.h"
+#include "epoch.h"
+
+/// hand-written parsers and formatters for the time representations used in csv
+/// (iso 8601 basic and extended, sql, seconds since epoch)
+///
+/// parsers do not throw, use no locale and do not allocate; they return false,
+/// if the string is not in the canonical form they understand, in which case
+/// the caller is expected to fall back to boost::posix_time parsing, which
+/// accepts more exotic forms and reports errors
+///
+/// only years 1400 to 9999 are supported, as in boost::gregorian
+
+namespace comma { namespace csv { namespace impl {
+
+namespace iso_time_detail {
+
+inline bool digits( const char* s, unsigned int n, int& v )
+{
+    v = 0;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        unsigned int d = static_cast< unsigned char >( s[i] ) - '0';
+        if( d > 9 ) { return false; }
+        v = v * 10 + d;
+    }
+    return true;
+}
+
+inline bool leap( int year ) { return ( year % 4 == 0 && year % 100 != 0 ) || year % 400 == 0; }
+
+inline int days_in_month( int year, int month )
+{
+    static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return month == 2 && leap( year ) ? 29 : days[ month - 1 ];
+}
+
+/// days since 1970-01-01 for given date in proleptic gregorian calendar
+inline comma::int64 days_from_civil( int y, int m, int d )
+{
+    y -= m <= 2;
+    const comma::int64 era = ( y >= 0 ? y : y - 399 ) / 400;
+    const comma::int64 yoe = y - era * 400;
+    const comma::int64 doy = ( 153 * ( m + ( m > 2 ? -3 : 9 ) ) + 2 ) / 5 + d - 1;
+    const comma::int64 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/// date for given days since 1970-01-01
+inline void civil_from_days( comma::int64 z, int& y, int& m, int& d )
+{
+    z += 719468;
+    const comma::int64 era = ( z >= 0 ? z : z - 146096 ) / 146097;
+    const comma::int64 doe = z - era * 146097;
+    const comma::int64 yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365;
+    const comma::int64 doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );
+    const comma::int64 mp = ( 5 * doy + 2 ) / 153;
+    d = int( doy - ( 153 * mp + 2 ) / 5 + 1 );
+    m = int( mp < 10 ? mp + 3 : mp - 9 );
+    y = int( yoe + era * 400 + ( m <= 2 ) );
+}
+
+/// parse optional fractional seconds as microseconds (digits beyond microseconds are truncated)
+inline bool fractions( const char*& s, const char* end, comma::int64& microseconds )
+{
+    microseconds = 0;
+    if( s == end || ( *s != '.' && *s != ',' ) ) { return true; }
+    ++s;
+    if( s == end ) { return false; }
+    comma::int64 scale = 100000;
+    const char* begin = s;
+    for( ; s != end; ++s )
+    {
+        unsigned int d = static_cast< unsigned char >( *s ) - '0';
+        if( d > 9 ) { break; }
+        microseconds += d * scale;
+        scale /= 10;
+    }
+    return s != begin;
+}
+
+inline bool make( int year, int month, int day, int hours, int minutes, int seconds, comma::int64 microseconds, comma::int64 offset, boost::posix_time::ptime& t )
+{
+    if( year < 1400 || month < 1 || month > 12 || day < 1 || day > days_in_month( year, month ) || hours > 23 || minutes > 59 || seconds > 59 ) { return false; }
+    const comma::int64 s = days_from_civil( year, month, day ) * 86400 + hours * 3600 + minutes * 60 + seconds - offset;
+    t = boost::posix_time::ptime( epoch, boost::posix_time::microseconds( s * 1000000 + microseconds ) );
+    return true;
+}
+
+inline char* put( char* p, int v, unsigned int n ) { for( char* q = p + n; q != p; v /= 10 ) { *--q = '0' + v % 10; } return p + n; }
+
+inline bool special( const boost::posix_time::ptime& t, char* buf, std::size_t& size )
+{
+    if( !t.is_special() ) { return false; }
+    static const char* not_a_date_time = "not-a-date-time";
+    const char* s = t.is_pos_infinity() ? "+infinity" : t.is_neg_infinity() ? "-infinity" : not_a_date_time;
+    for( size = 0; s[size]; ++size ) { buf[size] = s[size]; }
+    return true;
+}
+
+/// split time into date, time of day and microseconds
+inline void split( const boost::posix_time::ptime& t, int& year, int& month, int& day, int& seconds, int& microseconds )
+{
+    static const boost::posix_time::ptime base( epoch );
+    comma::int64 us = ( t - base ).total_microseconds();
+    static const comma::int64 day_us = comma::int64( 86400 ) * 1000000;
+    comma::int64 days = us / day_us;
+    us -= days * day_us;
+    if( us < 0 ) { us += day_us; --days; }
+    civil_from_days( days, year, month, day );
+    seconds = int( us / 1000000 );
+    microseconds = int( us % 1000000 );
+}
+
+} // namespace iso_time_detail {
+
+/// parse iso 8601 basic time: YYYYMMDDTHHMMSS[.FFFFFF], as output by boost::posix_time::to_iso_string()
+inline bool from_iso_basic_string( const char* s, std::size_t size, boost::posix_time::ptime& t )
+{
+    using namespace iso_time_detail;
+    int year, month, day, hours, minutes, seconds;
+    if( size < 15 || s[8] != 'T' ) { return false; }
+    if( !digits( s, 4, year ) || !digits( s + 4, 2, month ) || !digits( s + 6, 2, day ) || !digits( s + 9, 2, hours ) || !digits( s + 11, 2, minutes ) || !digits( s + 13, 2, seconds ) ) { return false; }
+    const char* end = s + size;
+    const char* p = s + 15;
+    comma::int64 microseconds;
+    if( !fractions( p, end, microseconds ) || p != end ) { return false; }
+    return make( year, month, day, hours, minutes, seconds, microseconds, 0, t );
+}
+
+/// parse iso 8601 extended time: YYYY-MM-DD?HH:MM:SS[.FFFFFF][Z|+hh|+hhmm|+hh:mm], where ? is 'T' or ' ' (i.e. xsd:dateTime or sql)
+inline bool from_iso_extended_string( const char* s, std::size_t size, boost::posix_time::ptime& t )
+{
+    using namespace iso_time_detail;
+    int year, month, day, hours, minutes, seconds;
+    if( size < 19 || s[4] != '-' || s[7] != '-' || ( s[10] != 'T' && s[10] != ' ' ) || s[13] != ':' || s[16] != ':' ) { return false; }
+    if( !digits( s, 4, year ) || !digits( s + 5, 2, month ) || !digits( s + 8, 2, day ) || !digits( s + 11, 2, hours ) || !digits( s + 14, 2, minutes ) || !digits( s + 17, 2, seconds ) ) { return false; }
+    const char* end = s + size;
+    const char* p = s + 19;
+    comma::int64 microseconds;
+    if( !fractions( p, end, microseconds ) ) { return false; }
+    comma::int64 offset = 0;
+    if( p != end )
+    {
+        if( *p == 'Z' ) { ++p; }
+        else if( *p == '+' || *p == '-' )
+        {
+            int sign = *p == '+' ? 1 : -1;
+            int h, m = 0;
+            ++p;
+            if( end - p < 2 || !digits( p, 2, h ) || h > 14 ) { return false; }
+            p += 2;
+            if( p != end && *p == ':' ) { ++p; if( p == end ) { return false; } }
+            if( p != end ) { if( end - p < 2 || !digits( p, 2, m ) || m > 59 ) { return false; } p += 2; }
+            offset = sign * ( h * 3600 + m * 60 );
+        }
+        if( p != end ) { return false; }
+    }
+    return make( year, month, day, hours, minutes, seconds, microseconds, offset, t );
+}
+
+/// parse seconds since epoch: [-]SSSS[.FFFFFF], fractions rounded to microseconds
+inline bool from_seconds_string( const char* s, std::size_t size, boost::posix_time::ptime& t )
+{
+    const char* end = s + size;
+    const char* p = s;
+    bool negative = p != end && *p == '-';
+    if( negative || ( p != end && *p == '+' ) ) { ++p; }
+    const char* begin = p;
+    comma::int64 seconds = 0;
+    for( ; p != end; ++p )
+    {
+        unsigned int d = static_cast< unsigned char >( *p ) - '0';
+        if( d > 9 ) { break; }
+        seconds = seconds * 10 + d;
+        if( seconds > 300000000000LL ) { return false; }
+    }
+    bool has_digits = p != begin;
+    comma::int64 microseconds = 0;
+    if( p != end && *p == '.' )
+    {
+        ++p;
+        comma::int64 scale = 100000;
+        const char* f = p;
+        for( ; p != end; ++p )
+        {
+            unsigned int d = static_cast< unsigned char >( *p ) - '0';
+            if( d > 9 ) { break; }
+            if( scale > 0 ) { microseconds += d * scale; }
+            else if( scale == 0 && d >= 5 ) { ++microseconds; }
+            scale = scale > 0 ? scale / 10 : -1;
+        }
+        has_digits = has_digits || p != f;
+    }
+    if( !has_digits || p != end ) { return false; }
+    const comma::int64 us = seconds * 1000000 + microseconds;
+    t = boost::posix_time::ptime( epoch, boost::posix_time::microseconds( negative ? -us : us ) );
+    return true;
+}
+
+/// parse time in any of the forms above, detecting the form by its shape
+inline bool from_any_string( const char* s, std::size_t size, boost::posix_time::ptime& t )
+{
+    if( size >= 15 && s[8] == 'T' ) { return from_iso_basic_string( s, size, t ); }
+    if( size >= 19 && s[4] == '-' ) { return from_iso_extended_string( s, size, t ); }
+    return from_seconds_string( s, size, t );
+}
+
+/// format time as boost::posix_time::to_iso_string() does, return number of characters written; buffer must hold at least 32 characters
+inline std::size_t to_iso_basic_string( const boost::posix_time::ptime& t, char* buf, bool always_with_fractions = false )
+{
+    using namespace iso_time_detail;
+    std::size_t size;
+    if( special( t, buf, size ) ) { return size; }
+    int year, month, day, seconds, microseconds;
+    split( t, year, month, day, seconds, microseconds );
+    char* p = put( buf, year, 4 );
+    p = put( p, month, 2 );
+    p = put( p, day, 2 );
+    *p++ = 'T';
+    p = put( p, seconds / 3600, 2 );
+    p = put( p, seconds / 60 % 60, 2 );
+    p = put( p, seconds % 60, 2 );
+    if( microseconds || always_with_fractions ) { *p++ = '.'; p = put( p, microseconds, 6 ); }
+    return p - buf;
+}
+
+/// format time as boost::posix_time::to_iso_extended_string() does, with 'T' or given date/time separator;
+/// return number of characters written; buffer must hold at least 32 characters
+inline std::size_t to_iso_extended_string( const boost::posix_time::ptime& t, char* buf, char separator = 'T', bool with_fractions = true )
+{
+    using namespace iso_time_detail;
+    std::size_t size;
+    if( special( t, buf, size ) ) { return size; }
+    int year, month, day, seconds, microseconds;
+    split( t, year, month, day, seconds, microseconds );
+    char* p = put( buf, year, 4 );
+    *p++ = '-';
+    p = put( p, month, 2 );
+    *p++ = '-';
+    p = put( p, day, 2 );
+    *p++ = separator;
+    p = put( p, seconds / 3600, 2 );
+    *p++ = ':';
+    p = put( p, seconds / 60 % 60, 2 );
+    *p++ = ':';
+    p = put( p, seconds % 60, 2 );
+    if( microseconds && with_fractions ) { *p++ = '.'; p = put( p, microseconds, 6 ); }
+    return p - buf;
+}
+
+/// same as boost::posix_time::from_iso_string(), but much faster for canonical input; throws on invalid input
+inline boost::posix_time::ptime from_iso_time_string( const std::string& s )
+{
+    boost::posix_time::ptime t;
+    return from_iso_basic_string( &s[0], s.size(), t ) ? t : boost::posix_time::from_iso_string( s );
+}
+
+/// same as boost::posix_time::to_iso_string(), but much faster
+inline std::string to_iso_time_string( const boost::posix_time::ptime& t )
+{
+    char buf[32];
+    return std::string( buf, to_iso_basic_string( t, buf ) );
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
+
+#endif // #ifndef COMMA_CSV_IMPL_ISO_TIME_H_
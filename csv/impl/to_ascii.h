@@ -41,6 +41,7 @@
 #include <boost/type_traits.hpp>
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
+#include "iso_time.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -84,7 +85,7 @@ class to_ascii
         std::size_t index_;
         boost::optional< unsigned int > precision_;
         boost::optional< char > quote_;
-        std::string as_string_( const boost::posix_time::ptime& v ) { return to_iso_string( v ); }
+        std::string as_string_( const boost::posix_time::ptime& v ) { return to_iso_time_string( v ); }
         std::string as_string_( const std::string& v ) { return quote_ ? *quote_ + v + *quote_ : v; } // todo: escape/unescape
         // todo: better output semantics for char/unsigned char
         std::string as_string_( const char& v ) { std::ostringstream oss; oss << static_cast< int >( v ); return oss.str(); }
@@ -32,6 +32,7 @@
 
 #pragma once
 
+#include <cstring>
 #include <string>
 #include <vector>
 #include <boost/static_assert.hpp>
@@ -226,6 +227,84 @@ struct unstructured
             return seed;
         }
     };    
+    
+    /// unstructured values packed into a single contiguous byte string with precomputed hash
+    /// for use as a hash key: one allocation per key instead of one per vector and string,
+    /// and cheap hashing and comparison; assign() reuses the buffer, thus packing a key
+    /// for a lookup in a loop does not allocate once the buffer is large enough
+    class packed
+    {
+        public:
+            packed() : hash_( 0 ) {}
+            
+            packed( const unstructured& u ) { assign( u ); }
+            
+            const packed& assign( const unstructured& u )
+            {
+                buffer_.clear();
+                for( std::size_t i = 0; i < u.longs.size(); ++i ) { append_( &u.longs[i], sizeof( comma::int64 ) ); }
+                for( std::size_t i = 0; i < u.doubles.size(); ++i ) { double d = u.doubles[i] + 0.0; append_( &d, sizeof( double ) ); } // quick and dirty: + 0.0 to normalize -0
+                BOOST_STATIC_ASSERT( sizeof( boost::posix_time::ptime ) == 8 ); // quick and dirty
+                for( std::size_t i = 0; i < u.time.size(); ++i ) { append_( &u.time[i], sizeof( boost::posix_time::ptime ) ); }
+                for( std::size_t i = 0; i < u.strings.size(); ++i )
+                {
+                    comma::uint32 size = u.strings[i].size();
+                    append_( &size, sizeof( comma::uint32 ) );
+                    buffer_.append( u.strings[i] );
+                }
+                hash_ = hash_bytes_( buffer_ );
+                return *this;
+            }
+            
+            /// unpack into given unstructured, which is expected to have the same number of values of each type as the packed one
+            void unpack( unstructured& u ) const
+            {
+                const char* p = &buffer_[0];
+                for( std::size_t i = 0; i < u.longs.size(); ++i, p += sizeof( comma::int64 ) ) { std::memcpy( &u.longs[i], p, sizeof( comma::int64 ) ); }
+                for( std::size_t i = 0; i < u.doubles.size(); ++i, p += sizeof( double ) ) { std::memcpy( &u.doubles[i], p, sizeof( double ) ); }
+                for( std::size_t i = 0; i < u.time.size(); ++i, p += sizeof( boost::posix_time::ptime ) ) { std::memcpy( static_cast< void* >( &u.time[i] ), p, sizeof( boost::posix_time::ptime ) ); }
+                for( std::size_t i = 0; i < u.strings.size(); ++i )
+                {
+                    comma::uint32 size;
+                    std::memcpy( &size, p, sizeof( comma::uint32 ) );
+                    p += sizeof( comma::uint32 );
+                    u.strings[i].assign( p, size );
+                    p += size;
+                }
+            }
+            
+            unstructured unpacked( const unstructured& sample ) const { unstructured u = sample; unpack( u ); return u; }
+            
+            const std::string& bytes() const { return buffer_; }
+            
+            std::size_t hash_value() const { return hash_; }
+            
+            bool operator==( const packed& rhs ) const { return hash_ == rhs.hash_ && buffer_ == rhs.buffer_; }
+            
+            bool operator!=( const packed& rhs ) const { return !operator==( rhs ); }
+            
+            struct hash
+            {
+                std::size_t operator()( const packed& p ) const { return p.hash_; }
+            };
+            
+        private:
+            std::string buffer_;
+            std::size_t hash_;
+            
+            void append_( const void* p, std::size_t size ) { buffer_.append( reinterpret_cast< const char* >( p ), size ); }
+            
+            static comma::uint64 mix_( comma::uint64 h ) { h ^= h >> 33; h *= 0xff51afd7ed558ccdULL; h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL; h ^= h >> 33; return h; }
+            
+            static std::size_t hash_bytes_( const std::string& s ) // 8 bytes at a time with murmur3 finalizer as mixer
+            {
+                comma::uint64 h = s.size();
+                std::size_t i = 0;
+                for( ; i + 8 <= s.size(); i += 8 ) { comma::uint64 w; std::memcpy( &w, &s[i], 8 ); h = mix_( h ^ w ) + 0x9e3779b97f4a7c15ULL; }
+                if( i < s.size() ) { comma::uint64 w = 0; std::memcpy( &w, &s[i], s.size() - i ); h = mix_( h ^ w ) + 0x9e3779b97f4a7c15ULL; }
+                return mix_( h );
+            }
+    };
 };
 
 template <> inline unstructured::values< comma::int64 >& unstructured::get< comma::int64 >() { return longs; }
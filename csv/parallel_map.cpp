@@ -0,0 +1,259 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef WIN32
+#include <errno.h>
+#include <poll.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "../base/exception.h"
+#include "parallel_map.h"
+
+namespace comma { namespace csv {
+
+static void call( const parallel_map::function_type& function, std::istream& is, std::ostream& os, comma::uint64 ) { function( is, os ); }
+
+parallel_map::parallel_map( const function_type& function, std::size_t record_size, unsigned int threads, std::size_t chunk_size )
+    : function_( boost::bind( &call, function, _1, _2, _3 ) )
+    , record_size_( record_size )
+    , threads_( threads == 0 ? boost::thread::hardware_concurrency() : threads )
+    , chunk_size_( record_size == 0 ? std::max( chunk_size, std::size_t( 1 ) ) : std::max( chunk_size / record_size, std::size_t( 1 ) ) * record_size )
+    , eof_( false )
+    , stop_( false )
+    , failed_( false )
+{
+    if( threads_ == 0 ) { threads_ = 1; }
+}
+
+parallel_map::parallel_map( const indexed& function, std::size_t record_size, unsigned int threads, std::size_t chunk_size )
+    : function_( function.function )
+    , record_size_( record_size )
+    , threads_( threads == 0 ? boost::thread::hardware_concurrency() : threads )
+    , chunk_size_( record_size == 0 ? std::max( chunk_size, std::size_t( 1 ) ) : std::max( chunk_size / record_size, std::size_t( 1 ) ) * record_size )
+    , eof_( false )
+    , stop_( false )
+    , failed_( false )
+{
+    if( threads_ == 0 ) { threads_ = 1; }
+}
+
+bool parallel_map::wait_( std::istream& is, int fd ) // wait until read would not block; return false, if stopped
+{
+    #ifndef WIN32
+    if( fd < 0 || is.rdbuf()->in_avail() > 0 ) { return true; }
+    while( true )
+    {
+        {
+            boost::mutex::scoped_lock lock( mutex_ );
+            if( stop_ || failed_ ) { return false; }
+        }
+        struct pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        int r = ::poll( &p, 1, 100 ); // timeout in milliseconds, arbitrary
+        if( r > 0 || ( r < 0 && errno != EINTR ) ) { return true; } // on error, let read report it
+    }
+    #else
+    return true;
+    #endif
+}
+
+comma::uint64 parallel_map::count_( const std::string& buf ) const // number of records in the chunk as counted by csv input streams, i.e. skipping empty lines
+{
+    if( record_size_ > 0 ) { return buf.size() / record_size_; }
+    comma::uint64 count = 0;
+    for( const char* p = buf.data(), *end = buf.data() + buf.size(); p < end; )
+    {
+        const char* n = static_cast< const char* >( std::memchr( p, '\n', end - p ) );
+        if( n == NULL ) { n = end; }
+        if( n > p && !( n == p + 1 && *p == '\r' ) ) { ++count; }
+        p = n + 1;
+    }
+    return count;
+}
+
+bool parallel_map::read_( std::istream& is, std::string& buf ) // read at least one line or record blocking, then whatever is available
+{
+    if( record_size_ > 0 )
+    {
+        buf.resize( chunk_size_ );
+        is.read( &buf[0], record_size_ );
+        if( is.gcount() == 0 ) { return false; }
+        if( is.gcount() < std::streamsize( record_size_ ) ) { COMMA_THROW( comma::exception, "expected " << record_size_ << " bytes, got only " << is.gcount() ); }
+        std::size_t size = record_size_;
+        std::streamsize available = is.rdbuf()->in_avail();
+        std::size_t count = available > 0 ? std::min( std::size_t( available ) / record_size_ * record_size_, chunk_size_ - size ) : 0;
+        if( count > 0 ) { is.read( &buf[size], count ); size += is.gcount(); }
+        buf.resize( size );
+        return true;
+    }
+    std::string line;
+    std::getline( is, line );
+    if( line.empty() && !is.good() ) { return false; }
+    buf = line;
+    buf += '\n';
+    while( buf.size() < chunk_size_ && is.good() )
+    {
+        std::streamsize available = is.rdbuf()->in_avail();
+        if( available <= 0 ) { break; }
+        std::size_t size = buf.size();
+        buf.resize( size + std::min( std::size_t( available ), chunk_size_ - size ) );
+        is.read( &buf[size], buf.size() - size );
+        buf.resize( size + is.gcount() );
+        if( buf[ buf.size() - 1 ] == '\n' ) { continue; }
+        std::getline( is, line ); // complete the last line
+        buf += line;
+        buf += '\n';
+    }
+    return true;
+}
+
+void parallel_map::read_all_( std::istream& is )
+{
+    try
+    {
+        int fd = &is == &std::cin ? 0 : -1;
+        comma::uint64 offset = 0;
+        while( true )
+        {
+            if( !wait_( is, fd ) ) { return; }
+            boost::shared_ptr< chunk > c( new chunk );
+            if( !read_( is, c->input ) ) { break; }
+            c->offset = offset;
+            offset += count_( c->input );
+            boost::mutex::scoped_lock lock( mutex_ );
+            while( !stop_ && !failed_ && pending_.size() >= 2 * threads_ ) { condition_.wait( lock ); }
+            if( stop_ || failed_ ) { return; }
+            pending_.push_back( c );
+            todo_.push_back( c );
+            condition_.notify_all();
+        }
+    }
+    catch( comma::exception& ex ) { end_( ex.error() ); return; }
+    catch( std::exception& ex ) { end_( ex.what() ); return; }
+    catch( ... ) { end_( "unknown exception" ); return; }
+    end_();
+}
+
+void parallel_map::end_( const std::string& what ) // on input error, output chunks read so far, as a single-threaded utility would
+{
+    boost::mutex::scoped_lock lock( mutex_ );
+    if( error_.empty() ) { error_ = what; }
+    eof_ = true;
+    condition_.notify_all();
+}
+
+void parallel_map::work_()
+{
+    while( true )
+    {
+        boost::shared_ptr< chunk > c;
+        {
+            boost::mutex::scoped_lock lock( mutex_ );
+            while( !stop_ && todo_.empty() && !eof_ ) { condition_.wait( lock ); }
+            if( stop_ || todo_.empty() ) { return; }
+            c = todo_.front();
+            todo_.pop_front();
+        }
+        std::ostringstream oss;
+        try
+        {
+            std::istringstream iss( c->input );
+            function_( iss, oss, c->offset );
+            c->output = oss.str();
+        }
+        catch( comma::exception& ex ) { c->output = oss.str(); fail_( c, ex.error() ); continue; }
+        catch( std::exception& ex ) { c->output = oss.str(); fail_( c, ex.what() ); continue; }
+        catch( ... ) { c->output = oss.str(); fail_( c, "unknown exception" ); continue; }
+        boost::mutex::scoped_lock lock( mutex_ );
+        c->done = true;
+        std::string().swap( c->input );
+        condition_.notify_all();
+    }
+}
+
+void parallel_map::fail_( const boost::shared_ptr< chunk >& c, const std::string& what ) // stop reading, let chunks before the failing one finish
+{
+    boost::mutex::scoped_lock lock( mutex_ );
+    c->done = true;
+    c->failed = true;
+    c->error = what;
+    failed_ = true;
+    todo_.clear(); // chunks are taken in input order, thus all the chunks left are after the failing one
+    condition_.notify_all();
+}
+
+void parallel_map::run( std::istream& is, std::ostream& os )
+{
+    eof_ = false;
+    stop_ = false;
+    failed_ = false;
+    error_.clear();
+    pending_.clear();
+    todo_.clear();
+    boost::thread reader( boost::bind( &parallel_map::read_all_, this, boost::ref( is ) ) );
+    boost::thread_group workers;
+    for( unsigned int i = 0; i < threads_; ++i ) { workers.create_thread( boost::bind( &parallel_map::work_, this ) ); }
+    std::string error;
+    while( true )
+    {
+        boost::shared_ptr< chunk > c;
+        {
+            boost::mutex::scoped_lock lock( mutex_ );
+            while( !stop_ && ( pending_.empty() ? !eof_ : !pending_.front()->done ) ) { condition_.wait( lock ); }
+            if( stop_ || pending_.empty() ) { break; }
+            c = pending_.front();
+            pending_.pop_front();
+            condition_.notify_all();
+        }
+        os.write( &c->output[0], c->output.size() );
+        os.flush();
+        if( c->failed ) { error = c->error; break; }
+    }
+    {
+        boost::mutex::scoped_lock lock( mutex_ );
+        stop_ = true; // stop reader and workers, if output ended early, e.g. on error
+        condition_.notify_all();
+    }
+    workers.join_all();
+    reader.join();
+    if( error.empty() )
+    {
+        boost::mutex::scoped_lock lock( mutex_ );
+        error = error_;
+    }
+    if( !error.empty() ) { COMMA_THROW( comma::exception, error ); }
+}
+
+} } // namespace comma { namespace csv {
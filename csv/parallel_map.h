@@ -0,0 +1,135 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_CSV_PARALLEL_MAP_H_
+#define COMMA_CSV_PARALLEL_MAP_H_
+
+#include <deque>
+#include <iostream>
+#include <string>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include "../base/types.h"
+
+namespace comma { namespace csv {
+
+/// order-preserving parallel map for stateless per-record transforms
+///
+/// a reader splits input into chunks of whole lines (ascii) or whole records (binary),
+/// worker threads transform chunks independently, and the calling thread writes
+/// transformed chunks in the input order
+///
+/// the chunk function reads records from a stream over the chunk and writes the
+/// results to an output stream, i.e. it usually is the same loop a utility runs
+/// on std::cin and std::cout; it is called concurrently from several threads,
+/// thus it must not modify any shared state
+///
+/// a chunk is whatever is available on input up to chunk size, but at least
+/// one line or record, thus latency on slow input stays low
+///
+/// if input is std::cin, it has to be unsynchronised from stdio (std::ios_base::sync_with_stdio( false )):
+/// the reader then waits for input on stdin file descriptor with a timeout rather than blocking in read,
+/// so that it stops soon after a chunk function fails; other input streams (files, string streams)
+/// are expected not to block indefinitely
+class parallel_map : public boost::noncopyable
+{
+    public:
+        /// chunk function: transform records from given input stream to given output stream
+        typedef boost::function< void( std::istream&, std::ostream& ) > function_type;
+
+        /// chunk function that also gets the number of records (non-empty lines, if ascii)
+        /// in the input before the chunk, e.g. to report record numbers in errors
+        typedef boost::function< void( std::istream&, std::ostream&, comma::uint64 ) > indexed_function_type;
+
+        /// explicit wrapper for indexed chunk function to tell it from plain chunk function in constructor, e.g:
+        ///     parallel_map map( parallel_map::indexed( boost::bind( &convert, _1, _2, _3 ) ), 0, threads );
+        struct indexed
+        {
+            indexed_function_type function;
+            explicit indexed( const indexed_function_type& function ) : function( function ) {}
+        };
+
+        /// constructor
+        /// @param function chunk function
+        /// @param record_size binary record size; 0 for ascii, i.e. line-aligned chunks
+        /// @param threads number of worker threads; 0: number of hardware threads
+        /// @param chunk_size maximum chunk size in bytes (rounded down to record size, if binary)
+        parallel_map( const function_type& function, std::size_t record_size = 0, unsigned int threads = 0, std::size_t chunk_size = 65536 );
+
+        /// constructor with indexed chunk function, parameters as above
+        parallel_map( const indexed& function, std::size_t record_size = 0, unsigned int threads = 0, std::size_t chunk_size = 65536 );
+
+        /// transform input to output until end of input;
+        /// output is flushed after each chunk
+        /// if chunk function throws, output is written in input order up to the failing chunk,
+        /// including whatever chunk function output for the failing chunk before throwing,
+        /// i.e. the same output as if the utility ran single-threaded; then the exception is rethrown
+        /// @throw comma::exception, if chunk function throws or input ends with incomplete record
+        void run( std::istream& is, std::ostream& os );
+
+        unsigned int threads() const { return threads_; }
+
+    private:
+        struct chunk
+        {
+            std::string input;
+            std::string output;
+            comma::uint64 offset; // number of records before the chunk
+            bool done;
+            bool failed; // chunk function threw: output holds what it wrote before throwing
+            std::string error;
+            chunk() : offset( 0 ), done( false ), failed( false ) {}
+        };
+        indexed_function_type function_;
+        std::size_t record_size_;
+        unsigned int threads_;
+        std::size_t chunk_size_;
+        std::deque< boost::shared_ptr< chunk > > pending_; // in input order
+        std::deque< boost::shared_ptr< chunk > > todo_;
+        boost::mutex mutex_;
+        boost::condition_variable condition_;
+        bool eof_;
+        bool stop_;
+        bool failed_;
+        std::string error_;
+        bool read_( std::istream& is, std::string& buf );
+        bool wait_( std::istream& is, int fd );
+        comma::uint64 count_( const std::string& buf ) const;
+        void read_all_( std::istream& is );
+        void work_();
+        void end_( const std::string& what = "" );
+        void fail_( const boost::shared_ptr< chunk >& c, const std::string& what );
+};
+
+} } // namespace comma { namespace csv {
+
+#endif // COMMA_CSV_PARALLEL_MAP_H_
@@ -0,0 +1,171 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <gtest/gtest.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include "../../base/exception.h"
+#include "../../csv/columnar.h"
+
+namespace comma { namespace csv { namespace columnar {
+
+struct record { double x; comma::uint32 id; char name[4]; };
+
+static std::string write_file( const std::string& filename, unsigned int count, std::size_t block_size, double nan_at = -1 )
+{
+    std::ofstream ofs( filename.c_str(), std::ios::binary );
+    columnar::writer w( ofs, comma::csv::format( "d,ui,s[4]" ), "x,id,name", block_size );
+    for( unsigned int i = 0; i < count; ++i )
+    {
+        record r;
+        r.x = i == nan_at ? std::numeric_limits< double >::quiet_NaN() : i * 0.5;
+        r.id = count - i;
+        ::memset( r.name, 0, 4 );
+        r.name[0] = 'a' + i % 26;
+        char buf[16];
+        ::memcpy( buf, &r.x, 8 );
+        ::memcpy( buf + 8, &r.id, 4 );
+        ::memcpy( buf + 12, r.name, 4 );
+        if( i % 2 == 0 ) { w.write( buf ); } else { w.write( buf, 1 ); }
+    }
+    w.close();
+    return filename;
+}
+
+static double x( const char* p ) { double d; ::memcpy( &d, p, 8 ); return d; }
+static comma::uint32 id( const char* p ) { comma::uint32 i; ::memcpy( &i, p + 8, 4 ); return i; }
+
+TEST( columnar, round_trip )
+{
+    std::string filename = write_file( "columnar_test.round_trip.bin", 1000, 64 );
+    columnar::reader r( filename );
+    EXPECT_EQ( "d,ui,s[4]", r.format().string() );
+    EXPECT_EQ( "x,id,name", r.fields() );
+    EXPECT_EQ( 1000u, r.size() );
+    EXPECT_EQ( 16u, r.blocks().size() );
+    EXPECT_EQ( 1000u - 15 * 64, r.blocks().back().size );
+    columnar::istream is( filename );
+    char buf[16];
+    for( unsigned int i = 0; i < 1000; ++i )
+    {
+        is.read( buf, 16 );
+        ASSERT_EQ( 16, is.gcount() );
+        EXPECT_EQ( i * 0.5, x( buf ) );
+        EXPECT_EQ( 1000 - i, id( buf ) );
+        EXPECT_EQ( 'a' + i % 26, buf[12] );
+    }
+    is.read( buf, 16 );
+    EXPECT_EQ( 0, is.gcount() );
+    EXPECT_TRUE( is.eof() );
+    std::remove( filename.c_str() );
+}
+
+TEST( columnar, statistics )
+{
+    std::string filename = write_file( "columnar_test.statistics.bin", 100, 10, 25 );
+    columnar::reader r( filename );
+    ASSERT_EQ( 10u, r.blocks().size() );
+    EXPECT_EQ( 0, x( &r.blocks()[0].min[0] ) );
+    EXPECT_EQ( 4.5, x( &r.blocks()[0].max[0] ) );
+    EXPECT_EQ( 91u, id( &r.blocks()[0].min[0] ) );
+    EXPECT_EQ( 100u, id( &r.blocks()[0].max[0] ) );
+    EXPECT_EQ( 'a', r.blocks()[0].min[12] );
+    EXPECT_EQ( 'j', r.blocks()[0].max[12] );
+    EXPECT_EQ( -std::numeric_limits< double >::infinity(), x( &r.blocks()[2].min[0] ) );
+    EXPECT_EQ( std::numeric_limits< double >::infinity(), x( &r.blocks()[2].max[0] ) );
+    EXPECT_EQ( 71u, id( &r.blocks()[2].min[0] ) );
+    std::remove( filename.c_str() );
+}
+
+TEST( columnar, projection )
+{
+    std::string filename = write_file( "columnar_test.projection.bin", 100, 30 );
+    columnar::istream is( filename, std::vector< std::size_t >( 1, 1 ) );
+    char buf[16];
+    for( unsigned int i = 0; i < 100; ++i )
+    {
+        is.read( buf, 16 );
+        ASSERT_EQ( 16, is.gcount() );
+        EXPECT_EQ( 0, x( buf ) );
+        EXPECT_EQ( 100 - i, id( buf ) );
+        EXPECT_EQ( 0, buf[12] );
+    }
+    std::remove( filename.c_str() );
+}
+
+static bool overlaps( const block& b, double from, double to ) { return !( x( &b.max[0] ) < from || to < x( &b.min[0] ) ); }
+
+TEST( columnar, filter )
+{
+    std::string filename = write_file( "columnar_test.filter.bin", 100, 10 );
+    columnar::istream is( filename, std::vector< std::size_t >(), boost::bind( &overlaps, _1, 20, 30 ) );
+    char buf[16];
+    std::vector< double > values;
+    while( is.read( buf, 16 ) ) { values.push_back( x( buf ) ); }
+    ASSERT_EQ( 30u, values.size() ); // blocks 4, 5, 6
+    EXPECT_EQ( 20, values.front() );
+    EXPECT_EQ( 34.5, values.back() );
+    EXPECT_EQ( 7u, is.skipped() );
+    std::remove( filename.c_str() );
+}
+
+TEST( columnar, time )
+{
+    {
+        std::ofstream ofs( "columnar_test.time.bin", std::ios::binary );
+        columnar::writer w( ofs, comma::csv::format( "t" ), "", 2 );
+        comma::int64 t[] = { 20, 10, std::numeric_limits< comma::int64 >::min(), 30 };
+        for( unsigned int i = 0; i < 4; ++i ) { w.write( reinterpret_cast< const char* >( t + i ) ); }
+    }
+    columnar::reader r( "columnar_test.time.bin" );
+    ASSERT_EQ( 2u, r.blocks().size() );
+    comma::int64 t;
+    ::memcpy( &t, &r.blocks()[0].min[0], 8 ); EXPECT_EQ( 10, t );
+    ::memcpy( &t, &r.blocks()[0].max[0], 8 ); EXPECT_EQ( 20, t );
+    ::memcpy( &t, &r.blocks()[1].min[0], 8 ); EXPECT_EQ( std::numeric_limits< comma::int64 >::min() + 1, t );
+    ::memcpy( &t, &r.blocks()[1].max[0], 8 ); EXPECT_EQ( std::numeric_limits< comma::int64 >::max(), t );
+    std::remove( "columnar_test.time.bin" );
+}
+
+TEST( columnar, invalid )
+{
+    {
+        std::ofstream ofs( "columnar_test.invalid.bin", std::ios::binary );
+        ofs << "not a columnar file";
+    }
+    EXPECT_THROW( columnar::reader( "columnar_test.invalid.bin" ), comma::exception );
+    std::remove( "columnar_test.invalid.bin" );
+}
+
+} } } // namespace comma { namespace csv { namespace columnar {
@@ -0,0 +1,110 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../../csv/impl/iso_time.h"
+
+namespace comma { namespace csv { namespace impl {
+
+static bool parse_basic( const char* s, boost::posix_time::ptime& t ) { return from_iso_basic_string( s, std::strlen( s ), t ); }
+static bool parse_extended( const char* s, boost::posix_time::ptime& t ) { return from_iso_extended_string( s, std::strlen( s ), t ); }
+static bool parse_seconds( const char* s, boost::posix_time::ptime& t ) { return from_seconds_string( s, std::strlen( s ), t ); }
+
+TEST( iso_time, from_iso_basic )
+{
+    boost::posix_time::ptime t;
+    const char* valid[] = { "20110304T111111", "20110304T111111.1234", "20110304T111111.1234567", "20000229T235959", "14000101T000000" };
+    for( unsigned int i = 0; i < sizeof( valid ) / sizeof( valid[0] ); ++i )
+    {
+        EXPECT_TRUE( parse_basic( valid[i], t ) );
+        EXPECT_EQ( boost::posix_time::from_iso_string( valid[i] ), t );
+    }
+    const char* fallback[] = { "", "20110304", "20110304T1111", "20110304T111111.", "19000229T000000", "20111304T000000", "20110304T241111", "not-a-date-time" };
+    for( unsigned int i = 0; i < sizeof( fallback ) / sizeof( fallback[0] ); ++i ) { EXPECT_FALSE( parse_basic( fallback[i], t ) ); }
+}
+
+TEST( iso_time, from_iso_extended )
+{
+    boost::posix_time::ptime expected = boost::posix_time::from_iso_string( "20141224T130000" );
+    boost::posix_time::ptime t;
+    EXPECT_TRUE( parse_extended( "2014-12-24T13:00:00", t ) );
+    EXPECT_EQ( expected, t );
+    EXPECT_TRUE( parse_extended( "2014-12-24 13:00:00", t ) );
+    EXPECT_EQ( expected, t );
+    EXPECT_TRUE( parse_extended( "2014-12-24T13:00:00.000Z", t ) );
+    EXPECT_EQ( expected, t );
+    EXPECT_TRUE( parse_extended( "2014-12-25T00:00:00.000+11:00", t ) );
+    EXPECT_EQ( expected, t );
+    EXPECT_TRUE( parse_extended( "2014-12-25T00:00:00+1100", t ) );
+    EXPECT_EQ( expected, t );
+    EXPECT_TRUE( parse_extended( "2014-12-24T02:00:00-11", t ) );
+    EXPECT_EQ( expected, t );
+    EXPECT_FALSE( parse_extended( "2014-12-24T13:00:00+1", t ) );
+    EXPECT_FALSE( parse_extended( "2014-12-24T13:00:00X", t ) );
+    EXPECT_FALSE( parse_extended( "20141224T130000", t ) );
+}
+
+TEST( iso_time, from_seconds )
+{
+    boost::posix_time::ptime t;
+    EXPECT_TRUE( parse_seconds( "1369179610.752231000", t ) );
+    EXPECT_EQ( boost::posix_time::from_iso_string( "20130521T234010.752231" ), t );
+    EXPECT_TRUE( parse_seconds( "-1.5", t ) );
+    EXPECT_EQ( boost::posix_time::from_iso_string( "19691231T235958.5" ), t );
+    EXPECT_TRUE( parse_seconds( "0.0000005", t ) );
+    EXPECT_EQ( boost::posix_time::from_iso_string( "19700101T000000.000001" ), t );
+    EXPECT_FALSE( parse_seconds( "", t ) );
+    EXPECT_FALSE( parse_seconds( ".", t ) );
+    EXPECT_FALSE( parse_seconds( "1e9", t ) );
+}
+
+TEST( iso_time, to_string )
+{
+    boost::posix_time::ptime times[] = { boost::posix_time::from_iso_string( "20110304T111111.1234" )
+                                       , boost::posix_time::from_iso_string( "20110304T111111" )
+                                       , boost::posix_time::from_iso_string( "19691231T235959.999999" )
+                                       , boost::posix_time::from_iso_string( "14000101T000000" )
+                                       , boost::posix_time::not_a_date_time
+                                       , boost::posix_time::pos_infin
+                                       , boost::posix_time::neg_infin };
+    for( unsigned int i = 0; i < sizeof( times ) / sizeof( times[0] ); ++i )
+    {
+        char buf[32];
+        EXPECT_EQ( boost::posix_time::to_iso_string( times[i] ), std::string( buf, to_iso_basic_string( times[i], buf ) ) );
+        EXPECT_EQ( boost::posix_time::to_iso_extended_string( times[i] ), std::string( buf, to_iso_extended_string( times[i], buf ) ) );
+        EXPECT_EQ( boost::posix_time::to_iso_string( times[i] ), to_iso_time_string( times[i] ) );
+        boost::posix_time::ptime t;
+        if( !times[i].is_special() ) { EXPECT_TRUE( from_any_string( buf, to_iso_extended_string( times[i], buf ), t ) ); EXPECT_EQ( times[i], t ); }
+    }
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
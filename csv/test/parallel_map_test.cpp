@@ -0,0 +1,137 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <sstream>
+#include <gtest/gtest.h>
+#include <boost/lexical_cast.hpp>
+#include "../../base/exception.h"
+#include "../../base/types.h"
+#include "../../csv/parallel_map.h"
+
+namespace comma { namespace csv {
+
+static void square( std::istream& is, std::ostream& os )
+{
+    std::string line;
+    while( std::getline( is, line ) )
+    {
+        if( line.empty() ) { continue; }
+        if( line == "fail" ) { COMMA_THROW( comma::exception, "failed" ); }
+        long n = boost::lexical_cast< long >( line );
+        os << n << ',' << n * n << std::endl;
+    }
+}
+
+static void negate( std::istream& is, std::ostream& os )
+{
+    comma::int32 n;
+    while( is.read( reinterpret_cast< char* >( &n ), sizeof( n ) ) ) { n = -n; os.write( reinterpret_cast< const char* >( &n ), sizeof( n ) ); }
+}
+
+static void number( std::istream& is, std::ostream& os, comma::uint64 offset )
+{
+    std::string line;
+    while( std::getline( is, line ) ) { if( !line.empty() ) { os << offset++ << ',' << line << std::endl; } }
+}
+
+TEST( parallel_map, ascii )
+{
+    std::ostringstream input;
+    std::ostringstream expected;
+    for( long i = 0; i < 100000; ++i ) { input << i << std::endl; expected << i << ',' << i * i << std::endl; }
+    for( unsigned int threads = 1; threads < 5; ++threads )
+    {
+        std::istringstream is( input.str() );
+        std::ostringstream os;
+        parallel_map( &square, 0, threads, 1000 ).run( is, os );
+        EXPECT_EQ( expected.str(), os.str() );
+    }
+    std::istringstream is( "1\n2\n3" ); // no trailing newline
+    std::ostringstream os;
+    parallel_map( &square, 0, 2, 1 ).run( is, os );
+    EXPECT_EQ( "1,1\n2,4\n3,9\n", os.str() );
+}
+
+TEST( parallel_map, binary )
+{
+    std::vector< comma::int32 > input( 100000 );
+    std::vector< comma::int32 > expected( input.size() );
+    for( unsigned int i = 0; i < input.size(); ++i ) { input[i] = i; expected[i] = -comma::int32( i ); }
+    std::istringstream is( std::string( reinterpret_cast< const char* >( &input[0] ), input.size() * sizeof( comma::int32 ) ) );
+    std::ostringstream os;
+    parallel_map( &negate, sizeof( comma::int32 ), 3, 1001 ).run( is, os ); // chunk size is not multiple of record size
+    EXPECT_EQ( std::string( reinterpret_cast< const char* >( &expected[0] ), expected.size() * sizeof( comma::int32 ) ), os.str() );
+    std::istringstream incomplete( std::string( 10, 0 ) );
+    std::ostringstream output;
+    EXPECT_THROW( parallel_map( &negate, sizeof( comma::int32 ), 3 ).run( incomplete, output ), comma::exception );
+    EXPECT_EQ( 8u, output.str().size() ); // whole records are still output
+}
+
+TEST( parallel_map, indexed )
+{
+    std::ostringstream input;
+    std::ostringstream expected;
+    for( long i = 0; i < 10000; ++i ) { input << i << std::endl; if( i % 7 == 0 ) { input << std::endl; } expected << i << ',' << i << std::endl; }
+    for( unsigned int threads = 1; threads < 4; ++threads )
+    {
+        std::istringstream is( input.str() );
+        std::ostringstream os;
+        parallel_map( parallel_map::indexed( &number ), 0, threads, 100 ).run( is, os ); // empty lines are not counted
+        EXPECT_EQ( expected.str(), os.str() );
+    }
+}
+
+TEST( parallel_map, exception )
+{
+    std::ostringstream input;
+    std::ostringstream expected; // records before the failing one, as single-threaded run would output
+    for( long i = 0; i < 100000; ++i )
+    {
+        if( i == 50000 ) { input << "fail" << std::endl; } else { input << i << std::endl; }
+        if( i < 50000 ) { expected << i << ',' << i * i << std::endl; }
+    }
+    for( unsigned int threads = 1; threads < 5; ++threads )
+    {
+        std::istringstream is( input.str() );
+        std::ostringstream os;
+        EXPECT_THROW( parallel_map( &square, 0, threads, 1000 ).run( is, os ), comma::exception );
+        EXPECT_EQ( expected.str(), os.str() );
+    }
+    for( std::size_t chunk_size = 1; chunk_size < 10000; chunk_size *= 100 ) // failing record in its own chunk or in the middle of a chunk
+    {
+        std::istringstream is( "1\n2\nfail\n3\nfail\n4\n" );
+        std::ostringstream os;
+        try { parallel_map( &square, 0, 2, chunk_size ).run( is, os ); FAIL(); }
+        catch( comma::exception& ex ) { EXPECT_EQ( "failed", std::string( ex.error() ) ); }
+        EXPECT_EQ( "1,1\n2,4\n", os.str() );
+    }
+}
+
+} } // namespace comma { namespace csv {
@@ -34,15 +34,20 @@
 #include <sys/ioctl.h>
 #endif
 
+#include <deque>
 #include <vector>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
 #include "../../base/types.h"
 #include "../../io/stream.h"
+#include "../../io/passthrough.h"
 #include "../../io/select.h"
+#include "../../io/shm.h"
 #include "../../string/string.h"
 
 void usage( bool verbose = false )
@@ -56,6 +61,7 @@ void usage( bool verbose = false )
     std::cerr << "    local:<path>: local socket" << std::endl;
     std::cerr << "    tcp:<host>:<port>: tcp socket" << std::endl;
     std::cerr << "    udp:<port>: udp socket" << std::endl;
+    std::cerr << "    shm:<name>: shared memory ring, e.g. written by io-publish shm:<name>; polled, while idle" << std::endl;
     std::cerr << "    zmp-<protocol>:<address>: zmq (todo)" << std::endl;
     std::cerr << "    <filename>: file" << std::endl;
     std::cerr << "    <fifo>: named pipe" << std::endl;
@@ -64,15 +70,22 @@ void usage( bool verbose = false )
     std::cerr << "options" << std::endl;
     std::cerr << "    --exit-on-first-closed,-e: exit, if one of the streams finishes" << std::endl;
     std::cerr << "    --flush,unbuffered,-u: flush output" << std::endl;
-    std::cerr << "    --round-robin=[<number of packets>]: todo: only for multiple inputs: read not more" << std::endl;
-    std::cerr << "                                         than <number of packets> from an input at once," << std::endl;
-    std::cerr << "                                         before checking other inputs" << std::endl;
-    std::cerr << "                                         if not specified, read from each input" << std::endl;
-    std::cerr << "                                         all available data" << std::endl;
-    std::cerr << "                                         ignored for udp streams, where one full udp" << std::endl;
-    std::cerr << "                                         packet at a time is always read" << std::endl;
+    std::cerr << "    --no-splice: for a single plain file, pipe, or socket input (not udp, shm, or lz4) without --size, on linux," << std::endl;
+    std::cerr << "                 data is passed to stdout without copying it through user space (see splice(2)), which also" << std::endl;
+    std::cerr << "                 makes it unbuffered; falls back to plain read and write, if not supported; use --no-splice" << std::endl;
+    std::cerr << "                 to always read and write" << std::endl;
+    std::cerr << "    --round-robin=[<number of packets>]: only for multiple inputs: output not more than <number of packets>" << std::endl;
+    std::cerr << "                                         from an input at once, before checking other inputs, so that" << std::endl;
+    std::cerr << "                                         a busy input does not hold up the others; a packet is a record" << std::endl;
+    std::cerr << "                                         of --size bytes for binary data or a line for ascii data" << std::endl;
+    std::cerr << "                                         default: output all complete packets read from an input" << std::endl;
+    std::cerr << "                                         (each input is read up to about 1MB at a time)" << std::endl;
     std::cerr << "    --size,-s=[<size>]: packet size, if binary data (required only for multiple sources)" << std::endl;
-    std::cerr << "    --verbose,-v: more output" << std::endl;
+    std::cerr << "    --verbose,-v: more output; once a second, output per input: number of packets and bytes, throughput, and" << std::endl;
+    std::cerr << "                  mean and maximum latency, i.e. how long complete packets waited in io-cat before output" << std::endl;
+    std::cerr << "    --weights=<weight>[,<weight>]...: one positive integer weight per input: output up to" << std::endl;
+    std::cerr << "                                      <weight> * <number of packets> from an input in a round;" << std::endl;
+    std::cerr << "                                      implies --round-robin=1, if --round-robin is not given" << std::endl;
     std::cerr << std::endl;
     std::cerr << "supported address types: tcp, udp, local (unix) sockets, named pipes, files, zmq (todo)" << std::endl;
     std::cerr << std::endl;
@@ -95,6 +108,8 @@ void usage( bool verbose = false )
     std::cerr << "            io-cat tcp:localhost:55555 tcp:localhost:88888 --size 100" << std::endl;
     std::cerr << "        merge line-based input with stdin" << std::endl;
     std::cerr << "            echo hello | io-cat tcp:localhost:55555 -" << std::endl;
+    std::cerr << "        merge control messages with bulk sensor data, 10 sensor records per control message at most" << std::endl;
+    std::cerr << "            io-cat tcp:localhost:55555 tcp:localhost:88888 --size 100 --round-robin 1 --weights 1,10" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
     std::cerr << std::endl;
@@ -106,10 +121,11 @@ class stream
     public:
         stream( const std::string address ) : address_( address ) {}
         virtual ~stream() {}
-        virtual unsigned int read_available( std::vector< char >& buffer, unsigned int max_count ) = 0;
+        virtual std::size_t read_available( char* buffer, std::size_t size ) = 0; // read available data without blocking, return 0, if none
         virtual comma::io::file_descriptor fd() const = 0;
         virtual bool eof() const = 0;
         virtual bool empty() const = 0;
+        virtual bool finished( bool ready ) const { return empty() && ( eof() || ready ); }
         virtual void close() = 0;
         virtual bool closed() const = 0;
         const std::string& address() const { return address_; }
@@ -132,11 +148,14 @@ class udp_stream : public stream
             if( error ) { COMMA_THROW( comma::exception, "io-cat: udp failed to set broadcast option on port " << port ); }
             socket_.bind( boost::asio::ip::udp::endpoint( boost::asio::ip::udp::v4(), port ), error );
             if( error ) { COMMA_THROW( comma::exception, "io-cat: udp failed to bind port " << port ); }
+            socket_.non_blocking( true );
         }
         
         bool eof() const { return false; }
         
-        bool empty() const { return false; }
+        bool empty() const { boost::system::error_code error; return socket_.available( error ) == 0; }
+        
+        bool finished( bool ) const { return false; } // a zero-length datagram is not end of stream
         
         void close() {}
         
@@ -144,11 +163,11 @@ class udp_stream : public stream
         
         comma::io::file_descriptor fd() const { return socket_.native_handle(); }
         
-        unsigned int read_available( std::vector< char >& buffer, unsigned int )
+        std::size_t read_available( char* buffer, std::size_t size ) // one datagram at a time
         {
             boost::system::error_code error;
-            std::size_t size = socket_.receive( boost::asio::buffer( buffer ), 0, error );
-            return error ? 0 : size;
+            std::size_t received = socket_.receive( boost::asio::buffer( buffer, size ), 0, error );
+            return error ? 0 : received;
         }
         
     private:
@@ -159,11 +178,9 @@ class udp_stream : public stream
 class any_stream : public stream
 {
     public:
-        any_stream( const std::string& address, unsigned int size, bool binary )
+        any_stream( const std::string& address )
             : stream( address )
             , istream_( address, comma::io::mode::binary, comma::io::mode::non_blocking )
-            , size_( size )
-            , binary_( binary )
             , closed_( false )
         {
             if( istream_() != &std::cin ) { return; }
@@ -173,34 +190,21 @@ class any_stream : public stream
         
         comma::io::file_descriptor fd() const { return istream_.fd(); }
         
-        unsigned int read_available( std::vector< char >& buffer, unsigned int max_count )
+        bool spliceable() const { return istream_.fd() != comma::io::invalid_file_descriptor; } // plain file, pipe, or socket; decoding streams like lz4 have no file descriptor
+        
+        std::size_t read_available( char* buffer, std::size_t size )
         {
-            std::size_t available = available_();
-            if( available == 0 ) { return 0; }
-            if( binary_ )
-            {
-                unsigned int count = size_ ? available / size_ : 0;
-                if( max_count && count > max_count ) { count = max_count; }
-                if( count == 0 ) { count = 1; } // read at least one packet
-                unsigned int size = size_ ? count * size_ : std::min( available, buffer.size() );
-                istream_->read( &buffer[0], size );
-                return istream_->gcount() <= 0 ? 0 : istream_->gcount();
-            }
-            else
-            {
-                std::string line; // quick and dirty, no-one expects ascii to be fast
-                std::getline( *istream_, line );
-                if( line.empty() ) { return 0; }
-                if( line.size() >= buffer.size() ) { buffer.resize( line.size() + 1 ); }
-                ::memcpy( &buffer[0], &line[0], line.size() );
-                buffer[ line.size() ] = '\n';
-                return line.size() + 1;
-            }
+            if( istream_() == NULL || !istream_->good() ) { return 0; } // e.g. pipe not ready to be opened yet
+            if( !spliceable() && istream_->rdbuf()->in_avail() < 0 ) { istream_->peek(); } // decoding stream: at end, set eof; does not block, thus other inputs are not held up while next block gets decoded
+            size = std::min( available_(), size );
+            if( size == 0 ) { return 0; }
+            istream_->read( buffer, size );
+            return istream_->gcount() <= 0 ? 0 : istream_->gcount();
         }
         
-        bool empty() const { return closed_ || available_() == 0; }
+        bool empty() const { return closed_ || ( istream_() != NULL && !istream_->good() ) || available_() == 0; } // nothing can be read past end of file, whatever in_avail() says
         
-        bool eof() const { return !istream_->good() || istream_->eof(); }
+        bool eof() const { return istream_() != NULL && ( !istream_->good() || istream_->eof() ); }
         
         void close() { closed_ = true; istream_.close(); }
         
@@ -208,8 +212,6 @@ class any_stream : public stream
         
     private:
         comma::io::istream istream_;
-        unsigned int size_;
-        bool binary_;
         std::size_t available_() const // seriously quick and dirty
         {
             if( istream_() == NULL ) { return istream_.available_on_file_descriptor(); } // quick and dirty
@@ -222,18 +224,192 @@ class any_stream : public stream
         bool closed_;
 };
 
-stream* make_stream( const std::string& address, unsigned int size, bool binary )
+class shm_stream : public stream
+{
+    public:
+        shm_stream( const std::string& address )
+            : stream( address )
+            , reader_( comma::io::shm::options( address.substr( address.find( ':' ) + 1 ) ).name )
+            , closed_( false )
+        {
+        }
+
+        comma::io::file_descriptor fd() const { return comma::io::invalid_file_descriptor; }
+
+        std::size_t read_available( char* buffer, std::size_t size ) { return reader_.read( buffer, std::min( reader_.available(), size ) ); }
+
+        bool empty() const { return closed_ || reader_.available() == 0; }
+
+        bool eof() const { return reader_.closed() && reader_.available() == 0; } // the writer publishes the rest of data before closing
+
+        void close() { closed_ = true; reader_.close(); }
+
+        bool closed() const { return closed_; }
+
+    private:
+        comma::io::shm::reader reader_;
+        bool closed_;
+};
+
+stream* make_stream( const std::string& address )
 {
     const std::vector< std::string >& v = comma::split( address, ':' );
     if( v[0] == "udp" ) { return new udp_stream( address ); }
+    if( v[0] == "shm" ) { return new shm_stream( address ); }
     if( v[0] == "zmq-local" || v[0] == "zero-local" || v[0] == "zmq-tcp" || v[0] == "zero-tcp" ) { COMMA_THROW( comma::exception, "io-cat: zmq support not implemented" ); }
-    return new any_stream( address, size, binary );
+    return new any_stream( address );
 }
 
-bool ready( const boost::ptr_vector< stream >& streams, comma::io::select& select )
+/// input stream with its own buffer, in which packets get reassembled:
+/// fixed-size records for binary data with --size, lines for ascii data,
+/// or whatever has been read for a single binary input; keeps track of
+/// how long complete packets wait in the buffer before being output
+class input
 {
-    for( unsigned int i = 0; i < streams.size(); ++i ) { if( !streams[i].empty() ) { select.check(); return true; } }
-    return select.wait( boost::posix_time::seconds( 1 ) ) > 0;
+    public:
+        struct statistics
+        {
+            comma::uint64 packets;
+            comma::uint64 bytes;
+            comma::uint64 latency; // sum of latencies in microseconds
+            comma::uint64 max_latency;
+            statistics() : packets( 0 ), bytes( 0 ), latency( 0 ), max_latency( 0 ) {}
+        };
+
+        input( stream* s, unsigned int size, bool binary, unsigned int weight )
+            : stream_( s )
+            , size_( size )
+            , binary_( binary )
+            , weight_( weight )
+            , buffer_( 65536 )
+            , begin_( 0 )
+            , end_( 0 )
+            , received_( 0 )
+            , consumed_( 0 )
+        {
+        }
+
+        stream& source() { return *stream_; }
+        const stream& source() const { return *stream_; }
+
+        unsigned int weight() const { return weight_; }
+
+        /// read available data, while there is room in the buffer; return number of bytes read
+        std::size_t read( const boost::posix_time::ptime& now )
+        {
+            std::size_t total = 0;
+            while( end_ - begin_ < capacity_ || !ready() )
+            {
+                reserve_( 65536 ); // enough for any datagram
+                std::size_t size = stream_->read_available( &buffer_[end_], buffer_.size() - end_ );
+                if( size == 0 ) { break; }
+                end_ += size;
+                received_ += size;
+                chunks_.push_back( chunk( received_, now ) );
+                total += size;
+            }
+            return total;
+        }
+
+        /// on end of stream, make the last line complete even if it has no end of line
+        /// @return size of incomplete binary packet left, if any
+        std::size_t finish()
+        {
+            if( begin_ == end_ ) { return 0; }
+            if( binary_ ) { return size_ ? ( end_ - begin_ ) % size_ : 0; }
+            if( buffer_[ end_ - 1 ] == '\n' ) { return 0; }
+            reserve_( 1 );
+            buffer_[ end_++ ] = '\n';
+            chunks_.back().end = ++received_;
+            return 0;
+        }
+
+        /// return true, if there is a complete packet to output
+        bool ready() const { return packet_( begin_ ) > 0; }
+
+        /// true, if stream is closed and all its data is output
+        bool done() const { return stream_->closed() && begin_ == end_; }
+
+        /// output up to given number of complete packets (all, if 0); return number of packets output
+        unsigned int write( std::ostream& os, unsigned int budget, const boost::posix_time::ptime& now )
+        {
+            std::size_t begin = begin_;
+            unsigned int count = 0;
+            for( std::size_t size; ( budget == 0 || count < budget ) && ( size = packet_( begin ) ) > 0; ++count )
+            {
+                begin += size;
+                comma::uint64 end = consumed_ + ( begin - begin_ ); // packet is complete, when its last byte arrives
+                while( chunks_.front().end < end ) { chunks_.pop_front(); }
+                comma::uint64 latency = ( now - chunks_.front().time ).total_microseconds();
+                update_( interval_, size, latency );
+                update_( total_, size, latency );
+            }
+            if( count == 0 ) { return 0; }
+            os.write( &buffer_[begin_], begin - begin_ );
+            consumed_ += begin - begin_;
+            begin_ = begin;
+            if( !chunks_.empty() && chunks_.front().end == consumed_ ) { chunks_.pop_front(); }
+            return count;
+        }
+
+        const statistics& total() const { return total_; }
+
+        /// return statistics since previous call
+        statistics interval() { statistics s = interval_; interval_ = statistics(); return s; }
+
+    private:
+        struct chunk
+        {
+            comma::uint64 end; // stream offset
+            boost::posix_time::ptime time;
+            chunk( comma::uint64 end, const boost::posix_time::ptime& time ) : end( end ), time( time ) {}
+        };
+        static const std::size_t capacity_ = 1 << 20; // stop reading, if that much is buffered, until the data is output
+        boost::scoped_ptr< stream > stream_;
+        unsigned int size_;
+        bool binary_;
+        unsigned int weight_;
+        std::vector< char > buffer_;
+        std::size_t begin_;
+        std::size_t end_;
+        comma::uint64 received_;
+        comma::uint64 consumed_;
+        std::deque< chunk > chunks_;
+        statistics interval_;
+        statistics total_;
+
+        std::size_t packet_( std::size_t begin ) const // return size of complete packet at given position or 0
+        {
+            if( begin == end_ ) { return 0; }
+            if( !binary_ ) { const char* p = static_cast< const char* >( ::memchr( &buffer_[begin], '\n', end_ - begin ) ); return p == NULL ? 0 : p - &buffer_[begin] + 1; }
+            if( size_ == 0 ) { return end_ - begin; }
+            return end_ - begin < size_ ? 0 : size_;
+        }
+
+        void reserve_( std::size_t size )
+        {
+            if( begin_ > 0 && ( begin_ == end_ || buffer_.size() - end_ < size ) ) { ::memmove( &buffer_[0], &buffer_[begin_], end_ - begin_ ); end_ -= begin_; begin_ = 0; }
+            if( buffer_.size() - end_ < size ) { buffer_.resize( end_ + size ); }
+        }
+
+        static void update_( statistics& s, std::size_t size, comma::uint64 latency )
+        {
+            ++s.packets;
+            s.bytes += size;
+            s.latency += latency;
+            if( latency > s.max_latency ) { s.max_latency = latency; }
+        }
+};
+
+static std::ostream& operator<<( std::ostream& os, const input::statistics& s )
+{
+    return os << s.packets << " packet(s), " << s.bytes << " byte(s), latency: mean " << ( s.packets ? s.latency / s.packets : 0 ) << "us max " << s.max_latency << "us";
+}
+
+void wait( const boost::ptr_vector< input >& inputs, comma::io::select& select, bool poll )
+{
+    for( unsigned int i = 0; i < inputs.size(); ++i ) { if( inputs[i].ready() || ( !inputs[i].source().closed() && !inputs[i].source().empty() ) ) { select.check(); return; } }
+    select.wait( boost::posix_time::milliseconds( poll ? 1 : 1000 ) ); // poll streams without file descriptor
 }
 
 int main( int argc, char** argv )
@@ -251,57 +427,76 @@ int main( int argc, char** argv )
         unsigned int size = options.value( "--size,-s", 0 );
         bool unbuffered = options.exists( "--flush,--unbuffered,-u" );
         bool exit_on_first_closed = options.exists( "--exit-on-first-closed,-e" );
-        const std::vector< std::string >& unnamed = options.unnamed( "--exit-on-first-closed,-e,--flush,--unbuffered,-u", "-.+" );
+        const std::vector< std::string >& unnamed = options.unnamed( "--exit-on-first-closed,-e,--flush,--unbuffered,-u,--no-splice,--verbose,-v", "-.+" );
         #ifdef WIN32
         if( size || unnamed.size() == 1 ) { _setmode( _fileno( stdout ), _O_BINARY ); }
         #endif
         if( unnamed.empty() ) { std::cerr << "io-cat: please specify at least one source" << std::endl; return 1; }
-        boost::ptr_vector< stream > streams;
+        std::vector< unsigned int > weights( unnamed.size(), 1 );
+        if( options.exists( "--weights" ) )
+        {
+            const std::vector< std::string >& v = comma::split( options.value< std::string >( "--weights" ), ',' );
+            if( v.size() != unnamed.size() ) { std::cerr << "io-cat: expected " << unnamed.size() << " weight(s), got: " << v.size() << std::endl; return 1; }
+            for( unsigned int i = 0; i < v.size(); ++i ) { weights[i] = boost::lexical_cast< unsigned int >( v[i] ); if( weights[i] == 0 ) { std::cerr << "io-cat: expected positive weights, got: " << v[i] << std::endl; return 1; } }
+        }
+        unsigned int round_robin = options.value( "--round-robin", options.exists( "--weights" ) ? 1 : 0 );
+        boost::ptr_vector< input > inputs;
         comma::io::select select;
+        bool poll = false;
         for( unsigned int i = 0; i < unnamed.size(); ++i )
         { 
-            streams.push_back( make_stream( unnamed[i], size, size || unnamed.size() == 1 ) );
-            select.read().add( streams.back() );
+            inputs.push_back( new input( make_stream( unnamed[i] ), size, size || unnamed.size() == 1, weights[i] ) );
+            if( inputs.back().source().fd() == comma::io::invalid_file_descriptor ) { poll = true; } else { select.read().add( inputs.back().source() ); }
+        }
+        const any_stream* single = inputs.size() == 1 ? dynamic_cast< const any_stream* >( &inputs[0].source() ) : NULL;
+        if( single != NULL && single->spliceable() && size == 0 && !options.exists( "--no-splice" ) ) // with --size, check for incomplete record below
+        {
+            comma::io::passthrough passthrough( inputs[0].source().fd(), 1 );
+            bool spliced = passthrough.run();
+            if( verbose ) { std::cerr << "io-cat: passed " << passthrough.size() << " bytes" << ( spliced ? "" : "; splice not supported, fell back to read and write" ) << std::endl; }
+            return 0;
         }
-        const unsigned int max_count = size ? ( size > 65536u ? 1 : 65536u / size ) : 0;
-        std::vector< char > buffer( size ? size * max_count : 65536u );        
-        unsigned int round_robin_count = unnamed.size() > 1 ? options.value( "--round-robin", 0 ) : 0;
-        for( bool done = false; !done; )
+        boost::posix_time::ptime last = boost::posix_time::microsec_clock::universal_time();
+        for( bool exiting = false; true; )
         {
-            if( !ready( streams, select ) ) { continue; }
-            done = true;
-            for( unsigned int i = 0; i < streams.size(); ++i )
+            if( !exiting ) { wait( inputs, select, poll ); } // on timeout, carry on anyway to output statistics
+            boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+            for( unsigned int i = 0; !exiting && i < inputs.size(); ++i ) // read whatever is available into input buffers
             {
-                if( streams[i].closed() ) { continue; }
-                bool ready = select.read().ready( streams[i].fd() );
-                bool empty = streams[i].empty();
-                if( empty && ( streams[i].eof() || ready ) )
-                { 
-                    if( verbose ) { std::cerr << "io-cat: stream " << i << " (" << unnamed[i] << ") closed" << std::endl; }
-                    select.read().remove( streams[i].fd() );
-                    streams[i].close();
-                    if( exit_on_first_closed || select.read()().empty() ) { return 0; }
-                    continue;
-                }
-                if( !ready && empty ) { done = false; continue; }
-                unsigned int countdown = round_robin_count;
-                while( !streams[i].eof() )
+                stream& s = inputs[i].source();
+                if( s.closed() ) { continue; }
+                bool ready = select.read().ready( s.fd() );
+                if( !s.finished( ready ) ) { inputs[i].read( now ); continue; }
+                if( verbose ) { std::cerr << "io-cat: stream " << i << " (" << unnamed[i] << ") closed" << std::endl; }
+                if( s.fd() != comma::io::invalid_file_descriptor ) { select.read().remove( s.fd() ); }
+                s.close();
+                std::size_t incomplete = inputs[i].finish();
+                if( incomplete ) { std::cerr << "io-cat: expected " << size << " byte(s), got only " << incomplete << " on " << s.address() << std::endl; return 1; }
+                exiting = exit_on_first_closed;
+            }
+            bool written = false;
+            for( unsigned int i = 0; i < inputs.size(); ++i ) // output complete packets, not more than the budget of each input per round
+            {
+                written = inputs[i].write( std::cout, exiting ? 0 : round_robin * inputs[i].weight(), now ) > 0 || written;
+            }
+            if( written && unbuffered ) { std::cout.flush(); }
+            bool done = true;
+            for( unsigned int i = 0; done && i < inputs.size(); ++i ) { done = inputs[i].done() || ( exiting && !inputs[i].ready() ); }
+            if( verbose && ( done || ( now - last ) >= boost::posix_time::seconds( 1 ) ) )
+            {
+                double seconds = double( ( now - last ).total_microseconds() ) / 1000000;
+                for( unsigned int i = 0; i < inputs.size(); ++i )
                 {
-                    unsigned int bytes_read = streams[i].read_available( buffer, countdown ? countdown : max_count );
-                    if( bytes_read == 0 ) { break; }
-                    done = false;
-                    if( size && bytes_read % size != 0 ) { std::cerr << "io-cat: expected " << size << " byte(s), got only " << ( bytes_read % size ) << " on " << streams[i].address() << std::endl; return 1; }
-                    std::cout.write( &buffer[0], bytes_read );
-                    if( unbuffered ) { std::cout.flush(); }
-                    if( round_robin_count )
-                    {
-                        countdown -= ( size ? bytes_read / size : 1 );
-                        if( countdown == 0 ) { break; }
-                    }
+                    input::statistics s = inputs[i].interval();
+                    if( s.packets == 0 ) { continue; }
+                    std::cerr << "io-cat: stream " << i << " (" << unnamed[i] << "): " << s << "; " << ( seconds > 0 ? s.packets / seconds : 0 ) << " packet(s)/s, " << ( seconds > 0 ? s.bytes / seconds : 0 ) << " byte(s)/s" << std::endl;
                 }
+                last = now;
             }
+            if( !done ) { continue; }
+            if( verbose ) { for( unsigned int i = 0; i < inputs.size(); ++i ) { std::cerr << "io-cat: stream " << i << " (" << unnamed[i] << "): total: " << inputs[i].total() << std::endl; } }
+            return 0;
         }
-        return 0;
     }
     catch( std::exception& ex ) { std::cerr << "io-cat: " << ex.what() << std::endl; }
     catch( ... ) { std::cerr << "io-cat: unknown exception" << std::endl; }
@@ -39,6 +39,7 @@
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/optional.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
@@ -69,6 +70,14 @@ static void usage( bool verbose = false )
     std::cerr << "    --multiplier,-m: multiplier for packet size, default is 1. The actual packet size will be m * s" << std::endl;
     std::cerr << "    --no-discard: if present, do blocking write to every open stream" << std::endl;
     std::cerr << "    --no-flush: if present, do not flush the output stream (use on high bandwidth sources)" << std::endl;
+    std::cerr << "    --queue-size=<bytes>: queue up to given number of bytes per client and write them out whenever client is ready;" << std::endl;
+    std::cerr << "                          each packet is stored once for all clients; a slow client does not lose data, as long" << std::endl;
+    std::cerr << "                          as it catches up within the queue size, and does not slow down other clients" << std::endl;
+    std::cerr << "    --queue-policy=<policy>: what to do, if a client queue is full; default: drop-newest" << std::endl;
+    std::cerr << "        drop-newest: discard the new packet for this client" << std::endl;
+    std::cerr << "        drop-oldest: discard oldest queued packets for this client" << std::endl;
+    std::cerr << "        block: wait for the client (i.e. the slowest client limits the throughput); same as --no-discard" << std::endl;
+    std::cerr << "    --verbose,-v: on exit, output per-client written and dropped packet counts to stderr (queued mode only)" << std::endl;
     std::cerr << std::endl;
     std::cerr << "client options" << std::endl;
     std::cerr << "    --exit-on-no-clients,-e: once the last client disconnects, exit" << std::endl;
@@ -85,8 +94,22 @@ static void usage( bool verbose = false )
     std::cerr << std::endl;
     std::cerr << "output streams" << std::endl;
     std::cerr << "    tcp:<port>: e.g. tcp:1234" << std::endl;
-    std::cerr << "    udp:<port>: e.g. udp:1234 (todo)" << std::endl;
+    std::cerr << "    udp:<port>[;<options>]: broadcast on udp, e.g. udp:1234" << std::endl;
+    std::cerr << "    udp:<address>:<port>[;<options>]: send to unicast, broadcast, or multicast address, e.g. udp:239.1.1.1:1234" << std::endl;
+    std::cerr << "        each record is sent as a datagram; records larger than datagram size are split into several datagrams" << std::endl;
+    std::cerr << "        options" << std::endl;
+    std::cerr << "            batch=<n>: send datagrams of n records in one system call; default: 1" << std::endl;
+    std::cerr << "            interface=<address>: multicast outgoing interface address" << std::endl;
+    std::cerr << "            sequence: prefix each datagram with 8-byte sequence number, see udp-client --sequence" << std::endl;
+    std::cerr << "            size=<bytes>: maximum datagram size; default: 65507" << std::endl;
+    std::cerr << "            ttl=<n>: multicast time to live, 0 to 255; default: 1" << std::endl;
+    std::cerr << "        e.g: io-publish --size 24 \"udp:239.1.1.1:1234;sequence;batch=16\"" << std::endl;
     std::cerr << "    local:<name>: linux/unix local server socket e.g. local:./tmp/my_socket" << std::endl;
+    std::cerr << "    shm:<name>[;capacity=<bytes>][;record-size=<bytes>]: shared memory ring for clients on the same host, e.g. shm:points" << std::endl;
+    std::cerr << "        clients read it with io-cat shm:<name> or any comma::io::istream; each client has its own read position" << std::endl;
+    std::cerr << "        capacity: ring size; default: 16777216" << std::endl;
+    std::cerr << "        record-size: if given, records never wrap around the end of the ring and only whole records are published" << std::endl;
+    std::cerr << "        without --no-discard, a record is discarded, if the slowest client has no space for it" << std::endl;
     std::cerr << "    <named pipe name>: named pipe, which will be re-opened, if client reconnects" << std::endl;
     std::cerr << "    <filename>: a regular file" << std::endl;
     std::cerr << std::endl;
@@ -102,7 +125,7 @@ class publish
         
         typedef publishers_t::scoped_transaction transaction_t;
         
-        publish( const std::vector< std::string >& filenames, unsigned int packet_size, bool discard, bool flush, bool output_number_of_clients, bool exit_on_no_clients )
+        publish( const std::vector< std::string >& filenames, unsigned int packet_size, bool discard, bool flush, bool output_number_of_clients, bool exit_on_no_clients, const boost::optional< comma::io::publisher::queue >& queue, bool verbose )
             : buffer_( packet_size, '\0' )
             , packet_size_( packet_size )
             , output_number_of_clients_( output_number_of_clients )
@@ -110,6 +133,7 @@ class publish
             , got_first_client_( false )
             , sizes_( filenames.size(), 0 )
             , is_shutdown_( false )
+            , verbose_( verbose )
         {
             struct sigaction new_action, old_action;
             new_action.sa_handler = SIG_IGN;
@@ -117,7 +141,11 @@ class publish
             sigaction( SIGPIPE, NULL, &old_action );
             sigaction( SIGPIPE, &new_action, NULL );
             transaction_t t( publishers_ );
-            for( std::size_t i = 0; i < filenames.size(); ++i ) { t->push_back( new comma::io::publisher( filenames[i], is_binary_() ? comma::io::mode::binary : comma::io::mode::ascii, !discard, flush ) ); }
+            for( std::size_t i = 0; i < filenames.size(); ++i )
+            {
+                comma::io::mode::value mode = is_binary_() ? comma::io::mode::binary : comma::io::mode::ascii;
+                t->push_back( queue ? new comma::io::publisher( filenames[i], mode, *queue ) : new comma::io::publisher( filenames[i], mode, !discard, flush ) );
+            }
             acceptor_thread_.reset( new boost::thread( boost::bind( &publish::accept_, boost::ref( *this ) ) ) );
         }
         
@@ -126,6 +154,11 @@ class publish
             is_shutdown_ = true;
             acceptor_thread_->join();
             transaction_t t( publishers_ );
+            for( std::size_t i = 0; i < t->size() && verbose_; ++i )
+            {
+                const std::vector< comma::io::publisher::client_statistics >& s = ( *t )[i].statistics();
+                for( std::size_t j = 0; j < s.size(); ++j ) { std::cerr << "io-publish: output " << i << ": client " << j << ": written " << s[j].written << " packets, " << s[j].bytes << " bytes; dropped " << s[j].dropped << " packets; queued " << s[j].queued << " bytes" << std::endl; }
+            }
             { for( std::size_t i = 0; i < t->size(); ++i ) { ( *t )[i].close(); } }
         }
         
@@ -190,6 +223,7 @@ class publish
                 select.wait( boost::posix_time::millisec( 100 ) ); // arbitrary timeout
                 transaction_t t( publishers_ );
                 for( unsigned int i = 0; i < t->size(); ++i ) { if( select.read().ready( ( *t )[i].acceptor_file_descriptor() ) ) { ( *t )[i].accept(); } }
+                for( unsigned int i = 0; i < t->size(); ++i ) { ( *t )[i].drain(); } // queued data on idle input
                 handle_sizes_( t );
             }
         }
@@ -203,6 +237,7 @@ class publish
         std::vector< unsigned int > sizes_;
         boost::scoped_ptr< boost::thread > acceptor_thread_;
         bool is_shutdown_;
+        bool verbose_;
 };
 
 int main( int ac, char** av )
@@ -211,6 +246,13 @@ int main( int ac, char** av )
     {
         comma::command_line_options options( ac, av, usage );
         const std::vector< std::string >& names = options.unnamed( "--no-discard,--verbose,-v,--no-flush,--output-number-of-clients,--clients,--exit-on-no-clients,-e", "-.+" );
+        boost::optional< comma::io::publisher::queue > queue;
+        if( options.exists( "--queue-size" ) )
+        {
+            comma::io::publisher::queue::policies policy = options.exists( "--no-discard" ) ? comma::io::publisher::queue::block : comma::io::publisher::queue::drop_newest;
+            if( options.exists( "--queue-policy" ) ) { policy = comma::io::publisher::queue::policy_from_string( options.value< std::string >( "--queue-policy" ) ); }
+            queue = comma::io::publisher::queue( options.value< std::size_t >( "--queue-size" ), policy );
+        }
         if( names.empty() ) { std::cerr << "io-publish: please specify at least one stream; use '-' for stdout" << std::endl; return 1; }
         const boost::array< comma::signal_flag::signals, 2 > signals = { { comma::signal_flag::sigint, comma::signal_flag::sigterm } };
         comma::signal_flag is_shutdown( signals );
@@ -219,7 +261,9 @@ int main( int ac, char** av )
                  , !options.exists( "--no-discard" )
                  , !options.exists( "--no-flush" )
                  , options.exists( "--output-number-of-clients,--clients" )
-                 , options.exists( "--exit-on-no-clients,-e" ) );
+                 , options.exists( "--exit-on-no-clients,-e" )
+                 , queue
+                 , options.exists( "--verbose,-v" ) );
         //ProfilerStart( "io-publish.prof" ); {
         while( std::cin.good() && !is_shutdown && p.read() );
         //ProfilerStop(); }
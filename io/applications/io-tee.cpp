@@ -38,6 +38,7 @@
 #include <boost/array.hpp>
 #include <boost/optional.hpp>
 #include "../../application/command_line_options.h"
+#include "../../io/passthrough.h"
 #include "../../io/select.h"
 #include "../../io/stream.h"
 
@@ -59,6 +60,9 @@ static void show_help( bool verbose = false )
         << "    --dry-run,--dry: print command that will be piped and exit, debug option" << std::endl
         << "    --append,-a: append to output file instead of overwriting" << std::endl
         << "    --unbuffered,-u: unbuffered input and output" << std::endl
+        << "    --no-splice: on linux, data is passed to stdout and command without copying it through user space (see splice(2)" << std::endl
+        << "                 and tee(2)), which also makes it unbuffered; falls back to plain read and write, if not supported" << std::endl
+        << "                 (e.g. for stdout opened for appending on some kernels); use --no-splice to always read and write" << std::endl
         << "    --debug: extra debug output (not for normal use)" << std::endl
         << "    --verbose,-v: more output" << std::endl
         << std::endl
@@ -137,7 +141,7 @@ int main( int ac, char **av )
             std::cerr << std::endl;
         }
         comma::command_line_options options( options_ac, av );
-        const std::vector< std::string >& unnamed = options.unnamed( "--unbuffered,-u,--verbose,-v,--debug,--dry-run,--dry,--append,-a", "-.*" );
+        const std::vector< std::string >& unnamed = options.unnamed( "--unbuffered,-u,--verbose,-v,--debug,--dry-run,--dry,--append,-a,--no-splice", "-.*" );
         if( unnamed.empty() ) { std::cerr << app_name << ": please specify output file name" << std::endl; return 1; }
         if( unnamed.size() > 1 ) { std::cerr << app_name << ": expected one output filename, got: " << comma::join( unnamed, ' ' ) << std::endl; return 1; }
         std::string outfile = unnamed[0];
@@ -158,6 +162,14 @@ int main( int ac, char **av )
         std::cout.flush();
         pipe = ::popen( &command[0], "w" );
         if( pipe == NULL ) { std::cerr << app_name << ": failed to open pipe; command: " << command << std::endl; return 1; }
+        bool passed = false;
+        if( !options.exists( "--no-splice" ) )
+        {
+            comma::io::passthrough passthrough( 0, 1, fileno( pipe ) );
+            bool spliced = passthrough.run();
+            if( verbose ) { std::cerr << app_name << ": passed " << passthrough.size() << " bytes" << ( spliced ? "" : "; splice not supported, fell back to read and write" ) << std::endl; }
+            passed = true;
+        }
         boost::array< char, 0xffff > buffer;
         if ( debug ) { std::cerr << app_name << ": created buffer" << std::endl; }
         comma::io::select stdin_select;
@@ -170,7 +182,7 @@ int main( int ac, char **av )
             std::ios_base::sync_with_stdio( false ); // unsync to make rdbuf()->in_avail() working
             std::cin.tie( NULL ); // std::cin is tied to std::cout by default
         }
-        while( std::cin.good() )
+        while( !passed && std::cin.good() )
         {
             if ( debug ) { std::cerr << app_name << ": loop" << std::endl; }
             std::size_t bytes_to_read = buffer.size();
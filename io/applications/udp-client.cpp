@@ -31,18 +31,26 @@
 /// @author vsevolod vlaskine
 
 #ifndef WIN32
+#include <errno.h>
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
 #endif
+#include <string.h>
 #include <iostream>
 #include <boost/array.hpp>
+#include <boost/asio/ip/multicast.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/static_assert.hpp>
 #include "../../application/contact_info.h"
 #include "../../application/command_line_options.h"
+#include "../../application/signal_flag.h"
 #include "../../base/types.h"
 #include "../../csv/format.h"
+#include "../../string/string.h"
 
 void usage()
 {
@@ -52,30 +60,151 @@ void usage()
     std::cerr << std::endl;
     std::cerr << "usage: udp-client <port> [<options>]" << std::endl;
     std::cerr << std::endl;
+    std::cerr << "exits on empty datagram or on receive error" << std::endl;
+    std::cerr << std::endl;
     std::cerr << "<options>" << std::endl;
     std::cerr << "    --ascii: output timestamp as ascii; default: 64-bit binary" << std::endl;
+    std::cerr << "    --batch=<n>: receive up to n datagrams per system call (recvmmsg() on linux); default: 64" << std::endl;
     std::cerr << "    --binary: output timestamp as 64-bit binary; default" << std::endl;
     std::cerr << "    --delimiter=<delimiter>: if ascii and --timestamp, use this delimiter; default: ','" << std::endl;
+    std::cerr << "    --multicast=<group>[,<interface>]: join multicast group on given or default interface, e.g. --multicast=239.1.1.1" << std::endl;
     std::cerr << "    --size=<size>: hint of maximum buffer size; default 16384" << std::endl;
+    std::cerr << "    --receive-buffer-size,--rcvbuf=<bytes>: socket receive buffer size; if running as root, system limit" << std::endl;
+    std::cerr << "                                            net.core.rmem_max is ignored; see actual size with --verbose" << std::endl;
     std::cerr << "    --reuse-addr,--reuseaddr: reuse udp address/port" << std::endl;
-    std::cerr << "    --timestamp: output packet timestamp (currently just system time)" << std::endl;
+    std::cerr << "    --sequence: datagrams are prefixed with 8-byte sequence number (see io-publish udp sequence option):" << std::endl;
+    std::cerr << "                strip it and report lost or reordered datagrams on stderr" << std::endl;
+    std::cerr << "    --timestamp: output packet timestamp: kernel receive time on linux (see SO_TIMESTAMPNS), otherwise system time" << std::endl;
+    std::cerr << "    --verbose,-v: once a second, report datagrams dropped by kernel (socket receive buffer full)," << std::endl;
+    std::cerr << "                  truncated (larger than --size), or lost (if --sequence), if any; report totals on exit" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
     std::cerr << std::endl;
     exit( 1 );
 }
 
+class receiver // quick and dirty
+{
+    public:
+        struct datagram
+        {
+            const char* data;
+            std::size_t size;
+            boost::posix_time::ptime timestamp;
+            bool truncated;
+            datagram() : data( NULL ), size( 0 ), truncated( false ) {}
+        };
+
+        receiver( int fd, std::size_t size, unsigned int batch ) : fd_( fd ), size_( size ), buffer_( size * batch ), datagrams_( batch ), dropped_( 0 )
+        {
+            #ifdef __linux__
+            int on = 1;
+            ::setsockopt( fd_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof( on ) ); // if fails, system time used
+            ::setsockopt( fd_, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof( on ) ); // if fails, drops not counted
+            messages_.resize( batch );
+            iov_.resize( batch );
+            control_.resize( batch * control_size );
+            for( unsigned int i = 0; i < batch; ++i )
+            {
+                iov_[i].iov_base = &buffer_[ i * size ];
+                iov_[i].iov_len = size;
+                ::memset( &messages_[i], 0, sizeof( ::mmsghdr ) );
+                messages_[i].msg_hdr.msg_iov = &iov_[i];
+                messages_[i].msg_hdr.msg_iovlen = 1;
+                messages_[i].msg_hdr.msg_control = &control_[ i * control_size ];
+            }
+            #endif
+        }
+
+        /// wait for at least one datagram, return number of datagrams received, 0 on timeout or interrupt, -1 on error
+        int receive()
+        {
+            #ifdef __linux__
+            for( unsigned int i = 0; i < messages_.size(); ++i ) { messages_[i].msg_hdr.msg_controllen = control_size; messages_[i].msg_hdr.msg_flags = 0; }
+            int count = ::recvmmsg( fd_, &messages_[0], messages_.size(), MSG_WAITFORONE, NULL );
+            if( count < 0 ) { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1; }
+            boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time(); // if no kernel timestamp
+            for( int i = 0; i < count; ++i )
+            {
+                datagram& d = datagrams_[i];
+                d.data = static_cast< const char* >( iov_[i].iov_base );
+                d.size = std::min( std::size_t( messages_[i].msg_len ), size_ );
+                d.truncated = messages_[i].msg_hdr.msg_flags & MSG_TRUNC;
+                d.timestamp = now;
+                for( ::cmsghdr* c = CMSG_FIRSTHDR( &messages_[i].msg_hdr ); c != NULL; c = CMSG_NXTHDR( &messages_[i].msg_hdr, c ) )
+                {
+                    if( c->cmsg_level != SOL_SOCKET ) { continue; }
+                    if( c->cmsg_type == SCM_TIMESTAMPNS )
+                    {
+                        ::timespec t;
+                        ::memcpy( &t, CMSG_DATA( c ), sizeof( t ) );
+                        d.timestamp = boost::posix_time::from_time_t( t.tv_sec ) + boost::posix_time::microseconds( t.tv_nsec / 1000 );
+                    }
+                    else if( c->cmsg_type == SO_RXQ_OVFL )
+                    {
+                        comma::uint32 dropped;
+                        ::memcpy( &dropped, CMSG_DATA( c ), sizeof( dropped ) );
+                        dropped_ = dropped; // total since socket opened
+                    }
+                }
+            }
+            return count;
+            #else // #ifdef __linux__
+            int size = ::recv( fd_, &buffer_[0], size_, 0 );
+            if( size < 0 ) { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1; }
+            datagrams_[0].data = &buffer_[0];
+            datagrams_[0].size = size;
+            datagrams_[0].timestamp = boost::posix_time::microsec_clock::universal_time();
+            return 1;
+            #endif // #ifdef __linux__
+        }
+
+        const datagram& operator[]( unsigned int i ) const { return datagrams_[i]; }
+
+        /// number of datagrams dropped by kernel, since socket opened
+        comma::uint64 dropped() const { return dropped_; }
+
+    private:
+        int fd_;
+        std::size_t size_;
+        std::vector< char > buffer_;
+        std::vector< datagram > datagrams_;
+        comma::uint64 dropped_;
+        #ifdef __linux__
+        enum { control_size = CMSG_SPACE( sizeof( ::timespec ) ) + CMSG_SPACE( sizeof( comma::uint32 ) ) };
+        std::vector< ::mmsghdr > messages_;
+        std::vector< ::iovec > iov_;
+        std::vector< char > control_;
+        #endif
+};
+
+struct statistics
+{
+    comma::uint64 received;
+    comma::uint64 dropped;
+    comma::uint64 truncated;
+    comma::uint64 lost;
+    statistics() : received( 0 ), dropped( 0 ), truncated( 0 ), lost( 0 ) {}
+    bool operator!=( const statistics& rhs ) const { return dropped != rhs.dropped || truncated != rhs.truncated || lost != rhs.lost; }
+};
+
+static std::ostream& operator<<( std::ostream& os, const statistics& s ) { return os << "received " << s.received << ", dropped by kernel " << s.dropped << ", truncated " << s.truncated << ", lost " << s.lost << " datagram(s)"; }
+
 int main( int argc, char** argv )
 {
     comma::command_line_options options( argc, argv );
     if( argc < 2 || options.exists( "--help,-h" ) ) { usage(); }
-    const std::vector< std::string >& unnamed = options.unnamed( "--ascii,--binary,--reuse-addr,--reuseaddr,--timestamp", "--delimiter,--size" );
+    const std::vector< std::string >& unnamed = options.unnamed( "--ascii,--binary,--reuse-addr,--reuseaddr,--sequence,--timestamp,--verbose,-v", "--batch,--delimiter,--multicast,--receive-buffer-size,--rcvbuf,--size" );
     if( unnamed.empty() ) { std::cerr << "udp-client: please specify port" << std::endl; return 1; }
     unsigned short port = boost::lexical_cast< unsigned short >( unnamed[0] );
     bool timestamped = options.exists( "--timestamp" );
     bool binary = !options.exists( "--ascii" );
     char delimiter = options.value( "--delimiter", ',' );
-    std::vector< char > packet( options.value( "--size", 16384 ) );
+    bool sequenced = options.exists( "--sequence" );
+    bool verbose = options.exists( "--verbose,-v" );
+    std::size_t size = options.value( "--size", 16384 );
+    unsigned int batch = options.value( "--batch", 64 );
+    if( batch == 0 ) { std::cerr << "udp-client: expected positive batch size, got 0" << std::endl; return 1; }
     boost::asio::io_service service;
     boost::asio::ip::udp::socket socket( service );
     socket.open( boost::asio::ip::udp::v4() );
@@ -89,6 +218,38 @@ int main( int argc, char** argv )
     }
     socket.bind( boost::asio::ip::udp::endpoint( boost::asio::ip::udp::v4(), port ), error );
     if( error ) { std::cerr << "udp-client: failed to bind port " << port << std::endl; return 1; }
+    if( options.exists( "--multicast" ) )
+    {
+        const std::vector< std::string >& v = comma::split( options.value< std::string >( "--multicast" ), ',' );
+        boost::asio::ip::address group = boost::asio::ip::address::from_string( v[0], error );
+        if( error || !group.is_multicast() || !group.is_v4() ) { std::cerr << "udp-client: expected ipv4 multicast group address, got \"" << v[0] << "\"" << std::endl; return 1; }
+        boost::asio::ip::address_v4 interface = v.size() > 1 ? boost::asio::ip::address_v4::from_string( v[1], error ) : boost::asio::ip::address_v4::any();
+        if( error ) { std::cerr << "udp-client: expected interface address, got \"" << v[1] << "\"" << std::endl; return 1; }
+        socket.set_option( boost::asio::ip::multicast::join_group( group.to_v4(), interface ), error );
+        if( error ) { std::cerr << "udp-client: failed to join multicast group " << v[0] << ": " << error.message() << std::endl; return 1; }
+    }
+
+    if( options.exists( "--receive-buffer-size,--rcvbuf" ) )
+    {
+        int buffer_size = options.value< int >( "--receive-buffer-size,--rcvbuf" );
+        #ifdef __linux__
+        if( ::setsockopt( socket.native_handle(), SOL_SOCKET, SO_RCVBUFFORCE, &buffer_size, sizeof( buffer_size ) ) != 0 ) // works only with CAP_NET_ADMIN
+        #endif
+        {
+            socket.set_option( boost::asio::socket_base::receive_buffer_size( buffer_size ), error );
+            if( error ) { std::cerr << "udp-client: failed to set receive buffer size " << buffer_size << " on port " << port << ": " << error.message() << std::endl; return 1; }
+        }
+    }
+    if( verbose )
+    {
+        boost::asio::socket_base::receive_buffer_size buffer_size;
+        socket.get_option( buffer_size );
+        std::cerr << "udp-client: port " << port << ": receive buffer size: " << buffer_size.value() << " bytes" << std::endl;
+    }
+    #ifndef WIN32
+    ::timeval timeout = { 1, 0 }; // to check for signals
+    ::setsockopt( socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+    #endif
 
     #ifdef WIN32
     if( binary )
@@ -97,28 +258,64 @@ int main( int argc, char** argv )
     }
     #endif
     
-    while( std::cout.good() )
+    comma::signal_flag is_shutdown;
+    receiver r( socket.native_handle(), size, batch );
+    statistics total;
+    statistics reported;
+    boost::posix_time::ptime last_report = boost::posix_time::microsec_clock::universal_time();
+    comma::uint64 expected = 0;
+    bool first = true;
+    bool done = false;
+    BOOST_STATIC_ASSERT( sizeof( boost::posix_time::ptime ) == sizeof( comma::uint64 ) );
+    while( std::cout.good() && !is_shutdown && !done )
     {
-        boost::system::error_code error;
-        std::size_t size = socket.receive( boost::asio::buffer( packet ), 0, error );
-        if( error || size == 0 ) { break; }
-        if( timestamped )
+        int count = r.receive();
+        if( count < 0 ) { std::cerr << "udp-client: port " << port << ": failed to receive: " << ::strerror( errno ) << std::endl; break; } // as before, exit with 0
+        total.dropped = r.dropped();
+        for( int i = 0; i < count; ++i )
         {
-            boost::posix_time::ptime timestamp = boost::posix_time::microsec_clock::universal_time();
-            BOOST_STATIC_ASSERT( sizeof( boost::posix_time::ptime ) == sizeof( comma::uint64 ) );
-            if( binary )
-            { 
-                static char buf[ sizeof( comma::int64 ) ];
-                comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::to_bin( timestamp, buf );
-                std::cout.write( buf, sizeof( comma::int64 ) );
+            const receiver::datagram& d = r[i];
+            if( d.size == 0 ) { done = true; break; } // as before, empty datagram ends output
+            ++total.received;
+            if( d.truncated ) { ++total.truncated; }
+            std::size_t offset = 0;
+            if( sequenced )
+            {
+                if( d.size < sizeof( comma::uint64 ) ) { std::cerr << "udp-client: expected datagram with sequence number, got " << d.size << " byte(s); discarded" << std::endl; continue; }
+                comma::uint64 sequence;
+                ::memcpy( &sequence, d.data, sizeof( comma::uint64 ) );
+                if( !first && sequence != expected )
+                {
+                    if( sequence > expected ) { total.lost += sequence - expected; std::cerr << "udp-client: lost " << ( sequence - expected ) << " datagram(s) before datagram " << sequence << std::endl; }
+                    else { std::cerr << "udp-client: datagram " << sequence << " out of order or duplicated, expected " << expected << std::endl; }
+                }
+                if( first || sequence >= expected ) { expected = sequence + 1; }
+                first = false;
+                offset = sizeof( comma::uint64 );
             }
-            else
+            if( timestamped )
             {
-                std::cout << boost::posix_time::to_iso_string( timestamp ) << delimiter;
+                if( binary )
+                {
+                    static char buf[ sizeof( comma::int64 ) ];
+                    comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::to_bin( d.timestamp, buf );
+                    std::cout.write( buf, sizeof( comma::int64 ) );
+                }
+                else
+                {
+                    std::cout << boost::posix_time::to_iso_string( d.timestamp ) << delimiter;
+                }
             }
+            std::cout.write( d.data + offset, d.size - offset );
         }
-        std::cout.write( &packet[0], size );
-        std::cout.flush();
-   }
-   return 0;
+        if( count > 0 ) { std::cout.flush(); }
+        if( !verbose ) { continue; }
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        if( now - last_report < boost::posix_time::seconds( 1 ) || !( total != reported ) ) { continue; }
+        std::cerr << "udp-client: port " << port << ": " << total << std::endl;
+        reported = total;
+        last_report = now;
+    }
+    if( verbose ) { std::cerr << "udp-client: port " << port << ": total: " << total << std::endl; }
+    return 0;
 }
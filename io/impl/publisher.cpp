@@ -35,6 +35,13 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #endif
 
 #include <boost/asio/ip/tcp.hpp>
@@ -193,9 +200,37 @@ class zero_acceptor_ : public acceptor
         bool accepted_;
 };
 
+queue::policies queue::policy_from_string( const std::string& s )
+{
+    if( s == "drop-newest" ) { return drop_newest; }
+    if( s == "drop-oldest" ) { return drop_oldest; }
+    if( s == "block" ) { return block; }
+    COMMA_THROW( comma::exception, "expected queue policy: drop-newest, drop-oldest, or block; got: \"" << s << "\"" );
+}
+
 publisher::publisher( const std::string& name, io::mode::value mode, bool blocking, bool flush )
-    : blocking_( blocking ),
-      flush_( flush )
+    : blocking_( blocking )
+    , flush_( flush )
+    , queue_size_( 0 )
+    , policy_( queue::drop_newest )
+{
+    init_( name, mode );
+}
+
+publisher::publisher( const std::string& name, io::mode::value mode, const impl::queue& queue )
+    : blocking_( false )
+    , flush_( false )
+    , queue_size_( queue.size )
+    , policy_( queue.policy )
+{
+#ifdef WIN32
+    COMMA_THROW( comma::exception, "queued publisher: not implemented on windows" );
+#endif
+    if( queue_size_ == 0 ) { COMMA_THROW( comma::exception, "expected non-zero queue size" ); }
+    init_( name, mode );
+}
+
+void publisher::init_( const std::string& name, io::mode::value mode )
 {
     std::vector< std::string > v = comma::split( name, ':' );
     if( v[0] == "tcp" )
@@ -205,7 +240,12 @@ publisher::publisher( const std::string& name, io::mode::value mode, bool blocki
     }
     else if( v[0] == "udp" )
     {
-        COMMA_THROW( comma::exception, "udp: todo" );
+        udp_.reset( new udp_sender( name ) );
+    }
+    else if( v[0] == "shm" )
+    {
+        shm::options options( name.substr( v[0].size() + 1 ) );
+        shm_.reset( new shm::writer( options.name, options.capacity, options.record_size ) );
     }
     else if( v[0] == "local" )
     {
@@ -220,13 +260,7 @@ publisher::publisher( const std::string& name, io::mode::value mode, bool blocki
     }
     else
     {
-        if( name == "-" )
-        {
-            streams_.insert( boost::shared_ptr< io::ostream >( new io::ostream( name, mode ) ) );
-#ifndef WIN32
-            select_.write().add( 1 );
-#endif
-        }
+        if( name == "-" ) { insert_( new io::ostream( name, mode ) ); }
         else
         {
             acceptor_.reset( new file_acceptor( name, mode ) );
@@ -236,7 +270,23 @@ publisher::publisher( const std::string& name, io::mode::value mode, bool blocki
 
 unsigned int publisher::write( const char* buf, std::size_t size, bool do_accept )
 {
+    if( udp_ ) { udp_->write( buf, size ); return 1; }
+    if( shm_ ) // readers attached to the ring are the clients
+    {
+        if( blocking_ || ( queue_size_ > 0 && policy_ == queue::block ) ) { shm_->write( buf, size ); }
+        else if( !shm_->try_write( buf, size ) ) { return 0; }
+        return shm_->readers();
+    }
     if( do_accept ) { accept(); }
+    if( queue_size_ > 0 )
+    {
+        if( size == 0 ) { return 0; }
+        packet p( new std::string( buf, size ) ); // stored once for all clients
+        unsigned int count = 0;
+        for( clients::iterator it = clients_.begin(); it != clients_.end(); ++it ) { if( push_( it->second, p ) ) { ++count; } }
+        drain();
+        return count;
+    }
     if( !blocking_ ) { select_.check(); } // todo: if slow, put all the files in one select
     unsigned int count = 0;
     for( streams::iterator i = streams_.begin(); i != streams_.end(); )
@@ -253,7 +303,15 @@ unsigned int publisher::write( const char* buf, std::size_t size, bool do_accept
 
 void publisher::close()
 {
+    if( udp_ ) { udp_->close(); }
+    if( shm_ ) { shm_->close(); }
     if( acceptor_ ) { acceptor_->close(); }
+    while( drain() > 0 ) // write queued data, while clients keep taking it
+    {
+        io::select select;
+        for( clients::const_iterator it = clients_.begin(); it != clients_.end(); ++it ) { if( !it->second.packets.empty() ) { select.write().add( it->second.fd ); } }
+        if( select.wait( boost::posix_time::seconds( 1 ) ) == 0 ) { break; }
+    }
     while( streams_.begin() != streams_.end() ) { remove_( streams_.begin() ); }
 }
 
@@ -265,20 +323,160 @@ unsigned int publisher::accept()
     {
         io::ostream* s = acceptor_->accept();
         if( s == NULL ) { return count; }
-        streams_.insert( boost::shared_ptr< io::ostream >( s ) );
-        select_.write().add( *s );
+        insert_( s );
         ++count;
     }
 }
 
+void publisher::insert_( io::ostream* s )
+{
+    streams_.insert( boost::shared_ptr< io::ostream >( s ) );
+    select_.write().add( *s );
+#ifndef WIN32
+    if( queue_size_ == 0 ) { return; }
+    io::file_descriptor fd = s->fd();
+    client& c = clients_[s];
+    c.fd = fd;
+    c.statistics.fd = fd;
+    c.flags = ::fcntl( fd, F_GETFL );
+    if( c.flags != -1 ) { ::fcntl( fd, F_SETFL, c.flags | O_NONBLOCK ); }
+    struct stat st;
+    if( ::fstat( fd, &st ) == 0 )
+    {
+        c.socket = S_ISSOCK( st.st_mode );
+        // queued data is written to the descriptor, which io::ostream opens without O_TRUNC, bypassing
+        // its lazily created std::ofstream; thus, truncate named regular files as std::ofstream would,
+        // but not stdout, since it may be redirected in append mode
+        if( S_ISREG( st.st_mode ) && fd != 1 ) { if( ::ftruncate( fd, 0 ) != 0 ) { c.failed = true; } }
+    }
+#endif
+}
+
+bool publisher::push_( client& c, const packet& p ) // return true, if queued
+{
+    if( c.failed ) { return false; }
+    if( !c.packets.empty() && c.statistics.queued + p->size() > queue_size_ ) // a packet larger than queue still goes into empty queue
+    {
+        switch( policy_ )
+        {
+            case queue::drop_newest:
+                ++c.statistics.dropped;
+                return false;
+            case queue::drop_oldest:
+                while( c.packets.size() > ( c.offset > 0 ? 1 : 0 ) && c.statistics.queued + p->size() > queue_size_ ) // partially written packet has to be completed
+                {
+                    std::deque< packet >::iterator it = c.packets.begin() + ( c.offset > 0 ? 1 : 0 );
+                    c.statistics.queued -= ( *it )->size();
+                    c.packets.erase( it );
+                    ++c.statistics.dropped;
+                }
+                if( c.packets.empty() || c.statistics.queued + p->size() <= queue_size_ ) { break; }
+                ++c.statistics.dropped;
+                return false;
+            case queue::block:
+            {
+                io::select select; // wait on this client only, since other clients may be writable all along
+                select.write().add( c.fd );
+                while( !c.packets.empty() && c.statistics.queued + p->size() > queue_size_ )
+                {
+                    select.wait();
+                    if( select.write().ready( c.fd ) && !drain_( c ) ) { c.failed = true; return false; }
+                }
+                break;
+            }
+        }
+    }
+    c.packets.push_back( p );
+    c.statistics.queued += p->size();
+    return true;
+}
+
+bool publisher::drain_( client& c ) // write as much as client takes without blocking, return false on error
+{
+#ifndef WIN32
+    static const std::size_t max_iov = 64;
+    while( !c.packets.empty() )
+    {
+        ::iovec iov[ max_iov ];
+        std::size_t n = 0;
+        std::size_t size = 0;
+        for( std::deque< packet >::const_iterator it = c.packets.begin(); it != c.packets.end() && n < max_iov; ++it, ++n )
+        {
+            std::size_t offset = n == 0 ? c.offset : 0;
+            iov[n].iov_base = const_cast< char* >( ( *it )->data() ) + offset;
+            iov[n].iov_len = ( *it )->size() - offset;
+            size += iov[n].iov_len;
+        }
+        ssize_t result;
+        if( c.socket )
+        {
+            ::msghdr message = ::msghdr();
+            message.msg_iov = iov;
+            message.msg_iovlen = n;
+            result = ::sendmsg( c.fd, &message, MSG_NOSIGNAL ); // no sigpipe on closed connection
+        }
+        else
+        {
+            result = ::writev( c.fd, iov, n );
+        }
+        if( result < 0 ) { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+        std::size_t written = result;
+        c.statistics.bytes += written;
+        c.statistics.queued -= written;
+        while( written > 0 )
+        {
+            std::size_t left = c.packets.front()->size() - c.offset;
+            if( written < left ) { c.offset += written; break; }
+            written -= left;
+            c.offset = 0;
+            c.packets.pop_front();
+            ++c.statistics.written;
+        }
+        if( std::size_t( result ) < size ) { return true; } // client would block
+    }
+#endif
+    return true;
+}
+
+std::size_t publisher::drain()
+{
+    if( udp_ ) { udp_->flush(); }
+    if( clients_.empty() ) { return 0; }
+    select_.check();
+    std::size_t queued = 0;
+    for( streams::iterator i = streams_.begin(); i != streams_.end(); )
+    {
+        streams::iterator it = i++;
+        client& c = clients_[ it->get() ];
+        if( !c.failed && !c.packets.empty() && select_.write().ready( c.fd ) ) { c.failed = !drain_( c ); }
+        if( c.failed ) { remove_( it ); } else { queued += c.statistics.queued; }
+    }
+    return queued;
+}
+
+std::vector< client_statistics > publisher::statistics() const
+{
+    std::vector< client_statistics > v;
+    for( clients::const_iterator it = clients_.begin(); it != clients_.end(); ++it ) { v.push_back( it->second.statistics ); }
+    return v;
+}
+
 void publisher::remove_( streams::iterator it )
 {
+    clients::iterator c = clients_.find( it->get() );
+    if( c != clients_.end() )
+    {
+#ifndef WIN32
+        if( c->second.flags != -1 ) { ::fcntl( c->second.fd, F_SETFL, c->second.flags ); }
+#endif
+        clients_.erase( c );
+    }
     select_.write().remove( **it );
     ( *it )->close();
     if( acceptor_ ) { acceptor_->notify_closed(); }
     streams_.erase( it );
 }
 
-std::size_t publisher::size() const { return streams_.size(); }
+std::size_t publisher::size() const { return streams_.size() + ( udp_ ? 1 : 0 ) + ( shm_ ? shm_->readers() : 0 ); }
 
 } } } // namespace comma { namespace io { namespace impl {
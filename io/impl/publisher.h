@@ -33,12 +33,20 @@
 #ifndef COMMA_IO_IMPL_PUBLISHER_H_
 #define COMMA_IO_IMPL_PUBLISHER_H_
 
+#include <deque>
+#include <map>
 #include <set>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include "../../base/types.h"
 #include "../file_descriptor.h"
 #include "../select.h"
+#include "../shm.h"
 #include "../stream.h"
+#include "udp.h"
 
 namespace comma { namespace io {
     
@@ -57,16 +65,45 @@ struct acceptor
     virtual void close() {}
 };
     
+/// queued publisher parameters
+struct queue
+{
+    /// what to do, if a client queue is full
+    enum policies { drop_newest, drop_oldest, block };
+
+    std::size_t size; // maximum number of queued bytes per client
+    policies policy;
+
+    explicit queue( std::size_t size, policies policy = drop_newest ) : size( size ), policy( policy ) {}
+
+    /// drop-newest | drop-oldest | block
+    static policies policy_from_string( const std::string& s );
+};
+
+/// client counters of queued publisher
+struct client_statistics
+{
+    io::file_descriptor fd;
+    comma::uint64 written; // packets
+    comma::uint64 dropped; // packets
+    comma::uint64 bytes; // bytes written
+    std::size_t queued; // bytes
+    client_statistics() : fd( io::invalid_file_descriptor ), written( 0 ), dropped( 0 ), bytes( 0 ), queued( 0 ) {}
+};
+
 class publisher
 {
     public:
         publisher( const std::string& name, io::mode::value mode, bool blocking = false, bool flush = true );
 
+        publisher( const std::string& name, io::mode::value mode, const impl::queue& queue );
+
         unsigned int write( const char* buf, std::size_t size, bool do_accept = true );
 
         template < typename T >
         impl::publisher& operator<<( const T& lhs ) // quick and dirty, inefficient, but then ascii is meant to be slow...
         {
+            if( queue_size_ > 0 || udp_ || shm_ ) { std::ostringstream oss; oss << lhs; const std::string& s = oss.str(); write( s.data(), s.size() ); return *this; }
             accept();
             select_.check();
             unsigned int count = 0;
@@ -87,6 +124,10 @@ class publisher
         std::size_t size() const;
 
         unsigned int accept();
+
+        std::size_t drain();
+
+        std::vector< client_statistics > statistics() const;
         
         const io::impl::acceptor& acceptor() const { return *acceptor_; }
 
@@ -95,10 +136,32 @@ class publisher
         bool blocking_;
         bool flush_;
         boost::scoped_ptr< io::impl::acceptor > acceptor_;
+        boost::scoped_ptr< io::impl::udp_sender > udp_;
+        boost::scoped_ptr< io::shm::writer > shm_;
         typedef std::set< boost::shared_ptr< io::ostream > > streams;
         streams streams_;
         io::select select_;
+        typedef boost::shared_ptr< const std::string > packet;
+        struct client
+        {
+            io::file_descriptor fd;
+            int flags; // original file status flags
+            bool socket;
+            bool failed;
+            std::deque< packet > packets;
+            std::size_t offset; // bytes of the first packet already written
+            client_statistics statistics;
+            client() : flags( 0 ), socket( false ), failed( false ), offset( 0 ) {}
+        };
+        typedef std::map< const io::ostream*, client > clients;
+        std::size_t queue_size_; // 0: synchronous write
+        queue::policies policy_;
+        clients clients_;
+        void init_( const std::string& name, io::mode::value mode );
+        void insert_( io::ostream* s );
         void remove_( streams::iterator it );
+        bool push_( client& c, const packet& p );
+        bool drain_( client& c );
 };
 
 } } } // namespace comma { namespace io { namespace impl {
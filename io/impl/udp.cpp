@@ -0,0 +1,193 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
+#include "../../base/exception.h"
+#include "../../base/last_error.h"
+#include "../../string/string.h"
+#include "udp.h"
+
+namespace comma { namespace io { namespace impl {
+
+#ifdef WIN32
+
+udp_sender::udp_sender( const std::string& ) : fd_( io::invalid_file_descriptor ), size_( 0 ), batch_( 1 ), sequence_( false ), count_( 0 ), records_( 0 ) { COMMA_THROW( comma::exception, "udp publisher: not implemented on windows" ); }
+udp_sender::~udp_sender() {}
+void udp_sender::write( const char*, std::size_t ) {}
+void udp_sender::flush() {}
+void udp_sender::close() {}
+
+#else // #ifdef WIN32
+
+static ::in_addr address_from_string( const std::string& s )
+{
+    ::in_addr a;
+    if( ::inet_pton( AF_INET, s.c_str(), &a ) == 1 ) { return a; }
+    ::addrinfo hints;
+    ::memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    ::addrinfo* info = NULL;
+    int error = ::getaddrinfo( s.c_str(), NULL, &hints, &info );
+    if( error != 0 || info == NULL ) { COMMA_THROW( comma::exception, "udp publisher: failed to resolve \"" << s << "\": " << ::gai_strerror( error ) ); }
+    a = reinterpret_cast< const ::sockaddr_in* >( info->ai_addr )->sin_addr;
+    ::freeaddrinfo( info );
+    return a;
+}
+
+udp_sender::udp_sender( const std::string& name )
+    : fd_( io::invalid_file_descriptor )
+    , size_( max_size )
+    , batch_( 1 )
+    , sequence_( false )
+    , count_( 0 )
+    , records_( 0 )
+{
+    std::vector< std::string > s = comma::split( name, ';' );
+    std::vector< std::string > v = comma::split( s[0], ':' );
+    if( v[0] != "udp" || v.size() < 2 || v.size() > 3 ) { COMMA_THROW( comma::exception, "expected udp:<port> or udp:<address>:<port>, got \"" << name << "\"" ); }
+    ::memset( &address_, 0, sizeof( address_ ) );
+    address_.sin_family = AF_INET;
+    address_.sin_port = htons( boost::lexical_cast< unsigned short >( v.back() ) );
+    address_.sin_addr.s_addr = v.size() == 2 ? htonl( INADDR_BROADCAST ) : address_from_string( v[1] ).s_addr;
+    unsigned char ttl = 1;
+    boost::optional< ::in_addr > interface;
+    for( unsigned int i = 1; i < s.size(); ++i )
+    {
+        if( s[i].empty() ) { continue; }
+        std::vector< std::string > option = comma::split( s[i], '=' );
+        if( option[0] == "sequence" ) { sequence_ = true; continue; }
+        if( option.size() != 2 ) { COMMA_THROW( comma::exception, "udp publisher: expected <option>=<value>, got \"" << s[i] << "\" in \"" << name << "\"" ); }
+        if( option[0] == "batch" ) { batch_ = boost::lexical_cast< unsigned int >( option[1] ); }
+        else if( option[0] == "interface" ) { interface = address_from_string( option[1] ); }
+        else if( option[0] == "size" ) { size_ = boost::lexical_cast< std::size_t >( option[1] ); }
+        else if( option[0] == "ttl" ) { unsigned int t = boost::lexical_cast< unsigned int >( option[1] ); if( t > 255 ) { COMMA_THROW( comma::exception, "udp publisher: expected ttl from 0 to 255, got " << t ); } ttl = t; }
+        else { COMMA_THROW( comma::exception, "udp publisher: expected option, got \"" << s[i] << "\" in \"" << name << "\"" ); }
+    }
+    if( batch_ == 0 ) { COMMA_THROW( comma::exception, "udp publisher: expected positive batch, got 0" ); }
+    if( size_ > max_size || size_ <= ( sequence_ ? sizeof( comma::uint64 ) : 0 ) ) { COMMA_THROW( comma::exception, "udp publisher: expected datagram size up to " << max_size << ", got " << size_ ); }
+    fd_ = ::socket( AF_INET, SOCK_DGRAM, 0 );
+    if( fd_ < 0 ) { last_error::to_exception( "udp publisher: failed to create socket" ); }
+    int broadcast = 1;
+    if( ::setsockopt( fd_, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof( broadcast ) ) != 0 ) { ::close( fd_ ); last_error::to_exception( "udp publisher: failed to set broadcast option" ); }
+    if( IN_MULTICAST( ntohl( address_.sin_addr.s_addr ) ) )
+    {
+        if( ::setsockopt( fd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof( ttl ) ) != 0 ) { ::close( fd_ ); last_error::to_exception( "udp publisher: failed to set multicast ttl" ); }
+        if( interface && ::setsockopt( fd_, IPPROTO_IP, IP_MULTICAST_IF, &*interface, sizeof( ::in_addr ) ) != 0 ) { ::close( fd_ ); last_error::to_exception( "udp publisher: failed to set multicast interface" ); }
+    }
+}
+
+udp_sender::~udp_sender() { close(); }
+
+void udp_sender::write( const char* buf, std::size_t size )
+{
+    std::size_t header = sequence_ ? sizeof( comma::uint64 ) : 0;
+    std::size_t payload = size_ - header;
+    for( std::size_t offset = 0; offset < size || ( size == 0 && offset == 0 ); offset += payload ) // empty record still is a datagram
+    {
+        std::size_t n = std::min( payload, size - offset );
+        std::size_t begin = buffer_.size();
+        if( sequence_ ) { comma::uint64 sequence = count_ + datagrams_.size(); buffer_.append( reinterpret_cast< const char* >( &sequence ), sizeof( comma::uint64 ) ); }
+        buffer_.append( buf + offset, n );
+        datagrams_.push_back( std::make_pair( begin, header + n ) );
+        if( size == 0 ) { break; }
+    }
+    if( ++records_ >= batch_ ) { flush(); }
+}
+
+void udp_sender::flush()
+{
+    records_ = 0;
+    if( datagrams_.empty() || fd_ == io::invalid_file_descriptor ) { return; }
+    std::vector< ::iovec > iov( datagrams_.size() );
+    for( std::size_t i = 0; i < datagrams_.size(); ++i )
+    {
+        iov[i].iov_base = &buffer_[ datagrams_[i].first ];
+        iov[i].iov_len = datagrams_[i].second;
+    }
+#ifdef __linux__
+    std::vector< ::mmsghdr > messages( datagrams_.size() );
+    for( std::size_t i = 0; i < datagrams_.size(); ++i )
+    {
+        ::memset( &messages[i], 0, sizeof( ::mmsghdr ) );
+        messages[i].msg_hdr.msg_name = &address_;
+        messages[i].msg_hdr.msg_namelen = sizeof( address_ );
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    for( std::size_t i = 0; i < messages.size(); )
+    {
+        int sent = ::sendmmsg( fd_, &messages[i], messages.size() - i, 0 );
+        if( sent > 0 ) { i += sent; continue; }
+        if( errno == EINTR ) { continue; }
+        if( errno == ECONNREFUSED ) { ++i; continue; } // icmp port unreachable from a previous datagram, keep going
+        last_error::to_exception( "udp publisher: sendmmsg() failed" );
+    }
+#else // #ifdef __linux__
+    for( std::size_t i = 0; i < iov.size(); )
+    {
+        ::msghdr message;
+        ::memset( &message, 0, sizeof( message ) );
+        message.msg_name = &address_;
+        message.msg_namelen = sizeof( address_ );
+        message.msg_iov = &iov[i];
+        message.msg_iovlen = 1;
+        if( ::sendmsg( fd_, &message, 0 ) >= 0 || errno == ECONNREFUSED ) { ++i; continue; }
+        if( errno == EINTR ) { continue; }
+        last_error::to_exception( "udp publisher: sendmsg() failed" );
+    }
+#endif // #ifdef __linux__
+    count_ += datagrams_.size();
+    datagrams_.clear();
+    buffer_.clear();
+}
+
+void udp_sender::close()
+{
+    if( fd_ == io::invalid_file_descriptor ) { return; }
+    try { flush(); } catch( ... ) {}
+    ::close( fd_ );
+    fd_ = io::invalid_file_descriptor;
+}
+
+#endif // #ifdef WIN32
+
+} } } // namespace comma { namespace io { namespace impl {
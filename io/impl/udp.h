@@ -0,0 +1,106 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_IO_IMPL_UDP_H_
+#define COMMA_IO_IMPL_UDP_H_
+
+#ifndef WIN32
+#include <netinet/in.h>
+#endif
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "../../base/types.h"
+#include "../file_descriptor.h"
+
+namespace comma { namespace io { namespace impl {
+
+/// udp datagram sender for publisher: unicast, broadcast or multicast
+///
+/// a record larger than datagram size is split into several datagrams;
+/// all the datagrams of a record (or of a batch of records) are sent in
+/// one system call (sendmmsg() on linux)
+///
+/// if sequence option is given, each datagram starts with 8-byte sequence
+/// number (64-bit unsigned, counting datagrams from 0), so that receivers
+/// can detect lost or reordered datagrams
+class udp_sender : public boost::noncopyable
+{
+    public:
+        /// maximum udp payload over ipv4
+        static const std::size_t max_size = 65507;
+
+        /// constructor
+        /// @param name udp:<port>[;<options>]: broadcast to 255.255.255.255:<port>
+        ///             udp:<address>:<port>[;<options>]: unicast, or broadcast, if <address> is a broadcast address, or multicast, if <address> is a multicast group
+        ///     options
+        ///         batch=<n>: send datagrams of n records at once, e.g. for high rates of small records; default: 1
+        ///         interface=<address>: multicast outgoing interface address; default: system routing
+        ///         sequence: prefix each datagram with sequence number
+        ///         size=<bytes>: maximum datagram size including sequence number; default: 65507
+        ///         ttl=<n>: multicast time to live, 0 to 255; default: 1, i.e. local network
+        udp_sender( const std::string& name );
+
+        /// destructor
+        ~udp_sender();
+
+        /// send record (or append to batch)
+        void write( const char* buf, std::size_t size );
+
+        /// send batched datagrams
+        void flush();
+
+        /// flush and close
+        void close();
+
+        /// return socket file descriptor
+        io::file_descriptor fd() const { return fd_; }
+
+        /// return number of datagrams sent so far, which is also the next sequence number
+        comma::uint64 count() const { return count_; }
+
+    private:
+        io::file_descriptor fd_;
+#ifndef WIN32
+        ::sockaddr_in address_;
+#endif
+        std::size_t size_;
+        unsigned int batch_;
+        bool sequence_;
+        comma::uint64 count_;
+        unsigned int records_; // records in current batch
+        std::string buffer_; // datagrams of current batch
+        std::vector< std::pair< std::size_t, std::size_t > > datagrams_; // offset and size in buffer
+};
+
+} } } // namespace comma { namespace io { namespace impl {
+
+#endif // #ifndef COMMA_IO_IMPL_UDP_H_
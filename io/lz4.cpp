@@ -0,0 +1,474 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "../base/exception.h"
+#include "lz4.h"
+
+namespace comma { namespace io { namespace lz4 {
+
+static const unsigned int hash_bits = 12;
+static const std::size_t min_match = 4;
+static const std::size_t last_literals = 5; // as in lz4 block format: last 5 bytes are always literals
+static const std::size_t match_find_limit = 12; // as in lz4 block format: last match starts at least 12 bytes before end
+static const std::size_t max_offset = 65535;
+static const unsigned int skip_trigger = 6; // the longer no match is found, the faster scan goes
+
+static comma::uint32 read32( const unsigned char* p ) { comma::uint32 v; ::memcpy( &v, p, sizeof( v ) ); return v; }
+
+static std::size_t hash( comma::uint32 v ) { return ( v * 2654435761u ) >> ( 32 - hash_bits ); }
+
+static unsigned char* write_length( unsigned char* op, std::size_t length )
+{
+    for( ; length >= 255; length -= 255 ) { *op++ = 255; }
+    *op++ = static_cast< unsigned char >( length );
+    return op;
+}
+
+static unsigned char* write_literals( unsigned char* op, const unsigned char* literals, std::size_t size, unsigned char*& token )
+{
+    token = op++;
+    if( size >= 15 ) { *token = 15 << 4; op = write_length( op, size - 15 ); } else { *token = static_cast< unsigned char >( size << 4 ); }
+    ::memcpy( op, literals, size );
+    return op + size;
+}
+
+std::size_t bound( std::size_t size ) { return size + size / 255 + 16; }
+
+std::size_t compress( const char* source, std::size_t size, char* dest )
+{
+    const unsigned char* src = reinterpret_cast< const unsigned char* >( source );
+    const unsigned char* end = src + size;
+    const unsigned char* anchor = src;
+    unsigned char* op = reinterpret_cast< unsigned char* >( dest );
+    unsigned char* token;
+    if( size > match_find_limit )
+    {
+        comma::uint32 table[ 1 << hash_bits ];
+        ::memset( table, 0, sizeof( table ) );
+        const unsigned char* limit = end - match_find_limit;
+        const unsigned char* match_limit = end - last_literals;
+        const unsigned char* ip = src;
+        while( ip < limit )
+        {
+            comma::uint32 sequence = read32( ip );
+            std::size_t h = hash( sequence );
+            const unsigned char* ref = src + table[h];
+            table[h] = ip - src;
+            if( ref >= ip || std::size_t( ip - ref ) > max_offset || read32( ref ) != sequence ) { ip += 1 + ( ( ip - anchor ) >> skip_trigger ); continue; }
+            while( ip > anchor && ref > src && ip[-1] == ref[-1] ) { --ip; --ref; }
+            const unsigned char* p = ip + min_match;
+            for( const unsigned char* q = ref + min_match; p < match_limit && *p == *q; ++p, ++q );
+            op = write_literals( op, anchor, ip - anchor, token );
+            std::size_t offset = ip - ref;
+            *op++ = offset & 0xff;
+            *op++ = offset >> 8;
+            std::size_t length = p - ip - min_match;
+            if( length >= 15 ) { *token |= 15; op = write_length( op, length - 15 ); } else { *token |= length; }
+            ip = anchor = p;
+        }
+    }
+    op = write_literals( op, anchor, end - anchor, token );
+    return op - reinterpret_cast< unsigned char* >( dest );
+}
+
+std::size_t decompress( const char* source, std::size_t size, char* dest, std::size_t capacity )
+{
+    const unsigned char* ip = reinterpret_cast< const unsigned char* >( source );
+    const unsigned char* end = ip + size;
+    unsigned char* begin = reinterpret_cast< unsigned char* >( dest );
+    unsigned char* op = begin;
+    unsigned char* op_end = begin + capacity;
+    while( ip < end )
+    {
+        unsigned int token = *ip++;
+        std::size_t literals = token >> 4;
+        if( literals == 15 ) { unsigned int s; do { if( ip == end ) { COMMA_THROW( comma::exception, "lz4: malformed input: truncated literal length" ); } s = *ip++; literals += s; } while( s == 255 ); }
+        if( literals > std::size_t( end - ip ) ) { COMMA_THROW( comma::exception, "lz4: malformed input: literals past end of input" ); }
+        if( literals > std::size_t( op_end - op ) ) { COMMA_THROW( comma::exception, "lz4: output exceeds capacity of " << capacity << " bytes" ); }
+        ::memcpy( op, ip, literals );
+        op += literals;
+        ip += literals;
+        if( ip == end ) { break; } // last sequence has literals only
+        if( end - ip < 2 ) { COMMA_THROW( comma::exception, "lz4: malformed input: truncated offset" ); }
+        std::size_t offset = ip[0] | ( std::size_t( ip[1] ) << 8 );
+        ip += 2;
+        if( offset == 0 || offset > std::size_t( op - begin ) ) { COMMA_THROW( comma::exception, "lz4: malformed input: invalid offset " << offset ); }
+        std::size_t length = token & 15;
+        if( length == 15 ) { unsigned int s; do { if( ip == end ) { COMMA_THROW( comma::exception, "lz4: malformed input: truncated match length" ); } s = *ip++; length += s; } while( s == 255 ); }
+        length += min_match;
+        if( length > std::size_t( op_end - op ) ) { COMMA_THROW( comma::exception, "lz4: output exceeds capacity of " << capacity << " bytes" ); }
+        const unsigned char* match = op - offset;
+        if( offset >= length ) { ::memcpy( op, match, length ); op += length; }
+        else { for( unsigned char* e = op + length; op < e; *op++ = *match++ ); } // overlapping match: repeat pattern
+    }
+    return op - begin;
+}
+
+static const char magic[] = "CMZ4";
+static const std::size_t magic_size = 4;
+static const std::size_t frame_header_size = 2 * sizeof( comma::uint32 );
+
+class ostream::streambuf : public std::streambuf
+{
+    public:
+        streambuf( std::ostream& os, std::size_t block_size, std::size_t record_size )
+            : os_( os )
+            , record_size_( record_size == 0 ? 1 : record_size )
+        {
+            buffer_.resize( std::max( block_size / record_size_, std::size_t( 1 ) ) * record_size_ );
+            compressed_.resize( bound( buffer_.size() ) );
+            comma::uint32 size = buffer_.size();
+            os_.write( magic, magic_size );
+            os_.write( reinterpret_cast< const char* >( &size ), sizeof( size ) );
+            setp( &buffer_[0], &buffer_[0] + buffer_.size() );
+        }
+
+        void close() { write_( pptr() - pbase() ); os_.flush(); }
+
+    protected:
+        int_type overflow( int_type c )
+        {
+            write_( pptr() - pbase() );
+            if( !os_.good() ) { return traits_type::eof(); }
+            if( !traits_type::eq_int_type( c, traits_type::eof() ) ) { *pptr() = traits_type::to_char_type( c ); pbump( 1 ); }
+            return traits_type::not_eof( c );
+        }
+
+        int sync() // write only whole records, keep the rest for the next frame
+        {
+            write_( ( pptr() - pbase() ) / record_size_ * record_size_ );
+            os_.flush();
+            return os_.good() ? 0 : -1;
+        }
+
+    private:
+        std::ostream& os_;
+        std::size_t record_size_;
+        std::vector< char > buffer_;
+        std::vector< char > compressed_;
+
+        void write_( std::size_t size ) // write first size bytes of buffer as a frame
+        {
+            if( size == 0 ) { return; }
+            std::size_t compressed = lz4::compress( &buffer_[0], size, &compressed_[0] );
+            bool stored = compressed >= size;
+            comma::uint32 header[2] = { comma::uint32( size ), comma::uint32( stored ? size : compressed ) };
+            os_.write( reinterpret_cast< const char* >( header ), frame_header_size );
+            os_.write( stored ? &buffer_[0] : &compressed_[0], header[1] );
+            std::size_t rest = pptr() - pbase() - size;
+            ::memmove( &buffer_[0], &buffer_[0] + size, rest );
+            setp( &buffer_[0], &buffer_[0] + buffer_.size() );
+            pbump( rest );
+        }
+};
+
+ostream::ostream( std::ostream& os, std::size_t block_size, std::size_t record_size ) : std::ostream( NULL )
+{
+    buf_.reset( new streambuf( os, block_size, record_size ) );
+    rdbuf( buf_.get() );
+}
+
+ostream::ostream( const std::string& filename, std::size_t block_size, std::size_t record_size ) : std::ostream( NULL )
+{
+    file_.reset( new std::ofstream( filename.c_str(), std::ios::binary ) );
+    if( !file_->is_open() ) { COMMA_THROW( comma::exception, "lz4: failed to open \"" << filename << "\"" ); }
+    buf_.reset( new streambuf( *file_, block_size, record_size ) );
+    rdbuf( buf_.get() );
+}
+
+ostream::~ostream() { try { close(); } catch( ... ) {} }
+
+void ostream::close()
+{
+    if( !buf_ ) { return; }
+    buf_->close();
+    if( file_ ) { file_->close(); }
+}
+
+class istream::streambuf : public std::streambuf
+{
+    public:
+        streambuf( std::istream& is )
+            : is_( is )
+            , header_read_( false )
+            , header_end_( -1 )
+            , block_size_( 0 )
+            , position_( 0 )
+            , next_( -1 )
+            , stop_( false )
+            , done_( false )
+        {
+            setg( NULL, NULL, NULL );
+        }
+
+        ~streambuf() { stop_thread_(); }
+
+        void close() { stop_thread_(); }
+
+    protected:
+        int_type underflow()
+        {
+            if( gptr() < egptr() ) { return traits_type::to_int_type( *gptr() ); }
+            if( !thread_ ) { thread_.reset( new boost::thread( boost::bind( &streambuf::run_, this ) ) ); }
+            boost::mutex::scoped_lock lock( mutex_ );
+            while( true )
+            {
+                while( ready_.empty() && !done_ ) { condition_.wait( lock ); }
+                if( ready_.empty() ) { if( !error_.empty() ) { COMMA_THROW( comma::exception, error_ ); } return traits_type::eof(); }
+                free_.push_back( block() );
+                free_.back().swap( current_ );
+                current_.swap( ready_.front() );
+                ready_.pop_front();
+                condition_.notify_all();
+                if( current_.size > 0 ) { break; }
+            }
+            setg( &current_.data[0], &current_.data[0], &current_.data[0] + current_.size );
+            return traits_type::to_int_type( *gptr() );
+        }
+
+        std::streamsize showmanyc() // size of the next decompressed frame, if ready, thus underflow() would not block; -1, if underflow() would fail
+        {
+            if( !thread_ ) { thread_.reset( new boost::thread( boost::bind( &streambuf::run_, this ) ) ); }
+            boost::mutex::scoped_lock lock( mutex_ );
+            for( std::size_t i = 0; i < ready_.size(); ++i ) { if( ready_[i].size > 0 ) { return ready_[i].size; } }
+            return done_ ? -1 : 0;
+        }
+
+        pos_type seekoff( off_type off, std::ios_base::seekdir way, std::ios_base::openmode which )
+        {
+            if( !( which & std::ios_base::in ) ) { return pos_type( off_type( -1 ) ); }
+            off_type position = current_.position + ( gptr() - eback() );
+            off_type target;
+            switch( way )
+            {
+                case std::ios_base::beg: target = off; break;
+                case std::ios_base::cur: target = position + off; break;
+                default: return pos_type( off_type( -1 ) ); // todo: seek from end
+            }
+            if( target < 0 ) { return pos_type( off_type( -1 ) ); }
+            if( target == position ) { return pos_type( target ); }
+            if( comma::uint64( target ) >= current_.position && comma::uint64( target ) < current_.position + current_.size )
+            {
+                setg( eback(), eback() + ( target - current_.position ), egptr() );
+                return pos_type( target );
+            }
+            try { return pos_type( seek_( target ) ); }
+            catch( ... ) { return pos_type( off_type( -1 ) ); }
+        }
+
+        pos_type seekpos( pos_type pos, std::ios_base::openmode which ) { return seekoff( off_type( pos ), std::ios_base::beg, which ); }
+
+    private:
+        struct block
+        {
+            std::vector< char > data;
+            std::size_t size;
+            comma::uint64 position; // uncompressed offset of block
+            std::streamoff next; // offset of the next frame in underlying stream; -1, if not known
+
+            block() : size( 0 ), position( 0 ), next( -1 ) {}
+            void swap( block& rhs ) { data.swap( rhs.data ); std::swap( size, rhs.size ); std::swap( position, rhs.position ); std::swap( next, rhs.next ); }
+        };
+
+        std::istream& is_;
+        bool header_read_;
+        std::streamoff header_end_;
+        comma::uint32 block_size_;
+        comma::uint64 position_; // uncompressed offset of the next frame to read
+        std::streamoff next_; // offset of the next frame to read in underlying stream
+        std::vector< char > compressed_;
+        block current_;
+        std::deque< block > ready_;
+        std::deque< block > free_;
+        boost::scoped_ptr< boost::thread > thread_;
+        boost::mutex mutex_;
+        boost::condition_variable condition_;
+        bool stop_;
+        bool done_;
+        std::string error_;
+
+        void stop_thread_()
+        {
+            if( !thread_ ) { return; }
+            {
+                boost::mutex::scoped_lock lock( mutex_ );
+                stop_ = true;
+                condition_.notify_all();
+            }
+            thread_->join();
+            thread_.reset();
+            stop_ = false;
+            done_ = false;
+            error_.clear();
+            for( ; !ready_.empty(); ready_.pop_front() ) { free_.push_back( block() ); free_.back().swap( ready_.front() ); }
+        }
+
+        void run_() // read-ahead: decompress next frame while the current is consumed
+        {
+            try
+            {
+                if( !header_read_ ) { read_header_(); }
+                while( true )
+                {
+                    block b;
+                    {
+                        boost::mutex::scoped_lock lock( mutex_ );
+                        while( !stop_ && ready_.size() > 1 ) { condition_.wait( lock ); }
+                        if( stop_ ) { return; }
+                        if( !free_.empty() ) { b.swap( free_.back() ); free_.pop_back(); }
+                    }
+                    bool ok = header_read_ && read_( b );
+                    boost::mutex::scoped_lock lock( mutex_ );
+                    if( !ok ) { done_ = true; condition_.notify_all(); return; }
+                    ready_.push_back( block() );
+                    ready_.back().swap( b );
+                    condition_.notify_all();
+                }
+            }
+            catch( std::exception& ex )
+            {
+                boost::mutex::scoped_lock lock( mutex_ );
+                error_ = ex.what();
+                done_ = true;
+                condition_.notify_all();
+            }
+        }
+
+        void read_header_()
+        {
+            char header[ magic_size + sizeof( comma::uint32 ) ];
+            is_.read( header, sizeof( header ) );
+            if( is_.gcount() == 0 ) { return; } // empty stream
+            if( is_.gcount() != std::streamsize( sizeof( header ) ) || ::memcmp( header, magic, magic_size ) != 0 ) { COMMA_THROW( comma::exception, "lz4: expected stream header, got invalid header" ); }
+            ::memcpy( &block_size_, header + magic_size, sizeof( comma::uint32 ) );
+            compressed_.resize( bound( block_size_ ) );
+            header_read_ = true;
+            header_end_ = is_.tellg();
+            next_ = header_end_;
+        }
+
+        bool read_frame_header_( comma::uint32& size, comma::uint32& compressed )
+        {
+            char header[ frame_header_size ];
+            is_.read( header, frame_header_size );
+            if( is_.gcount() == 0 ) { return false; }
+            if( is_.gcount() != std::streamsize( frame_header_size ) ) { COMMA_THROW( comma::exception, "lz4: expected frame header, got end of stream" ); }
+            ::memcpy( &size, header, sizeof( comma::uint32 ) );
+            ::memcpy( &compressed, header + sizeof( comma::uint32 ), sizeof( comma::uint32 ) );
+            if( size > block_size_ ) { COMMA_THROW( comma::exception, "lz4: expected frame size not greater than " << block_size_ << ", got " << size ); }
+            if( compressed > compressed_.size() ) { COMMA_THROW( comma::exception, "lz4: expected compressed frame size not greater than " << compressed_.size() << ", got " << compressed ); }
+            return true;
+        }
+
+        bool read_( block& b )
+        {
+            comma::uint32 size;
+            comma::uint32 compressed;
+            if( !read_frame_header_( size, compressed ) ) { return false; }
+            if( b.data.size() < block_size_ ) { b.data.resize( block_size_ ); }
+            char* p = size == compressed ? &b.data[0] : &compressed_[0];
+            is_.read( p, compressed );
+            if( is_.gcount() != std::streamsize( compressed ) ) { COMMA_THROW( comma::exception, "lz4: expected frame of " << compressed << " bytes, got end of stream" ); }
+            if( size != compressed && decompress( &compressed_[0], compressed, &b.data[0], size ) != size ) { COMMA_THROW( comma::exception, "lz4: frame size does not match its header" ); }
+            b.size = size;
+            b.position = position_;
+            position_ += size;
+            if( next_ >= 0 ) { next_ += frame_header_size + compressed; }
+            b.next = next_;
+            return true;
+        }
+
+        off_type seek_( off_type target ) // skip frames by their headers without decompressing
+        {
+            stop_thread_();
+            if( !header_read_ ) { read_header_(); }
+            bool forward = current_.size > 0 && comma::uint64( target ) >= current_.position + current_.size && current_.next >= 0;
+            std::streamoff offset = forward ? current_.next : header_end_;
+            if( offset < 0 ) { return -1; }
+            is_.clear();
+            is_.seekg( offset );
+            if( !is_.good() ) { return -1; }
+            next_ = offset;
+            position_ = forward ? current_.position + current_.size : 0;
+            while( true )
+            {
+                comma::uint32 size;
+                comma::uint32 compressed;
+                if( !read_frame_header_( size, compressed ) ) // end of stream
+                {
+                    if( comma::uint64( target ) != position_ ) { return -1; }
+                    is_.clear();
+                    current_.size = 0;
+                    current_.position = position_;
+                    current_.next = next_;
+                    setg( NULL, NULL, NULL );
+                    return target;
+                }
+                if( comma::uint64( target ) < position_ + size ) { is_.seekg( next_ ); break; }
+                is_.seekg( compressed, std::ios_base::cur );
+                next_ += frame_header_size + compressed;
+                position_ += size;
+            }
+            if( !read_( current_ ) ) { return -1; }
+            setg( &current_.data[0], &current_.data[0] + ( target - current_.position ), &current_.data[0] + current_.size );
+            return target;
+        }
+};
+
+istream::istream( std::istream& is ) : std::istream( NULL )
+{
+    buf_.reset( new streambuf( is ) );
+    rdbuf( buf_.get() );
+}
+
+istream::istream( const std::string& filename ) : std::istream( NULL )
+{
+    file_.reset( new std::ifstream( filename.c_str(), std::ios::binary ) );
+    if( !file_->is_open() ) { COMMA_THROW( comma::exception, "lz4: failed to open \"" << filename << "\"" ); }
+    buf_.reset( new streambuf( *file_ ) );
+    rdbuf( buf_.get() );
+}
+
+istream::~istream() { close(); }
+
+void istream::close()
+{
+    if( buf_ ) { buf_->close(); }
+    if( file_ ) { file_->close(); }
+}
+
+} } } // namespace comma { namespace io { namespace lz4 {
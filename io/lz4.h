@@ -0,0 +1,119 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_IO_LZ4_H_
+#define COMMA_IO_LZ4_H_
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <boost/scoped_ptr.hpp>
+#include "../base/types.h"
+
+namespace comma { namespace io { namespace lz4 {
+
+/// lz4 block format codec (see lz4 block format description),
+/// self-contained implementation: fast greedy compression, safe decompression
+
+/// return maximum compressed size for given input size
+std::size_t bound( std::size_t size );
+
+/// compress size bytes of source into dest of at least bound( size ) bytes, return compressed size
+std::size_t compress( const char* source, std::size_t size, char* dest );
+
+/// decompress size bytes of source into dest, return decompressed size
+/// @throw comma::exception on malformed input or if output does not fit into capacity
+std::size_t decompress( const char* source, std::size_t size, char* dest, std::size_t capacity );
+
+/// framed compressed stream:
+///     header: magic (4 bytes: "CMZ4"), maximum uncompressed frame size (ui)
+///     frames: uncompressed size (ui), compressed size (ui), data
+///             if compressed size equals uncompressed size, data is stored as is
+///
+/// frames are independent, thus a reader can skip a frame reading only its header
+///
+/// if record size is given, each frame holds a whole number of records,
+/// i.e. record boundaries are aligned to frames
+
+/// compressing output stream
+class ostream : public std::ostream
+{
+    public:
+        /// constructor, write to given stream, which has to stay valid until the lz4 stream is destroyed
+        /// @param block_size maximum uncompressed frame size, rounded down to a multiple of record size
+        /// @param record_size record size in bytes; 1 for no alignment
+        ostream( std::ostream& os, std::size_t block_size = 1 << 20, std::size_t record_size = 1 );
+
+        /// constructor, write to file
+        ostream( const std::string& filename, std::size_t block_size = 1 << 20, std::size_t record_size = 1 );
+
+        /// destructor, writes buffered data
+        ~ostream();
+
+        /// write buffered data and flush underlying stream
+        void close();
+
+    private:
+        class streambuf;
+        boost::scoped_ptr< std::ofstream > file_;
+        boost::scoped_ptr< streambuf > buf_;
+};
+
+/// decompressing input stream; frames are read and decompressed in a background thread,
+/// while the previous frame is consumed
+///
+/// rdbuf()->in_avail() does not block: it returns the number of bytes that can be read
+/// without waiting for decompression, or -1 at end of stream
+///
+/// seekg() on the stream skips whole frames by their headers without decompressing them,
+/// as long as underlying stream is seekable
+class istream : public std::istream
+{
+    public:
+        /// constructor, read from given stream, which has to stay valid until the lz4 stream is destroyed
+        istream( std::istream& is );
+
+        /// constructor, read from file
+        istream( const std::string& filename );
+
+        /// destructor, stops background thread
+        ~istream();
+
+        /// stop background thread and close file
+        void close();
+
+    private:
+        class streambuf;
+        boost::scoped_ptr< std::ifstream > file_;
+        boost::scoped_ptr< streambuf > buf_;
+};
+
+} } } // namespace comma { namespace io { namespace lz4 {
+
+#endif // COMMA_IO_LZ4_H_
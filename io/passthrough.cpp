@@ -0,0 +1,215 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <vector>
+#include "../base/exception.h"
+#include "passthrough.h"
+
+namespace comma { namespace io {
+
+#ifdef __linux__
+
+static const std::size_t chunk_size = 1 << 20;
+
+static bool is_pipe( int fd ) { struct stat s; return ::fstat( fd, &s ) == 0 && S_ISFIFO( s.st_mode ); }
+
+static bool unsupported( int error ) { return error == EINVAL || error == ENOSYS || error == EOPNOTSUPP; }
+
+static void wait( int from, int to ) // if file descriptors are non-blocking
+{
+    ::pollfd p = { from, POLLIN, 0 };
+    if( ::poll( &p, 1, 0 ) == 1 ) { p.fd = to; p.events = POLLOUT; } // input ready, thus output is not
+    ::poll( &p, 1, 1000 );
+}
+
+template < typename F >
+static ssize_t call( F f, int from, int to, std::size_t size, const char* what ) // return number of bytes, 0 on end of input, -1, if not supported
+{
+    while( true )
+    {
+        ssize_t n = f( from, to, size );
+        if( n >= 0 ) { return n; }
+        if( errno == EINTR ) { continue; }
+        if( errno == EAGAIN ) { wait( from, to ); continue; }
+        if( unsupported( errno ) ) { return -1; }
+        COMMA_THROW( comma::exception, what << "() failed: " << ::strerror( errno ) );
+    }
+}
+
+static ssize_t splice( int from, int to, std::size_t size ) { return ::splice( from, NULL, to, NULL, size, SPLICE_F_MOVE ); }
+
+static ssize_t tee( int from, int to, std::size_t size ) { return ::tee( from, to, size, 0 ); }
+
+#endif // #ifdef __linux__
+
+#ifndef WIN32
+
+static void write( int fd, const char* buf, std::size_t size )
+{
+    while( size > 0 )
+    {
+        ssize_t n = ::write( fd, buf, size );
+        if( n > 0 ) { buf += n; size -= n; continue; }
+        if( errno == EINTR ) { continue; }
+        if( errno == EAGAIN ) { ::pollfd p = { fd, POLLOUT, 0 }; ::poll( &p, 1, 1000 ); continue; }
+        COMMA_THROW( comma::exception, "write() failed: " << ::strerror( errno ) );
+    }
+}
+
+static void copy( int from, std::size_t size, int to, int copy ) // fallback: copy given number of bytes through user space
+{
+    std::vector< char > buffer( std::min( size, std::size_t( 65536 ) ) );
+    while( size > 0 )
+    {
+        ssize_t n = ::read( from, &buffer[0], std::min( size, buffer.size() ) );
+        if( n < 0 && errno == EINTR ) { continue; }
+        if( n < 0 && errno == EAGAIN ) { ::pollfd p = { from, POLLIN, 0 }; ::poll( &p, 1, 1000 ); continue; }
+        if( n <= 0 ) { COMMA_THROW( comma::exception, "read() failed: " << ( n == 0 ? "unexpected end of input" : ::strerror( errno ) ) ); }
+        write( to, &buffer[0], n );
+        if( copy != io::invalid_file_descriptor ) { write( copy, &buffer[0], n ); }
+        size -= n;
+    }
+}
+
+#endif // #ifndef WIN32
+
+passthrough::passthrough( io::file_descriptor in, io::file_descriptor out, io::file_descriptor copy )
+    : in_( in )
+    , out_( out )
+    , copy_( copy )
+    , size_( 0 )
+{
+    pipe_[0] = pipe_[1] = io::invalid_file_descriptor;
+}
+
+passthrough::~passthrough()
+{
+#ifdef __linux__
+    if( pipe_[0] != io::invalid_file_descriptor ) { ::close( pipe_[0] ); ::close( pipe_[1] ); }
+#endif
+}
+
+bool passthrough::move_( io::file_descriptor from, io::file_descriptor to, std::size_t size ) // move data that already is in pipe
+{
+#ifdef __linux__
+    while( size > 0 )
+    {
+        ssize_t n = call( &io::splice, from, to, size, "splice" );
+        if( n < 0 ) { return false; }
+        if( n == 0 ) { COMMA_THROW( comma::exception, "splice(): unexpected end of input" ); }
+        size -= n;
+        size_ += n;
+    }
+    return true;
+#else
+    (void)from; (void)to; (void)size;
+    return false;
+#endif
+}
+
+bool passthrough::run()
+{
+#ifdef WIN32
+    COMMA_THROW( comma::exception, "not implemented on windows" );
+#else
+    if( splice_() ) { return true; }
+    std::vector< char > buffer( 65536 ); // not supported: carry on with read() and write()
+    while( true )
+    {
+        ssize_t n = ::read( in_, &buffer[0], buffer.size() );
+        if( n < 0 && errno == EINTR ) { continue; }
+        if( n < 0 && errno == EAGAIN ) { ::pollfd p = { in_, POLLIN, 0 }; ::poll( &p, 1, 1000 ); continue; }
+        if( n == 0 ) { return false; }
+        if( n < 0 ) { COMMA_THROW( comma::exception, "read() failed: " << ::strerror( errno ) ); }
+        io::write( out_, &buffer[0], n );
+        if( copy_ != io::invalid_file_descriptor ) { io::write( copy_, &buffer[0], n ); }
+        size_ += n;
+    }
+#endif
+}
+
+bool passthrough::splice_()
+{
+#ifdef __linux__
+    bool through_pipe = !is_pipe( in_ ) && ( copy_ != io::invalid_file_descriptor || !is_pipe( out_ ) );
+    if( through_pipe && pipe_[0] == io::invalid_file_descriptor )
+    {
+        if( ::pipe( pipe_ ) != 0 ) { return false; }
+        ::fcntl( pipe_[1], F_SETPIPE_SZ, int( chunk_size ) ); // fewer system calls; harmlessly fails, if above system limit
+    }
+    while( true )
+    {
+        if( !through_pipe && copy_ == io::invalid_file_descriptor ) // input or output is a pipe: splice directly
+        {
+            ssize_t size = call( &io::splice, in_, out_, chunk_size, "splice" );
+            if( size <= 0 ) { return size == 0; }
+            size_ += size;
+            continue;
+        }
+        if( !through_pipe ) // input is a pipe: duplicate data to copy, then move the same data to output
+        {
+            ssize_t size = call( &io::tee, in_, copy_, chunk_size, "tee" );
+            if( size <= 0 ) { return size == 0; }
+            comma::uint64 size_before = size_;
+            if( move_( in_, out_, size ) ) { continue; }
+            std::size_t left = size - ( size_ - size_before );
+            io::copy( in_, left, out_, io::invalid_file_descriptor );
+            size_ += left;
+            return false;
+        }
+        ssize_t size = call( &io::splice, in_, pipe_[1], chunk_size, "splice" ); // input is not a pipe: read into internal pipe
+        if( size <= 0 ) { return size == 0; }
+        for( std::size_t left = size; left > 0; )
+        {
+            ssize_t teed = copy_ == io::invalid_file_descriptor ? ssize_t( left ) : call( &io::tee, pipe_[0], copy_, left, "tee" );
+            if( teed <= 0 ) { io::copy( pipe_[0], left, out_, copy_ ); size_ += left; return false; }
+            comma::uint64 size_before = size_;
+            if( move_( pipe_[0], out_, teed ) ) { left -= teed; continue; }
+            std::size_t rest = teed - ( size_ - size_before );
+            io::copy( pipe_[0], rest, out_, io::invalid_file_descriptor );
+            io::copy( pipe_[0], left - teed, out_, copy_ );
+            size_ += left - ( teed - rest );
+            return false;
+        }
+    }
+#else // #ifdef __linux__
+    return false;
+#endif // #ifdef __linux__
+}
+
+} } // namespace comma { namespace io {
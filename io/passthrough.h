@@ -0,0 +1,80 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_IO_PASSTHROUGH_H_
+#define COMMA_IO_PASSTHROUGH_H_
+
+#include <boost/noncopyable.hpp>
+#include "../base/types.h"
+#include "file_descriptor.h"
+
+namespace comma { namespace io {
+
+/// zero-copy passthrough from one file descriptor to another and optionally
+/// to a pipe, using splice() and tee() on linux: data does not get copied
+/// to user space
+///
+/// splice() needs a pipe on one side and tee() on both sides, thus if input
+/// is not a pipe, data goes through an internal pipe
+///
+/// if it turns out that splice() or tee() are not supported for given file
+/// descriptors (e.g. output is a terminal or a file opened for appending),
+/// run() carries on with plain read() and write()
+class passthrough : public boost::noncopyable
+{
+    public:
+        /// constructor
+        /// @param in input
+        /// @param out output
+        /// @param copy if valid, duplicate data to it; has to be a pipe
+        passthrough( io::file_descriptor in, io::file_descriptor out, io::file_descriptor copy = io::invalid_file_descriptor );
+
+        /// destructor
+        ~passthrough();
+
+        /// transfer data until end of input
+        /// @return true, if all data was spliced, false, if it fell back to read() and write()
+        bool run();
+
+        /// return number of bytes transferred so far
+        comma::uint64 size() const { return size_; }
+
+    private:
+        io::file_descriptor in_;
+        io::file_descriptor out_;
+        io::file_descriptor copy_;
+        io::file_descriptor pipe_[2]; // internal pipe, if needed
+        comma::uint64 size_;
+        bool splice_();
+        bool move_( io::file_descriptor from, io::file_descriptor to, std::size_t size );
+};
+
+} } // namespace comma { namespace io {
+
+#endif // COMMA_IO_PASSTHROUGH_H_
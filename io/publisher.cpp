@@ -36,12 +36,18 @@ namespace comma { namespace io {
 
 publisher::publisher( const std::string& name, comma::io::mode::value mode, bool blocking, bool flush ) : pimpl_( new impl::publisher( name, mode, blocking, flush ) ) {}
 
+publisher::publisher( const std::string& name, comma::io::mode::value mode, const queue& q ) : pimpl_( new impl::publisher( name, mode, q ) ) {}
+
 publisher::~publisher() { delete pimpl_; }
 
 std::size_t publisher::write( const char* buf, std::size_t size, bool do_accept ) { return pimpl_->write( buf, size, do_accept ); }
 
 unsigned int publisher::accept() { return pimpl_->accept(); }
 
+std::size_t publisher::drain() { return pimpl_->drain(); }
+
+std::vector< publisher::client_statistics > publisher::statistics() const { return pimpl_->statistics(); }
+
 void publisher::close() { pimpl_->close(); }
 
 std::size_t publisher::size() const { return pimpl_->size(); }
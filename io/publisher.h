@@ -35,6 +35,7 @@
 
 #include <stdlib.h>
 #include <string>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include "stream.h"
 #include "impl/publisher.h"
@@ -46,9 +47,14 @@ class publisher : public boost::noncopyable
 {
     public:
         /// constructor
-        /// @param name ::= tcp:<port> | udp:<port> | <filename>
+        /// @param name ::= tcp:<port> | udp:[<address>:]<port>[;<options>] | shm:<name>[;<options>] | <filename>
         ///     if tcp:<port>, create tcp server
-        ///     @todo if udp:<port>, broadcast on udp
+        ///     if udp:<port>, broadcast on udp; if udp:<address>:<port>, send to unicast,
+        ///         broadcast, or multicast address; records larger than datagram size
+        ///         are split into several datagrams; see impl::udp_sender for options
+        ///     if shm:<name>[;capacity=<bytes>][;record-size=<bytes>], write to shared memory ring,
+        ///         readers attached to the ring are the clients (see shm.h); if not blocking,
+        ///         a record is discarded, if the slowest reader has no space for it
         ///     if <filename> is a regular file, just write to it
         ///     if <filename> is named pipe, keep reopening it, if closed
         ///     @todo if <filename> is Linux domain socket, create Linux domain socket server
@@ -56,6 +62,23 @@ class publisher : public boost::noncopyable
         /// @param blocking if true, blocking write to a client, otherwise discard, if client not ready
         publisher( const std::string& name, io::mode::value mode, bool blocking = false, bool flush = true );
 
+        /// queued publishing parameters: maximum number of queued bytes per client
+        /// and what to do, if a client queue is full: drop the new packet, drop
+        /// oldest packets, or wait for the client
+        typedef impl::queue queue;
+
+        /// client counters
+        typedef impl::client_statistics client_statistics;
+
+        /// constructor for queued publishing: write() stores each packet once
+        /// in a reference-counted buffer and queues it to every client;
+        /// queues are written out without blocking with writev() whenever
+        /// clients are ready, thus a slow client does not lose data as long
+        /// as it catches up within its queue size, and does not slow down others,
+        /// unless queue policy is block
+        /// @note not implemented on windows
+        publisher( const std::string& name, io::mode::value mode, const queue& q );
+
         /// destructor
         ~publisher();
 
@@ -82,6 +105,13 @@ class publisher : public boost::noncopyable
         /// accept waiting clients, non-blocking
         /// @return number of clients accepted
         unsigned int accept();
+
+        /// queued publishing: write queued packets to ready clients, non-blocking
+        /// @return number of bytes still queued
+        std::size_t drain();
+
+        /// queued publishing: return counters for current clients
+        std::vector< client_statistics > statistics() const;
         
         /// return acceptor file descriptor
         file_descriptor acceptor_file_descriptor() const;
@@ -32,15 +32,121 @@
 
 #ifndef WIN32
 #include <cerrno>
+#include <unistd.h>
 #endif
 
+#include <limits>
 #include <string>
 #include "../base/exception.h"
 #include "../base/last_error.h"
+#include "../base/types.h"
 #include "select.h"
 
 namespace comma { namespace io {
-    
+
+#ifdef COMMA_IO_SELECT_EPOLL
+
+select::select() : epoll_fd_( -1 ) { init_(); }
+
+select::select( const select& rhs ) : read_descriptors_( rhs.read_descriptors_ ), write_descriptors_( rhs.write_descriptors_ ), except_descriptors_( rhs.except_descriptors_ ), epoll_fd_( -1 ) { init_(); }
+
+select::~select() { ::close( epoll_fd_ ); }
+
+select& select::operator=( const select& rhs )
+{
+    if( this == &rhs ) { return *this; }
+    ::close( epoll_fd_ );
+    epoll_fd_ = -1;
+    read_descriptors_.descriptors_ = rhs.read_descriptors_.descriptors_;
+    write_descriptors_.descriptors_ = rhs.write_descriptors_.descriptors_;
+    except_descriptors_.descriptors_ = rhs.except_descriptors_.descriptors_;
+    init_();
+    return *this;
+}
+
+void select::init_()
+{
+    read_descriptors_.select_ = write_descriptors_.select_ = except_descriptors_.select_ = this;
+    read_descriptors_.ready_.clear();
+    write_descriptors_.ready_.clear();
+    except_descriptors_.ready_.clear();
+    interest_.clear();
+    unpollable_.clear();
+    epoll_fd_ = ::epoll_create1( EPOLL_CLOEXEC );
+    if( epoll_fd_ < 0 ) { last_error::to_exception( "epoll_create1() failed" ); }
+    for( std::set< file_descriptor >::const_iterator it = read_descriptors_.descriptors_.begin(); it != read_descriptors_.descriptors_.end(); ++it ) { update_( *it, true ); }
+    for( std::set< file_descriptor >::const_iterator it = write_descriptors_.descriptors_.begin(); it != write_descriptors_.descriptors_.end(); ++it ) { update_( *it, true ); }
+    for( std::set< file_descriptor >::const_iterator it = except_descriptors_.descriptors_.begin(); it != except_descriptors_.descriptors_.end(); ++it ) { update_( *it, true ); }
+}
+
+void select::update_( file_descriptor fd, bool added )
+{
+    unsigned int events = ( read_descriptors_.descriptors_.find( fd ) == read_descriptors_.descriptors_.end() ? 0 : static_cast< unsigned int >( EPOLLIN ) )
+                        | ( write_descriptors_.descriptors_.find( fd ) == write_descriptors_.descriptors_.end() ? 0 : static_cast< unsigned int >( EPOLLOUT ) )
+                        | ( except_descriptors_.descriptors_.find( fd ) == except_descriptors_.descriptors_.end() ? 0 : static_cast< unsigned int >( EPOLLPRI ) );
+    boost::unordered_map< file_descriptor, unsigned int >::iterator it = interest_.find( fd );
+    if( events == 0 )
+    {
+        unpollable_.erase( fd );
+        if( it == interest_.end() ) { return; }
+        interest_.erase( it );
+        ::epoll_event e = ::epoll_event();
+        ::epoll_ctl( epoll_fd_, EPOLL_CTL_DEL, fd, &e ); // descriptor may already be closed, no harm
+        return;
+    }
+    if( unpollable_.find( fd ) != unpollable_.end() ) { return; }
+    if( !added && it != interest_.end() && it->second == events ) { return; }
+    ::epoll_event e = ::epoll_event();
+    e.events = events;
+    e.data.fd = fd;
+    // modify on re-adding descriptors, since a closed and reopened descriptor with the same number may have been dropped by epoll
+    if( it != interest_.end() && ::epoll_ctl( epoll_fd_, EPOLL_CTL_MOD, fd, &e ) == 0 ) { it->second = events; return; }
+    if( ::epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, fd, &e ) == 0 || ( errno == EEXIST && ::epoll_ctl( epoll_fd_, EPOLL_CTL_MOD, fd, &e ) == 0 ) ) { interest_[fd] = events; return; }
+    if( errno == EPERM ) { if( it != interest_.end() ) { interest_.erase( it ); } unpollable_.insert( fd ); return; } // regular file, /dev/null, etc
+    last_error::to_exception( "epoll_ctl() failed" );
+}
+
+std::size_t select::wait_( int timeout )
+{
+    read_descriptors_.ready_.clear();
+    write_descriptors_.ready_.clear();
+    except_descriptors_.ready_.clear();
+    if( interest_.empty() && unpollable_.empty() ) { return 0; } // same as ::select() semantics above
+    std::size_t count = 0;
+    if( !interest_.empty() )
+    {
+        events_.resize( interest_.size() );
+        int size = ::epoll_wait( epoll_fd_, &events_[0], events_.size(), unpollable_.empty() ? timeout : 0 );
+        if( size < 0 && errno != EINTR ) { last_error::to_exception( "epoll_wait() failed" ); } // do no throw if interrupted by signal
+        for( int i = 0; i < size; ++i ) // same conditions as linux ::select()
+        {
+            file_descriptor fd = events_[i].data.fd;
+            unsigned int events = events_[i].events;
+            if( ( events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) && read_descriptors_.descriptors_.find( fd ) != read_descriptors_.descriptors_.end() ) { read_descriptors_.ready_.insert( fd ); ++count; }
+            if( ( events & ( EPOLLOUT | EPOLLERR ) ) && write_descriptors_.descriptors_.find( fd ) != write_descriptors_.descriptors_.end() ) { write_descriptors_.ready_.insert( fd ); ++count; }
+            if( ( events & EPOLLPRI ) && except_descriptors_.descriptors_.find( fd ) != except_descriptors_.descriptors_.end() ) { except_descriptors_.ready_.insert( fd ); ++count; }
+        }
+    }
+    for( std::set< file_descriptor >::const_iterator it = unpollable_.begin(); it != unpollable_.end(); ++it )
+    {
+        if( read_descriptors_.descriptors_.find( *it ) != read_descriptors_.descriptors_.end() ) { read_descriptors_.ready_.insert( *it ); ++count; }
+        if( write_descriptors_.descriptors_.find( *it ) != write_descriptors_.descriptors_.end() ) { write_descriptors_.ready_.insert( *it ); ++count; }
+    }
+    return count;
+}
+
+std::size_t select::wait() { return wait_( -1 ); }
+
+std::size_t select::wait( unsigned int timeout_seconds, unsigned int timeout_nanoseconds )
+{
+    comma::uint64 milliseconds = comma::uint64( timeout_seconds ) * 1000 + ( timeout_nanoseconds + 999999 ) / 1000000;
+    return wait_( milliseconds > comma::uint64( std::numeric_limits< int >::max() ) ? std::numeric_limits< int >::max() : int( milliseconds ) );
+}
+
+select::descriptors::descriptors() : select_( NULL ) {}
+
+#else // #ifdef COMMA_IO_SELECT_EPOLL
+
 static std::size_t select_impl_( int nfds, fd_set* fdr, fd_set* fdw, fd_set* fde, struct timeval* t )
 {
     if( fdr == NULL && fdw == NULL && fde == NULL ) { return 0; } // good semantics?
@@ -88,17 +194,21 @@ std::size_t select::wait( unsigned int timeout_seconds, unsigned int timeout_nan
                        , &t );
 }
 
-std::size_t select::wait( boost::posix_time::time_duration timeout )
+select::select() { read_descriptors_.select_ = write_descriptors_.select_ = except_descriptors_.select_ = this; }
+
+select::select( const select& rhs ) : read_descriptors_( rhs.read_descriptors_ ), write_descriptors_( rhs.write_descriptors_ ), except_descriptors_( rhs.except_descriptors_ ) { read_descriptors_.select_ = write_descriptors_.select_ = except_descriptors_.select_ = this; }
+
+select::~select() {}
+
+select& select::operator=( const select& rhs )
 {
-    unsigned int sec = timeout.total_seconds();
-	unsigned int nanosec = ( static_cast< unsigned int >( timeout.total_microseconds() ) - sec * 1000000 ) * 1000;
-//     std::cerr << "select wait " << sec << " , " << nanosec << std::endl;
-    return wait( sec, nanosec );
+    read_descriptors_.descriptors_ = rhs.read_descriptors_.descriptors_;
+    write_descriptors_.descriptors_ = rhs.write_descriptors_.descriptors_;
+    except_descriptors_.descriptors_ = rhs.except_descriptors_.descriptors_;
+    return *this;
 }
 
-std::size_t select::check() { return wait( 0 ); }
-
-select::descriptors::descriptors()
+select::descriptors::descriptors() : select_( NULL )
 {
     reset_fds_();
 }
@@ -120,4 +230,16 @@ fd_set* select::descriptors::reset_fds_()
     return &fd_set_;
 }
 
+#endif // #ifdef COMMA_IO_SELECT_EPOLL
+
+std::size_t select::wait( boost::posix_time::time_duration timeout )
+{
+    unsigned int sec = timeout.total_seconds();
+	unsigned int nanosec = ( static_cast< unsigned int >( timeout.total_microseconds() ) - sec * 1000000 ) * 1000;
+//     std::cerr << "select wait " << sec << " , " << nanosec << std::endl;
+    return wait( sec, nanosec );
+}
+
+std::size_t select::check() { return wait( 0 ); }
+
 } } // namespace comma { namespace io {
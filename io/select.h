@@ -39,9 +39,16 @@
 #include "sys/select.h"
 #endif
 
+#if defined( __linux__ ) && !defined( COMMA_IO_SELECT_NO_EPOLL ) // define COMMA_IO_SELECT_NO_EPOLL to fall back to ::select()
+#define COMMA_IO_SELECT_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #include <cassert>
 #include <set>
+#include <vector>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
 #include "../base/exception.h"
 #include "file_descriptor.h"
@@ -61,13 +68,40 @@ namespace comma { namespace io {
 ///       only on sockets, therefore, WSAStartup will be called from our
 ///       socket library; but the latter solution indirectly relies on
 ///       something extrinsic to select and therefore is not good.
+///
+/// on linux, implemented with level-triggered epoll: the interest set is
+/// updated on add() and remove() rather than rebuilt on each wait, thus
+/// wait is not O(max fd) and descriptors are not limited by FD_SETSIZE;
+/// descriptors that epoll does not support (e.g. regular files) are
+/// reported as always ready, as ::select() does
+///
+/// differences from ::select() on linux:
+///     - descriptors::add() may throw, if epoll_ctl() fails, e.g. on an invalid
+///       descriptor, while ::select() would fail in wait() with EBADF
+///     - a descriptor closed after add() silently drops out of the epoll interest
+///       set: it is never reported ready and wait() does not fail with EBADF;
+///       thus, remove descriptors before closing them
+///     - timeouts are rounded up to whole milliseconds (epoll_wait() resolution)
 class select
 {
     public:
+        /// constructor
+        select();
+
+        /// copy constructor
+        select( const select& rhs );
+
+        /// destructor
+        ~select();
+
+        /// assignment
+        select& operator=( const select& rhs );
+
         /// blocking wait, if OK, returns what select() returned, otherwise throws
         std::size_t wait();
 
         /// wait with timeout, if OK, returns what select() returned, otherwise throws
+        /// @note with epoll, timeout is rounded up to milliseconds
         std::size_t wait( unsigned int timeout_seconds, unsigned int timeout_nanoseconds = 0 );
 
         /// wait with timeout, if OK, returns what select() returned, otherwise throws
@@ -84,6 +118,7 @@ class select
                 descriptors();
                 
                 /// add file descriptor
+                /// @throw comma::exception, if epoll_ctl() fails (linux epoll backend only)
                 void add( file_descriptor fd );
                 template < typename T > void add( const T& t ) { add( t.fd() ); }
                 
@@ -100,9 +135,14 @@ class select
 
             private:
                 friend class select;
-                fd_set* reset_fds_();
                 std::set< file_descriptor > descriptors_; //boost::unordered_set< file_descriptor > descriptors_;
+                select* select_;
+                #ifdef COMMA_IO_SELECT_EPOLL
+                boost::unordered_set< file_descriptor > ready_;
+                #else
+                fd_set* reset_fds_();
                 fd_set fd_set_;
+                #endif
         };
 
         /// return read descriptors
@@ -121,12 +161,33 @@ class select
         descriptors read_descriptors_;
         descriptors write_descriptors_;
         descriptors except_descriptors_;
+        #ifdef COMMA_IO_SELECT_EPOLL
+        int epoll_fd_;
+        boost::unordered_map< file_descriptor, unsigned int > interest_; // registered epoll events
+        std::set< file_descriptor > unpollable_; // e.g. regular files
+        std::vector< ::epoll_event > events_;
+        void init_();
+        void update_( file_descriptor fd, bool added );
+        std::size_t wait_( int timeout_milliseconds );
+        #endif
 };
 
+#ifdef COMMA_IO_SELECT_EPOLL
+
+inline void select::descriptors::add( file_descriptor fd ) { if( fd == invalid_file_descriptor ) { return; } descriptors_.insert( fd ); if( select_ ) { select_->update_( fd, true ); } }
+
+inline void select::descriptors::remove( file_descriptor fd ) { if( fd == invalid_file_descriptor ) { return; } descriptors_.erase( fd ); ready_.erase( fd ); if( select_ ) { select_->update_( fd, false ); } }
+
+inline bool select::descriptors::ready( file_descriptor fd ) const { return ready_.find( fd ) != ready_.end(); }
+
+#else // #ifdef COMMA_IO_SELECT_EPOLL
+
 inline void select::descriptors::add( file_descriptor fd ) { if( fd != invalid_file_descriptor ) { descriptors_.insert( fd ); } }
 
 inline void select::descriptors::remove( file_descriptor fd ) { if( fd != invalid_file_descriptor ) { descriptors_.erase( fd ); } }
 
 inline bool select::descriptors::ready( file_descriptor fd ) const { return descriptors_.find( fd ) != descriptors_.end() && FD_ISSET( fd, const_cast< fd_set* >( &fd_set_ ) ) != 0; }
 
+#endif // #ifdef COMMA_IO_SELECT_EPOLL
+
 } } // namespace comma { namespace io {
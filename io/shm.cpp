@@ -0,0 +1,507 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+#include "../base/exception.h"
+#include "../base/last_error.h"
+#include "../string/string.h"
+#include "shm.h"
+
+namespace comma { namespace io { namespace shm {
+
+options::options( const std::string& s ) : capacity( 1 << 24 ), record_size( 1 ) // quick and dirty: io does not depend on name_value
+{
+    std::vector< std::string > v = comma::split( s, ';' );
+    name = v[0];
+    if( name.empty() ) { COMMA_THROW( comma::exception, "shm: expected segment name, got \"" << s << "\"" ); }
+    for( unsigned int i = 1; i < v.size(); ++i )
+    {
+        std::vector< std::string > w = comma::split( v[i], '=' );
+        if( w.size() != 2 ) { COMMA_THROW( comma::exception, "shm: expected <name>=<value>, got \"" << v[i] << "\"" ); }
+        if( w[0] == "capacity" ) { capacity = boost::lexical_cast< std::size_t >( w[1] ); }
+        else if( w[0] == "record-size" || w[0] == "size" ) { record_size = boost::lexical_cast< std::size_t >( w[1] ); }
+        else { COMMA_THROW( comma::exception, "shm: expected capacity or record-size, got \"" << w[0] << "\"" ); }
+    }
+}
+
+#ifdef WIN32
+
+struct header {};
+writer::writer( const std::string&, std::size_t, std::size_t ) { COMMA_THROW( comma::exception, "shm: not implemented on windows" ); }
+writer::~writer() {}
+void writer::write( const char*, std::size_t ) {}
+bool writer::try_write( const char*, std::size_t ) { return false; }
+std::size_t writer::reserve( char*&, std::size_t ) { return 0; }
+char* writer::record() { return NULL; }
+void writer::commit( std::size_t ) {}
+void writer::close() {}
+unsigned int writer::readers() const { return 0; }
+reader::reader( const std::string&, bool ) { COMMA_THROW( comma::exception, "shm: not implemented on windows" ); }
+reader::~reader() {}
+std::size_t reader::read( char*, std::size_t ) { return 0; }
+std::size_t reader::peek( const char*& ) { return 0; }
+const char* reader::record() { return NULL; }
+void reader::consume( std::size_t ) {}
+std::size_t reader::available() const { return 0; }
+bool reader::closed() const { return true; }
+void reader::close() {}
+
+#else // #ifdef WIN32
+
+static const comma::uint32 magic = 0x4d48534d; // "MSHM"
+static const comma::uint32 version = 1;
+static const unsigned int max_readers = 64;
+static const comma::uint64 joining = comma::uint64( -1 ); // cursor of a free or just claimed reader slot
+
+struct slot
+{
+    comma::uint64 cursor;
+    comma::int32 pid; // 0: free slot
+    char padding[52]; // one slot per cache line
+};
+
+struct header
+{
+    comma::uint32 magic; // set last, when the rest of header is initialised
+    comma::uint32 version;
+    comma::uint64 capacity;
+    comma::uint64 record_size;
+    comma::int32 writer; // pid
+    comma::uint32 closed;
+    char padding0[32];
+    comma::uint64 head; // published write position, always at record boundary, unless closed
+    char padding1[56];
+    comma::uint32 data; // futex: bumped by writer on publishing, if readers wait
+    comma::uint32 readers_waiting;
+    comma::uint32 space; // futex: bumped by readers on consuming, if writer waits
+    comma::uint32 writer_waiting;
+    char padding2[48];
+    slot readers[ max_readers ];
+};
+
+static const std::size_t data_offset = ( ( sizeof( header ) + 4095 ) / 4096 ) * 4096;
+
+// all the shared counters are accessed sequentially consistent: waiting flags and positions
+// are checked on both sides in opposite order, thus one of the sides always sees the other
+template < typename T > static T load( const T* p ) { return __atomic_load_n( p, __ATOMIC_SEQ_CST ); }
+
+template < typename T > static void store( T* p, T value ) { __atomic_store_n( p, value, __ATOMIC_SEQ_CST ); }
+
+static bool sleep( comma::uint32* futex, comma::uint32 value ) // return false on timeout
+{
+#ifdef __linux__
+    ::timespec timeout = { 0, 100000000 };
+    return !( ::syscall( SYS_futex, futex, FUTEX_WAIT, value, &timeout, NULL, 0 ) == -1 && errno == ETIMEDOUT );
+#else // #ifdef __linux__
+    ::usleep( 1000 );
+    return load( futex ) != value;
+#endif // #ifdef __linux__
+}
+
+static void wake( comma::uint32* futex )
+{
+    __atomic_add_fetch( futex, 1, __ATOMIC_SEQ_CST );
+#ifdef __linux__
+    ::syscall( SYS_futex, futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0 );
+#endif // #ifdef __linux__
+}
+
+static bool alive( comma::int32 pid ) { return !( ::kill( pid, 0 ) == -1 && errno == ESRCH ); }
+
+static std::string segment_name( const std::string& name ) { return name[0] == '/' ? name : "/" + name; }
+
+writer::writer( const std::string& name, std::size_t capacity, std::size_t record_size )
+    : name_( segment_name( name ) )
+    , header_( NULL )
+    , data_( NULL )
+    , mapped_( 0 )
+    , record_size_( record_size == 0 ? 1 : record_size )
+    , position_( 0 )
+{
+    if( capacity == 0 ) { COMMA_THROW( comma::exception, "shm: expected positive capacity" ); }
+    capacity_ = ( ( capacity + record_size_ - 1 ) / record_size_ ) * record_size_;
+    ::shm_unlink( name_.c_str() ); // segment left by a previous writer, its readers keep their mapping
+    int fd = ::shm_open( name_.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH );
+    if( fd < 0 ) { last_error::to_exception( "shm: failed to create \"" + name_ + "\"" ); }
+    mapped_ = data_offset + capacity_;
+    void* p = ::ftruncate( fd, mapped_ ) == 0 ? ::mmap( NULL, mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+    int error = errno;
+    ::close( fd );
+    if( p == MAP_FAILED ) { ::shm_unlink( name_.c_str() ); COMMA_THROW( comma::exception, "shm: failed to map \"" << name_ << "\" of " << mapped_ << " bytes: " << ::strerror( error ) ); }
+    header_ = static_cast< header* >( p );
+    data_ = static_cast< char* >( p ) + data_offset;
+    header_->version = version;
+    header_->capacity = capacity_;
+    header_->record_size = record_size_;
+    header_->writer = ::getpid();
+    for( unsigned int i = 0; i < max_readers; ++i ) { header_->readers[i].cursor = joining; }
+    store( &header_->magic, magic );
+}
+
+writer::~writer() { close(); }
+
+std::size_t writer::wait_( std::size_t size, bool block )
+{
+    if( header_ == NULL ) { COMMA_THROW( comma::exception, "shm: writer of \"" << name_ << "\" closed" ); }
+    bool waiting = false;
+    comma::uint32 value = 0;
+    while( true )
+    {
+        comma::uint64 tail = position_ - position_ % record_size_; // without readers, still do not overwrite unpublished incomplete record
+        bool attaching = false;
+        for( unsigned int i = 0; i < max_readers; ++i )
+        {
+            comma::int32 pid = load( &header_->readers[i].pid );
+            if( pid == 0 ) { continue; }
+            comma::uint64 cursor = load( &header_->readers[i].cursor );
+            if( cursor != joining ) { if( cursor < tail ) { tail = cursor; } continue; }
+            if( alive( pid ) ) { attaching = true; continue; } // reader is just attaching or detaching
+            __atomic_compare_exchange_n( &header_->readers[i].pid, &pid, 0, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ); // reader died while attaching or detaching
+        }
+        std::size_t free = capacity_ - ( position_ - tail );
+        if( attaching ) { ::sched_yield(); continue; }
+        if( free >= size || !block )
+        {
+            if( waiting ) { store( &header_->writer_waiting, comma::uint32( 0 ) ); }
+            return free >= size ? free : 0;
+        }
+        if( !waiting ) // flag to readers that the writer waits, then check again
+        {
+            store( &header_->writer_waiting, comma::uint32( 1 ) );
+            value = load( &header_->space );
+            waiting = true;
+            continue;
+        }
+        bool woken = sleep( &header_->space, value );
+        value = load( &header_->space );
+        if( woken ) { continue; }
+        for( unsigned int i = 0; i < max_readers; ++i ) // detach readers that died
+        {
+            comma::int32 pid = load( &header_->readers[i].pid );
+            if( pid == 0 || alive( pid ) ) { continue; }
+            store( &header_->readers[i].cursor, joining );
+            __atomic_compare_exchange_n( &header_->readers[i].pid, &pid, 0, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+        }
+    }
+}
+
+std::size_t writer::reserve( char*& p, std::size_t size )
+{
+    std::size_t free = wait_( 1, true );
+    std::size_t offset = position_ % capacity_;
+    p = data_ + offset;
+    return std::min( std::min( size, free ), capacity_ - offset );
+}
+
+char* writer::record()
+{
+    if( position_ % record_size_ != 0 ) { COMMA_THROW( comma::exception, "shm: expected writer of \"" << name_ << "\" at record boundary, got " << ( position_ % record_size_ ) << " byte(s) of incomplete record" ); }
+    wait_( record_size_, true );
+    return data_ + position_ % capacity_;
+}
+
+void writer::commit( std::size_t size )
+{
+    if( size == 0 ) { return; }
+    position_ += size;
+    store( &header_->head, position_ - position_ % record_size_ );
+    if( load( &header_->readers_waiting ) > 0 ) { wake( &header_->data ); }
+}
+
+void writer::write( const char* buf, std::size_t size )
+{
+    while( size > 0 )
+    {
+        char* p;
+        std::size_t n = reserve( p, size );
+        ::memcpy( p, buf, n );
+        commit( n );
+        buf += n;
+        size -= n;
+    }
+}
+
+bool writer::try_write( const char* buf, std::size_t size )
+{
+    if( size > capacity_ || wait_( size, false ) == 0 ) { return size == 0; }
+    write( buf, size );
+    return true;
+}
+
+unsigned int writer::readers() const
+{
+    if( header_ == NULL ) { return 0; }
+    unsigned int count = 0;
+    for( unsigned int i = 0; i < max_readers; ++i ) { if( load( &header_->readers[i].pid ) != 0 ) { ++count; } }
+    return count;
+}
+
+void writer::close()
+{
+    if( header_ == NULL ) { return; }
+    store( &header_->head, position_ ); // incomplete record, if any
+    store( &header_->closed, comma::uint32( 1 ) );
+    wake( &header_->data );
+    ::munmap( header_, mapped_ );
+    ::shm_unlink( name_.c_str() );
+    header_ = NULL;
+    data_ = NULL;
+}
+
+reader::reader( const std::string& name, bool blocking )
+    : header_( NULL )
+    , data_( NULL )
+    , mapped_( 0 )
+    , capacity_( 0 )
+    , record_size_( 1 )
+    , slot_( 0 )
+    , cursor_( 0 )
+{
+    std::string n = segment_name( name );
+    int fd = -1;
+    while( true ) // wait for writer to create and initialise segment
+    {
+        fd = ::shm_open( n.c_str(), O_RDWR, 0 );
+        if( fd < 0 && errno != ENOENT ) { last_error::to_exception( "shm: failed to open \"" + n + "\"" ); }
+        struct stat s;
+        if( fd >= 0 && ::fstat( fd, &s ) == 0 && std::size_t( s.st_size ) >= data_offset )
+        {
+            void* p = ::mmap( NULL, data_offset, PROT_READ, MAP_SHARED, fd, 0 );
+            if( p != MAP_FAILED )
+            {
+                const header* h = static_cast< const header* >( p );
+                bool ready = load( &h->magic ) == magic;
+                if( ready && h->version != version ) { ::munmap( p, data_offset ); ::close( fd ); COMMA_THROW( comma::exception, "shm: expected version " << version << " of \"" << n << "\", got " << h->version ); }
+                capacity_ = h->capacity;
+                record_size_ = h->record_size;
+                ::munmap( p, data_offset );
+                if( ready ) { break; }
+            }
+        }
+        if( fd >= 0 ) { ::close( fd ); }
+        if( !blocking ) { COMMA_THROW( comma::exception, "shm: \"" << n << "\" not found" ); }
+        ::usleep( 10000 );
+    }
+    mapped_ = data_offset + capacity_;
+    void* p = ::mmap( NULL, mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    int error = errno;
+    ::close( fd );
+    if( p == MAP_FAILED ) { COMMA_THROW( comma::exception, "shm: failed to map \"" << n << "\" of " << mapped_ << " bytes: " << ::strerror( error ) ); }
+    header_ = static_cast< header* >( p );
+    data_ = static_cast< char* >( p ) + data_offset;
+    for( ; slot_ < max_readers; ++slot_ ) // claim slot: its cursor stays "joining" until set, thus writer waits for it
+    {
+        comma::int32 expected = 0;
+        if( __atomic_compare_exchange_n( &header_->readers[slot_].pid, &expected, comma::int32( ::getpid() ), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) ) { break; }
+    }
+    if( slot_ == max_readers ) { ::munmap( header_, mapped_ ); header_ = NULL; COMMA_THROW( comma::exception, "shm: \"" << n << "\" already has maximum of " << max_readers << " readers" ); }
+    cursor_ = load( &header_->head );
+    store( &header_->readers[slot_].cursor, cursor_ );
+}
+
+reader::~reader() { close(); }
+
+bool reader::wait_( std::size_t size )
+{
+    if( header_ == NULL ) { return false; }
+    bool waiting = false;
+    comma::uint32 value = 0;
+    while( true )
+    {
+        bool closed = load( &header_->closed ) != 0; // check before head: writer publishes head before closing
+        bool ready = load( &header_->head ) - cursor_ >= size;
+        if( ready || closed )
+        {
+            if( waiting ) { __atomic_sub_fetch( &header_->readers_waiting, 1, __ATOMIC_SEQ_CST ); }
+            return ready;
+        }
+        if( !waiting ) // flag to writer that a reader waits, then check again
+        {
+            __atomic_add_fetch( &header_->readers_waiting, 1, __ATOMIC_SEQ_CST );
+            value = load( &header_->data );
+            waiting = true;
+            continue;
+        }
+        bool woken = sleep( &header_->data, value );
+        value = load( &header_->data );
+        if( !woken && !alive( header_->writer ) ) // writer died without closing
+        {
+            __atomic_sub_fetch( &header_->readers_waiting, 1, __ATOMIC_SEQ_CST );
+            return load( &header_->head ) - cursor_ >= size;
+        }
+    }
+}
+
+std::size_t reader::available() const { return header_ == NULL ? 0 : load( &header_->head ) - cursor_; }
+
+bool reader::closed() const { return header_ == NULL || load( &header_->closed ) != 0; }
+
+std::size_t reader::peek( const char*& p )
+{
+    if( !wait_( 1 ) ) { return 0; }
+    std::size_t offset = cursor_ % capacity_;
+    p = data_ + offset;
+    return std::min( available(), capacity_ - offset );
+}
+
+const char* reader::record()
+{
+    if( cursor_ % record_size_ != 0 ) { COMMA_THROW( comma::exception, "shm: expected reader at record boundary, got " << ( cursor_ % record_size_ ) << " byte(s) into record" ); }
+    return wait_( record_size_ ) ? data_ + cursor_ % capacity_ : NULL;
+}
+
+void reader::consume( std::size_t size )
+{
+    if( size == 0 || header_ == NULL ) { return; }
+    cursor_ += size;
+    store( &header_->readers[slot_].cursor, cursor_ );
+    if( load( &header_->writer_waiting ) != 0 ) { wake( &header_->space ); }
+}
+
+std::size_t reader::read( char* buf, std::size_t size )
+{
+    std::size_t count = 0;
+    for( const char* p; count < size && ( count == 0 || available() > 0 ); ) // the second part, if data wraps around
+    {
+        std::size_t n = std::min( peek( p ), size - count );
+        if( n == 0 ) { break; }
+        ::memcpy( buf + count, p, n );
+        consume( n );
+        count += n;
+    }
+    return count;
+}
+
+void reader::close()
+{
+    if( header_ == NULL ) { return; }
+    store( &header_->readers[slot_].cursor, joining );
+    store( &header_->readers[slot_].pid, comma::int32( 0 ) );
+    if( load( &header_->writer_waiting ) != 0 ) { wake( &header_->space ); }
+    ::munmap( header_, mapped_ );
+    header_ = NULL;
+    data_ = NULL;
+}
+
+#endif // #ifdef WIN32
+
+class ostream::streambuf : public std::streambuf
+{
+    public:
+        streambuf( const std::string& name, std::size_t capacity, std::size_t record_size ) : writer_( name, capacity, record_size ) {}
+
+        void close() { commit_(); writer_.close(); }
+
+    protected:
+        int_type overflow( int_type c ) // put area is free space in the ring itself, no intermediate buffer
+        {
+            commit_();
+            if( traits_type::eq_int_type( c, traits_type::eof() ) ) { return traits_type::not_eof( c ); }
+            char* p;
+            std::size_t size = writer_.reserve( p, chunk_size );
+            setp( p, p + size );
+            *pptr() = traits_type::to_char_type( c );
+            pbump( 1 );
+            return c;
+        }
+
+        int sync() { commit_(); return 0; }
+
+    private:
+        enum { chunk_size = 65536 }; // publish at least every chunk size bytes
+        shm::writer writer_;
+        void commit_() { if( pptr() != pbase() ) { writer_.commit( pptr() - pbase() ); } setp( NULL, NULL ); }
+};
+
+class istream::streambuf : public std::streambuf
+{
+    public:
+        streambuf( const std::string& name, bool blocking ) : reader_( name, blocking ) {}
+
+        void close() { release_(); reader_.close(); }
+
+    protected:
+        int_type underflow() // get area is data in the ring itself, released to writer, once consumed
+        {
+            if( gptr() < egptr() ) { return traits_type::to_int_type( *gptr() ); }
+            release_();
+            const char* p;
+            std::size_t size = reader_.peek( p );
+            if( size == 0 ) { return traits_type::eof(); }
+            char* q = const_cast< char* >( p );
+            setg( q, q, q + size );
+            return traits_type::to_int_type( *q );
+        }
+
+        std::streamsize showmanyc() { return reader_.available(); }
+
+    private:
+        shm::reader reader_;
+        void release_() { reader_.consume( egptr() - eback() ); setg( NULL, NULL, NULL ); }
+};
+
+ostream::ostream( const std::string& name, std::size_t capacity, std::size_t record_size ) : std::ostream( NULL )
+{
+    buf_.reset( new streambuf( name, capacity, record_size ) );
+    rdbuf( buf_.get() );
+}
+
+ostream::~ostream() { close(); }
+
+void ostream::close() { buf_->close(); }
+
+istream::istream( const std::string& name, bool blocking ) : std::istream( NULL )
+{
+    buf_.reset( new streambuf( name, blocking ) );
+    rdbuf( buf_.get() );
+}
+
+istream::~istream() { close(); }
+
+void istream::close() { buf_->close(); }
+
+} } } // namespace comma { namespace io { namespace shm {
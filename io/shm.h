@@ -0,0 +1,200 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_IO_SHM_H_
+#define COMMA_IO_SHM_H_
+
+#include <iostream>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include "../base/types.h"
+
+namespace comma { namespace io { namespace shm {
+
+/// single-producer multiple-consumer byte ring in posix shared memory (see shm_open)
+/// for passing data between processes on the same host without pipe or socket copies
+///
+/// the writer creates the segment, each reader attaches to it with its own read cursor,
+/// starting at the current write position; the writer waits for the slowest reader,
+/// i.e. readers do not lose data, as long as they keep reading (a reader process that
+/// died is detached by the writer); without readers, the writer overwrites the ring,
+/// except for an incomplete record not published yet
+///
+/// waiting sides sleep on futexes in the segment (on linux; elsewhere they poll),
+/// a wakeup system call is made only if the other side is actually waiting
+///
+/// if record size is given, capacity is a multiple of record size and the writer
+/// publishes only whole records, thus a record never wraps around the end of the ring
+/// and readers can access records in place, without copying (see reader::record())
+///
+/// @note not implemented on windows
+
+/// shm:<name>[;capacity=<bytes>][;record-size=<bytes>]
+struct options
+{
+    std::string name;
+    std::size_t capacity; // default: 16MB
+    std::size_t record_size; // default: 1, i.e. byte stream
+
+    options( const std::string& s );
+};
+
+struct header;
+
+/// ring writer, owns shared memory segment
+class writer : public boost::noncopyable
+{
+    public:
+        /// create shared memory segment (an old segment with the same name gets unlinked)
+        /// @param name segment name, e.g. "points" for /dev/shm/points
+        /// @param capacity ring size in bytes, rounded up to multiple of record size
+        /// @param record_size record size in bytes; 1 for byte stream
+        writer( const std::string& name, std::size_t capacity = 1 << 24, std::size_t record_size = 1 );
+
+        /// close
+        ~writer();
+
+        /// write data; wait, while there is not enough space
+        void write( const char* buf, std::size_t size );
+
+        /// write all data, if there is enough space, otherwise write nothing
+        /// @return false, if there is not enough space
+        bool try_write( const char* buf, std::size_t size );
+
+        /// return pointer to contiguous free space in the ring, wait for at least 1 byte of it
+        /// @return number of bytes available at p, up to size
+        std::size_t reserve( char*& p, std::size_t size );
+
+        /// zero-copy write: return pointer to space for the next record, wait for it;
+        /// fill the record and call commit( record_size() )
+        char* record();
+
+        /// publish size bytes written to reserved space
+        void commit( std::size_t size );
+
+        /// mark end of data for readers, unlink segment
+        void close();
+
+        /// return number of attached readers
+        unsigned int readers() const;
+
+        std::size_t capacity() const { return capacity_; }
+        std::size_t record_size() const { return record_size_; }
+
+    private:
+        std::string name_;
+        header* header_;
+        char* data_;
+        std::size_t mapped_;
+        std::size_t capacity_;
+        std::size_t record_size_;
+        comma::uint64 position_; // written, possibly not published yet
+        std::size_t wait_( std::size_t size, bool block );
+};
+
+/// ring reader
+class reader : public boost::noncopyable
+{
+    public:
+        /// attach to shared memory segment
+        /// @param blocking if true, wait for writer to create segment, otherwise throw, if it does not exist
+        reader( const std::string& name, bool blocking = true );
+
+        /// detach
+        ~reader();
+
+        /// read at least 1 byte, wait, if no data
+        /// @return number of bytes read, 0 on end of data
+        std::size_t read( char* buf, std::size_t size );
+
+        /// zero-copy read: get pointer to contiguous available data in the ring, wait, if no data;
+        /// data stays valid until consume()
+        /// @return number of bytes available at p, 0 on end of data
+        std::size_t peek( const char*& p );
+
+        /// zero-copy read: return pointer to the next whole record, wait for it; NULL on end of data;
+        /// call consume( record_size() ), when done with the record
+        const char* record();
+
+        /// release size bytes to the writer
+        void consume( std::size_t size );
+
+        /// return number of bytes available without waiting
+        std::size_t available() const;
+
+        /// return true, if writer closed the ring (there still may be data available)
+        bool closed() const;
+
+        /// detach
+        void close();
+
+        std::size_t capacity() const { return capacity_; }
+        std::size_t record_size() const { return record_size_; }
+
+    private:
+        header* header_;
+        char* data_;
+        std::size_t mapped_;
+        std::size_t capacity_;
+        std::size_t record_size_;
+        unsigned int slot_;
+        comma::uint64 cursor_;
+        bool wait_( std::size_t size );
+};
+
+/// output stream writing to ring; data is published on flush or when ring chunk is full
+class ostream : public std::ostream
+{
+    public:
+        ostream( const std::string& name, std::size_t capacity = 1 << 24, std::size_t record_size = 1 );
+        ~ostream();
+        void close();
+
+    private:
+        class streambuf;
+        boost::scoped_ptr< streambuf > buf_;
+};
+
+/// input stream reading from ring without intermediate buffer
+class istream : public std::istream
+{
+    public:
+        istream( const std::string& name, bool blocking = true );
+        ~istream();
+        void close();
+
+    private:
+        class streambuf;
+        boost::scoped_ptr< streambuf > buf_;
+};
+
+} } } // namespace comma { namespace io { namespace shm {
+
+#endif // COMMA_IO_SHM_H_
@@ -55,7 +55,9 @@
 #include "../base/exception.h"
 #include "../string/string.h"
 #include "file_descriptor.h"
+#include "lz4.h"
 #include "select.h"
+#include "shm.h"
 #include "stream.h"
 
 #ifdef USE_ZEROMQ
@@ -94,6 +96,18 @@ struct traits < std::istream >
     #else
     static io::file_descriptor open( const std::string& name ) { return ::open( &name[0], O_RDONLY | O_NONBLOCK ); }
     #endif
+    static std::istream* lz4( const std::string& name, std::size_t, std::size_t, boost::function< void() >& close )
+    {
+        comma::io::lz4::istream* s = name == "-" ? new comma::io::lz4::istream( std::cin ) : new comma::io::lz4::istream( name );
+        close = boost::bind( &comma::io::lz4::istream::close, s );
+        return s;
+    }
+    static std::istream* shm( const comma::io::shm::options& options, bool blocking, boost::function< void() >& close )
+    {
+        comma::io::shm::istream* s = new comma::io::shm::istream( options.name, blocking );
+        close = boost::bind( &comma::io::shm::istream::close, s );
+        return s;
+    }
 };
 
 template <>
@@ -129,6 +143,18 @@ struct traits < std::ostream >
             static io::file_descriptor open( const std::string& name ) { return ::open( &name[0], O_WRONLY | O_CREAT | O_NONBLOCK, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ); }
         #endif
     #endif
+    static std::ostream* lz4( const std::string& name, std::size_t block_size, std::size_t record_size, boost::function< void() >& close )
+    {
+        comma::io::lz4::ostream* s = name == "-" ? new comma::io::lz4::ostream( std::cout, block_size, record_size ) : new comma::io::lz4::ostream( name, block_size, record_size );
+        close = boost::bind( &comma::io::lz4::ostream::close, s );
+        return s;
+    }
+    static std::ostream* shm( const comma::io::shm::options& options, bool, boost::function< void() >& close )
+    {
+        comma::io::shm::ostream* s = new comma::io::shm::ostream( options.name, options.capacity, options.record_size );
+        close = boost::bind( &comma::io::shm::ostream::close, s );
+        return s;
+    }
 };
 
 template <>
@@ -147,6 +173,8 @@ struct traits < std::iostream >
             static io::file_descriptor open( const std::string& name ) { return ::open( &name[0], O_RDWR | O_NONBLOCK ); }
         #endif
     #endif
+    static std::iostream* lz4( const std::string&, std::size_t, std::size_t, boost::function< void() >& ) { COMMA_THROW( comma::exception, "lz4: bidirectional compressed streams not supported" ); }
+    static std::iostream* shm( const comma::io::shm::options&, bool, boost::function< void() >& ) { COMMA_THROW( comma::exception, "shm: bidirectional shared memory streams not supported" ); }
 };
 
 template < typename S > void close_file_stream( typename traits< S >::file_stream* s, int fd )
@@ -155,6 +183,27 @@ template < typename S > void close_file_stream( typename traits< S >::file_strea
     if( fd != io::invalid_file_descriptor ) { ::close( fd ); }
 }
 
+struct lz4_options
+{
+    std::string name;
+    std::size_t block_size;
+    std::size_t record_size;
+
+    lz4_options( const std::string& s ) : block_size( 1 << 20 ), record_size( 1 ) // quick and dirty: io does not depend on name_value
+    {
+        std::vector< std::string > v = comma::split( s, ';' );
+        name = v[0];
+        for( unsigned int i = 1; i < v.size(); ++i )
+        {
+            std::vector< std::string > w = comma::split( v[i], '=' );
+            if( w.size() != 2 ) { COMMA_THROW( comma::exception, "lz4: expected <name>=<value>, got \"" << v[i] << "\"" ); }
+            if( w[0] == "block-size" ) { block_size = boost::lexical_cast< std::size_t >( w[1] ); }
+            else if( w[0] == "record-size" || w[0] == "size" ) { record_size = boost::lexical_cast< std::size_t >( w[1] ); }
+            else { COMMA_THROW( comma::exception, "lz4: expected block-size or record-size, got \"" << w[0] << "\"" ); }
+        }
+    }
+};
+
 } // namespace impl
 
 template < typename S >
@@ -234,6 +283,7 @@ std::size_t stream< S >::available_on_file_descriptor() const
 #ifdef WIN32
     COMMA_THROW( comma::exception, "not implemented" );
 #else
+    if( fd_ == io::invalid_file_descriptor ) { return 0; }
     int error = ::ioctl( fd_, FIONREAD, &count );
     if( error != 0 ) { COMMA_THROW( comma::exception, "ioctl failed with error code: \"" << error << "\"" ); }
 #endif
@@ -270,6 +320,19 @@ stream< S >::stream( const std::string& name, mode::value m, mode::blocking_valu
     {
         COMMA_THROW( comma::exception, "todo" );
     }
+    else if( v[0] == "lz4" )
+    {
+        if( v.size() < 2 ) { COMMA_THROW( comma::exception, "expected lz4:<filename>[;block-size=<bytes>][;record-size=<bytes>], got \"" << name << "\"" ); }
+        impl::lz4_options options( name.substr( v[0].size() + 1 ) );
+        boost::function< void() > close;
+        stream_ = impl::traits< S >::lz4( options.name, options.block_size, options.record_size, close ); // no file descriptor to select on: compressed data on the underlying file descriptor does not mean decompressed data is available
+        close_ = close;
+    }
+    else if( v[0] == "shm" )
+    {
+        if( v.size() < 2 ) { COMMA_THROW( comma::exception, "expected shm:<name>[;capacity=<bytes>][;record-size=<bytes>], got \"" << name << "\"" ); }
+        stream_ = impl::traits< S >::shm( shm::options( name.substr( v[0].size() + 1 ) ), blocking_, close_ ); // no file descriptor to select on
+    }
     else if( v[0] == "serial" )
     {
         COMMA_THROW( comma::exception, "todo" );
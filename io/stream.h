@@ -52,6 +52,13 @@ struct mode
 ///     filename: file stream
 ///     -: std::cin or std::cout
 ///     tcp:address:port: tcp client socket stream
+///     lz4:filename[;block-size=<bytes>][;record-size=<bytes>]: lz4-compressed framed file stream,
+///         see lz4.h; lz4:- for compressed stdin or stdout; if record size is given,
+///         records are never split across frames; there is no file descriptor to select on,
+///         since compressed data on the underlying file does not mean decompressed data is available
+///     shm:name[;capacity=<bytes>][;record-size=<bytes>]: shared memory ring, see shm.h; output stream
+///         creates the ring, input streams attach to it, each with its own read position;
+///         there is no file descriptor to select on
 ///     @todo udp:address:port: udp socket stream
 ///     @todo linux socket name: linux socket client stream
 ///     @todo serial device name: serial stream
@@ -81,12 +88,12 @@ class stream : boost::noncopyable
         /// return pointer to stream
         const S* operator->() const;
 
-        /// @return file descriptor (to use in select)
+        /// @return file descriptor (to use in select); invalid_file_descriptor, if the stream has none (e.g. lz4 or shm)
         comma::io::file_descriptor fd() const;
 
         /// @return the number of characters available for reading on file descriptor
         /// @note for number of bytes available for reading in std::istream call rdbuf()->avail()
-        /// e.g. std::cin.rdbuf()->in_avail()
+        /// e.g. std::cin.rdbuf()->in_avail(); 0, if the stream has no file descriptor
         std::size_t available_on_file_descriptor() const;
 
         /// @return stream name
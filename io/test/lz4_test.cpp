@@ -0,0 +1,239 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/thread/thread.hpp>
+#include "../../base/exception.h"
+#include "../../base/types.h"
+#include "../lz4.h"
+#include "../stream.h"
+
+static std::string make_data( std::size_t size, unsigned int seed )
+{
+    std::string s( size, 0 );
+    ::srand( seed );
+    for( std::size_t i = 0; i < size; ++i ) { s[i] = i % 100 < 60 ? char( 'a' + ( i / 7 ) % 5 ) : char( ::rand() % 256 ); } // partly compressible
+    return s;
+}
+
+static std::string round_trip( const std::string& s )
+{
+    std::vector< char > compressed( comma::io::lz4::bound( s.size() ) );
+    std::size_t size = comma::io::lz4::compress( &s[0], s.size(), &compressed[0] );
+    EXPECT_LE( size, compressed.size() );
+    std::string t( s.size(), 0 );
+    EXPECT_EQ( s.size(), comma::io::lz4::decompress( &compressed[0], size, &t[0], t.size() ) );
+    return t;
+}
+
+TEST( lz4, codec )
+{
+    EXPECT_EQ( "", round_trip( "" ) );
+    EXPECT_EQ( "a", round_trip( "a" ) );
+    EXPECT_EQ( "hello, world", round_trip( "hello, world" ) );
+    EXPECT_EQ( std::string( 100000, 'x' ), round_trip( std::string( 100000, 'x' ) ) );
+    for( unsigned int i = 0; i < 20; ++i ) { std::string s = make_data( 1 + i * 7919, i ); EXPECT_EQ( s, round_trip( s ) ); }
+    std::string s( 100000, 'x' );
+    std::vector< char > compressed( comma::io::lz4::bound( s.size() ) );
+    std::size_t size = comma::io::lz4::compress( &s[0], s.size(), &compressed[0] );
+    EXPECT_LT( size, 1000u );
+    std::string t( 100, 0 );
+    EXPECT_THROW( comma::io::lz4::decompress( &compressed[0], size, &t[0], t.size() ), comma::exception );
+    EXPECT_THROW( comma::io::lz4::decompress( &compressed[0], 3, &t[0], t.size() ), comma::exception );
+}
+
+static void write_uint32( std::ostream& os, comma::uint32 v ) { char b[4] = { char( v & 0xff ), char( ( v >> 8 ) & 0xff ), char( ( v >> 16 ) & 0xff ), char( ( v >> 24 ) & 0xff ) }; os.write( b, 4 ); }
+
+static comma::uint32 read_uint32( const std::string& s, std::size_t offset ) { const unsigned char* b = reinterpret_cast< const unsigned char* >( &s[offset] ); return b[0] | ( b[1] << 8 ) | ( b[2] << 16 ) | ( comma::uint32( b[3] ) << 24 ); }
+
+static std::string read_file( const std::string& name ) { std::ifstream ifs( name.c_str(), std::ios::binary ); return std::string( std::istreambuf_iterator< char >( ifs ), std::istreambuf_iterator< char >() ); }
+
+// cross-check the block codec against the reference lz4 utility through its legacy frame format:
+// magic number, then for each block of up to 8MB its compressed size and lz4 block data
+TEST( lz4, reference )
+{
+    if( std::system( "lz4 --version > /dev/null 2>&1" ) != 0 ) { std::cerr << "lz4_test: lz4 utility not found; reference test skipped" << std::endl; return; }
+    static const comma::uint32 magic = 0x184c2102;
+    for( unsigned int i = 0; i < 4; ++i )
+    {
+        std::string s = i == 0 ? std::string( 100000, 'x' ) : make_data( 1 + i * 100003, i );
+        {
+            std::vector< char > compressed( comma::io::lz4::bound( s.size() ) );
+            std::size_t size = comma::io::lz4::compress( &s[0], s.size(), &compressed[0] );
+            std::ofstream ofs( "lz4_test.legacy.lz4", std::ios::binary );
+            write_uint32( ofs, magic );
+            write_uint32( ofs, size );
+            ofs.write( &compressed[0], size );
+        }
+        EXPECT_EQ( 0, std::system( "lz4 -d -c -q lz4_test.legacy.lz4 > lz4_test.legacy" ) );
+        EXPECT_TRUE( s == read_file( "lz4_test.legacy" ) );
+        { std::ofstream ofs( "lz4_test.legacy", std::ios::binary ); ofs.write( &s[0], s.size() ); }
+        EXPECT_EQ( 0, std::system( "lz4 -l -c -q -f lz4_test.legacy > lz4_test.legacy.lz4" ) );
+        std::string c = read_file( "lz4_test.legacy.lz4" );
+        ASSERT_LE( 4u, c.size() );
+        EXPECT_EQ( magic, read_uint32( c, 0 ) );
+        std::string t;
+        for( std::size_t offset = 4; offset + 4 <= c.size(); )
+        {
+            comma::uint32 size = read_uint32( c, offset );
+            offset += 4;
+            ASSERT_LE( offset + size, c.size() );
+            std::string block( 8 << 20, 0 );
+            block.resize( comma::io::lz4::decompress( &c[offset], size, &block[0], block.size() ) );
+            t += block;
+            offset += size;
+        }
+        EXPECT_TRUE( s == t );
+    }
+    std::remove( "lz4_test.legacy" );
+    std::remove( "lz4_test.legacy.lz4" );
+}
+
+TEST( lz4, stream )
+{
+    std::string s = make_data( 1000000, 1 );
+    {
+        comma::io::lz4::ostream os( "test.lz4", 65536, 12 );
+        for( std::size_t i = 0; i < s.size(); i += 1200 ) { os.write( &s[i], std::min( std::size_t( 1200 ), s.size() - i ) ); os.flush(); }
+    }
+    comma::io::lz4::istream is( "test.lz4" );
+    std::string t( s.size() + 1, 0 );
+    is.read( &t[0], t.size() );
+    EXPECT_EQ( std::streamsize( s.size() ), is.gcount() );
+    t.resize( is.gcount() );
+    EXPECT_TRUE( s == t );
+    std::remove( "test.lz4" );
+}
+
+TEST( lz4, in_avail )
+{
+    std::string s = make_data( 100000, 4 );
+    {
+        comma::io::lz4::ostream os( "test.lz4", 4096 );
+        os.write( &s[0], s.size() );
+    }
+    comma::io::lz4::istream is( "test.lz4" );
+    std::string t;
+    while( true ) // read only what is available without blocking, as io-cat does
+    {
+        std::streamsize size = is.rdbuf()->in_avail();
+        if( size < 0 ) { break; }
+        if( size == 0 ) { boost::this_thread::yield(); continue; }
+        EXPECT_GE( 4096, size );
+        std::string buf( size, 0 );
+        is.read( &buf[0], size );
+        ASSERT_EQ( size, is.gcount() );
+        t += buf;
+    }
+    EXPECT_TRUE( s == t );
+    EXPECT_EQ( std::char_traits< char >::eof(), is.peek() );
+    EXPECT_TRUE( is.eof() );
+    std::remove( "test.lz4" );
+}
+
+TEST( lz4, record_alignment )
+{
+    std::string s = make_data( 10000, 2 );
+    std::ofstream ofs( "test.lz4", std::ios::binary );
+    {
+        comma::io::lz4::ostream os( ofs, 1000, 12 );
+        os.write( &s[0], 30 ); // 2.5 records
+        os.flush();
+        os.write( &s[30], s.size() - 30 );
+    }
+    ofs.close();
+    std::ifstream ifs( "test.lz4", std::ios::binary );
+    ifs.seekg( 8 );
+    std::vector< comma::uint32 > sizes;
+    while( true )
+    {
+        comma::uint32 header[2];
+        ifs.read( reinterpret_cast< char* >( header ), 8 );
+        if( ifs.gcount() == 0 ) { break; }
+        sizes.push_back( header[0] );
+        ifs.seekg( header[1], std::ios::cur );
+    }
+    ASSERT_LT( 2u, sizes.size() );
+    EXPECT_EQ( 24u, sizes[0] ); // flush writes whole records only
+    std::size_t total = 0;
+    for( std::size_t i = 0; i + 1 < sizes.size(); ++i ) { EXPECT_EQ( 0u, sizes[i] % 12 ); EXPECT_LE( sizes[i], 996u ); total += sizes[i]; }
+    EXPECT_EQ( 4u, sizes.back() % 12 ); // incomplete record at the end written on destruction
+    EXPECT_EQ( 10000u, total + sizes.back() );
+    std::remove( "test.lz4" );
+}
+
+TEST( lz4, seek )
+{
+    std::string s = make_data( 100000, 3 );
+    {
+        comma::io::lz4::ostream os( "test.lz4", 4096 );
+        os.write( &s[0], s.size() );
+    }
+    comma::io::lz4::istream is( "test.lz4" );
+    char c;
+    std::size_t positions[] = { 10, 20, 5000, 4095, 4096, 99999, 0, 60000, 60001 };
+    for( unsigned int i = 0; i < sizeof( positions ) / sizeof( positions[0] ); ++i )
+    {
+        is.seekg( positions[i] );
+        ASSERT_TRUE( is.good() );
+        EXPECT_EQ( std::streamoff( positions[i] ), std::streamoff( is.tellg() ) );
+        is.get( c );
+        EXPECT_EQ( s[ positions[i] ], c );
+    }
+    is.seekg( 50000 );
+    std::string t( 50000, 0 );
+    is.read( &t[0], t.size() );
+    EXPECT_TRUE( s.substr( 50000 ) == t );
+    is.clear();
+    is.seekg( 200000 );
+    EXPECT_TRUE( is.fail() );
+    std::remove( "test.lz4" );
+}
+
+TEST( lz4, io_stream )
+{
+    {
+        comma::io::ostream os( "lz4:test.lz4;record-size=4" );
+        *os << "hello, world" << std::endl;
+        os.close();
+    }
+    comma::io::istream is( "lz4:test.lz4" );
+    std::string line;
+    std::getline( *is, line );
+    EXPECT_EQ( "hello, world", line );
+    is.close();
+    std::remove( "test.lz4" );
+}
@@ -0,0 +1,150 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "../passthrough.h"
+
+namespace comma { namespace io {
+
+static std::vector< char > make_data( std::size_t size )
+{
+    std::vector< char > data( size );
+    for( std::size_t i = 0; i < size; ++i ) { data[i] = char( i * 13 + i / 251 ); }
+    return data;
+}
+
+static void write_all( int fd, const std::vector< char >* data )
+{
+    for( std::size_t i = 0; i < data->size(); ) { ssize_t n = ::write( fd, &( *data )[i], data->size() - i ); if( n <= 0 ) { break; } i += n; }
+    ::close( fd );
+}
+
+static void read_all( int fd, std::vector< char >* data )
+{
+    char buf[4096];
+    for( ssize_t n; ( n = ::read( fd, buf, sizeof( buf ) ) ) > 0; ) { data->insert( data->end(), buf, buf + n ); }
+    ::close( fd );
+}
+
+static std::vector< char > read_file( FILE* f )
+{
+    std::vector< char > data;
+    ::rewind( f );
+    char buf[4096];
+    for( std::size_t n; ( n = ::fread( buf, 1, sizeof( buf ), f ) ) > 0; ) { data.insert( data.end(), buf, buf + n ); }
+    return data;
+}
+
+TEST( passthrough, pipe_to_file_with_copy )
+{
+    std::vector< char > data = make_data( 3000000 );
+    int in[2], copy[2];
+    ASSERT_EQ( 0, ::pipe( in ) );
+    ASSERT_EQ( 0, ::pipe( copy ) );
+    FILE* out = ::tmpfile();
+    ASSERT_TRUE( out != NULL );
+    std::vector< char > copied;
+    boost::thread writer( boost::bind( &write_all, in[1], &data ) );
+    boost::thread reader( boost::bind( &read_all, copy[0], &copied ) );
+    {
+        passthrough p( in[0], fileno( out ), copy[1] );
+        p.run();
+        EXPECT_EQ( data.size(), p.size() );
+    }
+    ::close( in[0] );
+    ::close( copy[1] );
+    writer.join();
+    reader.join();
+    EXPECT_TRUE( read_file( out ) == data );
+    EXPECT_TRUE( copied == data );
+    ::fclose( out );
+}
+
+TEST( passthrough, file_to_pipe_with_copy )
+{
+    std::vector< char > data = make_data( 3000000 );
+    FILE* in = ::tmpfile();
+    ASSERT_TRUE( in != NULL );
+    ASSERT_EQ( data.size(), ::fwrite( &data[0], 1, data.size(), in ) );
+    ::fflush( in );
+    ::rewind( in );
+    int out[2], copy[2];
+    ASSERT_EQ( 0, ::pipe( out ) );
+    ASSERT_EQ( 0, ::pipe( copy ) );
+    std::vector< char > received, copied;
+    boost::thread out_reader( boost::bind( &read_all, out[0], &received ) );
+    boost::thread copy_reader( boost::bind( &read_all, copy[0], &copied ) );
+    {
+        passthrough p( fileno( in ), out[1], copy[1] );
+        p.run();
+        EXPECT_EQ( data.size(), p.size() );
+    }
+    ::close( out[1] );
+    ::close( copy[1] );
+    out_reader.join();
+    copy_reader.join();
+    EXPECT_TRUE( received == data );
+    EXPECT_TRUE( copied == data );
+    ::fclose( in );
+}
+
+TEST( passthrough, append )
+{
+    std::vector< char > data = make_data( 100000 );
+    FILE* in = ::tmpfile();
+    ASSERT_TRUE( in != NULL );
+    ASSERT_EQ( data.size(), ::fwrite( &data[0], 1, data.size(), in ) );
+    ::fflush( in );
+    ::rewind( in );
+    FILE* out = ::tmpfile();
+    ASSERT_TRUE( out != NULL );
+    ::fputs( "head", out );
+    ::fflush( out );
+    ::fcntl( fileno( out ), F_SETFL, ::fcntl( fileno( out ), F_GETFL ) | O_APPEND ); // splice() may not support it, then read() and write()
+    {
+        passthrough p( fileno( in ), fileno( out ) );
+        p.run();
+        EXPECT_EQ( data.size(), p.size() );
+    }
+    std::vector< char > expected( 4 );
+    std::copy( "head", "head" + 4, expected.begin() );
+    expected.insert( expected.end(), data.begin(), data.end() );
+    EXPECT_TRUE( read_file( out ) == expected );
+    ::fclose( in );
+    ::fclose( out );
+}
+
+} } // namespace comma { namespace io {
@@ -0,0 +1,186 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "../publisher.h"
+
+namespace comma { namespace io {
+
+static std::string read_all( int fd )
+{
+    std::string s;
+    char buf[65536];
+    for( ssize_t size; ( size = ::read( fd, buf, sizeof( buf ) ) ) > 0; s.append( buf, size ) );
+    return s;
+}
+
+static void check_packets( const std::string& s, std::size_t packet_size, unsigned int count ) // whole packets in order
+{
+    ASSERT_EQ( 0u, s.size() % packet_size );
+    int previous = -1;
+    for( std::size_t i = 0; i < s.size(); i += packet_size )
+    {
+        int n = static_cast< unsigned char >( s[i] ) + 256 * static_cast< unsigned char >( s[i + 1] );
+        EXPECT_LT( previous, n );
+        EXPECT_LT( n, int( count ) );
+        EXPECT_EQ( std::string( packet_size - 2, char( n ) ), s.substr( i + 2, packet_size - 2 ) );
+        previous = n;
+    }
+}
+
+static unsigned int publish( io::publisher::queue::policies policy, std::string& output, io::publisher::client_statistics& statistics )
+{
+    const std::string name = "publisher_test.fifo";
+    ::unlink( name.c_str() );
+    EXPECT_EQ( 0, ::mkfifo( name.c_str(), 0600 ) );
+    int fd = ::open( name.c_str(), O_RDONLY | O_NONBLOCK );
+    EXPECT_LE( 0, fd );
+    io::publisher publisher( name, io::mode::binary, io::publisher::queue( 10000, policy ) );
+    EXPECT_EQ( 1u, publisher.accept() );
+    const unsigned int count = 1000;
+    unsigned int queued = 0;
+    for( unsigned int i = 0; i < count; ++i )
+    {
+        std::string packet( 1000, char( i ) );
+        packet[0] = char( i % 256 );
+        packet[1] = char( i / 256 );
+        queued += publisher.write( &packet[0], packet.size() );
+    }
+    EXPECT_EQ( 1u, publisher.statistics().size() );
+    statistics = publisher.statistics()[0];
+    output = read_all( fd );
+    output += read_all( fd );
+    EXPECT_EQ( 0u, publisher.drain() );
+    output += read_all( fd );
+    publisher.close();
+    ::close( fd );
+    ::unlink( name.c_str() );
+    return queued;
+}
+
+TEST( publisher, queue_drop_newest )
+{
+    std::string output;
+    io::publisher::client_statistics statistics;
+    unsigned int queued = publish( io::publisher::queue::drop_newest, output, statistics );
+    EXPECT_LT( queued, 1000u ); // pipe capacity and queue are smaller than published data
+    EXPECT_EQ( 1000u, queued + statistics.dropped );
+    EXPECT_EQ( statistics.bytes + statistics.queued, queued * 1000 );
+    EXPECT_EQ( queued * 1000, output.size() );
+    check_packets( output, 1000, 1000 );
+    EXPECT_EQ( 0, output[0] ); // oldest kept
+}
+
+TEST( publisher, queue_drop_oldest )
+{
+    std::string output;
+    io::publisher::client_statistics statistics;
+    unsigned int queued = publish( io::publisher::queue::drop_oldest, output, statistics );
+    EXPECT_EQ( 1000u, queued );
+    EXPECT_LT( 0u, statistics.dropped );
+    EXPECT_EQ( ( 1000 - statistics.dropped ) * 1000, output.size() );
+    check_packets( output, 1000, 1000 );
+    EXPECT_EQ( std::string( 998, char( 999 ) ), output.substr( output.size() - 998 ) ); // newest kept
+}
+
+static void read_until_end( int fd, std::string* output, unsigned int delay_milliseconds )
+{
+    char buf[65536];
+    for( ssize_t size; ( size = ::read( fd, buf, sizeof( buf ) ) ) > 0; output->append( buf, size ) ) { boost::this_thread::sleep( boost::posix_time::milliseconds( delay_milliseconds ) ); }
+}
+
+static int connect( const std::string& name )
+{
+    int fd = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+    ::sockaddr_un address = ::sockaddr_un();
+    address.sun_family = AF_UNIX;
+    std::strncpy( address.sun_path, name.c_str(), sizeof( address.sun_path ) - 1 );
+    EXPECT_EQ( 0, ::connect( fd, reinterpret_cast< ::sockaddr* >( &address ), sizeof( address ) ) );
+    return fd;
+}
+
+TEST( publisher, queue_block )
+{
+    const std::string name = "publisher_test.socket";
+    ::unlink( name.c_str() );
+    const unsigned int count = 1000;
+    std::string slow;
+    std::string fast;
+    const std::size_t queue_size = 10000;
+    unsigned int queued = 0;
+    {
+        io::publisher publisher( "local:" + name, io::mode::binary, io::publisher::queue( queue_size, io::publisher::queue::block ) );
+        int slow_fd = connect( name );
+        int fast_fd = connect( name );
+        EXPECT_EQ( 2u, publisher.accept() );
+        boost::thread slow_reader( boost::bind( &read_until_end, slow_fd, &slow, 10 ) );
+        boost::thread fast_reader( boost::bind( &read_until_end, fast_fd, &fast, 0 ) );
+        for( unsigned int i = 0; i < count; ++i )
+        {
+            std::string packet( 1000, char( i ) );
+            packet[0] = char( i % 256 );
+            packet[1] = char( i / 256 );
+            queued += publisher.write( &packet[0], packet.size() );
+            std::vector< io::publisher::client_statistics > statistics = publisher.statistics();
+            ASSERT_EQ( 2u, statistics.size() );
+            for( unsigned int j = 0; j < statistics.size(); ++j ) // write waited for the slow client rather than growing its queue or dropping
+            {
+                EXPECT_LE( statistics[j].queued, queue_size );
+                EXPECT_EQ( 0u, statistics[j].dropped );
+                EXPECT_EQ( ( i + 1 ) * 1000, statistics[j].bytes + statistics[j].queued );
+            }
+        }
+        publisher.close();
+        slow_reader.join();
+        fast_reader.join();
+        ::close( slow_fd );
+        ::close( fast_fd );
+    }
+    ::unlink( name.c_str() );
+    EXPECT_EQ( 2 * count, queued ); // number of clients each packet got queued for
+    EXPECT_EQ( count * 1000, slow.size() );
+    EXPECT_EQ( count * 1000, fast.size() );
+    check_packets( slow, 1000, count );
+    check_packets( fast, 1000, count );
+}
+
+} } // namespace comma { namespace io {
@@ -0,0 +1,168 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../select.h"
+
+namespace comma { namespace io {
+
+TEST( select, read )
+{
+    int p[2];
+    ASSERT_EQ( 0, ::pipe( p ) );
+    select s;
+    EXPECT_EQ( 0u, s.check() ); // nothing to select on
+    s.read().add( p[0] );
+    EXPECT_EQ( 0u, s.check() );
+    EXPECT_FALSE( s.read().ready( p[0] ) );
+    EXPECT_EQ( 1, ::write( p[1], "x", 1 ) );
+    EXPECT_EQ( 1u, s.wait( 1 ) );
+    EXPECT_TRUE( s.read().ready( p[0] ) );
+    EXPECT_EQ( 1u, s.check() ); // level-triggered
+    char c;
+    EXPECT_EQ( 1, ::read( p[0], &c, 1 ) );
+    EXPECT_EQ( 0u, s.wait( boost::posix_time::milliseconds( 10 ) ) );
+    EXPECT_FALSE( s.read().ready( p[0] ) );
+    ::close( p[1] );
+    EXPECT_EQ( 1u, s.check() ); // end of input is readable
+    EXPECT_TRUE( s.read().ready( p[0] ) );
+    s.read().remove( p[0] );
+    EXPECT_FALSE( s.read().ready( p[0] ) );
+    EXPECT_EQ( 0u, s.check() );
+    ::close( p[0] );
+}
+
+TEST( select, read_write )
+{
+    int p[2];
+    ASSERT_EQ( 0, ::pipe( p ) );
+    select s;
+    s.read().add( p[0] );
+    s.write().add( p[1] );
+    EXPECT_EQ( 1u, s.check() );
+    EXPECT_FALSE( s.read().ready( p[0] ) );
+    EXPECT_TRUE( s.write().ready( p[1] ) );
+    EXPECT_EQ( 1, ::write( p[1], "x", 1 ) );
+    EXPECT_EQ( 2u, s.check() );
+    select t( s ); // copy
+    s.read().remove( p[0] );
+    s.write().remove( p[1] );
+    EXPECT_EQ( 0u, s.check() );
+    EXPECT_EQ( 2u, t.check() );
+    EXPECT_TRUE( t.read().ready( p[0] ) );
+    t.read().remove( p[0] );
+    t.read().add( p[1] ); // same descriptor in read and write
+    t.write().add( p[0] );
+    t.write().remove( p[0] );
+    EXPECT_EQ( 1u, t.check() );
+    EXPECT_TRUE( t.write().ready( p[1] ) );
+    ::close( p[0] );
+    ::close( p[1] );
+}
+
+TEST( select, regular_file )
+{
+    FILE* f = ::tmpfile();
+    ASSERT_TRUE( f != NULL );
+    select s;
+    s.read().add( ::fileno( f ) );
+    EXPECT_EQ( 1u, s.wait() ); // as ::select(), regular files are always ready
+    EXPECT_TRUE( s.read().ready( ::fileno( f ) ) );
+    s.read().remove( ::fileno( f ) );
+    EXPECT_EQ( 0u, s.check() );
+    ::fclose( f );
+}
+
+TEST( select, reused_descriptor )
+{
+    int p[2];
+    ASSERT_EQ( 0, ::pipe( p ) );
+    select s;
+    s.read().add( p[0] );
+    ::close( p[0] ); // closed without removing
+    int q[2];
+    ASSERT_EQ( 0, ::pipe( q ) );
+    ASSERT_EQ( p[0], q[0] ); // lowest available descriptor gets reused
+    s.read().add( q[0] );
+    EXPECT_EQ( 1, ::write( q[1], "x", 1 ) );
+    EXPECT_EQ( 1u, s.wait( 1 ) );
+    EXPECT_TRUE( s.read().ready( q[0] ) );
+    ::close( p[1] );
+    ::close( q[0] );
+    ::close( q[1] );
+}
+
+#ifdef COMMA_IO_SELECT_EPOLL
+TEST( select, many_descriptors )
+{
+    int p[2];
+    ASSERT_EQ( 0, ::pipe( p ) );
+    std::vector< int > fds;
+    for( unsigned int i = 0; i < 1100; ++i )
+    {
+        int fd = ::dup( p[0] );
+        if( fd < 0 ) { break; } // hit descriptor limit
+        fds.push_back( fd );
+    }
+    select s;
+    for( unsigned int i = 0; i < fds.size(); ++i ) { s.read().add( fds[i] ); }
+    EXPECT_EQ( 0u, s.check() );
+    EXPECT_EQ( 1, ::write( p[1], "x", 1 ) );
+    EXPECT_EQ( fds.size(), s.wait( 1 ) );
+    EXPECT_TRUE( s.read().ready( fds.back() ) );
+    for( unsigned int i = 0; i < fds.size(); ++i ) { s.read().remove( fds[i] ); ::close( fds[i] ); }
+    ::close( p[0] );
+    ::close( p[1] );
+}
+
+TEST( select, closed_descriptor )
+{
+    int p[2];
+    ASSERT_EQ( 0, ::pipe( p ) );
+    ::close( p[0] );
+    select s;
+    EXPECT_THROW( s.read().add( p[0] ), comma::exception ); // ::select() would fail in wait() with EBADF instead
+    int q[2];
+    ASSERT_EQ( 0, ::pipe( q ) );
+    s.read().add( q[0] );
+    EXPECT_EQ( 1, ::write( q[1], "x", 1 ) );
+    ::close( q[0] ); // closed without removing: never ready, no error
+    EXPECT_EQ( 0u, s.check() );
+    EXPECT_FALSE( s.read().ready( q[0] ) );
+    ::close( p[1] );
+    ::close( q[1] );
+}
+#endif // #ifdef COMMA_IO_SELECT_EPOLL
+
+} } // namespace comma { namespace io {
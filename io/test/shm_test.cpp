@@ -0,0 +1,160 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include "../../base/exception.h"
+#include "../shm.h"
+#include "../stream.h"
+
+namespace comma { namespace io {
+
+static std::string name( const std::string& s ) { return "comma-shm-test-" + s + "-" + boost::lexical_cast< std::string >( ::getpid() ); }
+
+static void write( shm::writer* w, const std::vector< char >* data, std::size_t chunk )
+{
+    for( std::size_t i = 0; i < data->size(); i += chunk ) { w->write( &( *data )[i], std::min( chunk, data->size() - i ) ); }
+    w->close();
+}
+
+TEST( shm, wrap_around )
+{
+    shm::writer w( name( "wrap" ), 1000 );
+    shm::reader r( name( "wrap" ) );
+    std::vector< char > data( 100000 );
+    for( std::size_t i = 0; i < data.size(); ++i ) { data[i] = char( i * 7 + i / 255 ); }
+    boost::thread t( boost::bind( &write, &w, &data, 333 ) ); // writer has to wait for reader all the time
+    std::vector< char > received;
+    char buf[97];
+    for( std::size_t n; ( n = r.read( buf, sizeof( buf ) ) ) > 0; ) { received.insert( received.end(), buf, buf + n ); }
+    t.join();
+    EXPECT_TRUE( received == data );
+}
+
+TEST( shm, records )
+{
+    shm::writer w( name( "records" ), 1000, 24 );
+    EXPECT_EQ( 1008u, w.capacity() );
+    shm::reader r( name( "records" ) );
+    EXPECT_EQ( 24u, r.record_size() );
+    EXPECT_EQ( 1u, w.readers() );
+    std::vector< char > data( 24 * 1000 );
+    for( std::size_t i = 0; i < data.size(); ++i ) { data[i] = char( i / 24 ); }
+    boost::thread t( boost::bind( &write, &w, &data, 10 ) ); // chunks not aligned with records
+    unsigned int count = 0;
+    for( const char* p; ( p = r.record() ) != NULL; ++count )
+    {
+        EXPECT_EQ( std::string( 24, char( count ) ), std::string( p, 24 ) );
+        r.consume( r.record_size() );
+    }
+    t.join();
+    EXPECT_EQ( 1000u, count );
+}
+
+TEST( shm, try_write )
+{
+    shm::writer w( name( "try" ), 100 );
+    EXPECT_TRUE( w.try_write( "0123456789", 10 ) ); // no readers: ring is overwritten
+    shm::reader r( name( "try" ) );
+    EXPECT_EQ( 0u, r.available() ); // reader starts at current position
+    for( unsigned int i = 0; i < 10; ++i ) { EXPECT_TRUE( w.try_write( "0123456789", 10 ) ); }
+    EXPECT_FALSE( w.try_write( "0", 1 ) );
+    EXPECT_EQ( 100u, r.available() );
+    char buf[50];
+    EXPECT_EQ( 50u, r.read( buf, 50 ) );
+    EXPECT_TRUE( w.try_write( "0123456789", 10 ) );
+    r.close();
+    EXPECT_EQ( 0u, w.readers() );
+    EXPECT_TRUE( w.try_write( &std::string( 100, 'x' )[0], 100 ) );
+}
+
+TEST( shm, incomplete_record )
+{
+    shm::writer w( name( "incomplete" ), 100, 10 );
+    w.write( "01234", 5 ); // no readers, incomplete record not published
+    EXPECT_FALSE( w.try_write( &std::string( 96, 'x' )[0], 96 ) ); // would overwrite incomplete record
+    shm::reader r( name( "incomplete" ) );
+    w.write( "56789", 5 );
+    const char* p = r.record();
+    ASSERT_TRUE( p != NULL );
+    EXPECT_EQ( "0123456789", std::string( p, 10 ) );
+}
+
+TEST( shm, dead_attaching_reader )
+{
+    shm::writer w( name( "dead" ), 100 );
+    pid_t pid = ::fork();
+    ASSERT_LE( 0, pid );
+    if( pid == 0 ) { ::_exit( 0 ); }
+    ASSERT_EQ( pid, ::waitpid( pid, NULL, 0 ) );
+    int fd = ::shm_open( ( "/" + name( "dead" ) ).c_str(), O_RDWR, 0 );
+    ASSERT_LE( 0, fd );
+    void* m = ::mmap( NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    ASSERT_TRUE( m != MAP_FAILED );
+    *reinterpret_cast< comma::int32* >( static_cast< char* >( m ) + 200 ) = pid; // pid of the first reader slot, whose cursor is still unset, as if reader died attaching
+    ::munmap( m, 4096 );
+    EXPECT_EQ( 1u, w.readers() );
+    EXPECT_TRUE( w.try_write( "0123456789", 10 ) ); // does not wait for the dead reader
+    EXPECT_EQ( 0u, w.readers() );
+}
+
+TEST( shm, stream )
+{
+    io::ostream os( "shm:" + name( "stream" ) );
+    io::istream is( "shm:" + name( "stream" ) );
+    EXPECT_EQ( io::invalid_file_descriptor, is.fd() );
+    *os << "hello" << std::endl << 1234 << std::endl;
+    std::string line;
+    std::getline( *is, line );
+    EXPECT_EQ( "hello", line );
+    std::getline( *is, line );
+    EXPECT_EQ( "1234", line );
+    *os << "world";
+    os.close();
+    std::getline( *is, line );
+    EXPECT_EQ( "world", line );
+    EXPECT_TRUE( is->eof() );
+}
+
+TEST( shm, reader_not_found )
+{
+    EXPECT_THROW( shm::reader( name( "none" ), false ), comma::exception );
+}
+
+} } // namespace comma { namespace io {
@@ -0,0 +1,136 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/lexical_cast.hpp>
+#include "../../base/exception.h"
+#include "../impl/udp.h"
+
+namespace comma { namespace io {
+
+class receiver
+{
+    public:
+        receiver() : fd_( ::socket( AF_INET, SOCK_DGRAM, 0 ) ), port_( 0 )
+        {
+            ::sockaddr_in a;
+            ::memset( &a, 0, sizeof( a ) );
+            a.sin_family = AF_INET;
+            a.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+            ::bind( fd_, reinterpret_cast< ::sockaddr* >( &a ), sizeof( a ) );
+            ::socklen_t size = sizeof( a );
+            ::getsockname( fd_, reinterpret_cast< ::sockaddr* >( &a ), &size );
+            port_ = ntohs( a.sin_port );
+            ::timeval timeout = { 1, 0 };
+            ::setsockopt( fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+        }
+        ~receiver() { ::close( fd_ ); }
+        std::string name() const { return "udp:127.0.0.1:" + boost::lexical_cast< std::string >( port_ ); }
+        std::vector< std::string > receive( unsigned int count )
+        {
+            std::vector< std::string > datagrams;
+            char buf[65536];
+            for( unsigned int i = 0; i < count; ++i )
+            {
+                int size = ::recv( fd_, buf, sizeof( buf ), 0 );
+                if( size < 0 ) { break; }
+                datagrams.push_back( std::string( buf, size ) );
+            }
+            return datagrams;
+        }
+    private:
+        int fd_;
+        unsigned short port_;
+};
+
+TEST( udp, unicast )
+{
+    receiver r;
+    impl::udp_sender s( r.name() );
+    s.write( "hello", 5 );
+    s.write( "world", 5 );
+    std::vector< std::string > d = r.receive( 2 );
+    ASSERT_EQ( 2u, d.size() );
+    EXPECT_EQ( "hello", d[0] );
+    EXPECT_EQ( "world", d[1] );
+    EXPECT_EQ( 2u, s.count() );
+}
+
+TEST( udp, fragments_and_sequence )
+{
+    receiver r;
+    impl::udp_sender s( r.name() + ";sequence;size=12" );
+    s.write( "0123456789", 10 );
+    std::vector< std::string > d = r.receive( 3 );
+    ASSERT_EQ( 3u, d.size() );
+    const char* expected[] = { "0123", "4567", "89" };
+    for( unsigned int i = 0; i < d.size(); ++i )
+    {
+        ASSERT_LE( sizeof( comma::uint64 ), d[i].size() );
+        comma::uint64 sequence;
+        ::memcpy( &sequence, &d[i][0], sizeof( comma::uint64 ) );
+        EXPECT_EQ( i, sequence );
+        EXPECT_EQ( expected[i], d[i].substr( sizeof( comma::uint64 ) ) );
+    }
+}
+
+TEST( udp, batch )
+{
+    receiver r;
+    impl::udp_sender s( r.name() + ";batch=3" );
+    s.write( "a", 1 );
+    s.write( "b", 1 );
+    EXPECT_EQ( 0u, s.count() );
+    s.write( "c", 1 );
+    EXPECT_EQ( 3u, s.count() );
+    s.write( "d", 1 );
+    s.flush();
+    std::vector< std::string > d = r.receive( 4 );
+    ASSERT_EQ( 4u, d.size() );
+    EXPECT_EQ( "abcd", d[0] + d[1] + d[2] + d[3] );
+}
+
+TEST( udp, invalid )
+{
+    EXPECT_THROW( impl::udp_sender( "udp:127.0.0.1:1234:5" ), comma::exception );
+    EXPECT_THROW( impl::udp_sender( "udp:127.0.0.1:1234;size=70000" ), comma::exception );
+    EXPECT_THROW( impl::udp_sender( "udp:127.0.0.1:1234;batch=0" ), comma::exception );
+    EXPECT_THROW( impl::udp_sender( "udp:127.0.0.1:1234;blah=1" ), comma::exception );
+    EXPECT_THROW( impl::udp_sender( "udp:239.255.0.1:1234;ttl=300" ), comma::exception ); // would wrap to 44
+}
+
+} } // namespace comma { namespace io {
@@ -33,7 +33,10 @@
 #define COMMA_SYNC_LAZY_HEADER_GUARD_
 
 #include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
 
 namespace comma {
 
@@ -80,6 +83,111 @@ class lazy
         }
 };
 
+/// lazy initialization wrapper that can be shared between threads: the
+/// value is made exactly once, by whichever thread gets to it first,
+/// while other threads wait; if making the value throws, the next access
+/// tries again
+///
+/// once the value is made, access costs a single atomic load, no locking
+///
+/// \note the value itself is not protected: share it read-only, e.g. a
+///       lookup table, or synchronize access to it otherwise
+template < typename T >
+class concurrent_lazy : public boost::noncopyable
+{
+    public:
+        typedef boost::function< T() > functor_t;
+        
+        concurrent_lazy() : ready_( false ) {}
+        
+        concurrent_lazy( const functor_t& make_value ) : make_value_( make_value ), ready_( false ) {}
+        
+        T& get() { make_(); return *value_; }
+        
+        const T& get() const { make_(); return *value_; }
+        
+        operator T() { return get(); }
+        
+        operator T() const { return get(); }
+        
+        T& operator*() { return get(); }
+        
+        const T& operator*() const { return get(); }
+        
+        T* operator->() { return &get(); }
+        
+        const T* operator->() const { return &get(); }
+        
+        /// return true, if value already made
+        bool ready() const { return __atomic_load_n( &ready_, __ATOMIC_ACQUIRE ); }
+        
+    private:
+        mutable boost::optional< T > value_;
+        functor_t make_value_;
+        mutable bool ready_;
+        mutable boost::mutex mutex_;
+        void make_() const
+        {
+            if( __atomic_load_n( &ready_, __ATOMIC_ACQUIRE ) ) { return; }
+            boost::mutex::scoped_lock lock( mutex_ );
+            if( ready_ ) { return; }
+            if( make_value_ ) { value_.reset( make_value_() ); } else { value_ = T(); }
+            __atomic_store_n( &ready_, true, __ATOMIC_RELEASE );
+        }
+};
+
+/// lazy initialization wrapper with a separate value for each thread,
+/// e.g. for thread-local caches or scratch buffers: each thread makes
+/// its own value on its first access; the value is destroyed, when the
+/// thread exits
+///
+/// \note as with boost::thread_specific_ptr, instances must outlive all the
+///       threads that use them, i.e. never destroy an instance while another
+///       thread that has accessed it is still running: per-thread values are
+///       keyed by the address of the instance, thus such a thread would keep
+///       the value of the destroyed instance and get it back from a new
+///       instance at the same address, even if of a different type; destroying
+///       an instance destroys only the value of the destroying thread, values
+///       of other threads are destroyed when those threads exit
+///
+/// \note make_value gets called from different threads, thus it must
+///       be safe to call concurrently
+template < typename T >
+class thread_local_lazy : public boost::noncopyable
+{
+    public:
+        typedef boost::function< T() > functor_t;
+        
+        thread_local_lazy() {}
+        
+        thread_local_lazy( const functor_t& make_value ) : make_value_( make_value ) {}
+        
+        T& get() { make_(); return *value_; }
+        
+        const T& get() const { make_(); return *value_; }
+        
+        operator T() { return get(); }
+        
+        operator T() const { return get(); }
+        
+        T& operator*() { return get(); }
+        
+        const T& operator*() const { return get(); }
+        
+        T* operator->() { return &get(); }
+        
+        const T* operator->() const { return &get(); }
+        
+    private:
+        mutable boost::thread_specific_ptr< T > value_;
+        functor_t make_value_;
+        void make_() const
+        {
+            if( value_.get() ) { return; }
+            value_.reset( make_value_ ? new T( make_value_() ) : new T );
+        }
+};
+
 } // namespace comma {
 
 #endif // #ifndef COMMA_SYNC_LAZY_HEADER_GUARD_
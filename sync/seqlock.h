@@ -0,0 +1,124 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_SYNC_SEQLOCK_HEADER_GUARD_
+#define COMMA_SYNC_SEQLOCK_HEADER_GUARD_
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "../base/types.h"
+
+namespace comma {
+
+/// value protected by a sequence lock: readers never block writers and
+/// never write to shared memory; they copy the value and retry, if a
+/// writer changed it meanwhile; writers are serialized by a mutex
+///
+/// for small plain (trivially copyable) types, e.g. a configuration
+/// struct of numbers, read on every record and rarely changed; the value
+/// is copied byte by byte, thus for large or non-trivial types rather
+/// use snapshot (see snapshot.h)
+///
+/// see unit test for examples
+template < typename T >
+class seqlock
+{
+    public:
+        /// constructor
+        seqlock( const T& t = T() ) : t_( t ), sequence_( 0 ) {}
+
+        /// return consistent copy of the value
+        T read() const;
+
+        /// write new value
+        void write( const T& t ) { boost::mutex::scoped_lock lock( mutex_ ); write_( t ); }
+
+        /// writer: gives access to a copy of the current value, which
+        /// gets published on destruction; readers see either the old
+        /// or the new value, never something in between
+        class scoped_transaction
+        {
+            public:
+                /// constructor, locks writer mutex
+                scoped_transaction( seqlock& s ) : seqlock_( s ), lock_( s.mutex_ ), t_( s.t_ ) {}
+
+                /// destructor, publishes the value
+                ~scoped_transaction() { seqlock_.write_( t_ ); }
+
+                /// access operators
+                T& operator*() { return t_; }
+                const T& operator*() const { return t_; }
+                T* operator->() { return &t_; }
+                const T* operator->() const { return &t_; }
+
+            private:
+                seqlock& seqlock_;
+                boost::mutex::scoped_lock lock_;
+                T t_;
+        };
+
+    private:
+        friend class scoped_transaction;
+        T t_;
+        comma::uint64 sequence_; // odd, while writing
+        boost::mutex mutex_;
+        void write_( const T& t );
+};
+
+template < typename T >
+inline T seqlock< T >::read() const
+{
+    T t;
+    unsigned char* to = reinterpret_cast< unsigned char* >( &t );
+    const unsigned char* from = reinterpret_cast< const unsigned char* >( &t_ );
+    while( true )
+    {
+        comma::uint64 sequence = __atomic_load_n( &sequence_, __ATOMIC_ACQUIRE );
+        if( sequence & 1 ) { boost::this_thread::yield(); continue; } // writer in progress
+        for( std::size_t i = 0; i < sizeof( T ); ++i ) { to[i] = __atomic_load_n( from + i, __ATOMIC_RELAXED ); }
+        __atomic_thread_fence( __ATOMIC_ACQUIRE ); // do not let the copying drift past checking the sequence
+        if( __atomic_load_n( &sequence_, __ATOMIC_RELAXED ) == sequence ) { return t; }
+    }
+}
+
+template < typename T >
+inline void seqlock< T >::write_( const T& t )
+{
+    const unsigned char* from = reinterpret_cast< const unsigned char* >( &t );
+    unsigned char* to = reinterpret_cast< unsigned char* >( &t_ );
+    comma::uint64 sequence = sequence_;
+    __atomic_store_n( &sequence_, sequence + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE ); // readers seeing any new byte also see odd sequence
+    for( std::size_t i = 0; i < sizeof( T ); ++i ) { __atomic_store_n( to + i, from[i], __ATOMIC_RELAXED ); }
+    __atomic_store_n( &sequence_, sequence + 2, __ATOMIC_RELEASE );
+}
+
+} // namespace comma {
+
+#endif // #ifndef COMMA_SYNC_SEQLOCK_HEADER_GUARD_
@@ -0,0 +1,152 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COMMA_SYNC_SNAPSHOT_HEADER_GUARD_
+#define COMMA_SYNC_SNAPSHOT_HEADER_GUARD_
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include "../base/types.h"
+
+namespace comma {
+
+/// read-copy-update style shared value: writers publish a new immutable
+/// version of the value, while readers keep using the version they have
+/// got, until they refresh; an old version is destroyed, once the last
+/// reader lets go of it
+///
+/// readers in hot loops use a reader handle, one per thread: it keeps
+/// the current version and checks for a new one with a single atomic
+/// load, i.e. no lock and no atomic read-modify-write, unless the value
+/// actually has changed
+///
+/// see unit test for examples
+template < typename T >
+class snapshot
+{
+    public:
+        /// constructors
+        snapshot() : t_( new T ), version_( 0 ) {}
+        snapshot( const T& t ) : t_( new T( t ) ), version_( 0 ) {}
+        snapshot( T* t ) : t_( t ), version_( 0 ) {}
+
+        /// return current version
+        boost::shared_ptr< const T > get() const { comma::uint64 v; return get_( v ); }
+
+        /// publish new value; waits for a transaction in progress, if any
+        void set( const T& t ) { set( new T( t ) ); }
+
+        /// publish new value, take ownership; waits for a transaction in progress, if any
+        void set( T* t ) { boost::mutex::scoped_lock lock( writer_mutex_ ); publish_( t ); }
+
+        /// writer: gives access to a copy of the current value, which
+        /// gets published on destruction; writers are serialized
+        class scoped_transaction
+        {
+            public:
+                /// constructor
+                scoped_transaction( snapshot& s ) : snapshot_( s ), lock_( s.writer_mutex_ ), t_( new T( *s.get() ) ) {}
+
+                /// destructor, publishes the value
+                ~scoped_transaction() { snapshot_.publish_( t_ ); }
+
+                /// access operators
+                T& operator*() { return *t_; }
+                const T& operator*() const { return *t_; }
+                T* operator->() { return t_; }
+                const T* operator->() const { return t_; }
+
+            private:
+                snapshot& snapshot_;
+                boost::mutex::scoped_lock lock_;
+                T* t_;
+        };
+
+        /// reader handle, use one per thread; references and pointers it
+        /// returns stay valid until next access through it or refresh()
+        class reader
+        {
+            public:
+                /// constructor
+                reader( const snapshot& s ) : snapshot_( s ), t_( s.get_( version_ ) ) {}
+
+                /// pick up the newest version, if any; return true, if changed
+                bool refresh();
+
+                /// access operators, refresh first
+                const T& operator*() { refresh(); return *t_; }
+                const T* operator->() { refresh(); return t_.get(); }
+
+                /// return version last picked up without refreshing
+                boost::shared_ptr< const T > current() const { return t_; }
+
+            private:
+                const snapshot& snapshot_;
+                boost::shared_ptr< const T > t_;
+                comma::uint64 version_;
+        };
+
+    private:
+        friend class scoped_transaction;
+        friend class reader;
+        boost::shared_ptr< const T > t_;
+        comma::uint64 version_;
+        mutable boost::mutex mutex_; // protects t_
+        boost::mutex writer_mutex_; // serializes transactions
+        boost::shared_ptr< const T > get_( comma::uint64& version ) const
+        {
+            boost::mutex::scoped_lock lock( mutex_ );
+            version = version_;
+            return t_;
+        }
+        void publish_( T* t );
+};
+
+template < typename T >
+inline void snapshot< T >::publish_( T* t )
+{
+    boost::shared_ptr< const T > p( t );
+    {
+        boost::mutex::scoped_lock lock( mutex_ );
+        t_.swap( p );
+        __atomic_store_n( &version_, version_ + 1, __ATOMIC_RELEASE );
+    }
+} // old version, if not used by any reader, gets destroyed here, outside of the lock
+
+template < typename T >
+inline bool snapshot< T >::reader::refresh()
+{
+    if( __atomic_load_n( &snapshot_.version_, __ATOMIC_ACQUIRE ) == version_ ) { return false; }
+    t_ = snapshot_.get_( version_ );
+    return true;
+}
+
+} // namespace comma {
+
+#endif // #ifndef COMMA_SYNC_SNAPSHOT_HEADER_GUARD_
@@ -35,16 +35,42 @@
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 namespace comma {
 
+namespace impl {
+
+template < typename Mutex > struct shared_lock
+{
+    static void lock( Mutex& m ) { m.lock(); }
+    static void unlock( Mutex& m ) { m.unlock(); }
+};
+
+template <> struct shared_lock< boost::shared_mutex >
+{
+    static void lock( boost::shared_mutex& m ) { m.lock_shared(); }
+    static void unlock( boost::shared_mutex& m ) { m.unlock_shared(); }
+};
+
+} // namespace impl {
+
 /// wrapper synchronizing access to the whole class, rather
 /// than to some of its methods, as otherwise we would need
 /// to write a wrapper exposing all the class's methods
 /// protected by a mutex; owns the class;
 ///
+/// Mutex: boost::recursive_mutex by default; with boost::shared_mutex,
+/// const_scoped_transaction takes a shared lock, thus any number of
+/// readers can access the class at the same time, while writers
+/// (scoped_transaction) get exclusive access; boost::shared_mutex is not
+/// recursive, i.e. do not nest transactions in the same thread
+///
+/// see seqlock.h and snapshot.h for read-mostly data, where readers
+/// should not take a lock at all
+///
 /// see unit test for examples
-template < typename T >
+template < typename T, typename Mutex = boost::recursive_mutex >
 class synchronized
 {
     public:
@@ -63,6 +89,12 @@ class synchronized
         /// unlock
         void unlock() const { mutex_.unlock(); }
 
+        /// lock for reading: shared lock for boost::shared_mutex, same as lock() otherwise
+        void lock_shared() const { impl::shared_lock< Mutex >::lock( mutex_ ); }
+
+        /// unlock after reading
+        void unlock_shared() const { impl::shared_lock< Mutex >::unlock( mutex_ ); }
+
         /// accessor class
         class scoped_transaction
         {
@@ -88,11 +120,11 @@ class synchronized
         class const_scoped_transaction
         {
             public:
-                /// constructor, locks mutex
-                const_scoped_transaction( const synchronized& s ) : synchronized_( s ) { synchronized_.lock(); }
+                /// constructor, locks mutex for reading
+                const_scoped_transaction( const synchronized& s ) : synchronized_( s ) { synchronized_.lock_shared(); }
 
                 /// destructor, unlocks mutex
-                ~const_scoped_transaction() { synchronized_.unlock(); }
+                ~const_scoped_transaction() { synchronized_.unlock_shared(); }
 
                 /// access operators
                 const T& operator*() const { return *synchronized_.t_; }
@@ -107,7 +139,7 @@ class synchronized
         friend class scoped_transaction;
         friend class const_scoped_transaction;
         boost::scoped_ptr< T > t_;
-        mutable boost::recursive_mutex mutex_;
+        mutable Mutex mutex_;
 };
 
 } // namespace comma {
@@ -27,8 +27,10 @@
 // OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
 // IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <vector>
 #include <gtest/gtest.h>
 #include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 #include "../lazy.h"
 
 namespace comma { namespace sync { namespace test {
@@ -102,4 +104,47 @@ TEST( lazy, functions )
     }
 }
 
+static unsigned int made;
+
+static tested make_counted() { __atomic_add_fetch( &made, 1, __ATOMIC_SEQ_CST ); boost::this_thread::sleep( boost::posix_time::milliseconds( 10 ) ); return tested( 777, "counted" ); }
+
+static void get_concurrent( const comma::concurrent_lazy< tested >* e, unsigned int* a ) { *a = ( *e )->a; }
+
+TEST( lazy, concurrent )
+{
+    made = 0;
+    comma::concurrent_lazy< tested > e( &make_counted );
+    EXPECT_FALSE( e.ready() );
+    std::vector< unsigned int > a( 8, 0 );
+    boost::thread_group threads;
+    for( unsigned int i = 0; i < a.size(); ++i ) { threads.create_thread( boost::bind( &get_concurrent, &e, &a[i] ) ); }
+    threads.join_all();
+    EXPECT_EQ( 1u, made );
+    EXPECT_TRUE( e.ready() );
+    for( unsigned int i = 0; i < a.size(); ++i ) { EXPECT_EQ( 777u, a[i] ); }
+    EXPECT_EQ( "counted", e->name );
+    EXPECT_EQ( 1u, made );
+}
+
+static void get_thread_local( comma::thread_local_lazy< tested >* e, const tested** p )
+{
+    ( *e )->a += 1;
+    *p = &e->get();
+    EXPECT_EQ( 778u, ( *e )->a ); // same value on each access in the same thread
+}
+
+TEST( lazy, per_thread )
+{
+    made = 0;
+    comma::thread_local_lazy< tested > e( &make_counted );
+    EXPECT_EQ( 777u, e->a );
+    std::vector< const tested* > p( 4, NULL );
+    boost::thread_group threads;
+    for( unsigned int i = 0; i < p.size(); ++i ) { threads.create_thread( boost::bind( &get_thread_local, &e, &p[i] ) ); }
+    threads.join_all();
+    EXPECT_EQ( 5u, made );
+    EXPECT_EQ( 777u, e->a );
+    for( unsigned int i = 0; i < p.size(); ++i ) { EXPECT_TRUE( p[i] != &e.get() ); }
+}
+
 } } } // namespace comma { namespace sync { namespace test {
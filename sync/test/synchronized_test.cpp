@@ -0,0 +1,193 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include "../seqlock.h"
+#include "../snapshot.h"
+#include "../synchronized.h"
+
+namespace comma { namespace sync { namespace test {
+
+TEST( synchronized, basics )
+{
+    comma::synchronized< std::vector< int > > v;
+    {
+        comma::synchronized< std::vector< int > >::scoped_transaction t( v );
+        t->push_back( 1 );
+        comma::synchronized< std::vector< int > >::scoped_transaction u( v ); // recursive mutex by default
+        u->push_back( 2 );
+    }
+    comma::synchronized< std::vector< int > >::const_scoped_transaction t( v );
+    EXPECT_EQ( 2u, t->size() );
+}
+
+TEST( synchronized, shared )
+{
+    typedef comma::synchronized< std::vector< int >, boost::shared_mutex > synchronized_t;
+    synchronized_t v;
+    {
+        synchronized_t::scoped_transaction t( v );
+        t->push_back( 1 );
+    }
+    synchronized_t::const_scoped_transaction r( v );
+    synchronized_t::const_scoped_transaction s( v ); // readers share the lock
+    EXPECT_EQ( 1u, r->size() );
+    EXPECT_EQ( 1, ( *s )[0] );
+}
+
+struct config
+{
+    comma::uint64 a;
+    comma::uint64 b; // always a + 1
+    double c;
+    config() : a( 0 ), b( 1 ), c( 0 ) {}
+};
+
+static void write_configs( seqlock< config >* s, unsigned int count )
+{
+    for( unsigned int i = 0; i < count; ++i )
+    {
+        seqlock< config >::scoped_transaction t( *s );
+        t->a = i;
+        t->c = i * 0.5;
+        t->b = t->a + 1;
+    }
+}
+
+TEST( seqlock, basics )
+{
+    seqlock< config > s;
+    EXPECT_EQ( 1u, s.read().b );
+    config c;
+    c.a = 5;
+    c.b = 6;
+    s.write( c );
+    EXPECT_EQ( 5u, s.read().a );
+    EXPECT_EQ( 6u, s.read().b );
+}
+
+TEST( seqlock, threads )
+{
+    seqlock< config > s;
+    boost::thread writer( boost::bind( &write_configs, &s, 100000 ) );
+    bool consistent = true;
+    comma::uint64 last = 0;
+    bool monotonic = true;
+    for( unsigned int i = 0; i < 100000; ++i )
+    {
+        config c = s.read();
+        consistent = consistent && c.b == c.a + 1 && c.c == c.a * 0.5;
+        monotonic = monotonic && c.a >= last;
+        last = c.a;
+    }
+    writer.join();
+    EXPECT_TRUE( consistent );
+    EXPECT_TRUE( monotonic );
+    EXPECT_EQ( 99999u, s.read().a );
+}
+
+struct settings
+{
+    std::string name;
+    std::vector< int > values;
+};
+
+static void update_settings( snapshot< settings >* s, unsigned int count )
+{
+    for( unsigned int i = 1; i <= count; ++i )
+    {
+        snapshot< settings >::scoped_transaction t( *s );
+        t->values.push_back( i );
+        t->name = std::string( i % 7, 'x' );
+    }
+}
+
+TEST( snapshot, basics )
+{
+    snapshot< settings > s;
+    snapshot< settings >::reader r( s );
+    EXPECT_TRUE( r->values.empty() );
+    boost::shared_ptr< const settings > old = s.get();
+    {
+        snapshot< settings >::scoped_transaction t( s );
+        t->name = "hello";
+    }
+    EXPECT_TRUE( old->name.empty() ); // old version is immutable and stays alive
+    EXPECT_EQ( "", r.current()->name ); // reader has not refreshed yet
+    EXPECT_EQ( "hello", r->name );
+    EXPECT_FALSE( r.refresh() );
+    settings n;
+    n.values.push_back( 5 );
+    s.set( n );
+    EXPECT_TRUE( r.refresh() );
+    EXPECT_EQ( 5, ( *r ).values[0] );
+}
+
+static void set_name( snapshot< settings >* s, const std::string& name ) { settings t; t.name = name; s->set( t ); }
+
+TEST( snapshot, set_during_transaction )
+{
+    snapshot< settings > s;
+    boost::scoped_ptr< boost::thread > setter;
+    {
+        snapshot< settings >::scoped_transaction t( s );
+        t->name = "transaction";
+        setter.reset( new boost::thread( boost::bind( &set_name, &s, "set" ) ) );
+        boost::this_thread::sleep( boost::posix_time::milliseconds( 50 ) );
+        EXPECT_EQ( "", s.get()->name ); // set() waits for transaction
+    }
+    setter->join();
+    EXPECT_EQ( "set", s.get()->name ); // not overwritten by the transaction, which started earlier
+}
+
+TEST( snapshot, threads )
+{
+    snapshot< settings > s;
+    boost::thread writer( boost::bind( &update_settings, &s, 1000 ) );
+    snapshot< settings >::reader r( s );
+    bool consistent = true;
+    std::size_t last = 0;
+    for( unsigned int i = 0; i < 100000; ++i )
+    {
+        const settings& t = *r;
+        consistent = consistent && t.values.size() >= last && t.name.size() == t.values.size() % 7;
+        last = t.values.size();
+    }
+    writer.join();
+    EXPECT_TRUE( consistent );
+    EXPECT_EQ( 1000u, r->values.size() );
+}
+
+} } } // namespace comma { namespace sync { namespace test {